@@ -6,6 +6,9 @@
 #include <math.h>
 #include <locale.h>
 #include <getopt.h>
+#include <strings.h>
+#include <sys/stat.h>
+#include <pthread.h>
 
 #include <omp.h>
 
@@ -28,6 +31,12 @@
 #include "nlk_wv_class.h"
 #include "nlk_dataset.h"
 #include "nlk_util.h"
+#include "nlk_random.h"
+#include "nlk_pca.h"
+#include "nlk_kmeans.h"
+#include "nlk_class_score.h"
+#include "nlk_mem.h"
+#include "nlk_snapshot.h"
 
 
 
@@ -44,16 +53,26 @@
 enum cmd_opts_t { 
     /* general options */
     CMD_OPTS_THREADS = 1,   /**< specify language model */
+    CMD_OPTS_SEED,          /**< random number generator seed */
+    CMD_OPTS_MEM_BUDGET,    /**< memory budget (bytes, K/M/G suffix) */
+    CMD_OPTS_PHASE_THREADS, /**< per phase number of threads */
+    CMD_OPTS_AFFINITY,      /**< pin threads to cpus/cores/nodes */
     /* unsupervised train/nn options */
     CMD_OPTS_MODEL,         /**< specify language model */
     CMD_OPTS_TRAIN,         /**< train from file */
     CMD_OPTS_EPOCHS,        /**< number of epochs */
     CMD_OPTS_LEARN_RATE,    /**< starting learning rate */
     CMD_OPTS_LEARN_DECAY,   /**< learning rate decay */
+    CMD_OPTS_ADAGRAD,       /**< AdaGrad learning rate for lookup layers */
     CMD_OPTS_NEGATIVE,      /**< number of negative examples to use */
     CMD_OPTS_VECTOR_SIZE,   /**< word/pv size */
     CMD_OPTS_WINDOW,        /**< context window  size = [window, window]*/
     CMD_OPTS_SAMPLE,        /**< undersample rate for words */
+    CMD_OPTS_SUBWORDS,      /**< char n-gram buckets */
+    CMD_OPTS_SUBWORD_MIN,   /**< min char n-gram size */
+    CMD_OPTS_SUBWORD_MAX,   /**< max char n-gram size */
+    CMD_OPTS_PV_MAP,        /**< back the paragraph vectors with a file */
+    CMD_OPTS_PUBLISH,       /**< publish a snapshot every n words */
     /* supervised sentence labelling options */
     CMD_OPTS_TRAIN_SENT,    /**< CONLL format file */
     CMD_OPTS_EVAL_SENT,     /**< CONLL format file */
@@ -70,6 +89,8 @@ enum cmd_opts_t {
     CMD_OPTS_IMPORT_VOCAB,  /**< import vocab from file */
     CMD_OPTS_MIN_COUNT,     /**< minimum token frequency */
     CMD_OPTS_REPLACEMENT,   /**< replace low freq tokens with special token */
+    CMD_OPTS_MAX_WORDS,     /**< maximum number of words (hashing) */
+    CMD_OPTS_HASH_BUCKETS,  /**< hash words beyond max words into buckets */
     /* serialization/output */
     CMD_OPTS_SAVE_NET,      /**< save neural net to file */
     CMD_OPTS_LOAD_NET,      /**< load neural net from file */
@@ -78,9 +99,23 @@ enum cmd_opts_t {
     CMD_OPTS_OUT_PVS,       /**< save/export PVs */
     CMD_OPTS_OUT_FORMAT,    /**< output format */
     CMD_OPTS_PREFIX_PVS,    /**< prefix paragraph ids with string in export */
+    /* dimensionality reduction */
+    CMD_OPTS_REDUCE,        /**< reduce exported vectors to this size */
+    CMD_OPTS_REDUCE_TABLE,  /**< the table to reduce (words, pvs) */
+    CMD_OPTS_PROJ_SAVE,     /**< save the projection */
+    CMD_OPTS_PROJ_LOAD,     /**< project generated PVs with this */
+    /* clustering */
+    CMD_OPTS_KMEANS,        /**< k-means with this number of clusters */
+    CMD_OPTS_KMEANS_TABLE,  /**< the table to cluster (words, pvs, gen) */
+    CMD_OPTS_KMEANS_ITER,   /**< maximum k-means iterations */
+    CMD_OPTS_KMEANS_BATCH,  /**< mini-batch size (0 = full batch) */
+    CMD_OPTS_KMEANS_OUT,    /**< save the cluster of each row */
     /* PV generation (inference/test) */
     CMD_OPTS_GEN_PVS,       /**< generate paragraph vectors for file */
     CMD_OPTS_GEN_SAVE,      /**< save generated PVs according to FORMAT */
+    CMD_OPTS_GEN_INIT,      /**< initialization of generated PVs */
+    CMD_OPTS_GEN_TOL,       /**< stop generating a PV when it converges */
+    CMD_OPTS_GEN_BATCH,     /**< PVs inferred at once per thread */
     /* evaluation */
     CMD_OPTS_EVAL_QUESTIONS,    /**< eval model on question answering */
     CMD_OPTS_EVAL_PARAPHRASES,  /**< eval model on paraphrase corpus */
@@ -111,21 +146,40 @@ Neural Network Language Tool.\n\
 \n\
 General Options:\n\
   --threads [INT]       number of threads to use (default: 0 - all procs)\n\
+  --phase-threads [SPEC]\n\
+                        threads per phase, e.g. vocab=8,train=cores\n\
+                        phases: vocab, count, train, infer, eval\n\
+                        (also read from the NLK_PHASE_THREADS variable)\n\
+  --affinity[=MODE]     pin threads: cpu (default), core or numa\n\
+  --seed [INT]          random seed (default: from the clock)\n\
+  --mem-budget [SIZE]   fit this memory budget (e.g. 8G) or refuse to run\n\
 \n\
 Training/Classification:\n\
-  --model [STRING]          language model: CBOW, SG, PVDM, PVDBOW\n\
+  --model [STRING]          language model: CBOW, SG, PVDM, PVDBOW,\n\
+                            PVDBOW-PURE (PVs only, no word vectors)\n\
   --concat                  use concatenate variant (valid if --model PVDM)\n\
   --corpus [FILE]           train model with this (text) file\n\
   --line-ids                line's start with ids (paragraph ids)\n\
+  --lower                   lower case text as it is read\n\
+  --case-fold               case fold text as it is read (unicode)\n\
   --train                   train unsupervised model (--model)\n\
   --iter [INT]              number of train epochs (default: 20)\n\
   --alpha [FLOAT]           the initial learning rate\n\
   --decay [FLOAT]           the learning rate decay\n\
   --hs                      use hierarchical softmax\n\
   --negative [INT]          the number of negative sampling examples\n\
+  --adagrad [FLOAT]         AdaGrad word/paragraph vectors at this rate\n\
+                            (e.g. 0.4)\n\
   --size [INT]              the size of word/paragraph vectors\n\
   --window [INT]            the size of the context window\n\
   --sample [FLOAT]          the word undersampling rate\n\
+  --subwords [INT]          use this many char n-gram buckets (not concat)\n\
+  --minn [INT]              min char n-gram size (default: 3)\n\
+  --maxn [INT]              max char n-gram size (default: 6)\n\
+  --pv-map [FILE]           keep the paragraph vectors in this (mapped) file\n\
+                            (with --load-net: read them from this file)\n\
+  --publish [INT]           snapshot the model every INT words trained, with\n\
+                            --questions evaluate each snapshot while training\n\
 \n\
 Supervised Sentence-Word Classification Options:\n\
   --train-sent-word [FILE]      train classifier with CONLL format file\n\
@@ -139,12 +193,16 @@ Supervised Document Classification Options:\n\
   --test-file [FILE]        test classifier with this file [NOT]\n\
   --test-classes [FILE]     test classifier with this id-class map file[NI!]\n\
   --classify [FILE]         classify this file\n\
+  --stream                  classify in chunks, in constant memory\n\
+  --quantize                classify with an int8 (calibrated) classifier\n\
   --output-class [FILE]     output classification results to this file\n\
 \n\
 Vocabulary:\n\
   --min-count  [INT]    minimum token count\n\
   --load-vocab [FILE]   load the vocabulary to file (includes counts)\n\
   --with-replacement    replace tokens below the minimum with special token \n\
+  --max-words [INT]     keep at most this many words (requires buckets)\n\
+  --hash-buckets [INT]  hash the remaining words into this many buckets\n\
   --save-vocab [FILE]   save the vocabulary to file\n\
   --import-vocab [FILE] import vocabulary from file\n\
 \n\
@@ -158,9 +216,29 @@ Serialization/Export:\n\
   --par-prefix [STR]    prefix paragraph ids when exporting\n\
   --import-words [FILE] import word vectors from file\n\
 \n\
+Dimensionality Reduction (of exported/generated vectors):\n\
+  --reduce [INT]        PCA to this size (randomized SVD)\n\
+  --reduce-random       random projection instead of PCA\n\
+  --reduce-table [STR]  fit on: words (default) or pvs (only a pvs\n\
+                        projection is applied to generated PVs)\n\
+  --save-projection [FILE]  save the projection\n\
+  --projection [FILE]   project generated PVs with this saved projection\n\
+\n\
+Clustering:\n\
+  --kmeans [INT]        k-means with this number of clusters\n\
+  --kmeans-table [STR]  cluster: words (default), pvs or gen (generated)\n\
+  --kmeans-iter [INT]   maximum iterations (default 100)\n\
+  --kmeans-batch [INT]  mini-batch size (default 0: full batch)\n\
+  --kmeans-output [FILE] save the cluster of each row (\"id class\",\n\
+                        the id is the word for words)\n\
+\n\
 Paragraph Vector Inference:\n\
   --gen-pvs [FILE]      generate paragraph vectors for this file\n\
   --gen-output [FILE]   output generated paragraph vectors\n\
+  --gen-init [STRING]   start PVs from: random, words (average), model\n\
+  --gen-tol [FLOAT]     stop when the relative PV change is below this\n\
+  --gen-batch [INT]     PVs each thread infers at once (default: 1,\n\
+                        interleaved if > 1, same result)\n\
 \n\
 Evaluation:\n\
   --questions [FILE]    evaluate on question corpus\n\
@@ -180,6 +258,69 @@ Miscellaneous:\n\
     /**@TODO printf("Example:\n"); */
 }
 
+/**
+ * Abort if the options need the word vectors of a model that has none: pure
+ * PV-DBOW only keeps a placeholder row (see nlk_w2v_create)
+ */
+static void
+nlk_check_word_vectors(const NLK_LM lm_type, const bool words_needed)
+{
+    if(lm_type == NLK_PVDBOW_PURE && words_needed) {
+        NLK_ERROR_ABORT("PVDBOW-PURE has no word vectors (--output-words, "
+                        "--questions, --reduce, --kmeans)", NLK_EINVAL);
+        /* unreachable */
+    }
+}
+
+/** @struct nlk_monitor_t
+ * Evaluates the snapshots published while training (--publish)
+ */
+struct nlk_monitor_t {
+    struct nlk_publisher_t  *pub;           /**< the training's publisher */
+    struct nlk_vocab_t     **vocab;         /**< the vocabulary */
+    const char              *questions;     /**< word-analogy questions */
+    size_t                   eval_limit;    /**< limit eval to first n */
+    bool                     done;          /**< training finished */
+};
+
+/**
+ * Monitor thread: evaluate each new snapshot on the word-analogy questions
+ */
+static void *
+nlk_monitor_snapshots(void *arg)
+{
+    struct nlk_monitor_t *mon = (struct nlk_monitor_t *) arg;
+    struct nlk_snapshot_t *snap;
+    size_t last = 0;
+    bool done = false;
+    nlk_real accuracy;
+
+    while(!done) {
+        /* after done, the final snapshot is the current one */
+        done = __atomic_load_n(&mon->done, __ATOMIC_ACQUIRE);
+        snap = nlk_snapshot_pin(mon->pub);
+        if(snap != NULL && snap->epoch != last) {
+            last = snap->epoch;
+            accuracy = 0;
+            /* one thread, outside of the training's thread setup */
+            nlk_eval_on_questions_threads(mon->questions, mon->vocab, 
+                                          snap->nn.words->weights, 
+                                          snap->nn.subwords, mon->eval_limit,
+                                          false, 1, &accuracy);
+            printf("\nsnapshot %zu (%zu words): accuracy = %f%%\n", 
+                   snap->epoch, snap->words, accuracy * 100);
+            fflush(stdout);
+        }
+        nlk_snapshot_unpin(snap);
+        if(!done) {
+            usleep(100000);
+        }
+    }
+    nlk_workspace_thread_free();
+
+    return NULL;
+}
+
 void
 nlk_export_words(struct nlk_layer_lookup_t *table, struct nlk_vocab_t **vocab, 
            NLK_FILE_FORMAT format, const char *path, const bool verbose)
@@ -219,6 +360,11 @@ main(int argc, char **argv)
     /** @subsection General Options
      */
     int num_threads             = 0;    /**< number of threads to use */
+    uint64_t seed               = 0;    /**< random seed (0 = from clock) */
+    size_t mem_budget           = 0;    /**< memory budget (0 = none) */
+    char *phase_threads         = NULL; /**< per phase threads spec */
+    NLK_AFFINITY affinity = NLK_AFFINITY_NONE; /**< thread pinning */
+    char *pv_map_auto           = NULL; /**< PV table file (budget) */
 
     /** @subsection Vocabulary Options
      */
@@ -228,6 +374,8 @@ main(int argc, char **argv)
     static int replace          = 0;    /**< replace low freq tokens */
     char *import_vocab_file     = NULL; /**< import vocabulary from file */
     char *load_vocab_file       = NULL; /**< load vocabulary from file */
+    size_t max_words            = 0;    /**< max words kept (0 = all) */
+    size_t hash_buckets         = 0;    /**< OOV hash buckets (0 = none) */
 
     /** @subsection Model Options
      */
@@ -239,6 +387,7 @@ main(int argc, char **argv)
      */
     char *corpus_file           = NULL; /**< train model on this file */
     static int line_ids         = 0;    /**< lines begin with paragraph ids */
+    static int normalize        = -1;   /**< text case (-1 = from the model) */
     static int hs               = 0;    /**< use hierarchical softmax */
     static int train            = 0;    /**< unsupervised train */
     size_t vector_size          = 100;  /**< word vector size */    
@@ -247,7 +396,13 @@ main(int argc, char **argv)
     int iter                    = 20;   /**< number of iterations/epochs */
     nlk_real learn_rate         = 0;    /**< learning rate (start) */
     nlk_real learn_rate_decay   = 0;    /**< learning rate decay */
+    nlk_real adagrad            = 0;    /**< AdaGrad learning rate (0: SGD) */
     float sample_rate           = 1e-3; /**< random undersample of freq words */
+    size_t subword_buckets      = 0;    /**< char n-gram buckets (0 = none) */
+    unsigned int subword_min    = NLK_SUBWORD_MIN_N; /**< min n-gram size */
+    unsigned int subword_max    = NLK_SUBWORD_MAX_N; /**< max n-gram size */
+    char *pv_map_file           = NULL; /**< file backing the PV table */
+    size_t publish_words        = 0;    /**< snapshot every n words (0: no)*/
 
     /** @subsection sentence labelling
      */
@@ -262,6 +417,8 @@ main(int argc, char **argv)
     char *class_test_file       = NULL; /**< test class map file */
     char *classify_file         = NULL; /**< a file to classify */
     char *class_out_file        = NULL; /**< classification output file */
+    static int stream           = 0;    /**< stream the file to classify */
+    static int quantize         = 0;    /**< int8 classifier */
 
     /** @subsection Serialization &  Export
      */
@@ -273,11 +430,32 @@ main(int argc, char **argv)
     char *output_pvs_file       = NULL; /**< save PVs to this file */
     char *format_name           = NULL; /**< format option as a string */
     NLK_FILE_FORMAT format      = NLK_FILE_BIN;
+
+    /** @subsection Dimensionality Reduction
+     */
+    size_t reduce               = 0;    /**< reduce to this size (0 = no) */
+    static int reduce_random    = 0;    /**< random projection (not PCA) */
+    char *reduce_table          = NULL; /**< table to fit: words or pvs */
+    char *projection_save_file  = NULL; /**< save the projection here */
+    char *projection_file       = NULL; /**< load a projection from here */
+    struct nlk_pca_t *projection = NULL;/**< the projection */
+    bool project_words          = false;/**< projection fit on words */
+
+    /** @subsection Clustering
+     */
+    size_t kmeans               = 0;    /**< number of clusters (0 = no) */
+    char *kmeans_table          = NULL; /**< table to cluster */
+    size_t kmeans_iter          = NLK_KMEANS_ITER; /**< max iterations */
+    size_t kmeans_batch         = 0;    /**< mini-batch size (0 = full) */
+    char *kmeans_file           = NULL; /**< save the clusters here */
     
     /** @subsection Paragraph Vector Generation (Inferance/Test) Variables
      */
     char *gen_paragraphs_file   = NULL; /**< generate PVs from this file */
     char *pvs_save_file         = NULL; /**< save generated PVs to this file */
+    char *gen_init_name         = NULL; /**< PV initialization (string) */
+    float gen_tol               = 0;    /**< PV convergence tolerance */
+    unsigned int gen_batch      = NLK_PV_BATCH; /**< PVs inferred at once */
 
     /** @subsection Evaluation
      */
@@ -306,7 +484,14 @@ main(int argc, char **argv)
             {"hs",              no_argument,       &hs,             1  },
             {"train",           no_argument,       &train,          1  },
             {"line-ids",        no_argument,       &line_ids,       1  },
+            {"lower",           no_argument,       &normalize,
+                                                    NLK_NORMALIZE_LOWER },
+            {"case-fold",       no_argument,       &normalize,
+                                                NLK_NORMALIZE_CASE_FOLD },
             {"remove-pvs",      no_argument,       &remove_pvs,     1  },
+            {"reduce-random",   no_argument,       &reduce_random,  1  },
+            {"stream",          no_argument,       &stream,         1  },
+            {"quantize",        no_argument,       &quantize,       1  },
             {"help",            no_argument,       &show_help,      1  },
             {"version",         no_argument,       &show_version,   1  },
             {"verbose",         no_argument,       &verbose,        1  },
@@ -315,15 +500,25 @@ main(int argc, char **argv)
              */
             /* general options */
             {"threads",         required_argument, 0, CMD_OPTS_THREADS       },
+            {"seed",            required_argument, 0, CMD_OPTS_SEED          },
+            {"mem-budget",      required_argument, 0, CMD_OPTS_MEM_BUDGET    },
+            {"phase-threads",   required_argument, 0, CMD_OPTS_PHASE_THREADS },
+            {"affinity",        optional_argument, 0, CMD_OPTS_AFFINITY      },
             /* train/nn/context options */
             {"model",           required_argument, 0, CMD_OPTS_MODEL         },
             {"corpus",          required_argument, 0, CMD_OPTS_TRAIN         },
             {"iter",            required_argument, 0, CMD_OPTS_EPOCHS        },
             {"alpha",           required_argument, 0, CMD_OPTS_LEARN_RATE    },
             {"negative",        required_argument, 0, CMD_OPTS_NEGATIVE      },
+            {"adagrad",         required_argument, 0, CMD_OPTS_ADAGRAD       },
             {"size",            required_argument, 0, CMD_OPTS_VECTOR_SIZE   },
             {"window",          required_argument, 0, CMD_OPTS_WINDOW        },
             {"sample",          required_argument, 0, CMD_OPTS_SAMPLE        },
+            {"subwords",        required_argument, 0, CMD_OPTS_SUBWORDS      },
+            {"minn",            required_argument, 0, CMD_OPTS_SUBWORD_MIN   },
+            {"maxn",            required_argument, 0, CMD_OPTS_SUBWORD_MAX   },
+            {"pv-map",          required_argument, 0, CMD_OPTS_PV_MAP        },
+            {"publish",         required_argument, 0, CMD_OPTS_PUBLISH       },
             /* supervised sentence labelling */
             {"train-sent-word", required_argument, 0, CMD_OPTS_TRAIN_SENT    },
             {"test-sent-word",  required_argument, 0, CMD_OPTS_TEST_SENT     },
@@ -340,6 +535,8 @@ main(int argc, char **argv)
             {"load-vocab",      required_argument, 0, CMD_OPTS_LOAD_VOCAB    },
             {"min-count",       required_argument, 0, CMD_OPTS_MIN_COUNT     },
             {"import-vocab",    required_argument, 0, CMD_OPTS_IMPORT_VOCAB  },
+            {"max-words",       required_argument, 0, CMD_OPTS_MAX_WORDS     },
+            {"hash-buckets",    required_argument, 0, CMD_OPTS_HASH_BUCKETS  },
             /* serialization */
             {"save-net",        required_argument, 0, CMD_OPTS_SAVE_NET      },
             {"load-net",        required_argument, 0, CMD_OPTS_LOAD_NET      },
@@ -348,8 +545,22 @@ main(int argc, char **argv)
             {"output-pvs",      required_argument, 0, CMD_OPTS_OUT_PVS       },
             {"format",          required_argument, 0, CMD_OPTS_OUT_FORMAT    },
             {"par-prefix",      required_argument, 0, CMD_OPTS_PREFIX_PVS    },
+            /* dimensionality reduction */
+            {"reduce",          required_argument, 0, CMD_OPTS_REDUCE        },
+            {"reduce-table",    required_argument, 0, CMD_OPTS_REDUCE_TABLE  },
+            {"save-projection", required_argument, 0, CMD_OPTS_PROJ_SAVE     },
+            {"projection",      required_argument, 0, CMD_OPTS_PROJ_LOAD     },
+            /* clustering */
+            {"kmeans",          required_argument, 0, CMD_OPTS_KMEANS        },
+            {"kmeans-table",    required_argument, 0, CMD_OPTS_KMEANS_TABLE  },
+            {"kmeans-iter",     required_argument, 0, CMD_OPTS_KMEANS_ITER   },
+            {"kmeans-batch",    required_argument, 0, CMD_OPTS_KMEANS_BATCH  },
+            {"kmeans-output",   required_argument, 0, CMD_OPTS_KMEANS_OUT    },
             /* PV generation (inferance/test) */
             {"gen-pvs",         required_argument, 0, CMD_OPTS_GEN_PVS       },
+            {"gen-init",        required_argument, 0, CMD_OPTS_GEN_INIT      },
+            {"gen-tol",         required_argument, 0, CMD_OPTS_GEN_TOL       },
+            {"gen-batch",       required_argument, 0, CMD_OPTS_GEN_BATCH     },
             {"gen-output",      required_argument, 0, CMD_OPTS_GEN_SAVE      },
             /* intrinsic evaluation */
             {"questions",  required_argument, 0, CMD_OPTS_EVAL_QUESTIONS     },
@@ -378,6 +589,18 @@ main(int argc, char **argv)
             case CMD_OPTS_THREADS:
                 num_threads = atoi(optarg);
                 break;
+            case CMD_OPTS_SEED:
+                seed = strtoull(optarg, NULL, 10);
+                break;
+            case CMD_OPTS_MEM_BUDGET:
+                mem_budget = nlk_mem_parse_size(optarg);
+                break;
+            case CMD_OPTS_PHASE_THREADS:
+                phase_threads = optarg;
+                break;
+            case CMD_OPTS_AFFINITY:
+                affinity = nlk_affinity(optarg);
+                break;
             /* train/nn options */
             case CMD_OPTS_MODEL:
                 model_name = optarg;
@@ -397,6 +620,9 @@ main(int argc, char **argv)
             case CMD_OPTS_NEGATIVE:
                 negative = atoi(optarg);
                 break;
+            case CMD_OPTS_ADAGRAD:
+                adagrad = atof(optarg);
+                break;
             case CMD_OPTS_VECTOR_SIZE:
                 vector_size = atoi(optarg);
                 break;
@@ -406,6 +632,21 @@ main(int argc, char **argv)
             case CMD_OPTS_SAMPLE:
                 sample_rate = atof(optarg);
                 break;
+            case CMD_OPTS_SUBWORDS:
+                subword_buckets = atol(optarg);
+                break;
+            case CMD_OPTS_SUBWORD_MIN:
+                subword_min = atoi(optarg);
+                break;
+            case CMD_OPTS_SUBWORD_MAX:
+                subword_max = atoi(optarg);
+                break;
+            case CMD_OPTS_PV_MAP:
+                pv_map_file = optarg;
+                break;
+            case CMD_OPTS_PUBLISH:
+                publish_words = strtoull(optarg, NULL, 10);
+                break;
             /* supervised document classification */
             case CMD_OPTS_CLASS:
                 class_train_file = optarg;
@@ -445,6 +686,12 @@ main(int argc, char **argv)
             case CMD_OPTS_IMPORT_VOCAB:
                 import_vocab_file = optarg;
                 break;
+            case CMD_OPTS_MAX_WORDS:
+                max_words = atol(optarg);
+                break;
+            case CMD_OPTS_HASH_BUCKETS:
+                hash_buckets = atol(optarg);
+                break;
             /* serialization/output */
             case CMD_OPTS_SAVE_NET:
                 nn_save_file = optarg;
@@ -464,6 +711,35 @@ main(int argc, char **argv)
             case CMD_OPTS_OUT_FORMAT:
                 format_name = optarg;
                 break;
+            /* dimensionality reduction */
+            case CMD_OPTS_REDUCE:
+                reduce = strtoull(optarg, NULL, 10);
+                break;
+            case CMD_OPTS_REDUCE_TABLE:
+                reduce_table = optarg;
+                break;
+            case CMD_OPTS_PROJ_SAVE:
+                projection_save_file = optarg;
+                break;
+            case CMD_OPTS_PROJ_LOAD:
+                projection_file = optarg;
+                break;
+            /* clustering */
+            case CMD_OPTS_KMEANS:
+                kmeans = strtoull(optarg, NULL, 10);
+                break;
+            case CMD_OPTS_KMEANS_TABLE:
+                kmeans_table = optarg;
+                break;
+            case CMD_OPTS_KMEANS_ITER:
+                kmeans_iter = strtoull(optarg, NULL, 10);
+                break;
+            case CMD_OPTS_KMEANS_BATCH:
+                kmeans_batch = strtoull(optarg, NULL, 10);
+                break;
+            case CMD_OPTS_KMEANS_OUT:
+                kmeans_file = optarg;
+                break;
             /* paragraph vector inference (generate/test) */
             case CMD_OPTS_GEN_PVS:
                 gen_paragraphs_file = optarg;
@@ -471,6 +747,15 @@ main(int argc, char **argv)
             case CMD_OPTS_GEN_SAVE:
                 pvs_save_file = optarg;
                 break;
+            case CMD_OPTS_GEN_INIT:
+                gen_init_name = optarg;
+                break;
+            case CMD_OPTS_GEN_TOL:
+                gen_tol = atof(optarg);
+                break;
+            case CMD_OPTS_GEN_BATCH:
+                gen_batch = atoi(optarg);
+                break;
             /* evaluation */
             case CMD_OPTS_EVAL_QUESTIONS:
                 questions_file = optarg;
@@ -500,6 +785,18 @@ main(int argc, char **argv)
         exit(0);
     }
 
+    /* words beyond --max-words are folded into the hash buckets */
+    if(max_words > 0 && hash_buckets == 0) {
+        NLK_ERROR_ABORT("--max-words requires --hash-buckets", NLK_EINVAL);
+        /* unreachable */
+    }
+    /* with buckets, rare words are hashed instead of replaced */
+    if(replace && hash_buckets > 0) {
+        NLK_ERROR_ABORT("--with-replacement conflicts with --hash-buckets", 
+                        NLK_EINVAL);
+        /* unreachable */
+    }
+
     /* show help and quit */
     if(show_help) {
         print_help();
@@ -530,6 +827,7 @@ main(int argc, char **argv)
         printf("Running in DEBUG mode!\n");
         printf("MAX WORD SIZE = %d chars\n", NLK_MAX_WORD_SIZE);
         printf("MAX LINE SIZE = %d words\n", NLK_MAX_LINE_SIZE);
+        printf("TRAIN CHUNK SIZE = %d words\n", NLK_CHUNK_SIZE);
     }
 #endif
 
@@ -538,9 +836,24 @@ main(int argc, char **argv)
      */
     /* Global Init */
     nlk_init(); /* initialize random number generator, sigmoid table, locale */
+    if(seed != 0) {
+        nlk_random_init_xs1024(seed);
+    }
+    nlk_set_affinity(affinity);
     nlk_set_num_threads(num_threads);
+    if(getenv("NLK_PHASE_THREADS") != NULL &&
+       nlk_set_phase_threads_spec(getenv("NLK_PHASE_THREADS")) 
+       != NLK_SUCCESS) {
+        nlk_log_message("Invalid NLK_PHASE_THREADS (e.g. train=cores)");
+        return NLK_FAILURE;
+    }
+    if(phase_threads != NULL && 
+       nlk_set_phase_threads_spec(phase_threads) != NLK_SUCCESS) {
+        nlk_log_message("Invalid --phase-threads (e.g. train=cores)");
+        return NLK_FAILURE;
+    }
     if(verbose) {
-        printf("num threads: %d\n", nlk_get_num_threads());
+        nlk_threads_print();
     }
 
     /* Model Type */
@@ -550,9 +863,25 @@ main(int argc, char **argv)
         lm_type = nlk_lm_model(model_name, concat);
     }
 
+    /* options that use the word vectors (not the paragraph vectors) */
+    const bool words_needed = output_words_file != NULL || 
+        questions_file != NULL ||
+        (reduce > 0 && (reduce_table == NULL || 
+                        strcasecmp(reduce_table, "pvs") != 0)) ||
+        (kmeans > 0 && (kmeans_table == NULL || 
+                        (strcasecmp(kmeans_table, "pvs") != 0 && 
+                         strcasecmp(kmeans_table, "gen") != 0)));
+    nlk_check_word_vectors(lm_type, words_needed);
+
     /* Output File Format */
     format = nlk_format(format_name);
 
+    /* PV inference */
+    NLK_PV_OPTS pv_opts = { .epochs = iter, .tol = gen_tol, 
+                            .init = nlk_pv_init_type(gen_init_name),
+                            .table = NULL, .batch = gen_batch, 
+                            .adagrad = adagrad, .iterations = 0 };
+
     /* learn rate */
     if(learn_rate <= 0) {
         learn_rate = nlk_lm_learn_rate(lm_type);
@@ -576,6 +905,11 @@ main(int argc, char **argv)
         }
     }
 
+    /* text normalization (before any text is read) */
+    if(normalize >= 0) {
+        nlk_text_set_normalize(normalize);
+    }
+
     /** @ section Load or Create Neural Network and Corpus
      */
     struct nlk_neuralnet_t *nn = NULL;
@@ -583,15 +917,74 @@ main(int argc, char **argv)
     /** @subsection Load the neural network
      */
     if(nn_load_file != NULL) {
+        /* the default NEG table is built on load: shrink it if it would 
+         * take more than a quarter of the budget */
+        if(mem_budget > 0 && 
+           NLK_NEG_TABLE_SIZE * sizeof(size_t) > mem_budget / 4) {
+            nlk_vocab_neg_table_set_size(NLK_MEM_NEG_TABLE_MIN);
+        }
         nlk_tic("Loading Neural Network from ", false);
         printf("%s\n", nn_load_file);
 
         /* load */
         nn = nlk_neuralnet_load_path(nn_load_file, verbose);
+
+        /* read text as the model was trained unless told otherwise */
+        if(normalize < 0) {
+            nlk_text_set_normalize(nn->train_opts.normalize);
+        } else {
+            nn->train_opts.normalize = nlk_text_get_normalize();
+        }
+        /* paragraph vectors kept in a mapped file (--pv-map when trained) */
+        if(pv_map_file != NULL) {
+            NLK_ARRAY *pvs = nlk_array_open_map(pv_map_file, true);
+            if(pvs == NULL || pvs->cols != nn->words->weights->cols) {
+                NLK_ERROR_ABORT("paragraph vector file does not match the "
+                                "network", NLK_EINVAL);
+                /* unreachable */
+            }
+            if(nn->paragraphs != NULL) {
+                nlk_layer_lookup_free(nn->paragraphs);
+            }
+            nn->paragraphs = nlk_layer_lookup_create_from_array(pvs);
+            nn->train_opts.paragraph = true;
+            if(verbose) {
+                printf("paragraph vectors (%zu) read from %s\n", pvs->rows,
+                       pv_map_file);
+            }
+        }
         if(verbose) {
             nlk_tic("Neural Network loaded from ", false);
             printf("%s\n", nn_load_file);
         }
+        nlk_check_word_vectors(nn->train_opts.model_type, words_needed);
+        nlk_mem_phase("load");
+
+        /* memory plan: the loaded tables and the threads must fit */
+        if(mem_budget > 0) {
+            struct nlk_mem_plan_t plan;
+            const NLK_PHASE phase = train ? NLK_PHASE_TRAIN : NLK_PHASE_INFER;
+
+            nlk_mem_plan_infer(&plan, nn, 0, 0, 1, 
+                               nlk_get_phase_threads(phase));
+            if(nlk_mem_plan_fit(&plan, mem_budget, verbose) != NLK_SUCCESS) {
+                nlk_mem_plan_print(&plan, mem_budget);
+                nlk_log_message("Memory budget too small for the loaded "
+                                "network");
+                return NLK_FAILURE;
+            }
+
+            /* apply */
+            nlk_set_phase_threads(phase, plan.threads);
+            if(nn->neg_table != NULL && 
+               plan.neg_table_size < nn->neg_table_size) {
+                free(nn->neg_table);
+                nn->neg_table_size = plan.neg_table_size;
+                nn->neg_table = nlk_vocab_neg_table_create(&nn->vocab, 
+                                                    nn->neg_table_size,
+                                                    NLK_NEG_TABLE_POW);
+            }
+        }
 
     } 
      /** @subsection Create the neural network
@@ -602,8 +995,21 @@ main(int argc, char **argv)
             nlk_tic("creating vocabulary for ", false);
             printf("%s min_count = %d\n", corpus_file, min_count);
         }
-        vocab = nlk_vocab_create(corpus_file, line_ids, min_count, replace, 
-                                 verbose);
+        if(hash_buckets > 0) {
+            /* keep all counts, then hash everything beyond max words: the
+             * counting itself still holds the whole corpus vocabulary */
+            vocab = nlk_vocab_create(corpus_file, line_ids, 0, false, 
+                                     verbose);
+            nlk_vocab_reduce_hash(&vocab, min_count, max_words, 
+                                  hash_buckets);
+            if(verbose) {
+                printf("vocabulary: hashed into %zu buckets (words: %zu)\n",
+                        hash_buckets, nlk_vocab_size(&vocab));
+            }
+        } else {
+            vocab = nlk_vocab_create(corpus_file, line_ids, min_count, 
+                                     replace, verbose);
+        }
         if(verbose) {
             nlk_tic("vocabulary created", true);
         }
@@ -664,9 +1070,54 @@ main(int argc, char **argv)
         train_opts.word_count = total_words;
         train_opts.paragraph_count = total_lines;
         train_opts.line_ids = line_ids;
+        train_opts.subword_buckets = subword_buckets;
+        train_opts.subword_min = subword_min;
+        train_opts.subword_max = subword_max;
+        train_opts.normalize = nlk_text_get_normalize();
+        train_opts.paragraph_map = pv_map_file;
+        train_opts.adagrad = adagrad;
+        nlk_mem_phase("vocabulary");
+
+        /* memory plan: fit the budget (or refuse) before allocating */
+        if(verbose || mem_budget > 0) {
+            struct nlk_mem_plan_t plan;
+            struct nlk_context_opts_t plan_ctx;
+
+            nlk_lm_context_opts(lm_type, window, &vocab, &plan_ctx);
+            nlk_mem_plan_train(&plan, &train_opts, concat, 
+                               nlk_vocab_size(&vocab), plan_ctx.max_size,
+                               nlk_get_phase_threads(NLK_PHASE_TRAIN));
+            plan.can_map = train_opts.paragraph && nn_save_file != NULL;
+            if(publish_words > 0) {
+                /* the monitor pins a snapshot while the next is published */
+                plan.snapshots = NLK_MEM_SNAPSHOTS + 
+                                 (questions_file != NULL ? 1 : 0);
+            }
+            if(nlk_mem_plan_fit(&plan, mem_budget, verbose) != NLK_SUCCESS) {
+                nlk_mem_plan_print(&plan, mem_budget);
+                nlk_log_message("Memory budget too small for these options");
+                return NLK_FAILURE;
+            }
+            nlk_mem_plan_print(&plan, mem_budget);
+
+            /* apply */
+            nlk_vocab_neg_table_set_size(plan.neg_table_size);
+            nlk_set_phase_threads(NLK_PHASE_TRAIN, plan.threads);
+            if(plan.paragraphs_map > 0 && train_opts.paragraph_map == NULL) {
+                pv_map_auto = (char *) malloc(strlen(nn_save_file) + 5);
+                if(pv_map_auto == NULL) {
+                    NLK_ERROR_ABORT("unable to allocate memory", NLK_ENOMEM);
+                    /* unreachable */
+                }
+                sprintf(pv_map_auto, "%s.pvs", nn_save_file);
+                train_opts.paragraph_map = pv_map_auto;
+                printf("paragraph vectors backed by %s\n", pv_map_auto);
+            }
+        }
 
         /* create network */
         nn = nlk_w2v_create(train_opts, concat, vocab, verbose);
+        nlk_mem_phase("create");
     } 
 
     /**@section Unsupervised Train 
@@ -678,11 +1129,49 @@ main(int argc, char **argv)
                     nn->train_opts.sample, nn->train_opts.window);
         }
 
+        /* snapshots for reading while training */
+        struct nlk_publisher_t *publisher = NULL;
+        struct nlk_monitor_t monitor;
+        pthread_t monitor_thread;
+        bool monitoring = false;
+        int eval_threads = nlk_get_phase_threads(NLK_PHASE_EVAL);
+
+        if(publish_words > 0) {
+            publisher = nlk_publisher_create(publish_words);
+            nlk_w2v_set_publisher(publisher);
+        }
+        if(publisher != NULL && questions_file != NULL) {
+            /* the monitor should not take the training's cpus */
+            nlk_set_phase_threads(NLK_PHASE_EVAL, 1);
+            monitor.pub = publisher;
+            monitor.vocab = &vocab;
+            monitor.questions = questions_file;
+            monitor.eval_limit = eval_limit;
+            monitor.done = false;
+            monitoring = pthread_create(&monitor_thread, NULL, 
+                                        nlk_monitor_snapshots, 
+                                        &monitor) == 0;
+        }
+
         nlk_w2v(nn, corpus_file, verbose);
 
+        if(monitoring) {
+            __atomic_store_n(&monitor.done, true, __ATOMIC_RELEASE);
+            pthread_join(monitor_thread, NULL);
+            nlk_set_phase_threads(NLK_PHASE_EVAL, eval_threads);
+        }
+        if(publisher != NULL) {
+            nlk_w2v_set_publisher(NULL);
+            nlk_publisher_free(publisher);
+            /* no snapshot shares the negative table anymore (see nlk_w2v) */
+            free(nn->neg_table);
+            nn->neg_table = NULL;
+        }
+
         if(verbose) { 
             printf("\nTraining finished\n");
         }
+        nlk_mem_phase("train");
     }
 
 
@@ -753,6 +1242,12 @@ main(int argc, char **argv)
         train_opts.vector_size = vector_size;
         train_opts.word_count = 0;
         train_opts.paragraph_count = 0;
+        train_opts.subword_buckets = 0;
+        train_opts.subword_min = 0;
+        train_opts.subword_max = 0;
+        train_opts.normalize = nlk_text_get_normalize();
+        train_opts.paragraph_map = NULL;
+        train_opts.adagrad = 0;
 
         /* create */
         nn = nlk_wv_class_create_senna(train_opts, vocab, lookup_layer, 
@@ -808,17 +1303,93 @@ main(int argc, char **argv)
 
 
 
+    /** @section Dimensionality Reduction
+     * fit a projection on the words (default) or paragraphs, or load one
+     */
+    if(reduce > 0 && nn != NULL) {
+        NLK_ARRAY *fit_table = nn->words->weights;
+        project_words = true;
+        if(reduce_table != NULL && strcasecmp(reduce_table, "pvs") == 0) {
+            if(nn->paragraphs == NULL) {
+                NLK_ERROR_ABORT("no paragraph vectors to reduce", NLK_EINVAL);
+                /* unreachable */
+            }
+            fit_table = nn->paragraphs->weights;
+            project_words = false;
+        }
+        if(reduce_random) {
+            projection = nlk_pca_random(fit_table->cols, reduce);
+        } else {
+            if(verbose) {
+                nlk_tic("PCA", true);
+            }
+            projection = nlk_pca_fit(fit_table, reduce, verbose);
+        }
+    } else if(projection_file != NULL) {
+        projection = nlk_pca_load_path(projection_file);
+    }
+    if(projection != NULL && projection_save_file != NULL) {
+        nlk_pca_save_path(projection, projection_save_file);
+        if(verbose) {
+            printf("Projection saved to: %s\n", projection_save_file);
+        }
+    }
+
+
+    /** @section Clustering
+     * k-means over the words (default) or paragraphs of the model
+     */
+    if(kmeans > 0 && kmeans_file == NULL) {
+        NLK_ERROR_ABORT("--kmeans requires --kmeans-output", NLK_EINVAL);
+        /* unreachable */
+    }
+    if(kmeans > 0 && nn != NULL && (kmeans_table == NULL || 
+       strcasecmp(kmeans_table, "gen") != 0)) {
+        NLK_ARRAY *cluster_table = nn->words->weights;
+        struct nlk_vocab_t **cluster_vocab = &nn->vocab;
+        if(kmeans_table != NULL && strcasecmp(kmeans_table, "pvs") == 0) {
+            if(nn->paragraphs == NULL) {
+                NLK_ERROR_ABORT("no paragraph vectors to cluster", 
+                                NLK_EINVAL);
+                /* unreachable */
+            }
+            cluster_table = nn->paragraphs->weights;
+            cluster_vocab = NULL;
+        }
+        if(verbose) {
+            nlk_tic("k-means", true);
+        }
+        nlk_kmeans_cluster_path(cluster_table, cluster_vocab, kmeans, 
+                                kmeans_iter, kmeans_batch, kmeans_file, 
+                                verbose);
+    }
+
+
     /** @section Save & Export Vectors
      */
     if(nn != NULL) {
-        /* save paragraph vectors */
-        if(output_pvs_file != NULL) {
+        /* save paragraph vectors (projected if the projection is for PVs) */
+        if(output_pvs_file != NULL && projection != NULL && !project_words) {
+            NLK_ARRAY *proj = nlk_pca_project(projection,
+                                              nn->paragraphs->weights);
+            NLK_LAYER_LOOKUP *reduced =
+                nlk_layer_lookup_create_from_array(proj);
+            nlk_export_pvs(reduced, format, output_pvs_file, verbose);
+            nlk_layer_lookup_free(reduced);
+        } else if(output_pvs_file != NULL) {
             nlk_export_pvs(nn->paragraphs, format, output_pvs_file, verbose);
 
         }
 
-        /* save word vectors */
-        if(output_words_file != NULL) {
+        /* save word vectors (projected if the projection is for words) */
+        if(output_words_file != NULL && projection != NULL && project_words) {
+            NLK_ARRAY *proj = nlk_pca_project(projection, nn->words->weights);
+            NLK_LAYER_LOOKUP *reduced =
+                nlk_layer_lookup_create_from_array(proj);
+            nlk_export_words(reduced, &nn->vocab, format, output_words_file, 
+                             verbose);
+            nlk_layer_lookup_free(reduced);
+        } else if(output_words_file != NULL) {
             nlk_export_words(nn->words, &nn->vocab, format, output_words_file, 
                              verbose);
         }
@@ -849,6 +1420,7 @@ main(int argc, char **argv)
             }
         } /* end vocabulary export */
     } /* end of save/export if(nn != null) */
+    nlk_mem_phase("export");
 
 
     /** @section Paragraph Vector Inference
@@ -860,11 +1432,47 @@ main(int argc, char **argv)
         }
 
 
+        /* memory plan: fit the budget (or refuse) before reading */
+        if(verbose || mem_budget > 0) {
+            struct nlk_mem_plan_t plan;
+            struct stat st;
+            size_t text_bytes = 0;
+
+            if(stat(gen_paragraphs_file, &st) == 0) {
+                text_bytes = st.st_size;
+            }
+            nlk_mem_plan_infer(&plan, nn, 
+                               nlk_text_count_lines(gen_paragraphs_file),
+                               text_bytes, pv_opts.batch, 
+                               nlk_get_phase_threads(NLK_PHASE_INFER));
+            if(nlk_mem_plan_fit(&plan, mem_budget, verbose) != NLK_SUCCESS) {
+                nlk_mem_plan_print(&plan, mem_budget);
+                nlk_log_message("Memory budget too small for these options");
+                return NLK_FAILURE;
+            }
+            nlk_mem_plan_print(&plan, mem_budget);
+
+            /* apply */
+            nlk_set_phase_threads(NLK_PHASE_INFER, plan.threads);
+            pv_opts.batch = plan.batch;
+            if(nn->neg_table != NULL && 
+               plan.neg_table_size < nn->neg_table_size) {
+                free(nn->neg_table);
+                nn->neg_table_size = plan.neg_table_size;
+                nn->neg_table = nlk_vocab_neg_table_create(&nn->vocab, 
+                                                    nn->neg_table_size,
+                                                    NLK_NEG_TABLE_POW);
+            }
+        }
+
+
         /**@subsection Generate Paragraph Vectors
          */
         /* read file */
         struct nlk_corpus_t *corpus_pvs = nlk_corpus_read(gen_paragraphs_file, 
-                                                          &nn->vocab, verbose);
+                                                          &nn->vocab, 
+                                                          nn->subwords,
+                                                          verbose);
         
         /* generate (infer) paragraph vectors */
         NLK_LAYER_LOOKUP *par_table = NULL;
@@ -874,12 +1482,38 @@ main(int argc, char **argv)
             if(verbose) { printf("Generating paragraph vectors\n"); }
 
             /* do generate */
-            par_table = nlk_pv_gen(nn, corpus_pvs, iter, verbose);
+            pv_opts.table = nn->paragraphs;
+            par_table = nlk_pv_gen_opts(nn, corpus_pvs, &pv_opts, verbose);
+            if(verbose) {
+                printf("PV inference: %"PRIu64" iterations (%.2f per line)\n",
+                       pv_opts.iterations, 
+                       pv_opts.iterations / (double) corpus_pvs->len);
+            }
 
         }
         if(par_table != NULL) { pvs = par_table->weights; }
         if(verbose) { printf("\n"); }
 
+        /* project the new PVs (projection fit on or loaded for PVs) */
+        if(pvs != NULL && projection != NULL && !project_words) {
+            NLK_ARRAY *reduced = nlk_pca_project(projection, pvs);
+            nlk_array_free(pvs);
+            pvs = reduced;
+        } else if(pvs != NULL && projection != NULL) {
+            nlk_log_message("projection fit on words: generated PVs are "
+                            "not projected (see --reduce-table)");
+        }
+
+        /* cluster the new PVs */
+        if(pvs != NULL && kmeans > 0 && kmeans_table != NULL && 
+           strcasecmp(kmeans_table, "gen") == 0) {
+            if(verbose) {
+                nlk_tic("k-means", true);
+            }
+            nlk_kmeans_cluster_path(pvs, NULL, kmeans, kmeans_iter, 
+                                    kmeans_batch, kmeans_file, verbose);
+        }
+
 
         /**@subsection Export Generated Paragraph Vectors
          */
@@ -914,6 +1548,7 @@ main(int argc, char **argv)
 
         if(pvs != NULL) { nlk_array_free(pvs); }
         if(corpus_pvs != NULL) { nlk_corpus_free(corpus_pvs); }
+        nlk_mem_phase("inference");
     }
 
 
@@ -924,7 +1559,7 @@ main(int argc, char **argv)
     if(questions_file != NULL && nn != NULL) {
         nlk_tic("evaluating word-analogy", true);
         nlk_eval_on_questions(questions_file, &vocab, nn->words->weights, 
-                              eval_limit, true, &accuracy);
+                              nn->subwords, eval_limit, true, &accuracy);
         printf("accuracy = %f%%\n", accuracy * 100);
     }
     
@@ -962,7 +1597,7 @@ main(int argc, char **argv)
         /* read file */
         struct nlk_corpus_t *corpus_paraphrase = NULL;
         corpus_paraphrase = nlk_corpus_read(paraphrases_file, &nn->vocab, 
-                                            verbose);
+                                            nn->subwords, verbose);
 
         nlk_eval_on_paraphrases(nn, corpus_paraphrase, iter, verbose);
         nlk_corpus_free(corpus_paraphrase);
@@ -976,23 +1611,58 @@ main(int argc, char **argv)
 
     /**@subsection Classify a file
      */
-    if(classify_file != NULL && nn != NULL) {
+    if(classify_file != NULL && nn != NULL && stream) {
+        struct nlk_layer_linear_q8_t *q8 = NULL;
+
+        /* calibrate on the training PVs */
+        if(quantize && nn->paragraphs == NULL) {
+            NLK_ERROR_ABORT("--quantize --stream calibrates on the model's "
+                            "paragraph vectors (saved with --remove-pvs?)", 
+                            NLK_EINVAL);
+            /* unreachable */
+        } else if(quantize) {
+            q8 = nlk_pv_class_quantize(nn, nn->paragraphs->weights, verbose);
+        }
+
+        pv_opts.table = nn->paragraphs;
+        nlk_pv_classify_stream(nn, q8, classify_file, class_out_file, 
+                               &pv_opts, verbose);
+        if(q8 != NULL) { nlk_layer_linear_q8_free(q8); }
+    } else if(classify_file != NULL && nn != NULL) {
         size_t *ids = NULL;
         unsigned int *pred = NULL;
+        unsigned int *pred_float = NULL;
+        struct nlk_layer_linear_q8_t *q8 = NULL;
 
         /* create corpus */
         struct nlk_corpus_t *corpus_classify;
-        corpus_classify = nlk_corpus_read(classify_file, &nn->vocab, verbose);
+        corpus_classify = nlk_corpus_read(classify_file, &nn->vocab, 
+                                          nn->subwords, verbose);
         /* gen pvs */
         struct nlk_layer_lookup_t *par_table;
-        par_table = nlk_pv_gen(nn, corpus_classify, iter, verbose);
+        pv_opts.table = nn->paragraphs;
+        par_table = nlk_pv_gen_opts(nn, corpus_classify, &pv_opts, verbose);
+        if(verbose) {
+            printf("PV inference: %"PRIu64" iterations (%.2f per line)\n", 
+                   pv_opts.iterations, 
+                   pv_opts.iterations / (double) corpus_classify->len);
+        }
 
         /* classify */
-        pred = nlk_pv_classify(nn, par_table, NULL, 0, verbose);
+        ids = nlk_range(corpus_classify->len);
+        pred = nlk_pv_classify(nn, par_table, ids, corpus_classify->len, 
+                               verbose);
+
+        /* int8: calibrate on the inferred PVs, keep float for comparison */
+        if(quantize) {
+            q8 = nlk_pv_class_quantize(nn, par_table->weights, verbose);
+            pred_float = pred;
+            pred = nlk_pv_classify_q8(nn, q8, par_table, ids, 
+                                      corpus_classify->len, verbose);
+        }
 
         /* save classification results */
         if(class_out_file != NULL && pred != NULL) {
-            ids = nlk_range(corpus_classify->len);
             nlk_dataset_save_map_path(class_out_file, ids, 
                                       pred, corpus_classify->len);
         }
@@ -1000,17 +1670,40 @@ main(int argc, char **argv)
         if(class_test_file != NULL) {
             struct nlk_dataset_t *tset = NULL;
             tset = nlk_dataset_load_path(class_test_file);
-                        float acc = 0;
-            acc = nlk_class_score_accuracy(pred, tset->classes, tset->size);
+            struct nlk_class_score_t *score = NULL;
+            float acc = 0;
+            score = nlk_class_score_create(pred, tset->classes, tset->size);
+            acc = nlk_class_score_get_accuracy(score);
             if(verbose) {
                 printf("Test Accuracy: %f (/%zu)\n", acc, tset->size);
-                nlk_class_score_cm_print(pred, tset->classes, tset->size); 
+                nlk_class_score_print(score);
+                nlk_class_score_print_cm(score);
+            }
+            nlk_class_score_free(score);
+            if(pred_float != NULL) {
+                float acc_float = nlk_class_score_accuracy(pred_float, 
+                                                           tset->classes, 
+                                                           tset->size);
+                printf("Test Accuracy: float %f, int8 %f (delta %+f)\n", 
+                       acc_float, acc, acc - acc_float);
             }
             if(tset != NULL) { nlk_dataset_free(tset); }
         }
         if(pred != NULL) { free(pred); }
+        if(pred_float != NULL) { free(pred_float); }
+        if(q8 != NULL) { nlk_layer_linear_q8_free(q8); }
         if(ids != NULL) { free(ids); }
     }
+
+    /* actual peak resident memory */
+    nlk_mem_phase("evaluation");
+    if(verbose || mem_budget > 0) {
+        nlk_mem_phase_print();
+    }
+    if(pv_map_auto != NULL) { free(pv_map_auto); }
+
+    /* memory the threads kept between calls */
+    nlk_pv_threads_free();
        
     return 0;
 }
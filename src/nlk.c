@@ -1,7 +1,19 @@
 
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE /* sched_setaffinity */
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
 #include <stdbool.h>
+#include <limits.h>
 #include <locale.h>
 #include <omp.h>
+#ifdef __linux__
+#include <sched.h>
+#include <dirent.h>
+#endif
 
 #include "nlk_err.h"
 #include "nlk_math.h"
@@ -14,6 +26,27 @@
 
 
 int __nlk_num_threads = 0;  /**< global number of threads */
+/** per phase number of threads (0: global, NLK_THREADS_CORES: cores) */
+static int __nlk_phase_threads[NLK_PHASE_MAX] = { 0 };
+static const char *__nlk_phase_names[NLK_PHASE_MAX] = { 
+    "default", "vocab", "count", "train", "infer", "eval" 
+};
+static NLK_AFFINITY __nlk_affinity = NLK_AFFINITY_NONE; /**< pinning */
+static int __nlk_bound_threads = 0; /**< number of threads last pinned */
+
+/** @struct nlk_topology_t
+ * The cpus available to the process and where they are
+ */
+struct nlk_topology_t {
+    int n_cpus;                 /**< number of available cpus */
+    int n_cores;                /**< number of physical cores */
+    int n_nodes;                /**< number of NUMA nodes */
+    int n_packages;             /**< number of packages (sockets) */
+    int cpu[NLK_MAX_CPUS];      /**< available cpu ids */
+    int core[NLK_MAX_CPUS];     /**< core of each cpu (0..n_cores-1) */
+    int node[NLK_MAX_CPUS];     /**< NUMA node of each cpu (0..n_nodes-1) */
+};
+static struct nlk_topology_t __nlk_topology = { 0 };
 
 
 /**
@@ -62,6 +95,311 @@ nlk_init()
 }
 
 
+/**
+ * Sets the number of BLAS threads (OpenBLAS built with pthreads).
+ * OpenMP builds of OpenBLAS already run single threaded inside parallel 
+ * regions and use the OpenMP threads outside of them (setting their number 
+ * of threads would set the OpenMP one).
+ */
+static void
+nlk_blas_set_num_threads(int num_threads)
+{
+#ifdef OPENBLAS_VERSION
+    if(openblas_get_parallel() == OPENBLAS_THREAD) {
+        openblas_set_num_threads(num_threads);
+    }
+#else
+    (void) num_threads; /* avoid unused warning */
+#endif
+}
+
+/**
+ * BLAS calls are made from inside per example OpenMP loops: each OpenMP 
+ * thread runs its BLAS calls itself (no BLAS threads to oversubscribe the 
+ * machine). This is the default.
+ */
+void
+nlk_blas_single()
+{
+    nlk_blas_set_num_threads(1);
+}
+
+/**
+ * BLAS calls are large standalone operations (e.g. GEMMs over a whole 
+ * table) made outside of OpenMP parallel regions: BLAS gets the thread 
+ * budget. Go back to nlk_blas_single() after.
+ */
+void
+nlk_blas_parallel()
+{
+    nlk_blas_set_num_threads(nlk_get_num_threads());
+}
+
+#ifdef __linux__
+/**
+ * Read an int from a sysfs file
+ *
+ * @return the value or -1 if it can't be read
+ */
+static int
+nlk_sysfs_int(const char *path)
+{
+    FILE *fp = fopen(path, "r");
+    int value = -1;
+
+    if(fp == NULL) {
+        return -1;
+    }
+    if(fscanf(fp, "%d", &value) != 1) {
+        value = -1;
+    }
+    fclose(fp);
+    return value;
+}
+
+/**
+ * The NUMA node of a cpu: the nodeN entry in its sysfs directory
+ *
+ * @return the node or 0 if unknown
+ */
+static int
+nlk_sysfs_cpu_node(const int cpu)
+{
+    char path[128];
+    DIR *dir;
+    struct dirent *entry;
+    int node = 0;
+
+    snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d", cpu);
+    if((dir = opendir(path)) == NULL) {
+        return 0;
+    }
+    while((entry = readdir(dir)) != NULL) {
+        if(strncmp(entry->d_name, "node", 4) == 0 && 
+           sscanf(entry->d_name + 4, "%d", &node) == 1) {
+            break;
+        }
+    }
+    closedir(dir);
+    return node;
+}
+#endif
+
+/**
+ * Finds the cpus available to the process and their cores, NUMA nodes and
+ * packages (Linux sysfs). Elsewhere (or if unknown) every cpu is a core 
+ * on node 0.
+ */
+static void
+nlk_topology_init()
+{
+    struct nlk_topology_t *topo = &__nlk_topology;
+    int core_key[NLK_MAX_CPUS];     /* package * 2^16 + core_id */
+    int node_id[NLK_MAX_CPUS];
+    int packages[NLK_MAX_CPUS];
+    int cc;
+
+    if(topo->n_cpus > 0) {
+        return;
+    }
+
+#ifdef __linux__
+    cpu_set_t set;
+    char path[128];
+    int package;
+    int core;
+
+    if(sched_getaffinity(0, sizeof(cpu_set_t), &set) == 0) {
+        for(int cpu = 0; cpu < CPU_SETSIZE && topo->n_cpus < NLK_MAX_CPUS;
+            cpu++) {
+            if(!CPU_ISSET(cpu, &set)) {
+                continue;
+            }
+            cc = topo->n_cpus;
+            topo->cpu[cc] = cpu;
+
+            snprintf(path, sizeof(path), 
+                "/sys/devices/system/cpu/cpu%d/topology/physical_package_id",
+                cpu);
+            package = nlk_sysfs_int(path);
+            snprintf(path, sizeof(path), 
+                     "/sys/devices/system/cpu/cpu%d/topology/core_id", cpu);
+            core = nlk_sysfs_int(path);
+            if(package < 0 || core < 0) {
+                package = 0;
+                core = (1 << 15) + cpu; /* unknown: its own core */
+            }
+            core_key[cc] = (package << 16) + core;
+            packages[cc] = package;
+            node_id[cc] = nlk_sysfs_cpu_node(cpu);
+            topo->n_cpus++;
+        }
+    }
+#endif
+    if(topo->n_cpus == 0) {
+        topo->n_cpus = omp_get_num_procs();
+        if(topo->n_cpus > NLK_MAX_CPUS) {
+            topo->n_cpus = NLK_MAX_CPUS;
+        }
+        for(cc = 0; cc < topo->n_cpus; cc++) {
+            topo->cpu[cc] = cc;
+            core_key[cc] = cc;
+            packages[cc] = 0;
+            node_id[cc] = 0;
+        }
+    }
+
+    /* number the cores, nodes and packages in order of appearance */
+    for(cc = 0; cc < topo->n_cpus; cc++) {
+        int kk;
+
+        for(kk = 0; kk < cc && core_key[kk] != core_key[cc]; kk++) {
+            ;
+        }
+        topo->core[cc] = kk < cc ? topo->core[kk] : topo->n_cores++;
+
+        for(kk = 0; kk < cc && node_id[kk] != node_id[cc]; kk++) {
+            ;
+        }
+        topo->node[cc] = kk < cc ? topo->node[kk] : topo->n_nodes++;
+
+        for(kk = 0; kk < cc && packages[kk] != packages[cc]; kk++) {
+            ;
+        }
+        if(kk == cc) {
+            topo->n_packages++;
+        }
+    }
+}
+
+/**
+ * The number of physical cores available to the process
+ */
+int
+nlk_get_num_cores()
+{
+    nlk_topology_init();
+    return __nlk_topology.n_cores;
+}
+
+/**
+ * The cpus thread number thread_id gets pinned to for an affinity mode:
+ *  - cpu: the thread_id-th available cpu
+ *  - core: the cpus of the thread_id-th physical core
+ *  - numa: the cpus of NUMA node thread_id % nodes (threads spread across
+ *    the nodes)
+ * Round robin if there are more threads than cpus/cores.
+ *
+ * @param thread_id     the thread number
+ * @param cpus          the cpus (output, size >= NLK_MAX_CPUS)
+ *
+ * @return the number of cpus
+ */
+static int
+nlk_affinity_cpus(const int thread_id, int *cpus)
+{
+    const struct nlk_topology_t *topo = &__nlk_topology;
+    int n = 0;
+    int target;
+
+    switch(__nlk_affinity) {
+        case NLK_AFFINITY_CPU:
+            cpus[n++] = topo->cpu[thread_id % topo->n_cpus];
+            break;
+        case NLK_AFFINITY_CORE:
+            target = thread_id % topo->n_cores;
+            for(int cc = 0; cc < topo->n_cpus; cc++) {
+                if(topo->core[cc] == target) {
+                    cpus[n++] = topo->cpu[cc];
+                }
+            }
+            break;
+        case NLK_AFFINITY_NUMA:
+            target = thread_id % topo->n_nodes;
+            for(int cc = 0; cc < topo->n_cpus; cc++) {
+                if(topo->node[cc] == target) {
+                    cpus[n++] = topo->cpu[cc];
+                }
+            }
+            break;
+        default:
+            break;
+    }
+
+    return n;
+}
+
+/**
+ * Pin the OpenMP worker threads (of a team of num_threads) per the affinity 
+ * mode. The master thread keeps its mask: it also runs the serial code and
+ * the (BLAS) threads it creates inherit its mask. New threads inherit the 
+ * mask of the thread that creates them so this is done again whenever the 
+ * number of threads changes.
+ */
+static void
+nlk_bind_threads(const int num_threads)
+{
+    if(__nlk_affinity == NLK_AFFINITY_NONE || 
+       num_threads == __nlk_bound_threads) {
+        return;
+    }
+    nlk_topology_init();
+    __nlk_bound_threads = num_threads;
+
+#ifdef __linux__
+#pragma omp parallel num_threads(num_threads)
+{
+    cpu_set_t set;
+    int cpus[NLK_MAX_CPUS];
+    const int tid = omp_get_thread_num();
+
+    if(tid != 0) {
+        int n = nlk_affinity_cpus(tid, cpus);
+
+        CPU_ZERO(&set);
+        for(int ii = 0; ii < n; ii++) {
+            CPU_SET(cpus[ii], &set);
+        }
+        if(sched_setaffinity(0, sizeof(cpu_set_t), &set) != 0) {
+            nlk_log_warn("unable to set the cpu affinity");
+        }
+    }
+} /* end of pragma omp parallel */
+#endif
+}
+
+/**
+ * Affinity mode from its name: none, cpu, core or numa
+ */
+NLK_AFFINITY
+nlk_affinity(const char *name)
+{
+    if(name == NULL || strcasecmp(name, "cpu") == 0) {
+        return NLK_AFFINITY_CPU;
+    } else if(strcasecmp(name, "none") == 0) {
+        return NLK_AFFINITY_NONE;
+    } else if(strcasecmp(name, "core") == 0) {
+        return NLK_AFFINITY_CORE;
+    } else if(strcasecmp(name, "numa") == 0) {
+        return NLK_AFFINITY_NUMA;
+    }
+    NLK_ERROR_ABORT("Invalid affinity (none, cpu, core, numa).", NLK_EINVAL);
+    /* unreachable */
+}
+
+/**
+ * Pin the OpenMP threads to cpus, cores or NUMA nodes 
+ * (applied when the number of threads is set)
+ *
+ * @param affinity  the affinity mode
+ */
+void
+nlk_set_affinity(const NLK_AFFINITY affinity)
+{
+    __nlk_affinity = affinity;
+    __nlk_bound_threads = 0;
+}
+
 int
 nlk_set_num_threads(int num_threads)
 {
@@ -72,6 +410,8 @@ nlk_set_num_threads(int num_threads)
     __nlk_num_threads = num_threads;
 
     omp_set_num_threads(num_threads);
+    nlk_blas_single();
+    nlk_bind_threads(num_threads);
     return num_threads;
 }
 
@@ -82,3 +422,203 @@ nlk_get_num_threads() {
     }
     return __nlk_num_threads;
 }
+
+/**
+ * Sets the number of threads for a phase
+ *
+ * @param phase         the phase
+ * @param num_threads   number of threads, 0 for the global number or 
+ *                      NLK_THREADS_CORES for one per physical core
+ */
+void
+nlk_set_phase_threads(const NLK_PHASE phase, const int num_threads)
+{
+    __nlk_phase_threads[phase] = num_threads;
+}
+
+/**
+ * The number of threads of a phase
+ */
+int
+nlk_get_phase_threads(const NLK_PHASE phase)
+{
+    const int num_threads = __nlk_phase_threads[phase];
+
+    if(num_threads == NLK_THREADS_CORES) {
+        return nlk_get_num_cores();
+    } else if(num_threads <= 0) {
+        return nlk_get_num_threads();
+    }
+    return num_threads;
+}
+
+/**
+ * The largest number of threads of any phase (the size of the thread pool)
+ */
+int
+nlk_get_max_threads()
+{
+    int max = nlk_get_num_threads();
+
+    for(int pp = 1; pp < NLK_PHASE_MAX; pp++) {
+        if(nlk_get_phase_threads(pp) > max) {
+            max = nlk_get_phase_threads(pp);
+        }
+    }
+    return max;
+}
+
+/**
+ * Sets per phase threads from a spec: comma separated phase=threads pairs,
+ * e.g. "vocab=8,train=cores,eval=32". The number of threads is a positive 
+ * integer or "cores". Nothing is set if the spec is invalid.
+ *
+ * @return NLK_SUCCESS or NLK_EINVAL for an invalid spec
+ */
+int
+nlk_set_phase_threads_spec(const char *spec)
+{
+    char name[32];
+    char value[32];
+    char *end;
+    long n;
+    int phase_threads[NLK_PHASE_MAX];
+    const char *p = spec;
+    int consumed;
+    int pp;
+
+    memcpy(phase_threads, __nlk_phase_threads, sizeof(phase_threads));
+
+    while(*p != '\0') {
+        if(sscanf(p, " %31[^=, ] = %31[^, ]%n", name, value, &consumed) 
+           != 2) {
+            return NLK_EINVAL;
+        }
+        for(pp = 0; pp < NLK_PHASE_MAX; pp++) {
+            if(strcasecmp(name, __nlk_phase_names[pp]) == 0) {
+                break;
+            }
+        }
+        if(pp == NLK_PHASE_MAX) {
+            return NLK_EINVAL;
+        }
+        if(strcasecmp(value, "cores") == 0) {
+            phase_threads[pp] = NLK_THREADS_CORES;
+        } else {
+            n = strtol(value, &end, 10);
+            if(*end != '\0' || n <= 0 || n > INT_MAX) {
+                return NLK_EINVAL;
+            }
+            phase_threads[pp] = (int) n;
+        }
+
+        p += consumed;
+        while(*p == ' ') {
+            p++;
+        }
+        if(*p == ',') {
+            p++;
+        }
+    }
+
+    memcpy(__nlk_phase_threads, phase_threads, sizeof(phase_threads));
+    return NLK_SUCCESS;
+}
+
+/**
+ * Begins a phase: the following (per example) parallel regions run with the
+ * phase's number of threads, pinned per the affinity mode, with no BLAS 
+ * threads and new per thread random streams (nlk_rng_region). Inside a 
+ * parallel region this is a no-op.
+ *
+ * @param phase the phase
+ *
+ * @return the number of threads for the phase
+ */
+int
+nlk_phase_begin(const NLK_PHASE phase)
+{
+    int num_threads;
+
+    if(omp_in_parallel()) {
+        return omp_get_num_threads();
+    }
+
+    num_threads = nlk_get_phase_threads(phase);
+    omp_set_num_threads(num_threads);
+    nlk_blas_single();
+    nlk_bind_threads(num_threads);
+    nlk_rng_region();
+
+    return num_threads;
+}
+
+/**
+ * Print the topology and the thread layout: per phase threads, BLAS 
+ * threads and affinity
+ */
+void
+nlk_threads_print()
+{
+    const struct nlk_topology_t *topo = &__nlk_topology;
+    const int num_threads = nlk_get_num_threads();
+    int cpus[NLK_MAX_CPUS];
+    int n;
+
+    nlk_topology_init();
+    printf("topology: %d package(s), %d NUMA node(s), %d core(s), "
+           "%d cpu(s)\n", topo->n_packages, topo->n_nodes, topo->n_cores,
+           topo->n_cpus);
+
+    printf("num threads: %d (", num_threads);
+    for(int pp = 1; pp < NLK_PHASE_MAX; pp++) {
+        printf("%s%s %d", pp > 1 ? ", " : "", __nlk_phase_names[pp],
+               nlk_get_phase_threads(pp));
+    }
+    printf(")\n");
+
+#ifdef OPENBLAS_VERSION
+    switch(openblas_get_parallel()) {
+        case OPENBLAS_THREAD:
+            printf("BLAS threads: 1 in parallel loops, %d standalone\n",
+                   num_threads);
+            break;
+        case OPENBLAS_OPENMP:
+            printf("BLAS threads: OpenMP (1 in parallel loops, %d "
+                   "standalone)\n", num_threads);
+            break;
+        default:
+            printf("BLAS threads: 1 (sequential BLAS)\n");
+            break;
+    }
+#else
+    printf("BLAS threads: BLAS default\n");
+#endif
+
+    if(__nlk_affinity == NLK_AFFINITY_NONE) {
+        printf("affinity: none\n");
+        return;
+    }
+#ifdef __linux__
+    printf("affinity: %s, thread -> cpus:", 
+           __nlk_affinity == NLK_AFFINITY_CPU ? "cpu" :
+           __nlk_affinity == NLK_AFFINITY_CORE ? "core" : "numa");
+    /* the master thread is not pinned (see nlk_bind_threads) */
+    printf(" 0->unpinned");
+    for(int tt = 1; tt < num_threads && tt < NLK_THREADS_PRINT; tt++) {
+        n = nlk_affinity_cpus(tt, cpus);
+        printf(" %d->", tt);
+        for(int ii = 0; ii < n; ii++) {
+            printf("%s%d", ii > 0 ? "," : "", cpus[ii]);
+        }
+    }
+    if(num_threads > NLK_THREADS_PRINT) {
+        printf(" ...");
+    }
+    printf("\n");
+#else
+    (void) cpus;
+    (void) n;
+    printf("affinity: not supported\n");
+#endif
+}
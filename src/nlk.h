@@ -77,10 +77,57 @@ enum nlk_file_format_t {
 };
 typedef enum nlk_file_format_t NLK_FILE_FORMAT;
 
+/** @enum NLK_PHASE
+ * Phases that can run with their own number of threads
+ */
+enum nlk_phase_t {
+    NLK_PHASE_DEFAULT = 0,  /**< anything else: the global number */
+    NLK_PHASE_VOCAB   = 1,  /**< vocabulary counting */
+    NLK_PHASE_COUNT   = 2,  /**< counting the words in a corpus */
+    NLK_PHASE_TRAIN   = 3,  /**< training */
+    NLK_PHASE_INFER   = 4,  /**< PV inference */
+    NLK_PHASE_EVAL    = 5,  /**< evaluation and classification */
+    NLK_PHASE_MAX     = 6
+};
+typedef enum nlk_phase_t NLK_PHASE;
+
+/** @enum NLK_AFFINITY
+ * Pinning of threads
+ */
+enum nlk_affinity_t {
+    NLK_AFFINITY_NONE = 0,  /**< no pinning */
+    NLK_AFFINITY_CPU  = 1,  /**< one (logical) cpu per thread */
+    NLK_AFFINITY_CORE = 2,  /**< one physical core per thread */
+    NLK_AFFINITY_NUMA = 3,  /**< threads spread across NUMA nodes */
+};
+typedef enum nlk_affinity_t NLK_AFFINITY;
+
+#define NLK_THREADS_CORES -1    /**< phase threads: one per physical core */
+#define NLK_MAX_CPUS 1024       /**< max cpus in the topology */
+#define NLK_THREADS_PRINT 16    /**< max threads shown in the layout */
+
 NLK_FILE_FORMAT nlk_format(const char *);
 void nlk_init();
 int nlk_set_num_threads(int);
 int nlk_get_num_threads();
+int nlk_get_num_cores();
+
+/* per phase threads */
+void nlk_set_phase_threads(const NLK_PHASE, const int);
+int nlk_get_phase_threads(const NLK_PHASE);
+int nlk_get_max_threads();
+int nlk_set_phase_threads_spec(const char *);
+int nlk_phase_begin(const NLK_PHASE);
+
+/* affinity */
+NLK_AFFINITY nlk_affinity(const char *);
+void nlk_set_affinity(const NLK_AFFINITY);
+
+/* BLAS threads */
+void nlk_blas_single();
+void nlk_blas_parallel();
+
+void nlk_threads_print();
 
 
 __END_DECLS
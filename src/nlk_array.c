@@ -36,6 +36,10 @@
 #include <stdint.h>
 #include <math.h>
 #include <float.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 #include "nlk.h"
 #include "nlk_err.h"
@@ -177,6 +181,8 @@ nlk_array_create(const size_t rows, const size_t cols)
     array->cols = cols;
     array->rows = rows;
     array->len = rows * cols;
+    array->mapped = 0;
+    array->owner = NLK_ARRAY_OWNER_HEAP;
 
     return array;
 
@@ -184,6 +190,224 @@ error:
     NLK_ERROR_ABORT("", NLK_ENOMEM);
 }
 
+/**
+ * Create an array backed by a file (MAP_SHARED): pages are loaded on demand 
+ * and written back by the kernel, so the array can be larger than memory and
+ * its contents are in the file when it is freed.
+ *
+ * The file starts with a text header "NLKARRAY rows cols sizeof(nlk_real)"
+ * padded to NLK_ARRAY_MAP_OFFSET bytes followed by the row-major data.
+ *
+ * @param filepath  the file (created or truncated)
+ * @param rows      the number of rows
+ * @param cols      the number of columns
+ *
+ * @return the array (contents zero) or NULL on error
+ */
+struct nlk_array_t *
+nlk_array_create_map(const char *filepath, const size_t rows, 
+                     const size_t cols)
+{
+    struct nlk_array_t *array;
+    char header[NLK_ARRAY_MAP_OFFSET];
+    const size_t size = NLK_ARRAY_MAP_OFFSET + rows * cols * sizeof(nlk_real);
+    void *map;
+    int fd;
+
+    if(rows == 0 || cols == 0) {
+        NLK_ERROR_NULL("Array rows and column numbers must be non-zero",
+                       NLK_EINVAL);
+        /* unreachable */
+    }
+
+    fd = open(filepath, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if(fd < 0) {
+        NLK_ERROR_NULL(strerror(errno), errno);
+        /* unreachable */
+    }
+
+    /* header */
+    memset(header, ' ', NLK_ARRAY_MAP_OFFSET);
+    int len = snprintf(header, NLK_ARRAY_MAP_OFFSET, "NLKARRAY %zu %zu %zu", 
+                       rows, cols, sizeof(nlk_real));
+    header[len] = ' ';
+    header[NLK_ARRAY_MAP_OFFSET - 1] = '\n';
+    if(write(fd, header, NLK_ARRAY_MAP_OFFSET) != NLK_ARRAY_MAP_OFFSET
+       || ftruncate(fd, size) != 0) {
+        close(fd);
+        NLK_ERROR_NULL(strerror(errno), errno);
+        /* unreachable */
+    }
+
+    map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);  /* the mapping keeps the file */
+    if(map == MAP_FAILED) {
+        NLK_ERROR_NULL(strerror(errno), errno);
+        /* unreachable */
+    }
+
+    array = (struct nlk_array_t *) malloc(sizeof(struct nlk_array_t));
+    if(array == NULL) {
+        munmap(map, size);
+        NLK_ERROR_NULL("failed to allocate memory for array struct", 
+                       NLK_ENOMEM);
+        /* unreachable */
+    }
+
+    array->data = (nlk_real *) ((char *) map + NLK_ARRAY_MAP_OFFSET);
+    array->rows = rows;
+    array->cols = cols;
+    array->len = rows * cols;
+    array->mapped = size;
+    array->owner = NLK_ARRAY_OWNER_MAPPED;
+
+    return array;
+}
+
+/**
+ * Open an array backed by a file created by nlk_array_create_map: the header
+ * is checked and the existing rows are mapped (loaded on demand).
+ *
+ * @param filepath  the file
+ * @param readonly  changes are not written to the file (MAP_PRIVATE)
+ *
+ * @return the array or NULL on error
+ */
+struct nlk_array_t *
+nlk_array_open_map(const char *filepath, const bool readonly)
+{
+    struct nlk_array_t *array;
+    char header[NLK_ARRAY_MAP_OFFSET];
+    size_t rows;
+    size_t cols;
+    size_t real_size;
+    size_t size;
+    struct stat st;
+    void *map;
+    int fd;
+
+    fd = open(filepath, readonly ? O_RDONLY : O_RDWR);
+    if(fd < 0) {
+        NLK_ERROR_NULL(strerror(errno), errno);
+        /* unreachable */
+    }
+
+    /* header */
+    if(read(fd, header, NLK_ARRAY_MAP_OFFSET) != NLK_ARRAY_MAP_OFFSET) {
+        close(fd);
+        NLK_ERROR_NULL("file too short for a mapped array header", 
+                       NLK_EBADLEN);
+        /* unreachable */
+    }
+    header[NLK_ARRAY_MAP_OFFSET - 1] = '\0';
+    if(sscanf(header, "NLKARRAY %zu %zu %zu", &rows, &cols, &real_size) != 3
+       || rows == 0 || cols == 0) {
+        close(fd);
+        NLK_ERROR_NULL("invalid mapped array header", NLK_EINVAL);
+        /* unreachable */
+    }
+    if(real_size != sizeof(nlk_real)) {
+        close(fd);
+        NLK_ERROR_NULL("mapped array has a different value size", NLK_EINVAL);
+        /* unreachable */
+    }
+
+    /* the data must all be there */
+    size = NLK_ARRAY_MAP_OFFSET + rows * cols * sizeof(nlk_real);
+    if(fstat(fd, &st) != 0 || (size_t) st.st_size < size) {
+        close(fd);
+        NLK_ERROR_NULL("mapped array file is truncated", NLK_EBADLEN);
+        /* unreachable */
+    }
+
+    map = mmap(NULL, size, PROT_READ | PROT_WRITE, 
+               readonly ? MAP_PRIVATE : MAP_SHARED, fd, 0);
+    close(fd);  /* the mapping keeps the file */
+    if(map == MAP_FAILED) {
+        NLK_ERROR_NULL(strerror(errno), errno);
+        /* unreachable */
+    }
+
+    array = (struct nlk_array_t *) malloc(sizeof(struct nlk_array_t));
+    if(array == NULL) {
+        munmap(map, size);
+        NLK_ERROR_NULL("failed to allocate memory for array struct", 
+                       NLK_ENOMEM);
+        /* unreachable */
+    }
+
+    array->data = (nlk_real *) ((char *) map + NLK_ARRAY_MAP_OFFSET);
+    array->rows = rows;
+    array->cols = cols;
+    array->len = rows * cols;
+    array->mapped = size;
+    array->owner = NLK_ARRAY_OWNER_MAPPED;
+
+    return array;
+}
+
+/**
+ * Page range of a file backed array that covers rows [start, end[
+ */
+static void
+nlk_array_map_range(struct nlk_array_t *array, const size_t start, 
+                    const size_t end, char **addr, size_t *len)
+{
+    const size_t page = sysconf(_SC_PAGESIZE);
+    char *base = (char *) array->data - NLK_ARRAY_MAP_OFFSET;
+    size_t first = NLK_ARRAY_MAP_OFFSET 
+                 + start * array->cols * sizeof(nlk_real);
+    size_t last = NLK_ARRAY_MAP_OFFSET 
+                + end * array->cols * sizeof(nlk_real);
+
+    first -= first % page;
+    if(last > array->mapped) {
+        last = array->mapped;
+    }
+    *addr = base + first;
+    *len = last > first ? last - first : 0;
+}
+
+/**
+ * Advise the kernel about the access pattern (e.g. MADV_SEQUENTIAL) to rows
+ * [start, end[ of a file backed array. Does nothing for in memory arrays.
+ */
+void
+nlk_array_map_advise(struct nlk_array_t *array, const size_t start, 
+                     const size_t end, const int advice)
+{
+    char *addr;
+    size_t len;
+
+    if(array->owner != NLK_ARRAY_OWNER_MAPPED) {
+        return;
+    }
+    nlk_array_map_range(array, start, end, &addr, &len);
+    if(len > 0) {
+        madvise(addr, len, advice);
+    }
+}
+
+/**
+ * Write back rows [start, end[ of a file backed array: schedule it (async) or
+ * wait for it. Does nothing for in memory arrays.
+ */
+void
+nlk_array_map_sync(struct nlk_array_t *array, const size_t start, 
+                   const size_t end, const bool async)
+{
+    char *addr;
+    size_t len;
+
+    if(array->owner != NLK_ARRAY_OWNER_MAPPED) {
+        return;
+    }
+    nlk_array_map_range(array, start, end, &addr, &len);
+    if(len > 0 && msync(addr, len, async ? MS_ASYNC : MS_SYNC) != 0) {
+        nlk_log_err("msync: %s", strerror(errno));
+    }
+}
+
 /**
  * Assign an array view from a matrix column
  * A view's internal data pointer is meant to be assigned and not memory is
@@ -785,15 +1009,23 @@ nlk_array_load_err:
 
 
 /**
- * Free the memory of an array 
+ * Free the memory of an array (arrays from a workspace are left to it)
  *
  * @param array the array to free
  */
 void 
 nlk_array_free(struct nlk_array_t *array)
 {
+    if(array != NULL && array->owner == NLK_ARRAY_OWNER_WORKSPACE) {
+        /* released with its workspace */
+        return;
+    }
     if(array != NULL) {
-        if(array->data != NULL) {
+        if(array->data != NULL && array->owner == NLK_ARRAY_OWNER_MAPPED) {
+            munmap((char *) array->data - NLK_ARRAY_MAP_OFFSET, 
+                   array->mapped);
+            array->data = NULL;
+        } else if(array->data != NULL) {
             free(array->data);
             array->data = NULL;
         }
@@ -802,6 +1034,242 @@ nlk_array_free(struct nlk_array_t *array)
     }
 }
 
+
+/** @section Workspace
+ * Scratch arrays allocated and released as a stack
+ */
+
+/**
+ * Create a workspace block of at least size bytes
+ */
+static struct nlk_workspace_block_t *
+nlk_workspace_block_create(const size_t size, const size_t start)
+{
+    struct nlk_workspace_block_t *block;
+    int r;
+
+    block = (struct nlk_workspace_block_t *) 
+            malloc(sizeof(struct nlk_workspace_block_t));
+    if(block == NULL) {
+        NLK_ERROR_ABORT("unable to allocate memory for workspace", NLK_ENOMEM);
+        /* unreachable */
+    }
+    r = posix_memalign((void **)&block->data, NLK_WORKSPACE_ALIGN, size);
+    if(r != 0) {
+        NLK_ERROR_ABORT("unable to allocate memory for workspace", NLK_ENOMEM);
+        /* unreachable */
+    }
+    block->size = size;
+    block->start = start;
+    block->next = NULL;
+
+    return block;
+}
+
+/**
+ * Create a workspace
+ *
+ * @param size  initial size in bytes (0 = NLK_WORKSPACE_SIZE)
+ *
+ * @return the workspace
+ */
+struct nlk_workspace_t *
+nlk_workspace_create(const size_t size)
+{
+    struct nlk_workspace_t *ws;
+
+    ws = (struct nlk_workspace_t *) malloc(sizeof(struct nlk_workspace_t));
+    if(ws == NULL) {
+        NLK_ERROR_ABORT("unable to allocate memory for workspace", NLK_ENOMEM);
+        /* unreachable */
+    }
+    ws->first = nlk_workspace_block_create(size > 0 ? size 
+                                                    : NLK_WORKSPACE_SIZE, 0);
+    ws->cur = ws->first;
+    ws->top = 0;
+    ws->peak = 0;
+
+    return ws;
+}
+
+/**
+ * Free a workspace and all arrays handed out by it
+ */
+void
+nlk_workspace_free(struct nlk_workspace_t *ws)
+{
+    struct nlk_workspace_block_t *block;
+    struct nlk_workspace_block_t *next;
+
+    if(ws == NULL) {
+        return;
+    }
+    for(block = ws->first; block != NULL; block = next) {
+        next = block->next;
+        free(block->data);
+        free(block);
+    }
+    free(ws);
+}
+
+/* the workspace of each thread */
+static __thread struct nlk_workspace_t *__workspace = NULL;
+
+/**
+ * The calling thread's workspace (created on first use)
+ */
+struct nlk_workspace_t *
+nlk_workspace_thread()
+{
+    if(__workspace == NULL) {
+        __workspace = nlk_workspace_create(NLK_WORKSPACE_SIZE);
+    }
+    return __workspace;
+}
+
+/**
+ * Free the calling thread's workspace
+ */
+void
+nlk_workspace_thread_free()
+{
+    nlk_workspace_free(__workspace);
+    __workspace = NULL;
+}
+
+/**
+ * Bytes held by a workspace (all of its blocks)
+ */
+size_t
+nlk_workspace_size(const struct nlk_workspace_t *ws)
+{
+    const struct nlk_workspace_block_t *block = ws->first;
+
+    while(block->next != NULL) {
+        block = block->next;
+    }
+    return block->start + block->size;
+}
+
+/**
+ * Current position of the workspace, for a later nlk_workspace_reset
+ */
+size_t
+nlk_workspace_mark(const struct nlk_workspace_t *ws)
+{
+    return ws->cur->start + ws->top;
+}
+
+/**
+ * Release everything allocated since mark. The memory is kept.
+ *
+ * @param ws    the workspace
+ * @param mark  a position returned by nlk_workspace_mark
+ */
+void
+nlk_workspace_reset(struct nlk_workspace_t *ws, const size_t mark)
+{
+    struct nlk_workspace_block_t *block = ws->first;
+
+    while(mark > block->start + block->size) {
+        block = block->next;
+#ifndef NCHECKS
+        if(block == NULL) {
+            NLK_ERROR_VOID("workspace mark out of range", NLK_EINVAL);
+            /* unreachable */
+        }
+#endif
+    }
+    ws->cur = block;
+    ws->top = mark - block->start;
+}
+
+/**
+ * Allocate size bytes (aligned to NLK_WORKSPACE_ALIGN) from a workspace.
+ * When the current block is full, moves on to the next block large enough, 
+ * adding one (twice the size of the last) if there is none.
+ *
+ * @param ws    the workspace
+ * @param size  bytes
+ *
+ * @return the memory, valid until the workspace is reset to a mark before it
+ */
+void *
+nlk_workspace_alloc(struct nlk_workspace_t *ws, const size_t size)
+{
+    struct nlk_workspace_block_t *block;
+    size_t need = size + (NLK_WORKSPACE_ALIGN - 1);
+    void *mem;
+
+    need -= need % NLK_WORKSPACE_ALIGN;
+    if(need == 0) {
+        need = NLK_WORKSPACE_ALIGN;
+    }
+
+    if(ws->top + need > ws->cur->size) {
+        block = ws->cur;
+        while(block->next != NULL && block->next->size < need) {
+            block = block->next;
+        }
+        if(block->next == NULL) {
+            size_t grow = 2 * block->size;
+            if(grow < need) {
+                grow = need;
+            }
+            block->next = nlk_workspace_block_create(grow, block->start 
+                                                           + block->size);
+        }
+        ws->cur = block->next;
+        ws->top = 0;
+    }
+
+    mem = ws->cur->data + ws->top;
+    ws->top += need;
+    if(ws->cur->start + ws->top > ws->peak) {
+        ws->peak = ws->cur->start + ws->top;
+    }
+
+    return mem;
+}
+
+/**
+ * Create a rows x cols array in a workspace. The array is released by 
+ * resetting the workspace; nlk_array_free does nothing for it.
+ *
+ * @param ws    the workspace
+ * @param rows  number of rows
+ * @param cols  number of columns
+ *
+ * @return the array
+ */
+struct nlk_array_t *
+nlk_workspace_array(struct nlk_workspace_t *ws, const size_t rows, 
+                    const size_t cols)
+{
+    struct nlk_array_t *array;
+
+    /* 0 dimensions are not allowed */
+    nlk_assert((rows != 0 && cols != 0),
+               "Array rows and column numbers must be non-zero positive "
+               "integers not (%zu, %zu)", rows, cols);
+        /* unreachable */
+
+    /* header and data in one aligned piece */
+    array = (struct nlk_array_t *) nlk_workspace_alloc(ws, 
+                    NLK_WORKSPACE_ALIGN + rows * cols * sizeof(nlk_real));
+    array->data = (nlk_real *) ((char *) array + NLK_WORKSPACE_ALIGN);
+    array->rows = rows;
+    array->cols = cols;
+    array->len = rows * cols;
+    array->mapped = 0;
+    array->owner = NLK_ARRAY_OWNER_WORKSPACE;
+
+    return array;
+
+error:
+    NLK_ERROR_ABORT("", NLK_EINVAL);
+}
+
 /**
  * Scale an array by *scalar*
  *
@@ -1469,10 +1937,7 @@ nlk_carray_init_sigmoid(nlk_real *carray) {
 int
 nlk_sigmoid_array(struct nlk_array_t *arr)
 {
-    /*#pragma omp parallel for*/
-    for(size_t ii = 0; ii < arr->len; ii++) {
-        arr->data[ii] = nlk_sigmoid(arr->data[ii]);
-    }
+    nlk_sigmoid_vector(arr->data, arr->len, arr->data);
 
     return NLK_SUCCESS;
 }
@@ -40,6 +40,15 @@
 #include "nlk.h"
 #include "nlk_math.h"
 
+
+/** header size of a file backed array: data starts at this (page) offset */
+#define NLK_ARRAY_MAP_OFFSET 4096
+
+/** workspace alignment (bytes) */
+#define NLK_WORKSPACE_ALIGN 128
+/** initial size (bytes) of a per thread workspace */
+#define NLK_WORKSPACE_SIZE (64 * 1024)
+
 #undef __BEGIN_DECLS
 #undef __END_DECLS
 #ifdef __cplusplus
@@ -61,6 +70,16 @@ typedef enum nlk_opts_t {
 } NLK_OPTS;
 
 
+/* @enum NLK_ARRAY_OWNER
+ * who owns the data of an array (how it is released)
+ */
+typedef enum nlk_array_owner_t {
+    NLK_ARRAY_OWNER_HEAP      = 0,  /**< allocated: freed with the array */
+    NLK_ARRAY_OWNER_MAPPED    = 1,  /**< file backed: unmapped with it */
+    NLK_ARRAY_OWNER_WORKSPACE = 2   /**< released with its workspace */
+} NLK_ARRAY_OWNER;
+
+
 /* @ struct nlk_array
  * 1D or 2D array (vector or matrix)
  */
@@ -69,10 +88,37 @@ struct nlk_array_t {
     size_t cols;    /**< the number of columns in the matrix (size) */
     size_t len;     /**< len = rows * cols */
     nlk_real *data; /**< pointer to the beginning of the matrix data */ 
+    size_t mapped;  /**< bytes mapped from a file (0 if in memory) */
+    NLK_ARRAY_OWNER owner; /**< how the data is released */
 };
 typedef struct nlk_array_t NLK_ARRAY;
 
 
+/** @struct nlk_workspace_block_t
+ * A block of workspace memory
+ */
+struct nlk_workspace_block_t {
+    char                            *data;  /**< aligned memory */
+    size_t                           size;  /**< bytes */
+    size_t                           start; /**< bytes in previous blocks */
+    struct nlk_workspace_block_t    *next;  /**< next (larger) block */
+};
+
+/** @struct nlk_workspace_t
+ * Scratch memory for transient arrays, allocated and released as a stack: 
+ * nlk_workspace_mark before allocating, nlk_workspace_reset to the mark 
+ * when done. Blocks are kept after a reset so that, once warm, allocating
+ * from a workspace does not touch the heap.
+ */
+struct nlk_workspace_t {
+    struct nlk_workspace_block_t    *first; /**< first block */
+    struct nlk_workspace_block_t    *cur;   /**< block being allocated from */
+    size_t                           top;   /**< bytes used in cur */
+    size_t                           peak;  /**< most bytes ever used */
+};
+typedef struct nlk_workspace_t NLK_WORKSPACE;
+
+
 /* debug helpers */
 void nlk_print_array(const struct nlk_array_t *, const size_t, const size_t);
 bool nlk_array_has_nan(const struct nlk_array_t *);
@@ -119,6 +165,13 @@ do { \
  * Constructors, copy
  */
 struct  nlk_array_t *nlk_array_create(const size_t, const size_t);
+struct  nlk_array_t *nlk_array_create_map(const char *, const size_t, 
+                                          const size_t);
+struct  nlk_array_t *nlk_array_open_map(const char *, const bool);
+void    nlk_array_map_advise(struct nlk_array_t *, const size_t, const size_t,
+                             const int);
+void    nlk_array_map_sync(struct nlk_array_t *, const size_t, const size_t,
+                           const bool);
 void    nlk_array_row_view(const NLK_ARRAY *, const size_t, NLK_ARRAY *);
 
 struct  nlk_array_t *nlk_array_resize(struct nlk_array_t *, const size_t, 
@@ -177,6 +230,22 @@ struct nlk_array_t *nlk_array_load_text(FILE *);
 void nlk_array_free(struct nlk_array_t *);
 
 
+/*
+ * Workspace (scratch arrays)
+ */
+struct nlk_workspace_t *nlk_workspace_create(const size_t);
+void nlk_workspace_free(struct nlk_workspace_t *);
+struct nlk_workspace_t *nlk_workspace_thread();
+void nlk_workspace_thread_free();
+
+size_t nlk_workspace_size(const struct nlk_workspace_t *);
+size_t nlk_workspace_mark(const struct nlk_workspace_t *);
+void nlk_workspace_reset(struct nlk_workspace_t *, const size_t);
+void *nlk_workspace_alloc(struct nlk_workspace_t *, const size_t);
+struct nlk_array_t *nlk_workspace_array(struct nlk_workspace_t *, 
+                                        const size_t, const size_t);
+
+
 /*
  * Basic Linear Algebra Operations
  */
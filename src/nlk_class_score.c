@@ -0,0 +1,608 @@
+/******************************************************************************
+ * NLK - Neural Language Kit
+ *
+ * Copyright (c) 2015 Luis Rei <me@luisrei.com> http://luisrei.com @lmrei
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to 
+ * deal in the Software without restriction, including without limitation the 
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or 
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ *****************************************************************************/
+
+
+
+/** @file nlk_class_score.c
+ * Classification scoring from sparse (confusion) counts
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <omp.h>
+
+#include "nlk.h"
+#include "nlk_err.h"
+#include "nlk_random.h"
+
+#include "nlk_class_score.h"
+
+
+/** @struct nlk_class_score_map_t
+ * Open addressing (linear probing) counts of off-diagonal confusion cells.
+ * Keys are (truth << 32 | pred) and 0 marks an empty slot: it is the key of
+ * the diagonal cell (0, 0) which is never stored.
+ */
+struct nlk_class_score_map_t {
+    uint64_t   *keys;       /**< the keys */
+    uint64_t   *counts;     /**< the counts */
+    size_t      cap;        /**< number of slots (power of 2) */
+    size_t      len;        /**< number of keys */
+};
+
+
+/**
+ * Allocate the slots of a map
+ */
+static void
+nlk_class_score_map_init(struct nlk_class_score_map_t *map, const size_t cap)
+{
+    map->keys = (uint64_t *) calloc(cap, sizeof(uint64_t));
+    map->counts = (uint64_t *) calloc(cap, sizeof(uint64_t));
+    if(map->keys == NULL || map->counts == NULL) {
+        NLK_ERROR_ABORT("unable to allocate memory for scoring", NLK_ENOMEM);
+        /* unreachable */
+    }
+    map->cap = cap;
+    map->len = 0;
+}
+
+
+/**
+ * Add count to a key (no growth)
+ */
+static void
+nlk_class_score_map_put(struct nlk_class_score_map_t *map, const uint64_t key,
+                        const uint64_t count)
+{
+    const size_t mask = map->cap - 1;
+    size_t idx = nlk_random_fmix(key) & mask;
+
+    while(map->keys[idx] != 0 && map->keys[idx] != key) {
+        idx = (idx + 1) & mask;
+    }
+    if(map->keys[idx] == 0) {
+        map->keys[idx] = key;
+        map->len++;
+    }
+    map->counts[idx] += count;
+}
+
+
+/**
+ * Count one more (truth, pred) error, doubling the map at half load
+ */
+static void
+nlk_class_score_map_add(struct nlk_class_score_map_t *map, 
+                        const unsigned int truth, const unsigned int pred)
+{
+    if(2 * (map->len + 1) > map->cap) {
+        struct nlk_class_score_map_t old = *map;
+        nlk_class_score_map_init(map, 2 * old.cap);
+        for(size_t ii = 0; ii < old.cap; ii++) {
+            if(old.keys[ii] != 0) {
+                nlk_class_score_map_put(map, old.keys[ii], old.counts[ii]);
+            }
+        }
+        free(old.keys);
+        free(old.counts);
+    }
+    nlk_class_score_map_put(map, (uint64_t) truth << 32 | pred, 1);
+}
+
+
+/**
+ * Order cells by (truth, pred) (qsort)
+ */
+static int
+nlk_class_score_cmp_cell(const void *a, const void *b)
+{
+    const struct nlk_class_score_cell_t *x = a;
+    const struct nlk_class_score_cell_t *y = b;
+
+    if(x->truth != y->truth) {
+        return (x->truth > y->truth) - (x->truth < y->truth);
+    }
+    return (x->pred > y->pred) - (x->pred < y->pred);
+}
+
+
+/**
+ * Order cells by decreasing count (qsort)
+ */
+static int
+nlk_class_score_cmp_count(const void *a, const void *b)
+{
+    const struct nlk_class_score_cell_t *x = a;
+    const struct nlk_class_score_cell_t *y = b;
+
+    if(x->count != y->count) {
+        return (x->count < y->count) - (x->count > y->count);
+    }
+    return nlk_class_score_cmp_cell(a, b);
+}
+
+
+/**
+ * Order class values (qsort)
+ */
+static int
+nlk_class_score_cmp_class(const void *a, const void *b)
+{
+    const unsigned int x = *(const unsigned int *) a;
+    const unsigned int y = *(const unsigned int *) b;
+
+    return (x > y) - (x < y);
+}
+
+
+/**
+ * The index of the counts of a class
+ *
+ * @return the index or score->len if the class is not counted
+ */
+static size_t
+nlk_class_score_index(const struct nlk_class_score_t *score, 
+                      const unsigned int class_val)
+{
+    const unsigned int *found;
+
+    if(score->classes == NULL) {
+        return class_val < score->len ? class_val : score->len;
+    }
+    found = bsearch(&class_val, score->classes, score->len, 
+                    sizeof(unsigned int), nlk_class_score_cmp_class);
+    return found != NULL ? (size_t) (found - score->classes) : score->len;
+}
+
+
+/**
+ * The classes that occur in the predictions or the ground truth (sorted)
+ *
+ * @param len   the number of classes (result)
+ */
+static unsigned int *
+nlk_class_score_classes(const unsigned int *pred, const unsigned int *truth,
+                        const size_t n, size_t *len)
+{
+    unsigned int *classes;
+    size_t kept = 0;
+
+    classes = (unsigned int *) malloc((2 * n + 1) * sizeof(unsigned int));
+    if(classes == NULL) {
+        NLK_ERROR_NULL("unable to allocate memory for scoring", NLK_ENOMEM);
+        /* unreachable */
+    }
+    memcpy(classes, pred, n * sizeof(unsigned int));
+    memcpy(&classes[n], truth, n * sizeof(unsigned int));
+    qsort(classes, 2 * n, sizeof(unsigned int), nlk_class_score_cmp_class);
+    for(size_t ii = 0; ii < 2 * n; ii++) {
+        if(kept == 0 || classes[kept - 1] != classes[ii]) {
+            classes[kept++] = classes[ii];
+        }
+    }
+    *len = kept;
+
+    return classes;
+}
+
+
+/**
+ * Count a set of predictions in one (parallel) pass: per class true 
+ * positives, truth and prediction counts plus the off-diagonal cells of the 
+ * confusion matrix. Each thread counts into its own arrays and hash map; the
+ * maps are merged into a sorted array of cells. With many more classes than
+ * examples, only the classes that occur are counted (sparse).
+ *
+ * @param pred  array of predictions
+ * @param truth array containing the ground truth
+ * @param n     the number of test cases (size of pred/truth arrays)
+ *
+ * @return the counts
+ */
+struct nlk_class_score_t *
+nlk_class_score_create(const unsigned int *pred, const unsigned int *truth, 
+                       const size_t n)
+{
+    struct nlk_class_score_t *score;
+    unsigned int max = 0;
+    size_t n_classes;
+    size_t len;
+    size_t correct = 0;
+    size_t kept = 0;
+
+    /* the global number of threads, not the last phase's */
+    const int num_threads = nlk_get_num_threads();
+
+#pragma omp parallel for num_threads(num_threads) reduction(max : max)
+    for(size_t ii = 0; ii < n; ii++) {
+        if(pred[ii] > max) {
+            max = pred[ii];
+        }
+        if(truth[ii] > max) {
+            max = truth[ii];
+        }
+    }
+    n_classes = n > 0 ? (size_t) max + 1 : 0;
+
+    score = (struct nlk_class_score_t *) malloc(sizeof(*score));
+    if(score == NULL) {
+        NLK_ERROR_NULL("unable to allocate memory for scoring", NLK_ENOMEM);
+        /* unreachable */
+    }
+    score->n = n;
+    score->n_classes = n_classes;
+    score->len = n_classes;
+    score->classes = NULL;
+    if(n_classes > NLK_CLASS_SCORE_SPARSE && n_classes > 2 * n) {
+        score->classes = nlk_class_score_classes(pred, truth, n, &score->len);
+    }
+    len = score->len;
+    score->tp = (uint64_t *) calloc(len + 1, sizeof(uint64_t));
+    score->truth_count = (uint64_t *) calloc(len + 1, sizeof(uint64_t));
+    score->pred_count = (uint64_t *) calloc(len + 1, sizeof(uint64_t));
+    score->errors = NULL;
+    score->n_errors = 0;
+    if(score->tp == NULL || score->truth_count == NULL || 
+       score->pred_count == NULL) {
+        NLK_ERROR_NULL("unable to allocate memory for scoring", NLK_ENOMEM);
+        /* unreachable */
+    }
+
+#pragma omp parallel num_threads(num_threads) reduction(+ : correct)
+{
+    struct nlk_class_score_map_t map;
+    uint64_t *t_tp = (uint64_t *) calloc(len + 1, sizeof(uint64_t));
+    uint64_t *t_truth = (uint64_t *) calloc(len + 1, sizeof(uint64_t));
+    uint64_t *t_pred = (uint64_t *) calloc(len + 1, sizeof(uint64_t));
+
+    if(t_tp == NULL || t_truth == NULL || t_pred == NULL) {
+        NLK_ERROR_ABORT("unable to allocate memory for scoring", NLK_ENOMEM);
+        /* unreachable */
+    }
+    nlk_class_score_map_init(&map, 64);
+
+#pragma omp for
+    for(size_t ii = 0; ii < n; ii++) {
+        const size_t t = nlk_class_score_index(score, truth[ii]);
+        t_truth[t]++;
+        t_pred[nlk_class_score_index(score, pred[ii])]++;
+        if(pred[ii] == truth[ii]) {
+            t_tp[t]++;
+            correct++;
+        } else {
+            nlk_class_score_map_add(&map, truth[ii], pred[ii]);
+        }
+    }
+
+#pragma omp critical(nlk_class_score_merge)
+{
+    for(size_t cc = 0; cc < len; cc++) {
+        score->tp[cc] += t_tp[cc];
+        score->truth_count[cc] += t_truth[cc];
+        score->pred_count[cc] += t_pred[cc];
+    }
+    score->errors = (struct nlk_class_score_cell_t *) 
+                    realloc(score->errors, (score->n_errors + map.len + 1) * 
+                            sizeof(struct nlk_class_score_cell_t));
+    if(score->errors == NULL) {
+        NLK_ERROR_ABORT("unable to allocate memory for scoring", NLK_ENOMEM);
+        /* unreachable */
+    }
+    for(size_t ii = 0; ii < map.cap; ii++) {
+        if(map.keys[ii] != 0) {
+            struct nlk_class_score_cell_t *cell;
+            cell = &score->errors[score->n_errors++];
+            cell->truth = map.keys[ii] >> 32;
+            cell->pred = map.keys[ii] & 0xffffffff;
+            cell->count = map.counts[ii];
+        }
+    }
+}
+
+    free(t_tp);
+    free(t_truth);
+    free(t_pred);
+    free(map.keys);
+    free(map.counts);
+} /* end of parallel region */
+    score->correct = correct;
+
+    /* sort cells and merge the same cell counted by different threads */
+    qsort(score->errors, score->n_errors, 
+          sizeof(struct nlk_class_score_cell_t), nlk_class_score_cmp_cell);
+    for(size_t ii = 0; ii < score->n_errors; ii++) {
+        if(kept > 0 && 
+           nlk_class_score_cmp_cell(&score->errors[kept - 1], 
+                                    &score->errors[ii]) == 0) {
+            score->errors[kept - 1].count += score->errors[ii].count;
+        } else {
+            score->errors[kept++] = score->errors[ii];
+        }
+    }
+    score->n_errors = kept;
+
+    return score;
+}
+
+
+/**
+ * Accuracy
+ */
+float
+nlk_class_score_get_accuracy(const struct nlk_class_score_t *score)
+{
+    if(score->n == 0) {
+        return 0;
+    }
+    return score->correct / (double) score->n;
+}
+
+
+/**
+ * F1, precision and recall of a given class (0 when undefined)
+ *
+ * @param score     the counts
+ * @param class_val the class
+ * @param precision the precision of the class (result)
+ * @param recall    the recall of the class (result)
+ *
+ * @return the f1 score of the class
+ */
+float
+nlk_class_score_get_f1pr(const struct nlk_class_score_t *score, 
+                         const unsigned int class_val, float *precision,
+                         float *recall)
+{
+    const size_t cc = nlk_class_score_index(score, class_val);
+    double p = 0;
+    double r = 0;
+
+    if(cc < score->len) {
+        if(score->pred_count[cc] > 0) {
+            p = score->tp[cc] / (double) score->pred_count[cc];
+        }
+        if(score->truth_count[cc] > 0) {
+            r = score->tp[cc] / (double) score->truth_count[cc];
+        }
+    }
+    *precision = p;
+    *recall = r;
+
+    if(p + r == 0) {
+        return 0;
+    }
+    return 2.0 * p * r / (p + r);
+}
+
+
+/**
+ * Micro averaged F1, precision and recall (pooled over all classes)
+ */
+float
+nlk_class_score_get_micro(const struct nlk_class_score_t *score, 
+                          float *precision, float *recall)
+{
+    uint64_t tp = 0;
+    uint64_t pred = 0;
+    uint64_t truth = 0;
+    double p = 0;
+    double r = 0;
+
+    for(size_t cc = 0; cc < score->len; cc++) {
+        tp += score->tp[cc];
+        pred += score->pred_count[cc];
+        truth += score->truth_count[cc];
+    }
+    if(pred > 0) {
+        p = tp / (double) pred;
+    }
+    if(truth > 0) {
+        r = tp / (double) truth;
+    }
+    *precision = p;
+    *recall = r;
+
+    if(p + r == 0) {
+        return 0;
+    }
+    return 2.0 * p * r / (p + r);
+}
+
+
+/**
+ * Macro averaged F1, precision and recall: the mean over the classes that 
+ * occur in the ground truth or the predictions
+ */
+float
+nlk_class_score_get_macro(const struct nlk_class_score_t *score, 
+                          float *precision, float *recall)
+{
+    double f1 = 0;
+    double p = 0;
+    double r = 0;
+    size_t classes = 0;
+    float cp;
+    float cr;
+
+    for(size_t cc = 0; cc < score->len; cc++) {
+        if(score->truth_count[cc] == 0 && score->pred_count[cc] == 0) {
+            continue;
+        }
+        f1 += nlk_class_score_get_f1pr(score, score->classes != NULL ? 
+                                       score->classes[cc] : cc, &cp, &cr);
+        p += cp;
+        r += cr;
+        classes++;
+    }
+    if(classes == 0) {
+        *precision = 0;
+        *recall = 0;
+        return 0;
+    }
+    *precision = p / classes;
+    *recall = r / classes;
+
+    return f1 / classes;
+}
+
+
+/**
+ * SemEval sentiment F1: the mean F1 of the positive and negative classes
+ */
+float
+nlk_class_score_get_semeval(const struct nlk_class_score_t *score, 
+                            const unsigned int pos, const unsigned int neg)
+{
+    float p;
+    float r;
+    float f1;
+
+    f1 = nlk_class_score_get_f1pr(score, pos, &p, &r);
+    f1 += nlk_class_score_get_f1pr(score, neg, &p, &r);
+
+    return f1 / 2.0;
+}
+
+
+/**
+ * Print accuracy, micro and macro scores
+ */
+void
+nlk_class_score_print(const struct nlk_class_score_t *score)
+{
+    float p;
+    float r;
+    float f1;
+
+    printf("accuracy = %f (%zu/%zu)\n", nlk_class_score_get_accuracy(score),
+           score->correct, score->n);
+    f1 = nlk_class_score_get_micro(score, &p, &r);
+    printf("micro: prec = %.4f, rec = %.4f, f1 = %.4f\n", p, r, f1);
+    f1 = nlk_class_score_get_macro(score, &p, &r);
+    printf("macro: prec = %.4f, rec = %.4f, f1 = %.4f\n", p, r, f1);
+}
+
+
+/**
+ * Print the confusion matrix (Row = Truth, Col = Predicted) or, with more 
+ * than NLK_CLASS_SCORE_CM_DENSE classes, the NLK_CLASS_SCORE_CM_TOP most 
+ * frequent confusions
+ */
+void
+nlk_class_score_print_cm(const struct nlk_class_score_t *score)
+{
+    const size_t n_classes = score->n_classes;
+    const size_t errors = score->n - score->correct;
+    struct nlk_class_score_cell_t *top;
+    uint64_t *cm;
+    uint64_t total;
+    uint64_t row_errors;
+    uint64_t col_errors;
+
+    if(n_classes > NLK_CLASS_SCORE_CM_DENSE || score->classes != NULL) {
+        top = (struct nlk_class_score_cell_t *) 
+              malloc((score->n_errors + 1) * 
+                     sizeof(struct nlk_class_score_cell_t));
+        if(top == NULL) {
+            NLK_ERROR_VOID("unable to allocate memory for scoring", 
+                           NLK_ENOMEM);
+            /* unreachable */
+        }
+        memcpy(top, score->errors, 
+               score->n_errors * sizeof(struct nlk_class_score_cell_t));
+        qsort(top, score->n_errors, sizeof(struct nlk_class_score_cell_t),
+              nlk_class_score_cmp_count);
+
+        printf("\n%zu classes, %zu errors in %zu cells\nT -> P:\tcount\n", 
+               score->len, errors, score->n_errors);
+        for(size_t ii = 0; ii < score->n_errors && 
+            ii < NLK_CLASS_SCORE_CM_TOP; ii++) {
+            printf("%u -> %u:\t%"PRIu64"\n", top[ii].truth, top[ii].pred, 
+                   top[ii].count);
+        }
+        free(top);
+        return;
+    }
+
+    /* small: fill a dense matrix */
+    cm = (uint64_t *) calloc(n_classes * n_classes + 1, sizeof(uint64_t));
+    if(cm == NULL) {
+        NLK_ERROR_VOID("unable to allocate memory for scoring", NLK_ENOMEM);
+        /* unreachable */
+    }
+    for(size_t ii = 0; ii < n_classes; ii++) {
+        cm[ii * n_classes + ii] = score->tp[ii];
+    }
+    for(size_t ii = 0; ii < score->n_errors; ii++) {
+        cm[score->errors[ii].truth * n_classes + score->errors[ii].pred] = 
+            score->errors[ii].count;
+    }
+
+    /* header */
+    printf("\nT\\P:\t");
+    for(size_t ii = 0; ii < n_classes; ii++) {
+        printf("%zu:\t", ii); /* col index */
+    }
+    printf("\t|Total:\tE(FN):\n");
+
+    /* rows/cells */
+    for(size_t ii = 0; ii < n_classes; ii++) {
+        total = score->truth_count[ii];
+        row_errors = total - score->tp[ii];
+        printf("%zu:\t", ii); /* row index */
+        for(size_t jj = 0; jj < n_classes; jj++) {
+            printf("%"PRIu64"\t", cm[ii * n_classes + jj]);
+        }
+        printf("\t|%"PRIu64"\t%"PRIu64"\n", total, row_errors);
+    }
+
+    /* error row */
+    printf("-\nE(FP):\t");
+    for(size_t jj = 0; jj < n_classes; jj++) {
+        col_errors = score->pred_count[jj] - score->tp[jj];
+        printf("%"PRIu64"\t", col_errors);
+    }
+    printf("\t|%zu\t\\%zu\n", errors, errors);
+
+    free(cm);
+}
+
+
+/**
+ * Free scoring counts
+ */
+void
+nlk_class_score_free(struct nlk_class_score_t *score)
+{
+    free(score->classes);
+    free(score->tp);
+    free(score->truth_count);
+    free(score->pred_count);
+    free(score->errors);
+    free(score);
+}
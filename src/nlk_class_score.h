@@ -0,0 +1,110 @@
+/******************************************************************************
+ * NLK - Neural Language Kit
+ *
+ * Copyright (c) 2015 Luis Rei <me@luisrei.com> http://luisrei.com @lmrei
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to 
+ * deal in the Software without restriction, including without limitation the 
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or 
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ *****************************************************************************/
+
+
+
+/** @file nlk_class_score.h
+ * Classification scoring from sparse (confusion) counts
+ */
+
+
+#ifndef __NLK_CLASS_SCORE_H__
+#define __NLK_CLASS_SCORE_H__
+
+
+#include <stdint.h>
+#include <stddef.h>
+
+
+#undef __BEGIN_DECLS
+#undef __END_DECLS
+#ifdef __cplusplus
+# define __BEGIN_DECLS extern "C" {
+# define __END_DECLS }
+#else
+# define __BEGIN_DECLS /* empty */
+# define __END_DECLS /* empty */
+#endif
+__BEGIN_DECLS
+
+
+#define NLK_CLASS_SCORE_CM_DENSE    32  /**< print a full matrix up to this */
+#define NLK_CLASS_SCORE_CM_TOP      20  /**< else print the top confusions */
+#define NLK_CLASS_SCORE_SPARSE      1024 /**< count only the classes that 
+                                              occur above this many classes
+                                              and twice the examples */
+
+
+/** @struct nlk_class_score_cell_t
+ * An off-diagonal cell of the confusion matrix
+ */
+struct nlk_class_score_cell_t {
+    unsigned int truth;     /**< true class (row) */
+    unsigned int pred;      /**< predicted class (column) */
+    uint64_t     count;     /**< number of examples */
+};
+
+
+/** @struct nlk_class_score_t
+ * Per class counts and the sparse confusion matrix of a set of predictions.
+ * Only the classes that occur are stored in the confusion matrix so its
+ * size is bounded by the number of distinct errors, not n_classes^2.
+ * The per class counts are indexed by class (dense) unless there are more 
+ * than NLK_CLASS_SCORE_SPARSE classes and more than twice the examples: 
+ * then only the classes that occur are counted, in the order of classes.
+ */
+struct nlk_class_score_t {
+    size_t       n;             /**< number of examples */
+    size_t       correct;       /**< number of correct predictions */
+    size_t       n_classes;     /**< 1 + the largest class value */
+    size_t       len;           /**< number of per class counts */
+    unsigned int *classes;      /**< class of each count (sparse) or NULL */
+    uint64_t    *tp;            /**< true positives per class */
+    uint64_t    *truth_count;   /**< examples of each class (tp + fn) */
+    uint64_t    *pred_count;    /**< predictions of each class (tp + fp) */
+    struct nlk_class_score_cell_t *errors; /**< by (truth, pred) */
+    size_t       n_errors;      /**< number of off-diagonal cells */
+};
+typedef struct nlk_class_score_t NLK_CLASS_SCORE;
+
+
+struct nlk_class_score_t *nlk_class_score_create(const unsigned int *, 
+                                                 const unsigned int *,
+                                                 const size_t);
+float nlk_class_score_get_accuracy(const struct nlk_class_score_t *);
+float nlk_class_score_get_f1pr(const struct nlk_class_score_t *, 
+                               const unsigned int, float *, float *);
+float nlk_class_score_get_micro(const struct nlk_class_score_t *, float *, 
+                                float *);
+float nlk_class_score_get_macro(const struct nlk_class_score_t *, float *, 
+                                float *);
+float nlk_class_score_get_semeval(const struct nlk_class_score_t *, 
+                                  const unsigned int, const unsigned int);
+void nlk_class_score_print(const struct nlk_class_score_t *);
+void nlk_class_score_print_cm(const struct nlk_class_score_t *);
+void nlk_class_score_free(struct nlk_class_score_t *);
+
+
+__END_DECLS
+#endif /* __NLK_CLASS_SCORE_H__ */
@@ -70,17 +70,54 @@ nlk_corpus_display_progress(const size_t line_counter,
 }
 
 
+/**
+ * Read a line (with id) and vocabularize it, with subword OOV handling
+ * if subwords are given (see nlk_vocab_read_vocabularize)
+ *
+ * @return '\n' or EOF (see nlk_read_line)
+ */
+int
+nlk_corpus_read_vocabularize(int fd, struct nlk_vocab_t **vocab, 
+                             struct nlk_subword_t *subwords,
+                             struct nlk_vocab_t *replacement, 
+                             char **text_line, struct nlk_line_t *v, 
+                             char *buf)
+{
+    int ret;
+
+    ret = nlk_read_line(fd, text_line, &v->line_id, buf);
+    if(ret == EOF && text_line[0][0] == '\0') {
+        v->len = 0;
+        return ret;
+    }
+    if(subwords == NULL) {
+        v->len = nlk_vocab_vocabularize(vocab, text_line, replacement, 
+                                        v->varray); 
+    } else {
+        v->len = nlk_subword_vocabularize(subwords, vocab, text_line, 
+                                          replacement, v->varray);
+    }
+#ifndef NCHECKS
+    if(v->len > NLK_MAX_LINE_SIZE) {
+        NLK_ERROR("Bad line length", NLK_EINVAL);
+        /* unreachable */
+    }
+#endif
+    return ret;
+}
+
 /**
  * Reads a corpus (in id-text line delimited format)
  *
  * @param file_path the path to the corpus
  * @param vocab     the vocabulary to use
+ * @param subwords  subword vectors for OOV words or NULL
  *
  * @return a corpus structure
  */
 struct nlk_corpus_t *
 nlk_corpus_read(char *file_path, struct nlk_vocab_t **vocab, 
-                const bool verbose)
+                struct nlk_subword_t *subwords, const bool verbose)
 {
     struct nlk_corpus_t *corpus = NULL;
     size_t total_lines;
@@ -119,7 +156,7 @@ nlk_corpus_read(char *file_path, struct nlk_vocab_t **vocab,
 
     corpus->len = total_lines;
     struct nlk_line_t *lines = corpus->lines;
-    struct nlk_vocab_t *replacement = nlk_vocab_find(vocab, NLK_UNK_SYMBOL);
+    struct nlk_vocab_t *replacement = nlk_vocab_get_replacement(vocab);
 
     uint64_t word_count = 0;
     size_t line_counter = 0; 
@@ -130,7 +167,8 @@ nlk_corpus_read(char *file_path, struct nlk_vocab_t **vocab,
     /**
      * Start of Parallel Region
      */
-#pragma omp parallel reduction(+ : word_count) shared(line_counter, updated) 
+#pragma omp parallel num_threads(num_threads) reduction(+ : word_count) \
+    shared(line_counter, updated)
 {
     /* allocate memory for a line of text */
     char **text_line = nlk_text_line_create();
@@ -178,8 +216,8 @@ nlk_corpus_read(char *file_path, struct nlk_vocab_t **vocab,
             } /* end of display */
 
             /* read */
-            nlk_vocab_read_vocabularize(fd, true, vocab, replacement, text_line, 
-                                        &vline, buffer);
+            nlk_corpus_read_vocabularize(fd, vocab, subwords, replacement, 
+                                         text_line, &vline, buffer);
          
             /* check for errors */
             if(vline.len == 0) {
@@ -280,10 +318,21 @@ nlk_corpus_subset_count(const struct nlk_corpus_t *corpus, const size_t *ids,
                         const size_t n_ids)
 {
     uint64_t total = 0;
+    struct nlk_set_t *set = nlk_set_create(ids, n_ids);
+    if(set == NULL) {
+        NLK_ERROR_ABORT("unable to create id set", NLK_ENOMEM);
+        /* unreachable */
+    }
+
+    /* the global number of threads, not the last phase's */
+#pragma omp parallel for num_threads(nlk_get_num_threads()) \
+    reduction(+ : total)
     for(size_t ii = 0; ii < corpus->len; ii++) {
-        if(nlk_in(corpus->lines[ii].line_id, ids, n_ids)) {
+        if(nlk_set_in(set, corpus->lines[ii].line_id)) {
             total += corpus->lines[ii].len;
         }
     }
+
+    nlk_set_free(set);
     return total;
 }
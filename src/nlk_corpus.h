@@ -31,6 +31,7 @@
 #define __NLK_CORPUS_H__
 
 #include "nlk_vocabulary.h"
+#include "nlk_subword.h"
 
 #undef __BEGIN_DECLS
 #undef __END_DECLS
@@ -55,8 +56,11 @@ struct nlk_corpus_t {
 
 
 struct nlk_corpus_t *nlk_corpus_read(char *, struct nlk_vocab_t **, 
-                                     const bool);
+                                     struct nlk_subword_t *, const bool);
 void nlk_corpus_free(struct nlk_corpus_t *);
+int nlk_corpus_read_vocabularize(int, struct nlk_vocab_t **, 
+                                 struct nlk_subword_t *, struct nlk_vocab_t *,
+                                 char **, struct nlk_line_t *, char *);
 
 
 uint64_t nlk_corpus_subset_count(const struct nlk_corpus_t *, const size_t *,
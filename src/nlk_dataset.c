@@ -37,6 +37,7 @@
 #include "nlk_text.h"
 #include "nlk_util.h"
 #include "nlk_random.h"
+#include "nlk_class_score.h"
 
 #include "nlk_dataset.h"
 
@@ -631,23 +632,21 @@ nlk_class_f1pr_score_micro(const unsigned int *pred,
     size_t fn = 0;  /**< # of false negatives */
     float div = 0;
 
-    /* calculate tp, fp and tn globally for each class */
-    for(size_t class_val = 0; class_val < n_classes; class_val++) {
-        for(size_t ii = 0; ii < n; ii++) {
-            /* determine true positives and false negatives */
-            if(truth[ii] == class_val) {
-                if(truth[ii] == pred[ii]) {
-                    tp++;
-                } else {
-                    fn++;
-                }
-            }
-            /* determine false positives */
-            if(pred[ii] == class_val && truth[ii] != class_val) {
-                fp++;
+    /* calculate tp, fp and fn globally over the classes (one pass) */
+    for(size_t ii = 0; ii < n; ii++) {
+        /* determine true positives and false negatives */
+        if(truth[ii] < n_classes) {
+            if(truth[ii] == pred[ii]) {
+                tp++;
+            } else {
+                fn++;
             }
-        } /* end of class_i */
-    } /* end of all classes */
+        }
+        /* determine false positives */
+        if(pred[ii] < n_classes && truth[ii] != pred[ii]) {
+            fp++;
+        }
+    }
 
     /** @section Calculate Precision, Recall, F1
      */
@@ -673,36 +672,6 @@ nlk_class_f1pr_score_micro(const unsigned int *pred,
 }
 
 
-/**
- * Create a Confusion Matrix
- */
-static uint64_t **
-nlk_cm_create(const size_t n_classes)
-{
-    uint64_t **cm;
-    cm = (uint64_t **) calloc(n_classes, sizeof(uint64_t *));
-    for(unsigned int ii = 0; ii < n_classes; ii++) {
-        cm[ii] = (uint64_t *) calloc(n_classes, sizeof(uint64_t));
-    }
-
-    return cm;
-}
-
-/**
- * Free a Confusion Matrix
- */
-static void
-nlk_cm_free(uint64_t **cm, const unsigned int n_classes)
-{
-    for(unsigned int ii = 0; ii < n_classes; ii++) {
-        free(cm[ii]);
-        cm[ii] = NULL;
-    }
-
-    free(cm);
-    cm = NULL;
-}
-
 /**
  * Create and Print a Confusion Matrix
  * Row = Truth
@@ -712,62 +681,12 @@ void
 nlk_class_score_cm_print(const unsigned int *pred, const unsigned int *truth, 
                          const size_t n)
 {
-    unsigned int n_classes = nlk_count_unique(truth, n);
-    uint64_t **cm = nlk_cm_create(n_classes);
-    size_t total = 0;
-    size_t errors = 0;
-    size_t total_fp = 0;
-    size_t total_fn = 0;
-
-    /* set values */
-    for(unsigned int ii = 0; ii < n; ii++) {
-        cm[truth[ii]][pred[ii]]++;
-    }
-
-    /* header */
-    printf("\nT\\P:\t");
-    for(unsigned int ii = 0; ii < n_classes; ii++) {
-        printf("%u:\t", ii); /* col index */
-    }
-    printf("\t|Total:\tE(FN):"); /* col index */
-    printf("\n");
-
-    /* rows/cells */
-    for(unsigned int ii = 0; ii < n_classes; ii++) {
-        /* row ii */
-        total = 0;
-        errors = 0;
-        printf("%u:\t", ii); /* row index */
-        for(unsigned int jj = 0; jj < n_classes; jj++) {
-            printf("%"PRIu64"\t", cm[ii][jj]); /* cell value */
-            total += cm[ii][jj];
-            if(ii != jj) {
-                errors += cm[ii][jj];
-            }
-        }
-        total_fn += errors;
-        printf("\t|%"PRIu64"\t%"PRIu64"", total, errors); /* cell value */
-        printf("\n");
-    }
+    struct nlk_class_score_t *score = nlk_class_score_create(pred, truth, n);
 
-    /* Print error row */
-    printf("-\n");
-    printf("E(FP):\t");
-    for(unsigned int jj = 0; jj < n_classes; jj++) {
-        errors = 0;
-        for(unsigned int ii = 0; ii < n_classes; ii++) {
-            if(ii != jj) {
-                errors += cm[ii][jj];
-            }
-        }
-        total_fp += errors;
-        printf("%"PRIu64"\t", errors); /* cell value */
+    if(score != NULL) {
+        nlk_class_score_print_cm(score);
+        nlk_class_score_free(score);
     }
-    printf("\t|%"PRIu64"\t\\%"PRIu64"", total_fp, total_fn);
-    printf("\n");
-
-
-    nlk_cm_free(cm, n_classes);
 }
 
 
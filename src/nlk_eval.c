@@ -33,6 +33,7 @@
 #include <stdbool.h>
 #include <string.h>
 
+#include "nlk.h"
 #include "nlk_err.h"
 #include "nlk_tic.h"
 #include "nlk_array.h"
@@ -44,14 +45,69 @@
 #include "nlk_window.h"
 #include "nlk_corpus.h"
 #include "nlk_pv.h"
+#include "nlk_subword.h"
 
 #include "nlk_eval.h"
 
 
+/**
+ * Find or add an out of vocabulary question word: OOV items (NLK_VOCAB_CHAR)
+ * are numbered in order of addition; their vectors are the average of their 
+ * n-gram vectors (see nlk_subword_oov_vector).
+ *
+ * @param subwords      the subword structure
+ * @param oov           the OOV items (hash table)
+ * @param word          the word
+ *
+ * @return the OOV item or NULL if the word has no n-grams
+ */
+static struct nlk_vocab_t *
+nlk_eval_oov(const struct nlk_subword_t *subwords, struct nlk_vocab_t **oov,
+             const char *word)
+{
+    struct nlk_vocab_t *vi;
+    uint32_t ids[NLK_SUBWORD_MAX_NGRAMS];
+
+    HASH_FIND_STR(*oov, word, vi);
+    if(vi != NULL) {
+        return vi;
+    }
+    if(nlk_subword_ngrams(word, subwords->min_n, subwords->max_n, 
+                          subwords->ngrams->weights->rows, ids) == 0) {
+        return NULL;
+    }
+
+    vi = (struct nlk_vocab_t *) calloc(1, sizeof(struct nlk_vocab_t));
+    if(vi == NULL) {
+        NLK_ERROR_NULL("failed to allocate memory for an OOV word", 
+                       NLK_ENOMEM);
+        /* unreachable */
+    }
+    vi->word = strdup(word);
+    vi->type = NLK_VOCAB_CHAR;
+    vi->index = HASH_COUNT(*oov);
+    vi->hc = NULL;
+    HASH_ADD_STR(*oov, word, vi);
+
+    return vi;
+}
+
+/**
+ * True if a question word is within the evaluation limit: OOV words are
+ * always in it (their vectors follow the vocabulary's)
+ */
+static inline bool
+nlk_eval_in_limit(const struct nlk_vocab_t *vi, const size_t limit)
+{
+    return vi->type == NLK_VOCAB_CHAR || vi->index <= limit;
+}
+
 /** 
  * Parses a line of a word relation test set
  *
  * @param vocab         the vocabulary
+ * @param subwords      subword vectors for OOV question words or NULL
+ * @param oov           the OOV question words (updated)
  * @param lower_words   convert words in test set to lower case
  * @param line          the line string to parse
  * @param test          the parsed test from the line - result if return = true
@@ -59,7 +115,9 @@
  * @return false on failure, true on success
  */
 bool
-__nlk_read_question_line(struct nlk_vocab_t **vocab, bool lower_words, 
+__nlk_read_question_line(struct nlk_vocab_t **vocab, 
+                         const struct nlk_subword_t *subwords,
+                         struct nlk_vocab_t **oov, bool lower_words, 
                          char *line, struct nlk_analogy_test_t *test)
 {
     char *word;
@@ -90,6 +148,10 @@ __nlk_read_question_line(struct nlk_vocab_t **vocab, bool lower_words,
         
         /* find word in voculary */
         vi = nlk_vocab_find(vocab, word); 
+        if(vi == NULL && subwords != NULL && ii < 3) {
+            /* OOV question word: n-gram vector (the answer must be known) */
+            vi = nlk_eval_oov(subwords, oov, word);
+        }
         if(vi == NULL) {
             return false;   /* if any word is not in vocabulary, fail */
         }
@@ -112,6 +174,8 @@ __nlk_read_question_line(struct nlk_vocab_t **vocab, bool lower_words,
  *
  * @param filepath      file path of the test file
  * @param vocab         the vocabulary
+ * @param subwords      subword vectors for OOV question words or NULL
+ * @param oov           the OOV question words (output, see nlk_eval_oov)
  * @param lower_words   convert words in test set to lower case
  * @param total_tests   will be overwritten with the total number of tests read    
  *
@@ -119,7 +183,9 @@ __nlk_read_question_line(struct nlk_vocab_t **vocab, bool lower_words,
  */
 struct nlk_analogy_test_t *
 nlk_read_analogy_test_file(const char *filepath, struct nlk_vocab_t **vocab,
-                             const bool lower_words, size_t *total_tests)
+                           const struct nlk_subword_t *subwords,
+                           struct nlk_vocab_t **oov, const bool lower_words, 
+                           size_t *total_tests)
 {
     char line[NLK_MAX_LINE_SIZE];
     char *fr;
@@ -160,7 +226,7 @@ nlk_read_analogy_test_file(const char *filepath, struct nlk_vocab_t **vocab,
         }
 
         /* parse a single test case, if successful add to tests array */
-        if(__nlk_read_question_line(vocab, lower_words, line,
+        if(__nlk_read_question_line(vocab, subwords, oov, lower_words, line,
                                     &tests[test_number])) {
             test_number++;
         }
@@ -198,6 +264,7 @@ nlk_read_analogy_test_file(const char *filepath, struct nlk_vocab_t **vocab,
  * @param vocab         the vocabulary
  * @param weights       the weights matrix containing the representation of the
  *                      words in the vocabulary
+ * @param subwords      subword vectors for OOV question words or NULL
  * @param limit         limit for the number of words in the vocabulary
  * @param lower_words   convert words in test set to lower case
  * @param accuracy      the total accuracy (return value)
@@ -205,17 +272,58 @@ nlk_read_analogy_test_file(const char *filepath, struct nlk_vocab_t **vocab,
  * @return NLK_SUCCESS or NLK_FAILURE
  *
  * @note
- * This function ignores tests with OOV words. It is mostly meant to be 
+ * Without subwords this function ignores tests with OOV words. With them, 
+ * OOV question words are represented by the average of their n-gram vectors;
+ * tests with an OOV answer are still ignored. It is mostly meant to be 
  * used to monitor the progress of training a word representation.
  * @endnote
  */
 int
 nlk_eval_on_questions(const char *filepath, struct nlk_vocab_t **vocab,
-                      const NLK_ARRAY *weights, const size_t limit, 
-                      const bool lower_words, nlk_real *accuracy)
+                      const NLK_ARRAY *weights, 
+                      const struct nlk_subword_t *subwords, 
+                      const size_t limit, const bool lower_words, 
+                      nlk_real *accuracy)
+{
+    /* the phase's threads, no BLAS threads */
+    const int num_threads = nlk_phase_begin(NLK_PHASE_EVAL);
+
+    return nlk_eval_on_questions_threads(filepath, vocab, weights, subwords,
+                                         limit, lower_words, num_threads, 
+                                         accuracy);
+}
+
+/**
+ * Word analogy evaluation (see nlk_eval_on_questions) with an explicit 
+ * number of threads. It does not begin a phase: the global thread count, 
+ * the thread affinity and the RNG streams are left alone, so it can run in
+ * another thread while training, e.g. on a published snapshot.
+ *
+ * @param filepath      file path of the test file
+ * @param vocab         the vocabulary
+ * @param weights       the word representations
+ * @param subwords      subword vectors for OOV question words or NULL
+ * @param limit         limit for the number of words in the vocabulary
+ * @param lower_words   convert words in test set to lower case
+ * @param num_threads   the number of threads
+ * @param accuracy      the total accuracy (return value)
+ *
+ * @return NLK_SUCCESS or NLK_FAILURE
+ */
+int
+nlk_eval_on_questions_threads(const char *filepath, 
+                              struct nlk_vocab_t **vocab,
+                              const NLK_ARRAY *weights, 
+                              const struct nlk_subword_t *subwords,
+                              const size_t limit, const bool lower_words, 
+                              const int num_threads, nlk_real *accuracy)
 {
     struct nlk_analogy_test_t *tests; /* will contain all test cases */
     size_t total_tests;
+    struct nlk_vocab_t *oov = NULL;     /* OOV question words */
+    struct nlk_vocab_t *vi;
+    struct nlk_vocab_t *tmp;
+    NLK_ARRAY row;
 
     size_t _limit;
     NLK_ARRAY *weights_norm;    /* for the normalized copy of the weights */
@@ -223,20 +331,30 @@ nlk_eval_on_questions(const char *filepath, struct nlk_vocab_t **vocab,
     size_t executed = 0;
 
     /* read file */
-    tests = nlk_read_analogy_test_file(filepath, vocab, lower_words, 
-                                       &total_tests);
+    tests = nlk_read_analogy_test_file(filepath, vocab, subwords, &oov,
+                                       lower_words, &total_tests);
     if(tests == NULL) {
+        nlk_vocab_free(&oov);
         return NLK_FAILURE;
     }
 
+    /* copy of the weights, OOV question word vectors in the rows after them */
+    weights_norm = nlk_array_create(weights->rows + HASH_COUNT(oov), 
+                                    weights->cols);
+    cblas_scopy(weights->len, weights->data, 1, weights_norm->data, 1);
+    HASH_ITER(hh, oov, vi, tmp) {
+        vi->index += weights->rows;
+        nlk_array_row_view(weights_norm, vi->index, &row);
+        nlk_subword_oov_vector(subwords, vi->word, &row);
+    }
+
     /* normalize weights to make distance calculations easier */
-    weights_norm = nlk_array_create_copy(weights);
     nlk_array_normalize_row_vectors(weights_norm);
 
 
     *accuracy = 0;
     if(limit == 0) {
-        _limit = weights_norm->rows;
+        _limit = weights->rows;
     } else {
         _limit = limit;
     }
@@ -244,12 +362,17 @@ nlk_eval_on_questions(const char *filepath, struct nlk_vocab_t **vocab,
     /*
      * perform the tests 
      */
-#pragma omp parallel reduction(+ : correct) reduction(+ : executed)
+    /* per example loop */
+#pragma omp parallel num_threads(num_threads) \
+    reduction(+ : correct) reduction(+ : executed)
 {
-    NLK_ARRAY *predicted = nlk_array_create(1, weights->cols);
-    NLK_ARRAY *sub = nlk_array_create(1, weights->cols);
-    NLK_ARRAY *add = nlk_array_create(1, weights->cols);
-    NLK_ARRAY *word_vector = nlk_array_create(1, weights->cols);
+    /* scratch memory from the thread's workspace */
+    struct nlk_workspace_t *ws = nlk_workspace_thread();
+    const size_t mark = nlk_workspace_mark(ws);
+    NLK_ARRAY *predicted = nlk_workspace_array(ws, 1, weights->cols);
+    NLK_ARRAY *sub = nlk_workspace_array(ws, 1, weights->cols);
+    NLK_ARRAY *add = nlk_workspace_array(ws, 1, weights->cols);
+    NLK_ARRAY *word_vector = nlk_workspace_array(ws, 1, weights->cols);
     struct nlk_analogy_test_t *test;     /* iteration test case*/
     
 
@@ -263,9 +386,9 @@ nlk_eval_on_questions(const char *filepath, struct nlk_vocab_t **vocab,
 
         /* if any of the words is not in the limited vocab, skip */
         if(test->answer->index > _limit
-           || test->question[0]->index > _limit
-           || test->question[1]->index > _limit
-           || test->question[2]->index > _limit) {
+           || !nlk_eval_in_limit(test->question[0], _limit)
+           || !nlk_eval_in_limit(test->question[1], _limit)
+           || !nlk_eval_in_limit(test->question[2], _limit)) {
             continue;
         }
 
@@ -309,12 +432,10 @@ nlk_eval_on_questions(const char *filepath, struct nlk_vocab_t **vocab,
     }
 
     /* cleanup */
-    nlk_array_free(word_vector);
-    nlk_array_free(predicted);
-    nlk_array_free(sub);
-    nlk_array_free(add);
+    nlk_workspace_reset(ws, mark);
 } /* END OF PARALLEL BLOCk */
     free(tests);
+    nlk_vocab_free(&oov);
     nlk_array_free(weights_norm);
 
     /* result */
@@ -357,6 +478,8 @@ nlk_eval_on_paraphrases(struct nlk_neuralnet_t *nn,
         nlk_tic("evaluating", true);
     }
 
+    /* per example loop: the phase's threads, no BLAS threads */
+    nlk_phase_begin(NLK_PHASE_EVAL);
 #pragma omp parallel for reduction(+ : correct) reduction(+ : total)
     for(size_t tt = 0; tt < corpus->len / 2; tt++) {
         nlk_real best_similarity = 0;
@@ -430,6 +553,8 @@ nlk_eval_on_paraphrases_pre_gen(const NLK_ARRAY *pvs, size_t limit,
         nlk_tic("evaluating", true);
     }
 
+    /* per example loop: the phase's threads, no BLAS threads */
+    nlk_phase_begin(NLK_PHASE_EVAL);
 #pragma omp parallel reduction(+ : correct) reduction(+ : total)
 {
 #pragma omp for
@@ -60,8 +60,12 @@ typedef struct nlk_analogy_test nlk_ANALOGY_TEST;
 
 /* questions */
 int nlk_eval_on_questions(const char *, struct nlk_vocab_t **, 
-                          const NLK_ARRAY *, const size_t, const bool, 
-                          nlk_real *accuracy);
+                          const NLK_ARRAY *, const struct nlk_subword_t *,
+                          const size_t, const bool, nlk_real *accuracy);
+int nlk_eval_on_questions_threads(const char *, struct nlk_vocab_t **, 
+                                  const NLK_ARRAY *, 
+                                  const struct nlk_subword_t *, const size_t,
+                                  const bool, const int, nlk_real *accuracy);
 
 void nlk_analogy_test_free(struct nlk_analogy_test_t *);
 
@@ -0,0 +1,435 @@
+/******************************************************************************
+ * NLK - Neural Language Kit
+ *
+ * Copyright (c) 2015 Luis Rei <me@luisrei.com> http://luisrei.com @lmrei
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to 
+ * deal in the Software without restriction, including without limitation the 
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or 
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ *****************************************************************************/
+
+
+
+/** @file nlk_exec.c
+ * Batched forward/backward over a stack of linear layers and transfers
+ */
+
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "nlk.h"
+#include "nlk_err.h"
+#include "nlk_array.h"
+#include "nlk_transfer.h"
+#include "nlk_criterion.h"
+#include "nlk_layer_linear.h"
+#include "nlk_neuralnet.h"
+
+#include "nlk_exec.h"
+
+
+/**
+ * Workspace bytes of a batch x size array (see nlk_workspace_array)
+ */
+static size_t
+nlk_exec_array_size(const size_t batch, const size_t size)
+{
+    size_t bytes = batch * size * sizeof(nlk_real) + NLK_WORKSPACE_ALIGN - 1;
+
+    bytes -= bytes % NLK_WORKSPACE_ALIGN;
+    return NLK_WORKSPACE_ALIGN + bytes;
+}
+
+/**
+ * The first n rows of a batch (view)
+ */
+static inline void
+nlk_exec_rows(const NLK_ARRAY *batch, const size_t n, NLK_ARRAY *view)
+{
+    view->rows = n;
+    view->cols = batch->cols;
+    view->len = n * batch->cols;
+    view->data = batch->data;
+    view->mapped = 0;
+    view->owner = NLK_ARRAY_OWNER_HEAP;
+}
+
+/**
+ * Row ii of a batch as a vector (view)
+ */
+static inline void
+nlk_exec_row(const NLK_ARRAY *batch, const size_t ii, NLK_ARRAY *view)
+{
+    view->rows = batch->cols;
+    view->cols = 1;
+    view->len = batch->cols;
+    view->data = &batch->data[ii * batch->cols];
+    view->mapped = 0;
+    view->owner = NLK_ARRAY_OWNER_HEAP;
+}
+
+
+/**
+ * Create an executor for a stack of linear layers
+ *
+ * @param layers    the linear layers, from input to output
+ * @param transfers the transfer function after each layer
+ * @param n_layers  the number of layers
+ * @param batch     the maximum number of examples in a batch
+ *
+ * @return the executor or NULL if the layer sizes do not match
+ */
+struct nlk_exec_t *
+nlk_exec_create(struct nlk_layer_linear_t **layers, 
+                const NLK_TRANSFER *transfers, const size_t n_layers, 
+                const size_t batch)
+{
+    struct nlk_exec_t *exec;
+    size_t bytes = 0;
+    size_t out_size;
+
+    if(n_layers == 0 || batch == 0) {
+        NLK_ERROR_NULL("executor needs at least one layer and example", 
+                       NLK_EINVAL);
+        /* unreachable */
+    }
+    for(size_t ll = 1; ll < n_layers; ll++) {
+        if(layers[ll]->weights->cols != layers[ll - 1]->weights->rows) {
+            NLK_ERROR_NULL("layer input size does not match the output size "
+                           "of the previous layer", NLK_EBADLEN);
+            /* unreachable */
+        }
+    }
+
+    exec = (struct nlk_exec_t *) malloc(sizeof(struct nlk_exec_t));
+    if(exec == NULL) {
+        NLK_ERROR_ABORT("unable to allocate memory for executor", NLK_ENOMEM);
+        /* unreachable */
+    }
+    exec->n_layers = n_layers;
+    exec->batch = batch;
+    exec->layers = (struct nlk_layer_linear_t **) 
+                   malloc(n_layers * sizeof(struct nlk_layer_linear_t *));
+    exec->transfers = (NLK_TRANSFER *) malloc(n_layers * sizeof(NLK_TRANSFER));
+    exec->learn_rates = (nlk_real *) calloc(n_layers, sizeof(nlk_real));
+    exec->in = (NLK_ARRAY **) calloc(n_layers + 1, sizeof(NLK_ARRAY *));
+    exec->lin = (NLK_ARRAY **) calloc(n_layers, sizeof(NLK_ARRAY *));
+    exec->grad = (NLK_ARRAY **) calloc(n_layers + 1, sizeof(NLK_ARRAY *));
+    exec->grad_lin = (NLK_ARRAY **) calloc(n_layers, sizeof(NLK_ARRAY *));
+    if(exec->layers == NULL || exec->transfers == NULL 
+       || exec->learn_rates == NULL || exec->in == NULL || exec->lin == NULL
+       || exec->grad == NULL || exec->grad_lin == NULL) {
+        NLK_ERROR_ABORT("unable to allocate memory for executor", NLK_ENOMEM);
+        /* unreachable */
+    }
+    memcpy(exec->layers, layers, 
+           n_layers * sizeof(struct nlk_layer_linear_t *));
+    memcpy(exec->transfers, transfers, n_layers * sizeof(NLK_TRANSFER));
+
+    /** @section Plan
+     * input and gradient at the input, then for each layer its output and
+     * gradient (and the linear output and its gradient unless the transfer 
+     * is the identity)
+     */
+    bytes += 2 * nlk_exec_array_size(batch, layers[0]->weights->cols);
+    for(size_t ll = 0; ll < n_layers; ll++) {
+        out_size = layers[ll]->weights->rows;
+        bytes += 2 * nlk_exec_array_size(batch, out_size);
+        if(transfers[ll] != NLK_TRANSFER_NONE) {
+            bytes += 2 * nlk_exec_array_size(batch, out_size);
+        }
+    }
+    exec->ws = nlk_workspace_create(bytes);
+
+    exec->in[0] = nlk_workspace_array(exec->ws, batch, 
+                                      layers[0]->weights->cols);
+    exec->grad[0] = nlk_workspace_array(exec->ws, batch, 
+                                        layers[0]->weights->cols);
+    for(size_t ll = 0; ll < n_layers; ll++) {
+        out_size = layers[ll]->weights->rows;
+        exec->in[ll + 1] = nlk_workspace_array(exec->ws, batch, out_size);
+        exec->grad[ll + 1] = nlk_workspace_array(exec->ws, batch, out_size);
+        if(transfers[ll] != NLK_TRANSFER_NONE) {
+            exec->lin[ll] = nlk_workspace_array(exec->ws, batch, out_size);
+            exec->grad_lin[ll] = nlk_workspace_array(exec->ws, batch, 
+                                                     out_size);
+        } else {
+            exec->lin[ll] = exec->in[ll + 1];
+            exec->grad_lin[ll] = exec->grad[ll + 1];
+        }
+    }
+
+    return exec;
+}
+
+/**
+ * Create an executor for layers [first, first + n_layers[ of a network
+ *
+ * @param nn        the neural network
+ * @param first     the first layer
+ * @param transfers the transfer function after each layer
+ * @param n_layers  the number of layers
+ * @param batch     the maximum number of examples in a batch
+ *
+ * @return the executor or NULL if a layer is not linear or sizes mismatch
+ */
+struct nlk_exec_t *
+nlk_exec_create_nn(struct nlk_neuralnet_t *nn, const size_t first, 
+                   const NLK_TRANSFER *transfers, const size_t n_layers, 
+                   const size_t batch)
+{
+    struct nlk_layer_linear_t *layers[n_layers > 0 ? n_layers : 1];
+
+    if(first + n_layers > nn->n_layers) {
+        NLK_ERROR_NULL("layer out of range", NLK_EINVAL);
+        /* unreachable */
+    }
+    for(size_t ll = 0; ll < n_layers; ll++) {
+        if(nn->types[first + ll] != NLK_LAYER_LINEAR_TYPE) {
+            NLK_ERROR_NULL("executor layers must be linear", NLK_EINVAL);
+            /* unreachable */
+        }
+        layers[ll] = nn->layers[first + ll].ll;
+    }
+
+    return nlk_exec_create(layers, transfers, n_layers, batch);
+}
+
+/**
+ * Free an executor (not its layers)
+ */
+void
+nlk_exec_free(struct nlk_exec_t *exec)
+{
+    if(exec == NULL) {
+        return;
+    }
+    nlk_workspace_free(exec->ws);
+    free(exec->layers);
+    free(exec->transfers);
+    free(exec->learn_rates);
+    free(exec->in);
+    free(exec->lin);
+    free(exec->grad);
+    free(exec->grad_lin);
+    free(exec);
+}
+
+
+/**
+ * Input of example ii of the batch (view, to be filled by the caller)
+ */
+void
+nlk_exec_input(const struct nlk_exec_t *exec, const size_t ii, NLK_ARRAY *in)
+{
+    nlk_exec_row(exec->in[0], ii, in);
+}
+
+/**
+ * Output of example ii of the batch (view, after nlk_exec_forward)
+ */
+void
+nlk_exec_output(const struct nlk_exec_t *exec, const size_t ii, 
+                NLK_ARRAY *out)
+{
+    nlk_exec_row(exec->in[exec->n_layers], ii, out);
+}
+
+/**
+ * Set the learn rate of all layers
+ *
+ * @param exec          the executor
+ * @param learn_rate    the learn rate
+ * @param fan_in        divide the learn rate by each layer's input size
+ */
+void
+nlk_exec_learn_rate(struct nlk_exec_t *exec, const nlk_real learn_rate,
+                    const bool fan_in)
+{
+    for(size_t ll = 0; ll < exec->n_layers; ll++) {
+        exec->learn_rates[ll] = learn_rate;
+        if(fan_in) {
+            exec->learn_rates[ll] /= exec->layers[ll]->weights->cols;
+        }
+    }
+}
+
+
+/**
+ * Forward pass of the first n examples of the batch: out = x * W' + bias 
+ * for all examples at once (GEMM), then the transfer.
+ *
+ * @param exec  the executor (inputs filled, see nlk_exec_input)
+ * @param n     the number of examples (<= batch)
+ */
+void
+nlk_exec_forward(struct nlk_exec_t *exec, const size_t n)
+{
+    NLK_ARRAY lin;
+    NLK_ARRAY out;
+
+#ifndef NCHECKS
+    if(n == 0 || n > exec->batch) {
+        NLK_ERROR_VOID("number of examples larger than the batch", 
+                       NLK_EBADLEN);
+        /* unreachable */
+    }
+#endif
+
+    for(size_t ll = 0; ll < exec->n_layers; ll++) {
+        const struct nlk_layer_linear_t *layer = exec->layers[ll];
+        const size_t rows = layer->weights->rows;
+        const size_t cols = layer->weights->cols;
+        const nlk_real *x = exec->in[ll]->data;
+        nlk_real *y = exec->lin[ll]->data;
+
+        /* bias */
+        for(size_t ii = 0; ii < n; ii++) {
+            if(layer->bias != NULL) {
+                memcpy(&y[ii * rows], layer->bias->data, 
+                       rows * sizeof(nlk_real));
+            } else {
+                memset(&y[ii * rows], 0, rows * sizeof(nlk_real));
+            }
+        }
+
+        /* Y += X * W' */
+        if(n == 1) {
+            cblas_sgemv(CblasRowMajor, CblasNoTrans, rows, cols, 1, 
+                        layer->weights->data, cols, x, 1, 1, y, 1);
+        } else {
+            cblas_sgemm(CblasRowMajor, CblasNoTrans, CblasTrans, n, rows, 
+                        cols, 1, x, cols, layer->weights->data, cols, 1, y, 
+                        rows);
+        }
+
+        /* transfer */
+        nlk_exec_rows(exec->lin[ll], n, &lin);
+        nlk_exec_rows(exec->in[ll + 1], n, &out);
+        nlk_transfer_forward(exec->transfers[ll], &lin, &out);
+    }
+}
+
+/**
+ * Predicted class (max output) of the first n examples of the batch
+ */
+void
+nlk_exec_predict(const struct nlk_exec_t *exec, const size_t n, 
+                 unsigned int *pred)
+{
+    NLK_ARRAY out;
+
+    for(size_t ii = 0; ii < n; ii++) {
+        nlk_exec_output(exec, ii, &out);
+        pred[ii] = nlk_array_max_i(&out);
+    }
+}
+
+/**
+ * Negative Log Likelihood gradient at the output of the first n examples 
+ * (the output must be log-probabilities, e.g. NLK_TRANSFER_LOG_SOFTMAX)
+ *
+ * @param exec      the executor (after nlk_exec_forward)
+ * @param n         the number of examples
+ * @param targets   the target class of each example
+ */
+void
+nlk_exec_nll_backprop(struct nlk_exec_t *exec, const size_t n, 
+                      const unsigned int *targets)
+{
+    NLK_ARRAY out;
+    NLK_ARRAY grad;
+
+    for(size_t ii = 0; ii < n; ii++) {
+        nlk_exec_output(exec, ii, &out);
+        nlk_exec_row(exec->grad[exec->n_layers], ii, &grad);
+        nlk_nll_backprop(&out, targets[ii], &grad);
+    }
+}
+
+/**
+ * Backward pass of the first n examples of the batch: from the gradient at 
+ * the output (see nlk_exec_nll_backprop) computes the gradient at the input
+ * of each layer and updates its parameters with its learn rate, the 
+ * gradients of the batch summed (GEMM).
+ *
+ * @param exec          the executor (after nlk_exec_forward)
+ * @param n             the number of examples
+ * @param grad_input    also compute the gradient at the input of the stack 
+ *                      (exec->grad[0])
+ */
+void
+nlk_exec_backward(struct nlk_exec_t *exec, const size_t n, 
+                  const bool grad_input)
+{
+    NLK_ARRAY lin;
+    NLK_ARRAY out;
+    NLK_ARRAY grad_out;
+    NLK_ARRAY grad_lin;
+
+    for(size_t ll = exec->n_layers; ll-- > 0; ) {
+        struct nlk_layer_linear_t *layer = exec->layers[ll];
+        const size_t rows = layer->weights->rows;
+        const size_t cols = layer->weights->cols;
+        const nlk_real learn_rate = exec->learn_rates[ll];
+        const nlk_real *x = exec->in[ll]->data;
+        const nlk_real *g = exec->grad_lin[ll]->data;
+        nlk_real *g_in = exec->grad[ll]->data;
+
+        /* transfer */
+        nlk_exec_rows(exec->lin[ll], n, &lin);
+        nlk_exec_rows(exec->in[ll + 1], n, &out);
+        nlk_exec_rows(exec->grad[ll + 1], n, &grad_out);
+        nlk_exec_rows(exec->grad_lin[ll], n, &grad_lin);
+        nlk_transfer_backprop(exec->transfers[ll], &lin, &out, &grad_out, 
+                              &grad_lin);
+
+        /* gradient at the input: G_in = G * W (before the update) */
+        if(ll > 0 || grad_input) {
+            if(n == 1) {
+                cblas_sgemv(CblasRowMajor, CblasTrans, rows, cols, 1, 
+                            layer->weights->data, cols, g, 1, 0, g_in, 1);
+            } else {
+                cblas_sgemm(CblasRowMajor, CblasNoTrans, CblasNoTrans, n, 
+                            cols, rows, 1, g, rows, layer->weights->data, 
+                            cols, 0, g_in, cols);
+            }
+        }
+
+        /* parameters: W += learn_rate * G' * X, bias += learn_rate * sum(G) */
+        if(learn_rate == 0) {
+            continue;
+        }
+        if(n == 1) {
+            cblas_sger(CblasRowMajor, rows, cols, learn_rate, g, 1, x, 1, 
+                       layer->weights->data, cols);
+        } else {
+            cblas_sgemm(CblasRowMajor, CblasTrans, CblasNoTrans, rows, cols, 
+                        n, learn_rate, g, rows, x, cols, 1, 
+                        layer->weights->data, cols);
+        }
+        if(layer->bias != NULL) {
+            for(size_t ii = 0; ii < n; ii++) {
+                cblas_saxpy(rows, learn_rate, &g[ii * rows], 1, 
+                            layer->bias->data, 1);
+            }
+        }
+
+        NLK_ARRAY_CHECK_NAN(layer->weights, "NaN in weights");
+    }
+}
@@ -0,0 +1,106 @@
+/******************************************************************************
+ * NLK - Neural Language Kit
+ *
+ * Copyright (c) 2015 Luis Rei <me@luisrei.com> http://luisrei.com @lmrei
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to 
+ * deal in the Software without restriction, including without limitation the 
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or 
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ *****************************************************************************/
+
+
+
+/** @file nlk_exec.h
+ * Batched forward/backward over a stack of linear layers and transfers
+ */
+
+
+#ifndef __NLK_EXEC_H__
+#define __NLK_EXEC_H__
+
+
+#include <stddef.h>
+#include <stdbool.h>
+
+#include "nlk_array.h"
+#include "nlk_transfer.h"
+#include "nlk_layer_linear.h"
+#include "nlk_neuralnet.h"
+
+
+#undef __BEGIN_DECLS
+#undef __END_DECLS
+#ifdef __cplusplus
+# define __BEGIN_DECLS extern "C" {
+# define __END_DECLS }
+#else
+# define __BEGIN_DECLS /* empty */
+# define __END_DECLS /* empty */
+#endif
+__BEGIN_DECLS
+
+
+#define NLK_EXEC_BATCH 64   /**< default examples per batch (inference) */
+
+
+/** @struct nlk_exec_t
+ * Runs a stack of linear layers, each followed by a transfer function, over
+ * batches of up to batch examples (one example per row). The activations 
+ * and gradients of a batch are planned once, in the executor's workspace.
+ * The layers are shared: one executor per thread, Hogwild style updates.
+ */
+struct nlk_exec_t {
+    struct nlk_layer_linear_t  **layers;        /**< the linear layers */
+    NLK_TRANSFER                *transfers;     /**< transfer of each layer */
+    nlk_real                    *learn_rates;   /**< learn rate of each layer*/
+    size_t                       n_layers;      /**< number of layers */
+    size_t                       batch;         /**< max examples per batch */
+    NLK_ARRAY                  **in;            /**< input of each layer and
+                                                     output (n_layers + 1) */
+    NLK_ARRAY                  **lin;           /**< linear layer outputs */
+    NLK_ARRAY                  **grad;          /**< gradients at in */
+    NLK_ARRAY                  **grad_lin;      /**< gradients at lin */
+    struct nlk_workspace_t      *ws;            /**< activations, gradients */
+};
+typedef struct nlk_exec_t NLK_EXEC;
+
+
+/* create/free */
+struct nlk_exec_t *nlk_exec_create(struct nlk_layer_linear_t **, 
+                                   const NLK_TRANSFER *, const size_t, 
+                                   const size_t);
+struct nlk_exec_t *nlk_exec_create_nn(struct nlk_neuralnet_t *, const size_t,
+                                      const NLK_TRANSFER *, const size_t, 
+                                      const size_t);
+void nlk_exec_free(struct nlk_exec_t *);
+
+/* examples */
+void nlk_exec_input(const struct nlk_exec_t *, const size_t, NLK_ARRAY *);
+void nlk_exec_output(const struct nlk_exec_t *, const size_t, NLK_ARRAY *);
+void nlk_exec_learn_rate(struct nlk_exec_t *, const nlk_real, const bool);
+
+/* run */
+void nlk_exec_forward(struct nlk_exec_t *, const size_t);
+void nlk_exec_predict(const struct nlk_exec_t *, const size_t, 
+                      unsigned int *);
+void nlk_exec_nll_backprop(struct nlk_exec_t *, const size_t, 
+                           const unsigned int *);
+void nlk_exec_backward(struct nlk_exec_t *, const size_t, const bool);
+
+
+__END_DECLS
+#endif /* __NLK_EXEC_H__ */
@@ -0,0 +1,519 @@
+/******************************************************************************
+ * NLK - Neural Language Kit
+ *
+ * Copyright (c) 2015 Luis Rei <me@luisrei.com> http://luisrei.com @lmrei
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to 
+ * deal in the Software without restriction, including without limitation the 
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or 
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ *****************************************************************************/
+
+
+
+/** @file nlk_kmeans.c
+ * K-means clustering (k-means++ initialization, Lloyd or mini-batch)
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <errno.h>
+#include <omp.h>
+
+#include "nlk.h"
+#include "nlk_err.h"
+#include "nlk_array.h"
+#include "nlk_random.h"
+#include "nlk_dataset.h"
+#include "nlk_vocabulary.h"
+
+#include "nlk_kmeans.h"
+
+
+/**
+ * Squared norms of the centers
+ */
+static void
+nlk_kmeans_norms(const NLK_ARRAY *centroids, nlk_real *norms)
+{
+    const size_t d = centroids->cols;
+    const nlk_real *center;
+
+    for(size_t jj = 0; jj < centroids->rows; jj++) {
+        center = &centroids->data[jj * d];
+        norms[jj] = cblas_sdot(d, center, 1, center, 1);
+    }
+}
+
+
+/**
+ * Assign rows to their nearest center and, optionally, accumulate the
+ * per cluster sums and counts for the update.
+ * Distances are |x|^2 - 2 x.c + |c|^2 with x.c computed for a block of 
+ * NLK_KMEANS_BLOCK rows against all centers by a single SGEMM. Each thread
+ * accumulates its own partial sums which are added together at the end.
+ *
+ * @param x         the rows [n][d]
+ * @param n         the number of rows
+ * @param centroids the centers [k][d]
+ * @param norms     the squared norms of the centers [k]
+ * @param assign    the assignments [n] (modified)
+ * @param sums      per cluster sums [k][d] or NULL (overwritten)
+ * @param counts    per cluster counts [k] or NULL (overwritten)
+ * @param moved     the number of rows whose assignment changed (output)
+ *
+ * @return the inertia (sum of squared distances)
+ */
+static double
+nlk_kmeans_step(const nlk_real *x, const size_t n, const NLK_ARRAY *centroids,
+                const nlk_real *norms, unsigned int *assign, double *sums, 
+                size_t *counts, size_t *moved)
+{
+    const size_t k = centroids->rows;
+    const size_t d = centroids->cols;
+    double inertia = 0;
+    size_t changed = 0;
+
+    if(sums != NULL) {
+        memset(sums, 0, k * d * sizeof(double));
+        memset(counts, 0, k * sizeof(size_t));
+    }
+
+    /* per example loop: the phase's threads, no BLAS threads */
+    nlk_phase_begin(NLK_PHASE_DEFAULT);
+#pragma omp parallel reduction(+ : inertia, changed)
+{
+    nlk_real *dots;
+    double *t_sums = NULL;
+    size_t *t_counts = NULL;
+
+    dots = (nlk_real *) malloc(NLK_KMEANS_BLOCK * k * sizeof(nlk_real));
+    if(dots == NULL) {
+        NLK_ERROR_ABORT("unable to allocate memory for k-means", NLK_ENOMEM);
+        /* unreachable */
+    }
+    if(sums != NULL) {
+        t_sums = (double *) calloc(k * d, sizeof(double));
+        t_counts = (size_t *) calloc(k, sizeof(size_t));
+        if(t_sums == NULL || t_counts == NULL) {
+            NLK_ERROR_ABORT("unable to allocate memory for k-means", 
+                            NLK_ENOMEM);
+            /* unreachable */
+        }
+    }
+
+#pragma omp for schedule(dynamic)
+    for(size_t start = 0; start < n; start += NLK_KMEANS_BLOCK) {
+        const size_t rows = n - start < NLK_KMEANS_BLOCK ? 
+                            n - start : NLK_KMEANS_BLOCK;
+        const nlk_real *block = &x[start * d];
+
+        /* dots = X * C' */
+        cblas_sgemm(CblasRowMajor, CblasNoTrans, CblasTrans, rows, k, d, 
+                    1, block, d, centroids->data, d, 0, dots, k);
+
+        for(size_t ii = 0; ii < rows; ii++) {
+            const nlk_real *row = &block[ii * d];
+            const nlk_real *dot = &dots[ii * k];
+            unsigned int best = 0;
+            nlk_real best_dist = norms[0] - 2 * dot[0];
+            nlk_real dist;
+
+            for(size_t jj = 1; jj < k; jj++) {
+                dist = norms[jj] - 2 * dot[jj];
+                if(dist < best_dist) {
+                    best_dist = dist;
+                    best = jj;
+                }
+            }
+            dist = best_dist + cblas_sdot(d, row, 1, row, 1);
+            inertia += dist > 0 ? dist : 0;
+
+            if(assign[start + ii] != best) {
+                assign[start + ii] = best;
+                changed++;
+            }
+            if(t_sums != NULL) {
+                double *sum = &t_sums[best * d];
+                t_counts[best] += 1;
+                for(size_t kk = 0; kk < d; kk++) {
+                    sum[kk] += row[kk];
+                }
+            }
+        }
+    } /* end of blocks */
+
+    /* add the partial sums */
+    if(t_sums != NULL) {
+#pragma omp critical(nlk_kmeans_reduce)
+    {
+        for(size_t ii = 0; ii < k * d; ii++) {
+            sums[ii] += t_sums[ii];
+        }
+        for(size_t jj = 0; jj < k; jj++) {
+            counts[jj] += t_counts[jj];
+        }
+    }
+    }
+
+    free(dots);
+    free(t_sums);
+    free(t_counts);
+} /* end of parallel region */
+
+    *moved = changed;
+    return inertia;
+}
+
+
+/**
+ * k-means++ initialization: each new center is a row sampled with 
+ * probability proportional to its squared distance to the nearest center
+ * already chosen.
+ *
+ * @param table     the rows [n][d]
+ * @param centroids the centers [k][d] (overwritten)
+ * @param rng       the random number generator
+ */
+static void
+nlk_kmeans_init(const NLK_ARRAY *table, NLK_ARRAY *centroids, 
+                struct nlk_rng_t *rng)
+{
+    const size_t n = table->rows;
+    const size_t d = table->cols;
+    const size_t k = centroids->rows;
+    nlk_real *min_dist;
+    size_t pick;
+    double total;
+    double r;
+
+    min_dist = (nlk_real *) malloc(n * sizeof(nlk_real));
+    if(min_dist == NULL) {
+        NLK_ERROR_VOID("unable to allocate memory for k-means", NLK_ENOMEM);
+        /* unreachable */
+    }
+
+    /* per row distances: the phase's threads, no BLAS threads */
+    nlk_phase_begin(NLK_PHASE_DEFAULT);
+
+    pick = nlk_rng_to_range(nlk_rng_next(rng), n);
+    for(size_t jj = 0; jj < k; jj++) {
+        nlk_real *center = &centroids->data[jj * d];
+        memcpy(center, &table->data[pick * d], d * sizeof(nlk_real));
+        if(jj + 1 == k) {
+            break;
+        }
+
+        /* distance of every row to its nearest center */
+        total = 0;
+#pragma omp parallel for reduction(+ : total)
+        for(size_t ii = 0; ii < n; ii++) {
+            const nlk_real *row = &table->data[ii * d];
+            nlk_real dist = 0;
+            nlk_real diff;
+
+            for(size_t kk = 0; kk < d; kk++) {
+                diff = row[kk] - center[kk];
+                dist += diff * diff;
+            }
+            if(jj == 0 || dist < min_dist[ii]) {
+                min_dist[ii] = dist;
+            }
+            total += min_dist[ii];
+        }
+
+        /* sample the next center */
+        if(total <= 0) {
+            pick = nlk_rng_to_range(nlk_rng_next(rng), n);
+            continue;
+        }
+        r = nlk_rng_to_float(nlk_rng_next(rng)) * total;
+        for(size_t ii = 0; ii < n; ii++) {
+            if(min_dist[ii] <= 0) {
+                continue;
+            }
+            pick = ii;
+            r -= min_dist[ii];
+            if(r < 0) {
+                break;
+            }
+        }
+    }
+
+    free(min_dist);
+}
+
+
+/**
+ * Cluster the rows of a table with k-means.
+ * Centers are initialized with k-means++. With batch = 0 this is Lloyd's 
+ * algorithm over the whole table, stopping when no row changes cluster or 
+ * the inertia improves by less than NLK_KMEANS_TOL. Otherwise each 
+ * iteration is a mini-batch of rows sampled from the table and centers
+ * move towards their rows with a per center learning rate 1/count 
+ * (Sculley, 2010).
+ *
+ * @param table     the rows to cluster [n][d] (e.g. word or PV weights)
+ * @param k         the number of clusters
+ * @param iter      maximum iterations (0 for NLK_KMEANS_ITER)
+ * @param batch     mini-batch size (0 for full batch)
+ * @param verbose   print progress
+ *
+ * @return the clustering (inertia is that of the last iteration)
+ */
+struct nlk_kmeans_t *
+nlk_kmeans_fit(const NLK_ARRAY *table, const size_t k, const size_t iter,
+               const size_t batch, const bool verbose)
+{
+    const size_t n = table->rows;
+    const size_t d = table->cols;
+    const size_t max_iter = iter > 0 ? iter : NLK_KMEANS_ITER;
+    const size_t len = batch > 0 ? batch : n;
+    struct nlk_kmeans_t *km;
+    struct nlk_rng_t *rng = nlk_rng_thread();
+    nlk_real *norms;
+    double *sums;
+    size_t *counts;
+    size_t *seen = NULL;
+    unsigned int *assign;
+    nlk_real *x = table->data;
+    nlk_real *center;
+    double inertia = 0;
+    double prev;
+    size_t moved;
+    size_t row;
+
+    if(k == 0 || k > n || k > UINT_MAX) {
+        NLK_ERROR_NULL("invalid number of clusters", NLK_EINVAL);
+        /* unreachable */
+    }
+
+    km = (struct nlk_kmeans_t *) malloc(sizeof(struct nlk_kmeans_t));
+    norms = (nlk_real *) malloc(k * sizeof(nlk_real));
+    sums = (double *) malloc(k * d * sizeof(double));
+    counts = (size_t *) malloc(k * sizeof(size_t));
+    assign = (unsigned int *) malloc(len * sizeof(unsigned int));
+    if(batch > 0) {
+        x = (nlk_real *) malloc(batch * d * sizeof(nlk_real));
+        seen = (size_t *) calloc(k, sizeof(size_t));
+    }
+    if(km == NULL || norms == NULL || sums == NULL || counts == NULL || 
+       assign == NULL || x == NULL || (batch > 0 && seen == NULL)) {
+        NLK_ERROR_NULL("unable to allocate memory for k-means", NLK_ENOMEM);
+        /* unreachable */
+    }
+    memset(assign, 0xff, len * sizeof(unsigned int));
+    km->centroids = nlk_array_create(k, d);
+    km->iterations = 0;
+
+    nlk_kmeans_init(table, km->centroids, rng);
+
+    for(size_t it = 0; it < max_iter; it++) {
+        nlk_kmeans_norms(km->centroids, norms);
+        prev = inertia;
+
+        /* sample a mini-batch */
+        if(batch > 0) {
+            for(size_t ii = 0; ii < batch; ii++) {
+                row = nlk_rng_to_range(nlk_rng_next(rng), n);
+                memcpy(&x[ii * d], &table->data[row * d], 
+                       d * sizeof(nlk_real));
+            }
+        }
+
+        inertia = nlk_kmeans_step(x, len, km->centroids, norms, assign, sums,
+                                  counts, &moved);
+        km->iterations = it + 1;
+
+        /* update centers */
+        for(size_t jj = 0; jj < k; jj++) {
+            center = &km->centroids->data[jj * d];
+            if(batch > 0 && counts[jj] > 0) {
+                /* c += (sum - count * c) / seen */
+                seen[jj] += counts[jj];
+                for(size_t kk = 0; kk < d; kk++) {
+                    center[kk] += (sums[jj * d + kk] - counts[jj] * center[kk])
+                                  / seen[jj];
+                }
+            } else if(counts[jj] > 0) {
+                for(size_t kk = 0; kk < d; kk++) {
+                    center[kk] = sums[jj * d + kk] / counts[jj];
+                }
+            } else if(batch == 0) {
+                /* empty cluster: restart it at a random row */
+                row = nlk_rng_to_range(nlk_rng_next(rng), n);
+                memcpy(center, &table->data[row * d], d * sizeof(nlk_real));
+            }
+        }
+
+        if(verbose) {
+            printf("\rk-means: iteration %zu, inertia %f", it + 1, inertia);
+            if(batch == 0) {
+                printf(", moved %zu    ", moved);
+            }
+            fflush(stdout);
+        }
+        if(batch == 0 && (moved == 0 || 
+           (it > 0 && prev - inertia <= NLK_KMEANS_TOL * inertia))) {
+            break;
+        }
+    }
+    if(verbose) {
+        printf("\n");
+    }
+    km->inertia = inertia;
+
+    free(norms);
+    free(sums);
+    free(counts);
+    free(assign);
+    if(batch > 0) {
+        free(x);
+        free(seen);
+    }
+
+    return km;
+}
+
+
+/**
+ * Assign the rows of a table to their nearest cluster
+ *
+ * @param km        the clustering
+ * @param table     the rows [n][d]
+ * @param assign    the cluster of each row [n] (output)
+ *
+ * @return the inertia (sum of squared distances to the centers)
+ */
+double
+nlk_kmeans_assign(const struct nlk_kmeans_t *km, const NLK_ARRAY *table,
+                  unsigned int *assign)
+{
+    nlk_real *norms;
+    double inertia;
+    size_t moved;
+
+    if(table->cols != km->centroids->cols) {
+        NLK_ERROR_ABORT("table and centers dimensions do not match", 
+                        NLK_EBADLEN);
+        /* unreachable */
+    }
+    norms = (nlk_real *) malloc(km->centroids->rows * sizeof(nlk_real));
+    if(norms == NULL) {
+        NLK_ERROR_ABORT("unable to allocate memory for k-means", NLK_ENOMEM);
+        /* unreachable */
+    }
+
+    nlk_kmeans_norms(km->centroids, norms);
+    memset(assign, 0xff, table->rows * sizeof(unsigned int));
+    inertia = nlk_kmeans_step(table->data, table->rows, km->centroids, norms,
+                              assign, NULL, NULL, &moved);
+
+    free(norms);
+    return inertia;
+}
+
+
+/**
+ * Cluster the rows of a table and write the cluster of each row in the 
+ * dataset map format ("id class" lines). The id is the row's word if a 
+ * vocabulary is given (word vectors) and the row index otherwise.
+ *
+ * @param table     the rows to cluster [n][d]
+ * @param vocab     the vocabulary of the rows (words) or NULL
+ * @param k         the number of clusters
+ * @param iter      maximum iterations (0 for NLK_KMEANS_ITER)
+ * @param batch     mini-batch size (0 for full batch)
+ * @param filepath  the file to write
+ * @param verbose   print progress
+ */
+void
+nlk_kmeans_cluster_path(const NLK_ARRAY *table, struct nlk_vocab_t **vocab,
+                        const size_t k, const size_t iter, const size_t batch,
+                        const char *filepath, const bool verbose)
+{
+    struct nlk_kmeans_t *km;
+    struct nlk_vocab_t *vi;
+    unsigned int *assign;
+    size_t *ids;
+    char **words;
+    double inertia;
+
+    km = nlk_kmeans_fit(table, k, iter, batch, verbose);
+    if(km == NULL) {
+        return;
+    }
+
+    assign = (unsigned int *) malloc(table->rows * sizeof(unsigned int));
+    ids = (size_t *) malloc(table->rows * sizeof(size_t));
+    words = (char **) calloc(table->rows, sizeof(char *));
+    if(assign == NULL || ids == NULL || words == NULL) {
+        NLK_ERROR_VOID("unable to allocate memory for k-means", NLK_ENOMEM);
+        /* unreachable */
+    }
+    for(size_t ii = 0; ii < table->rows; ii++) {
+        ids[ii] = ii;
+    }
+    if(vocab != NULL) {
+        for(vi = *vocab; vi != NULL; vi = vi->hh.next) {
+            if(vi->index < table->rows) {
+                words[vi->index] = vi->word;
+            }
+        }
+    }
+
+    inertia = nlk_kmeans_assign(km, table, assign);
+    if(verbose) {
+        printf("k-means: %zu clusters, %zu iterations, inertia %f\n", k,
+               km->iterations, inertia);
+    }
+    if(vocab == NULL) {
+        nlk_dataset_save_map_path(filepath, ids, assign, table->rows);
+    } else {
+        FILE *fp = fopen(filepath, "w");
+        if(fp == NULL) {
+            NLK_ERROR_VOID(strerror(errno), errno);
+            /* unreachable */
+        }
+        for(size_t ii = 0; ii < table->rows; ii++) {
+            if(words[ii] != NULL) {
+                fprintf(fp, "%s %u\n", words[ii], assign[ii]);
+            } else {
+                fprintf(fp, "%zu %u\n", ii, assign[ii]);
+            }
+        }
+        fclose(fp);
+    }
+
+    free(assign);
+    free(ids);
+    free(words);
+    nlk_kmeans_free(km);
+}
+
+
+/**
+ * Free a clustering
+ */
+void
+nlk_kmeans_free(struct nlk_kmeans_t *km)
+{
+    nlk_array_free(km->centroids);
+    free(km);
+}
@@ -0,0 +1,81 @@
+/******************************************************************************
+ * NLK - Neural Language Kit
+ *
+ * Copyright (c) 2015 Luis Rei <me@luisrei.com> http://luisrei.com @lmrei
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to 
+ * deal in the Software without restriction, including without limitation the 
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or 
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ *****************************************************************************/
+
+
+
+/** @file nlk_kmeans.h
+ * K-means clustering definitions
+ */
+
+
+#ifndef __NLK_KMEANS_H__
+#define __NLK_KMEANS_H__
+
+
+#include <stdbool.h>
+
+#include "nlk_array.h"
+#include "nlk_vocabulary.h"
+
+
+#undef __BEGIN_DECLS
+#undef __END_DECLS
+#ifdef __cplusplus
+# define __BEGIN_DECLS extern "C" {
+# define __END_DECLS }
+#else
+# define __BEGIN_DECLS /* empty */
+# define __END_DECLS /* empty */
+#endif
+__BEGIN_DECLS
+
+
+#define NLK_KMEANS_BLOCK    256     /**< rows per distance SGEMM */
+#define NLK_KMEANS_ITER     100     /**< default maximum iterations */
+#define NLK_KMEANS_TOL      1e-4    /**< stop at this relative inertia change */
+
+
+/** @struct nlk_kmeans_t
+ * A k-means clustering
+ */
+struct nlk_kmeans_t {
+    NLK_ARRAY   *centroids;     /**< cluster centers [k][d] */
+    double       inertia;       /**< sum of squared distances to centers */
+    size_t       iterations;    /**< iterations until convergence */
+};
+typedef struct nlk_kmeans_t NLK_KMEANS;
+
+
+struct nlk_kmeans_t *nlk_kmeans_fit(const NLK_ARRAY *, const size_t, 
+                                    const size_t, const size_t, const bool);
+double nlk_kmeans_assign(const struct nlk_kmeans_t *, const NLK_ARRAY *, 
+                         unsigned int *);
+void nlk_kmeans_cluster_path(const NLK_ARRAY *, struct nlk_vocab_t **,
+                             const size_t, const size_t, const size_t, 
+                             const char *, const bool);
+void nlk_kmeans_free(struct nlk_kmeans_t *);
+
+
+__END_DECLS
+#endif /* __NLK_KMEANS_H__ */
@@ -33,6 +33,10 @@
 #include <string.h>
 #include <errno.h>
 
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
 #include "nlk_err.h"
 #include "nlk_array.h"
 #include "nlk_layer_linear.h"
@@ -321,3 +325,281 @@ nlk_layer_linear_load(FILE *in)
 }
 
 
+
+
+/**
+ * Create an int8 copy of a linear layer for inference. Each row of weights
+ * is quantized with its own scale (max |w| / NLK_Q8_MAX). The input scale
+ * is 1 / NLK_Q8_MAX (inputs in [-1, 1]) until the layer is calibrated.
+ *
+ * @param layer the (float) linear layer
+ *
+ * @return the quantized layer
+ */
+struct nlk_layer_linear_q8_t *
+nlk_layer_linear_q8_create(const struct nlk_layer_linear_t *layer)
+{
+    struct nlk_layer_linear_q8_t *q8;
+    const NLK_ARRAY *weights = layer->weights;
+    const nlk_real *row;
+    nlk_real max;
+
+    q8 = (struct nlk_layer_linear_q8_t *) 
+         malloc(sizeof(struct nlk_layer_linear_q8_t));
+    if(q8 == NULL) {
+        NLK_ERROR_NULL("failed to allocate memory for layer", NLK_ENOMEM);
+        /* unreachable */
+    }
+    q8->rows = weights->rows;
+    q8->cols = weights->cols;
+    q8->cols_pad = (weights->cols + NLK_Q8_PAD - 1) / NLK_Q8_PAD * NLK_Q8_PAD;
+    q8->in_scale = 1.0 / NLK_Q8_MAX;
+
+    q8->weights = (int8_t *) calloc(q8->rows * q8->cols_pad, sizeof(int8_t));
+    q8->scale = (float *) malloc(q8->rows * sizeof(float));
+    if(q8->weights == NULL || q8->scale == NULL) {
+        NLK_ERROR_NULL("failed to allocate memory for layer", NLK_ENOMEM);
+        /* unreachable */
+    }
+
+    /* per row quantization, padding stays 0 */
+    for(size_t rr = 0; rr < q8->rows; rr++) {
+        row = &weights->data[rr * q8->cols];
+        max = 0;
+        for(size_t cc = 0; cc < q8->cols; cc++) {
+            if(fabs(row[cc]) > max) {
+                max = fabs(row[cc]);
+            }
+        }
+        q8->scale[rr] = max > 0 ? max / NLK_Q8_MAX : 1;
+        for(size_t cc = 0; cc < q8->cols; cc++) {
+            q8->weights[rr * q8->cols_pad + cc] = lrintf(row[cc] / 
+                                                         q8->scale[rr]);
+        }
+    }
+
+    /* bias stays float */
+    if(layer->bias != NULL) {
+        q8->bias = nlk_array_create_copy(layer->bias);
+    } else {
+        q8->bias = NULL;
+    }
+
+    return q8;
+}
+
+
+/**
+ * Calibrate the input scale of a quantized layer on a sample of inputs:
+ * the largest absolute value seen maps to NLK_Q8_MAX.
+ *
+ * @param q8        the quantized layer
+ * @param inputs    sample inputs, one per row [n][input size]
+ * @param n         number of rows of inputs to use (at most inputs->rows)
+ */
+void
+nlk_layer_linear_q8_calibrate(struct nlk_layer_linear_q8_t *q8, 
+                              const NLK_ARRAY *inputs, size_t n)
+{
+    nlk_real max = 0;
+
+#ifndef NCHECKS
+    if(inputs->cols != q8->cols) {
+        NLK_ERROR_VOID("input and layer dimensions do not match", 
+                       NLK_EBADLEN);
+        /* unreachable */
+    }
+#endif
+    if(n > inputs->rows) {
+        n = inputs->rows;
+    }
+
+    for(size_t ii = 0; ii < n * inputs->cols; ii++) {
+        if(fabs(inputs->data[ii]) > max) {
+            max = fabs(inputs->data[ii]);
+        }
+    }
+    if(max > 0) {
+        q8->in_scale = max / NLK_Q8_MAX;
+    }
+}
+
+
+#ifdef __AVX2__
+/**
+ * acc += a . b in 32 bit sums of 4 products; |a| (unsigned) is multiplied
+ * by b with the sign of a, values are in [-NLK_Q8_MAX, NLK_Q8_MAX].
+ */
+static inline __m256i
+nlk_q8_madd(__m256i acc, const __m256i va, const __m256i vb)
+{
+#if defined(__AVX512VNNI__) && defined(__AVX512VL__)
+    return _mm256_dpbusd_epi32(acc, _mm256_abs_epi8(va), 
+                               _mm256_sign_epi8(vb, va));
+#elif defined(__AVXVNNI__)
+    return _mm256_dpbusd_avx_epi32(acc, _mm256_abs_epi8(va), 
+                                   _mm256_sign_epi8(vb, va));
+#else
+    /* pairs of products fit int16: 2 * 127 * 127 < 32767 */
+    const __m256i ones = _mm256_set1_epi16(1);
+    __m256i prod = _mm256_maddubs_epi16(_mm256_abs_epi8(va), 
+                                        _mm256_sign_epi8(vb, va));
+    return _mm256_add_epi32(acc, _mm256_madd_epi16(prod, ones));
+#endif
+}
+#endif
+
+
+/**
+ * int8 dot products of 4 rows with x (int32 accumulation), len is a 
+ * multiple of NLK_Q8_PAD
+ */
+static inline void
+nlk_q8_dot4(const int8_t *w0, const int8_t *w1, const int8_t *w2, 
+            const int8_t *w3, const int8_t *x, const size_t len, 
+            int32_t *dots)
+{
+#ifdef __AVX2__
+    __m256i acc0 = _mm256_setzero_si256();
+    __m256i acc1 = _mm256_setzero_si256();
+    __m256i acc2 = _mm256_setzero_si256();
+    __m256i acc3 = _mm256_setzero_si256();
+    __m256i vx;
+
+    for(size_t ii = 0; ii < len; ii += 32) {
+        vx = _mm256_loadu_si256((const __m256i *) &x[ii]);
+        acc0 = nlk_q8_madd(acc0, vx, 
+                           _mm256_loadu_si256((const __m256i *) &w0[ii]));
+        acc1 = nlk_q8_madd(acc1, vx, 
+                           _mm256_loadu_si256((const __m256i *) &w1[ii]));
+        acc2 = nlk_q8_madd(acc2, vx, 
+                           _mm256_loadu_si256((const __m256i *) &w2[ii]));
+        acc3 = nlk_q8_madd(acc3, vx, 
+                           _mm256_loadu_si256((const __m256i *) &w3[ii]));
+    }
+
+    /* horizontal sums, all 4 at once */
+    __m256i sum = _mm256_hadd_epi32(_mm256_hadd_epi32(acc0, acc1),
+                                    _mm256_hadd_epi32(acc2, acc3));
+    _mm_storeu_si128((__m128i *) dots, 
+                     _mm_add_epi32(_mm256_castsi256_si128(sum), 
+                                   _mm256_extracti128_si256(sum, 1)));
+#else
+    dots[0] = dots[1] = dots[2] = dots[3] = 0;
+    for(size_t ii = 0; ii < len; ii++) {
+        dots[0] += (int32_t) w0[ii] * x[ii];
+        dots[1] += (int32_t) w1[ii] * x[ii];
+        dots[2] += (int32_t) w2[ii] * x[ii];
+        dots[3] += (int32_t) w3[ii] * x[ii];
+    }
+#endif
+}
+
+
+/**
+ * Quantize x to int8: round(x * inv) saturated to [-NLK_Q8_MAX, NLK_Q8_MAX]
+ */
+static void
+nlk_q8_quantize(const nlk_real *x, const size_t len, const float inv, 
+                int8_t *q)
+{
+    size_t ii = 0;
+    float v;
+
+#ifdef __AVX2__
+    const __m256 vinv = _mm256_set1_ps(inv);
+    const __m256 vmax = _mm256_set1_ps(NLK_Q8_MAX);
+    const __m256 vmin = _mm256_set1_ps(-NLK_Q8_MAX);
+    /* packs interleave the 128 bit lanes: put the 4 byte groups back */
+    const __m256i order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+    __m256i v0, v1, v2, v3;
+
+#define NLK_Q8_CVT(off) _mm256_cvtps_epi32(_mm256_min_ps(vmax, \
+            _mm256_max_ps(vmin, _mm256_mul_ps(_mm256_loadu_ps(&x[ii + off]), \
+                                              vinv))))
+    for(; ii + 32 <= len; ii += 32) {
+        v0 = NLK_Q8_CVT(0);
+        v1 = NLK_Q8_CVT(8);
+        v2 = NLK_Q8_CVT(16);
+        v3 = NLK_Q8_CVT(24);
+        v0 = _mm256_packs_epi16(_mm256_packs_epi32(v0, v1), 
+                                _mm256_packs_epi32(v2, v3));
+        _mm256_storeu_si256((__m256i *) &q[ii], 
+                            _mm256_permutevar8x32_epi32(v0, order));
+    }
+#undef NLK_Q8_CVT
+#endif
+
+    for(; ii < len; ii++) {
+        v = x[ii] * inv;
+        if(v > NLK_Q8_MAX) {
+            v = NLK_Q8_MAX;
+        } else if(v < -NLK_Q8_MAX) {
+            v = -NLK_Q8_MAX;
+        }
+        q[ii] = lrintf(v);
+    }
+}
+
+
+/**
+ * Quantized Linear Layer forward pass: output = weights * input + bias
+ *
+ * @param q8        the quantized layer
+ * @param input     the (float) input
+ * @param work      memory for the quantized input (q8->cols_pad)
+ * @param output    the (float) output
+ */
+void
+nlk_layer_linear_q8_forward(const struct nlk_layer_linear_q8_t *q8, 
+                            const NLK_ARRAY *input, int8_t *work, 
+                            NLK_ARRAY *output)
+{
+    const size_t len = q8->cols_pad;
+    const int8_t *w = q8->weights;
+    int32_t dots[4];
+    size_t rr;
+
+#ifndef NCHECKS
+    if(input->rows * input->cols != q8->cols) {
+        NLK_ERROR_VOID("input and layer dimensions do not match", 
+                       NLK_EBADLEN);
+        /* unreachable */
+    }
+#endif
+
+    /* quantize input */
+    nlk_q8_quantize(input->data, q8->cols, 1.0 / q8->in_scale, work);
+    memset(&work[q8->cols], 0, len - q8->cols);
+
+    /* int32 dot products, 4 rows at a time (the last rows repeated) */
+    for(rr = 0; rr < q8->rows; rr += 4) {
+        nlk_q8_dot4(&w[rr * len], 
+                    &w[(rr + 1 < q8->rows ? rr + 1 : rr) * len],
+                    &w[(rr + 2 < q8->rows ? rr + 2 : rr) * len],
+                    &w[(rr + 3 < q8->rows ? rr + 3 : rr) * len],
+                    work, len, dots);
+        for(size_t ii = 0; ii < 4 && rr + ii < q8->rows; ii++) {
+            output->data[rr + ii] = q8->scale[rr + ii] * q8->in_scale * 
+                                    dots[ii];
+            if(q8->bias != NULL) {
+                output->data[rr + ii] += q8->bias->data[rr + ii];
+            }
+        }
+    }
+}
+
+
+/**
+ * Free a quantized linear layer
+ */
+void
+nlk_layer_linear_q8_free(struct nlk_layer_linear_q8_t *q8)
+{
+    free(q8->weights);
+    free(q8->scale);
+    if(q8->bias != NULL) {
+        nlk_array_free(q8->bias);
+    }
+    free(q8);
+}
@@ -33,6 +33,7 @@
 
 
 #include <stdbool.h>
+#include <stdint.h>
 
 #include "nlk_array.h"
 #include "nlk_vocabulary.h"
@@ -61,6 +62,27 @@ struct nlk_layer_linear_t {
 typedef struct nlk_layer_linear_t NLK_LAYER_LINEAR;
 
 
+#define NLK_Q8_MAX  127     /**< int8 range used: [-127, 127] */
+#define NLK_Q8_PAD  32      /**< input size is padded to a multiple of this */
+
+
+/** @struct nlk_layer_linear_q8_t
+ * Inference only int8 linear layer: weights are quantized per row 
+ * (w = scale[row] * q) and the input with a calibrated scale 
+ * (x = in_scale * q). Products are accumulated in int32.
+ */
+struct nlk_layer_linear_q8_t {
+    int8_t      *weights;           /**< quantized weights [rows][cols_pad] */
+    float       *scale;             /**< per row weight scale */
+    NLK_ARRAY   *bias;              /**< the layer bias (copy) or NULL */
+    size_t       rows;              /**< output size */
+    size_t       cols;              /**< input size */
+    size_t       cols_pad;          /**< input size padded to NLK_Q8_PAD */
+    float        in_scale;          /**< input scale (calibrated) */
+};
+typedef struct nlk_layer_linear_q8_t NLK_LAYER_LINEAR_Q8;
+
+
 /* 
  *  Initialization for linear layers
  */
@@ -101,5 +123,17 @@ void nlk_layer_linear_save(struct nlk_layer_linear_t *, FILE *);
 struct nlk_layer_linear_t *nlk_layer_linear_load(FILE *);
 
 
+/*
+ * Quantized (int8) Linear Layer - inference only
+ */
+struct nlk_layer_linear_q8_t *nlk_layer_linear_q8_create(
+                                            const struct nlk_layer_linear_t *);
+void nlk_layer_linear_q8_calibrate(struct nlk_layer_linear_q8_t *, 
+                                   const NLK_ARRAY *, const size_t);
+void nlk_layer_linear_q8_forward(const struct nlk_layer_linear_q8_t *, 
+                                 const NLK_ARRAY *, int8_t *, NLK_ARRAY *);
+void nlk_layer_linear_q8_free(struct nlk_layer_linear_q8_t *);
+
+
 __END_DECLS
 #endif /* __NLK_LAYER_LINEAR_H__ */
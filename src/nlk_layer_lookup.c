@@ -77,6 +77,8 @@ nlk_layer_lookup_create(const size_t table_size, const size_t layer_size)
     layer->update = true;
     layer->learn_rate = 0;
     layer->learn_rate_decay = 0;
+    layer->adagrad = NULL;
+    layer->adagrad_rate = 0;
 
     return layer;
 }
@@ -93,6 +95,11 @@ nlk_layer_lookup_create_from_array(NLK_ARRAY *weights)
 {
     struct nlk_layer_lookup_t *layer;
 
+    if(weights == NULL) {
+        NLK_ERROR_NULL("no weights for lookup layer", NLK_EINVAL);
+        /* unreachable */
+    }
+
     /*
      * Allocate memory for struct, create the members
      */
@@ -111,6 +118,8 @@ nlk_layer_lookup_create_from_array(NLK_ARRAY *weights)
     layer->update = true;
     layer->learn_rate = 0;
     layer->learn_rate_decay = 0;
+    layer->adagrad = NULL;
+    layer->adagrad_rate = 0;
 
     return layer;
 }
@@ -128,6 +137,7 @@ int
 nlk_layer_lookup_resize(struct nlk_layer_lookup_t *layer, 
                         const size_t table_size)
 {
+    const size_t rows = layer->weights->rows;
     NLK_ARRAY *weights = nlk_array_resize(layer->weights, table_size,
                                           layer->weights->cols);
     if(weights == NULL) {
@@ -136,9 +146,96 @@ nlk_layer_lookup_resize(struct nlk_layer_lookup_t *layer,
     
     layer->weights = weights;
 
+    /* AdaGrad state of the new rows */
+    if(layer->adagrad != NULL) {
+        nlk_real *adagrad = realloc(layer->adagrad, 
+                                    table_size * sizeof(nlk_real));
+        if(adagrad == NULL) {
+            return NLK_FAILURE;
+        }
+        for(size_t ii = rows; ii < table_size; ii++) {
+            adagrad[ii] = 0;
+        }
+        layer->adagrad = adagrad;
+    }
+
     return NLK_SUCCESS;
 }
 
+
+/** the learning rate the gradients of this thread are scaled by */
+static __thread nlk_real __grad_scale = 1;
+
+
+/**
+ * Use row-wise AdaGrad for the first layer updates (backprop_lookup*).
+ * The raw gradient of a row (the update divided by the thread's gradient 
+ * scale, see nlk_layer_lookup_grad_scale) is divided by the root of the sum 
+ * of the mean squared raw gradients that row received and scaled by the 
+ * AdaGrad rate: rare rows take larger steps. 
+ * Only the state of the updated rows is touched.
+ * The state is not saved with the layer.
+ *
+ * @param layer         the lookup layer
+ * @param learn_rate    the AdaGrad base learning rate
+ *
+ * @return NLK_SUCCESS or NLK_ENOMEM
+ */
+int
+nlk_layer_lookup_adagrad(struct nlk_layer_lookup_t *layer, 
+                         const nlk_real learn_rate)
+{
+    if(layer->adagrad == NULL) {
+        layer->adagrad = calloc(layer->weights->rows, sizeof(nlk_real));
+        if(layer->adagrad == NULL) {
+            NLK_ERROR("failed to allocate memory for AdaGrad", NLK_ENOMEM);
+            /* unreachable */
+        }
+    }
+    layer->adagrad_rate = learn_rate;
+
+    return NLK_SUCCESS;
+}
+
+
+/**
+ * Set the (decayed) learning rate the calling thread's updates are scaled 
+ * by. AdaGrad divides it out to accumulate the raw gradients.
+ *
+ * @param scale     the learning rate the updates are scaled by (> 0)
+ */
+void
+nlk_layer_lookup_grad_scale(const nlk_real scale)
+{
+    __grad_scale = scale;
+}
+
+
+/**
+ * Add an update (gradient) to a row of the first layer: SGD or AdaGrad
+ */
+static inline void
+nlk_layer_lookup_update_row(struct nlk_layer_lookup_t *layer, 
+                            const size_t row, const nlk_real *grad)
+{
+    const size_t cols = layer->weights->cols;
+    nlk_real *w = &layer->weights->data[row * cols];
+    nlk_real acc;
+
+    if(layer->adagrad == NULL) {
+        cblas_saxpy(cols, 1, grad, 1, w, 1); 
+        return;
+    }
+
+    /* raw gradient = grad / __grad_scale */
+    acc = layer->adagrad[row] + cblas_sdot(cols, grad, 1, grad, 1) / 
+                                (cols * __grad_scale * __grad_scale);
+    layer->adagrad[row] = acc;
+    cblas_saxpy(cols, layer->adagrad_rate / 
+                      (__grad_scale * (sqrt(acc) + NLK_ADAGRAD_EPS)), 
+                grad, 1, w, 1);
+}
+
 /** 
  * Initializes the lookup layer weights (word2vec) 
  * Initializations is done by drawing from a uniform distribution in the range
@@ -514,6 +611,12 @@ nlk_layer_lookup_backprop_lookup(struct nlk_layer_lookup_t *layer,
     }
 
     /* update weights */
+    if(layer->adagrad != NULL) {
+        for(ii = 0; ii < n_indices; ii++) {
+            nlk_layer_lookup_update_row(layer, indices[ii], grad_out->data);
+        }
+        return;
+    }
     for(ii = 0; ii < n_indices; ii++) {
         nlk_array_add_carray(grad_out,
                     &layer->weights->data[indices[ii] * layer->weights->cols]);
@@ -565,9 +668,8 @@ nlk_layer_lookup_backprop_lookup_concat(struct nlk_layer_lookup_t *layer,
             /* unreachable */
     }
 #endif
-        /* @TODO move this to nlk_array */
-        cblas_saxpy(cols, 1, &grad_out->data[ii * cols + start_at * cols], 1, 
-                    &layer->weights->data[indices[ii] * cols], 1); 
+        nlk_layer_lookup_update_row(layer, indices[ii], 
+                            &grad_out->data[ii * cols + start_at * cols]);
 
         NLK_ARRAY_CHECK_NAN_ROW(layer->weights, indices[ii], "NaN in weights");
     }
@@ -589,6 +691,10 @@ nlk_layer_lookup_backprop_lookup_one(struct nlk_layer_lookup_t *layer,
     }
 
     /* update weights */
+    if(layer->adagrad != NULL) {
+        nlk_layer_lookup_update_row(layer, index, grad_out->data);
+        return;
+    }
     nlk_array_add_carray(grad_out,
                 &layer->weights->data[index * layer->weights->cols]);
 }
@@ -613,9 +719,8 @@ nlk_layer_lookup_backprop_lookup_concat_one(struct nlk_layer_lookup_t *layer,
 
 
     /* update weights */
-    /* @TODO move this to nlk_array */
-    cblas_saxpy(cols, 1, &grad_out->data[grad_index * cols], 1, 
-                &layer->weights->data[index * cols], 1); 
+    nlk_layer_lookup_update_row(layer, index, 
+                                &grad_out->data[grad_index * cols]);
     NLK_ARRAY_CHECK_NAN_ROW(layer->weights, index, "NaN in weights");
 
 }
@@ -630,6 +735,7 @@ void
 nlk_layer_lookup_free(struct nlk_layer_lookup_t *layer)
 {
     nlk_array_free(layer->weights);
+    free(layer->adagrad);
     free(layer);
     layer = NULL;
 }
@@ -38,6 +38,10 @@
 #include "nlk_vocabulary.h"
 
 
+/* AdaGrad: added to the root of the accumulator to avoid division by zero */
+#define NLK_ADAGRAD_EPS 1e-6
+
+
 #undef __BEGIN_DECLS
 #undef __END_DECLS
 #ifdef __cplusplus
@@ -59,6 +63,9 @@ struct nlk_layer_lookup_t {
     bool         update;            /**< should weights change? */
     nlk_real     learn_rate;        /**< layer specific learning rate */
     nlk_real     learn_rate_decay;  /**< layer specific learning rate decay */
+    nlk_real    *adagrad;           /**< AdaGrad: per row sum of the mean
+                                         squared gradients (NULL: SGD) */
+    nlk_real     adagrad_rate;      /**< AdaGrad base learning rate */
 };
 typedef struct nlk_layer_lookup_t NLK_LAYER_LOOKUP;
 
@@ -72,6 +79,10 @@ struct nlk_layer_lookup_t *nlk_layer_lookup_create_from_array(NLK_ARRAY *);
 
 int nlk_layer_lookup_resize(struct nlk_layer_lookup_t *, const size_t);
 
+/* AdaGrad updates for the first layer backprop */
+int nlk_layer_lookup_adagrad(struct nlk_layer_lookup_t *, const nlk_real);
+void nlk_layer_lookup_grad_scale(const nlk_real);
+
 /* Initialize the lookup layer */
 void nlk_layer_lookup_init(struct nlk_layer_lookup_t *);
 void nlk_layer_lookup_init_array(NLK_ARRAY *);
@@ -55,8 +55,8 @@ void
 nlk_table_sigmoid_create()
 {
 
-    /* allocate array and set fields */
-    __sigmoid_table = malloc(NLK_SIGMOID_TABLE_SIZE * sizeof(nlk_real));
+    /* allocate array and set fields (+1: right end point for interpolation) */
+    __sigmoid_table = malloc((NLK_SIGMOID_TABLE_SIZE + 1) * sizeof(nlk_real));
     if(__sigmoid_table == NULL) {
         NLK_ERROR_VOID("failed to allocate memory for sigmoid table",
                        NLK_ENOMEM);
@@ -68,7 +68,7 @@ nlk_table_sigmoid_create()
     * [-max_exp, max_exp] split evenly into the number of elements in the array.
     */
     /* this splits the range [sigma(-max), sigma(max)] into *size* pieces */
-    for(size_t ii = 0; ii < NLK_SIGMOID_TABLE_SIZE; ii++) {
+    for(size_t ii = 0; ii <= NLK_SIGMOID_TABLE_SIZE; ii++) {
         __sigmoid_table[ii] = exp(((nlk_real) ii / 
                                   (nlk_real) NLK_SIGMOID_TABLE_SIZE * 2 - 1) * 
                                   NLK_MAX_EXP);
@@ -113,3 +113,61 @@ nlk_sigmoid(const nlk_real x)
 
     return __sigmoid_table[idx];
 }
+
+/**
+ * Calculates the sigmoid for an array of scores. Same semantics as 
+ * nlk_sigmoid: 0 for x <= -NLK_MAX_EXP and 1 for x >= NLK_MAX_EXP.
+ * The loop is branch free so that it can be vectorized.
+ * 
+ * The implementation is chosen at compile time with NLK_SIGMOID_IMPL:
+ * - NLK_SIGMOID_TABLE_INTERP: linear interpolation in the sigmoid table.
+ *   Max absolute error in ]-NLK_MAX_EXP, NLK_MAX_EXP[ is 2.7e-7 (float 
+ *   rounding; the interpolation error itself is 1.7e-8), vs 3.0e-4 for
+ *   the table lookup in nlk_sigmoid. Requires nlk_table_sigmoid_create.
+ * - NLK_SIGMOID_RATIONAL: 0.5 + 0.5 * tanh(x/2) with the [7/6] Pade 
+ *   approximation of tanh. No table (no gathers). Max absolute error in 
+ *   ]-NLK_MAX_EXP, NLK_MAX_EXP[ is 6e-7.
+ *
+ * @param x     the scores
+ * @param n     the number of scores
+ * @param out   the sigmoid of the scores (output, may be x)
+ */
+void
+nlk_sigmoid_vector(const nlk_real *x, const size_t n, nlk_real *out)
+{
+#if NLK_SIGMOID_IMPL == NLK_SIGMOID_RATIONAL
+    for(size_t ii = 0; ii < n; ii++) {
+        const nlk_real t = x[ii] * 0.5f;
+        const nlk_real t2 = t * t;
+        const nlk_real p = t * (135135.0f + t2 * (17325.0f + 
+                                t2 * (378.0f + t2)));
+        const nlk_real q = 135135.0f + t2 * (62370.0f + 
+                           t2 * (3150.0f + t2 * 28.0f));
+        nlk_real s = 0.5f + 0.5f * (p / q);
+        s = x[ii] >= NLK_MAX_EXP ? 1.0f : s;
+        s = x[ii] <= -NLK_MAX_EXP ? 0.0f : s;
+        out[ii] = s;
+    }
+#else
+    const nlk_real scale = (nlk_real) NLK_SIGMOID_TABLE_SIZE / 
+                           (2.0f * NLK_MAX_EXP);
+
+    for(size_t ii = 0; ii < n; ii++) {
+        nlk_real c = x[ii];
+        c = c < -NLK_MAX_EXP ? -NLK_MAX_EXP : c;
+        c = c > NLK_MAX_EXP ? NLK_MAX_EXP : c;
+
+        const nlk_real pos = (c + NLK_MAX_EXP) * scale;
+        int idx = (int) pos;
+        idx = idx > NLK_SIGMOID_TABLE_SIZE - 1 ? 
+              NLK_SIGMOID_TABLE_SIZE - 1 : idx;
+        const nlk_real frac = pos - (nlk_real) idx;
+
+        nlk_real s = __sigmoid_table[idx] + 
+                     frac * (__sigmoid_table[idx + 1] - __sigmoid_table[idx]);
+        s = x[ii] >= NLK_MAX_EXP ? 1.0f : s;
+        s = x[ii] <= -NLK_MAX_EXP ? 0.0f : s;
+        out[ii] = s;
+    }
+#endif
+}
@@ -32,6 +32,7 @@
 #define __NLK_MATH_H__
 
 #include <stdint.h>
+#include <stddef.h>
 #include <math.h>
 
 #include "nlk_err.h"
@@ -39,6 +40,13 @@
 #define NLK_MAX_EXP             6
 #define NLK_SIGMOID_TABLE_SIZE  10000
 
+/* nlk_sigmoid_vector implementations (compile with -DNLK_SIGMOID_IMPL=...) */
+#define NLK_SIGMOID_TABLE_INTERP    1   /**< table + linear interpolation */
+#define NLK_SIGMOID_RATIONAL        2   /**< rational (Pade) approximation */
+#ifndef NLK_SIGMOID_IMPL
+#define NLK_SIGMOID_IMPL NLK_SIGMOID_TABLE_INTERP
+#endif
+
 
 #undef __BEGIN_DECLS
 #undef __END_DECLS
@@ -60,6 +68,7 @@ typedef float nlk_real;
 
 void        nlk_table_sigmoid_create();
 nlk_real    nlk_sigmoid(const nlk_real);
+void        nlk_sigmoid_vector(const nlk_real *, const size_t, nlk_real *);
 
 
 /**
@@ -0,0 +1,541 @@
+/******************************************************************************
+ * NLK - Neural Language Kit
+ *
+ * Copyright (c) 2015 Luis Rei <me@luisrei.com> http://luisrei.com @lmrei
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to 
+ * deal in the Software without restriction, including without limitation the 
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or 
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ *****************************************************************************/
+
+
+
+/** @file nlk_mem.c
+ * Memory planning (estimates, budget) and resident memory reporting
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <sys/resource.h>
+
+#include "nlk.h"
+#include "nlk_err.h"
+#include "nlk_text.h"
+#include "nlk_vocabulary.h"
+#include "nlk_window.h"
+#include "nlk_neuralnet.h"
+
+#include "nlk_mem.h"
+
+
+/** @section Per thread estimates
+ * From the allocations made by the training and inference threads
+ */
+
+/**
+ * char **text_line of n words (nlk_text_chunk_create)
+ */
+static size_t
+nlk_mem_text_line(const size_t n)
+{
+    return n * (sizeof(char *) + NLK_MAX_WORD_SIZE + NLK_MEM_MALLOC);
+}
+
+
+/**
+ * A vocabularized line of n words (nlk_line_create)
+ */
+static size_t
+nlk_mem_line(const size_t n)
+{
+    return sizeof(struct nlk_line_t) + n * sizeof(struct nlk_vocab_t *);
+}
+
+
+/**
+ * The contexts of n words (nlk_context_create_array_size)
+ */
+static size_t
+nlk_mem_contexts(const size_t n, const size_t ctx_size)
+{
+    return n * (sizeof(struct nlk_context_t *) + 
+                sizeof(struct nlk_context_t) + 
+                ctx_size * (sizeof(size_t) + sizeof(bool)) +
+                3 * NLK_MEM_MALLOC);
+}
+
+
+/**
+ * Plan the memory for training a new model (nlk_w2v_create, nlk_w2v)
+ *
+ * @param plan          the plan (overwritten)
+ * @param train_opts    the training options
+ * @param concat        concatenation model
+ * @param vocab_size    the vocabulary size
+ * @param ctx_size      the maximum context size
+ * @param threads       the number of threads
+ */
+void
+nlk_mem_plan_train(struct nlk_mem_plan_t *plan, 
+                   const struct nlk_nn_train_t *train_opts, const bool concat,
+                   const size_t vocab_size, const size_t ctx_size, 
+                   const int threads)
+{
+    const size_t vector_size = train_opts->vector_size;
+    /* pure PV-DBOW keeps a single word row (see nlk_w2v_create) */
+    const size_t word_rows = train_opts->model_type == NLK_PVDBOW_PURE ? 1 :
+                             vocab_size;
+    size_t layer2_size = vector_size;
+    size_t pvs;
+
+    if(concat) {
+        layer2_size = train_opts->window * vector_size + vector_size;
+    }
+    memset(plan, 0, sizeof(*plan));
+
+    /* tables */
+    plan->words = word_rows * vector_size * sizeof(nlk_real);
+    if(train_opts->paragraph) {
+        pvs = train_opts->paragraph_count * vector_size * sizeof(nlk_real);
+        if(train_opts->paragraph_map != NULL) {
+            plan->paragraphs_map = pvs;
+        } else {
+            plan->paragraphs = pvs;
+        }
+    }
+    if(train_opts->hs) {
+        plan->hs = vocab_size * layer2_size * sizeof(nlk_real);
+    }
+    if(train_opts->negative) {
+        plan->neg = vocab_size * layer2_size * sizeof(nlk_real);
+        plan->neg_table_size = nlk_vocab_neg_table_get_size();
+    }
+    plan->subwords = train_opts->subword_buckets * vector_size * 
+                     sizeof(nlk_real);
+
+    /* a snapshot copies the word, output and n-gram tables (--publish) */
+    plan->snapshot = plan->words + plan->hs + plan->neg + plan->subwords;
+
+    /* AdaGrad: an accumulator per row of the lookup tables */
+    if(train_opts->adagrad > 0) {
+        plan->words += word_rows * sizeof(nlk_real);
+        plan->subwords += train_opts->subword_buckets * sizeof(nlk_real);
+        if(train_opts->paragraph) {
+            plan->paragraphs += train_opts->paragraph_count * sizeof(nlk_real);
+        }
+    }
+
+    /* vocabulary: items, words (hash keys), huffman codes */
+    plan->vocab = vocab_size * (sizeof(struct nlk_vocab_t) + 
+                                NLK_MAX_WORD_SIZE / 8 + 2 * NLK_MEM_MALLOC);
+    if(train_opts->hs) {
+        plan->vocab += vocab_size * sizeof(struct nlk_vocab_code_t);
+    }
+
+    /* per thread, sized for a chunk of a line: text, read buffer, 
+     * line and sample, contexts, layers */
+    plan->thread = nlk_mem_text_line(NLK_CHUNK_SIZE) + NLK_CHUNK_BUFFER_SIZE +
+                   2 * nlk_mem_line(NLK_CHUNK_SIZE) + 
+                   nlk_mem_contexts(NLK_CHUNK_SIZE, ctx_size) +
+                   2 * layer2_size * sizeof(nlk_real);
+    plan->threads = threads;
+    plan->batch = 1;
+    plan->can_map = false;
+
+    nlk_mem_plan_total(plan);
+}
+
+
+/**
+ * Plan the memory for inferring the PVs of a file with a loaded model
+ * (nlk_corpus_read, nlk_pv_gen_opts)
+ *
+ * @param plan          the plan (overwritten)
+ * @param nn            the neural network
+ * @param lines         the number of lines (PVs) to infer
+ * @param text_bytes    the size of the text file
+ * @param batch         PVs inferred at once by each thread
+ * @param threads       the number of threads
+ */
+void
+nlk_mem_plan_infer(struct nlk_mem_plan_t *plan, 
+                   const struct nlk_neuralnet_t *nn, const size_t lines,
+                   const size_t text_bytes, const size_t batch, 
+                   const int threads)
+{
+    const size_t vector_size = nn->words->weights->cols;
+    const size_t vocab_size = nn->words->weights->rows;
+    size_t layer2_size = vector_size;
+
+    memset(plan, 0, sizeof(*plan));
+
+    /* tables already loaded */
+    plan->words = nn->words->weights->len * sizeof(nlk_real);
+    if(nn->paragraphs != NULL) {
+        if(nn->paragraphs->weights->owner == NLK_ARRAY_OWNER_MAPPED) {
+            plan->paragraphs_map = nn->paragraphs->weights->len * 
+                                   sizeof(nlk_real);
+        } else {
+            plan->paragraphs = nn->paragraphs->weights->len * 
+                               sizeof(nlk_real);
+        }
+    }
+    if(nn->hs != NULL) {
+        plan->hs = nn->hs->weights->len * sizeof(nlk_real);
+        layer2_size = nn->hs->weights->cols;
+    }
+    if(nn->neg != NULL) {
+        plan->neg = nn->neg->weights->len * sizeof(nlk_real);
+        layer2_size = nn->neg->weights->cols;
+        plan->neg_table_size = nn->neg_table_size;
+    }
+    if(nn->subwords != NULL) {
+        plan->subwords = nn->subwords->ngrams->weights->len * 
+                         sizeof(nlk_real);
+    }
+    plan->vocab = vocab_size * (sizeof(struct nlk_vocab_t) + 
+                                NLK_MAX_WORD_SIZE / 8 + 2 * NLK_MEM_MALLOC);
+
+    /* the inferred PVs and the text (word ids are wider than words) */
+    plan->paragraphs += lines * vector_size * sizeof(nlk_real);
+    plan->corpus = 2 * text_bytes;
+
+    /* per thread: contexts, layers; per slot: sampled line, previous PV */
+    plan->thread = nlk_mem_contexts(NLK_MAX_LINE_SIZE, 
+                                    nn->context_opts.max_size) + 
+                   2 * layer2_size * sizeof(nlk_real);
+    plan->slot = nlk_mem_line(NLK_MAX_LINE_SIZE) + 
+                 vector_size * sizeof(nlk_real);
+    plan->threads = threads;
+    plan->batch = batch > 0 ? batch : 1;
+    plan->can_map = false;
+
+    nlk_mem_plan_total(plan);
+}
+
+
+/**
+ * (Re)compute the total of a plan: file backed tables are not counted as
+ * they live in the (evictable) page cache.
+ *
+ * @return the total
+ */
+size_t
+nlk_mem_plan_total(struct nlk_mem_plan_t *plan)
+{
+    plan->neg_table = plan->neg_table_size * sizeof(size_t);
+    plan->total = plan->words + plan->paragraphs + plan->hs + plan->neg + 
+                  plan->neg_table + plan->subwords + plan->vocab + 
+                  plan->corpus + plan->snapshots * plan->snapshot +
+                  plan->threads * (plan->thread + plan->batch * plan->slot);
+    return plan->total;
+}
+
+
+/**
+ * Fit a plan to a memory budget by switching to lower memory strategies,
+ * in order, until it fits:
+ *  - a smaller NEG table (NLK_MEM_NEG_TABLE_MIN entries)
+ *  - one PV per thread at a time (fewer inference buffers)
+ *  - a file backed (streamed) paragraph table, if can_map
+ *  - fewer threads (fewer per thread buffers)
+ *
+ * @param plan      the plan (modified)
+ * @param budget    the budget in bytes (0 for none)
+ * @param verbose   print the changes
+ *
+ * @return NLK_SUCCESS or NLK_ENOMEM if it does not fit
+ */
+int
+nlk_mem_plan_fit(struct nlk_mem_plan_t *plan, const size_t budget, 
+                 const bool verbose)
+{
+    size_t per_thread;
+    size_t fixed;
+    int threads;
+
+    if(budget == 0 || nlk_mem_plan_total(plan) <= budget) {
+        return NLK_SUCCESS;
+    }
+
+    /* smaller NEG table */
+    if(plan->neg_table_size > NLK_MEM_NEG_TABLE_MIN) {
+        plan->neg_table_size = NLK_MEM_NEG_TABLE_MIN;
+        if(verbose) {
+            printf("mem-budget: NEG table of %zu entries\n", 
+                   plan->neg_table_size);
+        }
+        if(nlk_mem_plan_total(plan) <= budget) {
+            return NLK_SUCCESS;
+        }
+    }
+
+    /* fewer inference buffers */
+    if(plan->batch > 1) {
+        plan->batch = 1;
+        if(verbose) {
+            printf("mem-budget: one PV per thread at a time\n");
+        }
+        if(nlk_mem_plan_total(plan) <= budget) {
+            return NLK_SUCCESS;
+        }
+    }
+
+    /* stream the paragraph table from a file */
+    if(plan->can_map && plan->paragraphs > 0) {
+        plan->paragraphs_map = plan->paragraphs;
+        plan->paragraphs = 0;
+        if(verbose) {
+            printf("mem-budget: file backed paragraph table\n");
+        }
+        if(nlk_mem_plan_total(plan) <= budget) {
+            return NLK_SUCCESS;
+        }
+    }
+
+    /* fewer threads */
+    per_thread = plan->thread + plan->batch * plan->slot;
+    fixed = plan->total - plan->threads * per_thread;
+    if(fixed + per_thread <= budget) {
+        threads = (budget - fixed) / per_thread;
+        if(threads < plan->threads) {
+            plan->threads = threads;
+            if(verbose) {
+                printf("mem-budget: %d threads\n", plan->threads);
+            }
+        }
+    }
+    if(nlk_mem_plan_total(plan) <= budget) {
+        return NLK_SUCCESS;
+    }
+
+    return NLK_ENOMEM;
+}
+
+
+/**
+ * Print a plan
+ *
+ * @param plan      the plan
+ * @param budget    the budget (0 for none)
+ */
+void
+nlk_mem_plan_print(const struct nlk_mem_plan_t *plan, const size_t budget)
+{
+    const double mb = 1.0 / (1024 * 1024);
+
+    printf("Memory plan (estimated):\n");
+    printf("  words:        %10.1f MB\n", plan->words * mb);
+    if(plan->paragraphs > 0) {
+        printf("  paragraphs:   %10.1f MB\n", plan->paragraphs * mb);
+    }
+    if(plan->paragraphs_map > 0) {
+        printf("  paragraphs:   %10.1f MB (file backed, not counted)\n", 
+               plan->paragraphs_map * mb);
+    }
+    if(plan->hs > 0) {
+        printf("  hs:           %10.1f MB\n", plan->hs * mb);
+    }
+    if(plan->neg > 0) {
+        printf("  neg:          %10.1f MB\n", plan->neg * mb);
+        printf("  neg table:    %10.1f MB (%zu entries)\n", 
+               plan->neg_table * mb, plan->neg_table_size);
+    }
+    if(plan->subwords > 0) {
+        printf("  subwords:     %10.1f MB\n", plan->subwords * mb);
+    }
+    printf("  vocabulary:   %10.1f MB\n", plan->vocab * mb);
+    if(plan->corpus > 0) {
+        printf("  text:         %10.1f MB\n", plan->corpus * mb);
+    }
+    if(plan->snapshots > 0) {
+        printf("  snapshots:    %10.1f MB (%zu x %.1f MB)\n", 
+               plan->snapshots * plan->snapshot * mb, plan->snapshots, 
+               plan->snapshot * mb);
+    }
+    printf("  threads:      %10.1f MB (%d x %.1f MB)\n", 
+           plan->threads * (plan->thread + plan->batch * plan->slot) * mb, 
+           plan->threads, (plan->thread + plan->batch * plan->slot) * mb);
+    printf("  total:        %10.1f MB", plan->total * mb);
+    if(budget > 0) {
+        printf(" (budget %.1f MB)", budget * mb);
+    }
+    printf("\n");
+}
+
+
+/**
+ * Parse a size in bytes with an optional K, M, G or T suffix (powers of 
+ * 1024), e.g. "512M", "8G"
+ *
+ * @return the size in bytes or 0 if invalid
+ */
+size_t
+nlk_mem_parse_size(const char *str)
+{
+    char *end = NULL;
+    double size = strtod(str, &end);
+
+    if(end == str || size < 0) {
+        return 0;
+    }
+    switch(toupper((unsigned char) *end)) {
+        case 'T':
+            size *= 1024;
+            /* fall through */
+        case 'G':
+            size *= 1024;
+            /* fall through */
+        case 'M':
+            size *= 1024;
+            /* fall through */
+        case 'K':
+            size *= 1024;
+            break;
+        default:
+            break;
+    }
+
+    return (size_t) size;
+}
+
+
+/** @section Resident memory
+ * Peak resident memory of each phase from VmHWM which is reset after each
+ * phase through /proc/self/clear_refs (Linux). Where that is not available
+ * each peak is the process peak up to the end of the phase.
+ */
+struct nlk_mem_phase_t {
+    const char *name;   /**< phase name */
+    size_t      peak;   /**< peak resident memory during the phase */
+    size_t      rss;    /**< resident memory at the end of the phase */
+};
+
+static struct nlk_mem_phase_t __phases[NLK_MEM_PHASES];
+static size_t __n_phases = 0;
+static size_t __peak = 0;   /**< peak of the phases ended (before resets) */
+
+
+/**
+ * Read a "Key: value kB" line from /proc/self/status
+ *
+ * @return the value in bytes or 0 if not available
+ */
+static size_t
+nlk_mem_status(const char *key)
+{
+    const size_t key_len = strlen(key);
+    char line[256];
+    size_t kb = 0;
+    FILE *fp = fopen("/proc/self/status", "r");
+
+    if(fp == NULL) {
+        return 0;
+    }
+    while(fgets(line, sizeof(line), fp) != NULL) {
+        if(strncmp(line, key, key_len) == 0 && line[key_len] == ':') {
+            kb = strtoull(line + key_len + 1, NULL, 10);
+            break;
+        }
+    }
+    fclose(fp);
+
+    return kb * 1024;
+}
+
+
+/**
+ * Current resident memory (bytes)
+ */
+size_t
+nlk_mem_rss()
+{
+    return nlk_mem_status("VmRSS");
+}
+
+
+/**
+ * Peak resident memory of the process (bytes)
+ * The kernel's peak is reset with each phase so this is the largest of 
+ * the peaks recorded so far and the current one.
+ */
+size_t
+nlk_mem_peak_rss()
+{
+    struct rusage usage;
+    size_t peak = __peak;
+
+    if(getrusage(RUSAGE_SELF, &usage) == 0 && 
+       (size_t) usage.ru_maxrss * 1024 > peak) {
+        peak = (size_t) usage.ru_maxrss * 1024;
+    }
+    return peak;
+}
+
+
+/**
+ * End a phase: record its peak and final resident memory and start the 
+ * next one.
+ *
+ * @param name  the phase name (not copied)
+ */
+void
+nlk_mem_phase(const char *name)
+{
+    FILE *fp;
+    size_t peak = nlk_mem_status("VmHWM");
+
+    if(peak == 0) {
+        peak = nlk_mem_peak_rss();
+    }
+    if(peak > __peak) {
+        __peak = peak;
+    }
+    if(__n_phases < NLK_MEM_PHASES) {
+        __phases[__n_phases].name = name;
+        __phases[__n_phases].peak = peak;
+        __phases[__n_phases].rss = nlk_mem_rss();
+        __n_phases++;
+    }
+
+    /* reset the peak (VmHWM) */
+    fp = fopen("/proc/self/clear_refs", "w");
+    if(fp != NULL) {
+        fputs("5", fp);
+        fclose(fp);
+    }
+}
+
+
+/**
+ * Print the peak resident memory of each phase
+ */
+void
+nlk_mem_phase_print()
+{
+    const double mb = 1.0 / (1024 * 1024);
+
+    printf("Peak RSS by phase:\n");
+    for(size_t ii = 0; ii < __n_phases; ii++) {
+        printf("  %-16s peak %10.1f MB, end %10.1f MB\n", __phases[ii].name,
+               __phases[ii].peak * mb, __phases[ii].rss * mb);
+    }
+    printf("  %-16s peak %10.1f MB\n", "process", nlk_mem_peak_rss() * mb);
+}
@@ -0,0 +1,109 @@
+/******************************************************************************
+ * NLK - Neural Language Kit
+ *
+ * Copyright (c) 2015 Luis Rei <me@luisrei.com> http://luisrei.com @lmrei
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to 
+ * deal in the Software without restriction, including without limitation the 
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or 
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ *****************************************************************************/
+
+
+
+/** @file nlk_mem.h
+ * Memory planning (estimates, budget) and resident memory reporting
+ */
+
+
+#ifndef __NLK_MEM_H__
+#define __NLK_MEM_H__
+
+
+#include <stddef.h>
+#include <stdbool.h>
+
+#include "nlk_neuralnet.h"
+
+
+#undef __BEGIN_DECLS
+#undef __END_DECLS
+#ifdef __cplusplus
+# define __BEGIN_DECLS extern "C" {
+# define __END_DECLS }
+#else
+# define __BEGIN_DECLS /* empty */
+# define __END_DECLS /* empty */
+#endif
+__BEGIN_DECLS
+
+
+#define NLK_MEM_PHASES          32          /**< max phases reported */
+#define NLK_MEM_MALLOC          16          /**< malloc overhead estimate */
+#define NLK_MEM_NEG_TABLE_MIN   (size_t)1e7 /**< NEG table under a budget */
+#define NLK_MEM_SNAPSHOTS       2           /**< snapshots published without
+                                                 readers (+1 per reader) */
+
+
+/** @struct nlk_mem_plan_t
+ * Estimated resident memory (bytes) of each subsystem for a set of options
+ */
+struct nlk_mem_plan_t {
+    size_t  words;          /**< word table */
+    size_t  paragraphs;     /**< paragraph table (in memory) */
+    size_t  paragraphs_map; /**< paragraph table (file backed) */
+    size_t  hs;             /**< hierarchical softmax table */
+    size_t  neg;            /**< negative sampling table */
+    size_t  neg_table;      /**< negative sampling distribution */
+    size_t  subwords;       /**< char n-gram table */
+    size_t  vocab;          /**< vocabulary */
+    size_t  corpus;         /**< text held in memory */
+    size_t  thread;         /**< working memory of each thread */
+    size_t  slot;           /**< working memory of each batch slot */
+    size_t  snapshot;       /**< a published snapshot (table copies) */
+    size_t  snapshots;      /**< snapshots alive at once (0: none) */
+    int     threads;        /**< number of threads */
+    size_t  batch;          /**< PVs inferred at once by each thread */
+    size_t  neg_table_size; /**< entries in the negative sampling table */
+    bool    can_map;        /**< the paragraph table can be file backed */
+    size_t  total;          /**< estimated total */
+};
+typedef struct nlk_mem_plan_t NLK_MEM_PLAN;
+
+
+/* plan */
+void nlk_mem_plan_train(struct nlk_mem_plan_t *, 
+                        const struct nlk_nn_train_t *, const bool, 
+                        const size_t, const size_t, const int);
+void nlk_mem_plan_infer(struct nlk_mem_plan_t *, 
+                        const struct nlk_neuralnet_t *, const size_t, 
+                        const size_t, const size_t, const int);
+size_t nlk_mem_plan_total(struct nlk_mem_plan_t *);
+int nlk_mem_plan_fit(struct nlk_mem_plan_t *, const size_t, const bool);
+void nlk_mem_plan_print(const struct nlk_mem_plan_t *, const size_t);
+
+/* sizes */
+size_t nlk_mem_parse_size(const char *);
+
+/* resident memory */
+size_t nlk_mem_rss();
+size_t nlk_mem_peak_rss();
+void nlk_mem_phase(const char *);
+void nlk_mem_phase_print();
+
+
+__END_DECLS
+#endif /* __NLK_MEM_H__ */
@@ -48,6 +48,8 @@ nlk_neuralnet_is_paragraph_model(const NLK_LM model_type)
     switch(model_type) {
         case NLK_PVDBOW:
             return true;
+        case NLK_PVDBOW_PURE:
+            return true;
         case NLK_PVDM:
             return true;
         case NLK_PVDM_CONCAT:
@@ -111,6 +113,9 @@ nlk_neuralnet_create(size_t n_layers)
     nn->words = NULL;
     nn->paragraphs = NULL;
     nn->vocab = NULL;
+    nn->subwords = NULL;
+    nn->neg_table = NULL;
+    nn->neg_table_size = 0;
 
     if(n_layers > 0) {
         nn->layers = (union nlk_layer_t *) malloc(sizeof(union nlk_layer_t *) *
@@ -238,6 +243,9 @@ nlk_neuralnet_free(struct nlk_neuralnet_t *nn)
     if(nn->paragraphs != NULL) {
         nlk_layer_lookup_free(nn->paragraphs);
     }
+    if(nn->subwords != NULL) {
+        nlk_subword_free(nn->subwords);
+    }
 
     /* free each layer */
     for(ii = 0; ii < nn->n_layers; ii++) {
@@ -350,7 +358,7 @@ nlk_neuralnet_save(struct nlk_neuralnet_t *nn, FILE *fp)
     }
 
     /* write the negative sampling layer */
-    if(nn->train_opts.hs) {
+    if(nn->train_opts.negative) {
         nlk_layer_lookup_save(nn->neg, fp);
     }
 
@@ -368,6 +376,19 @@ nlk_neuralnet_save(struct nlk_neuralnet_t *nn, FILE *fp)
                 /* unreachable */
         }
     }
+
+    /* write subwords: options are written here (not in the header) so that
+     * files without them can still be read */
+    fprintf(fp, "%zu %u %u\n", 
+            nn->subwords != NULL ? nn->train_opts.subword_buckets : 0,
+            nn->train_opts.subword_min, nn->train_opts.subword_max);
+    if(nn->subwords != NULL) {
+        nlk_subword_save(nn->subwords, fp);
+    }
+
+    /* write text normalization (same reason) */
+    fprintf(fp, "%d\n", (int) nn->train_opts.normalize);
+
     return 0;
 }
 
@@ -481,6 +502,8 @@ nlk_neuralnet_load(FILE *fp, bool verbose)
         goto nlk_neuralnet_load_err_head;
     }
     opts.line_ids = tmp;
+    opts.paragraph_map = NULL;
+    opts.adagrad = 0;
 
     /**
      * @section create neural network and load weights
@@ -547,14 +570,15 @@ nlk_neuralnet_load(FILE *fp, bool verbose)
     /* read negative sampling layer */
     if(nn->train_opts.negative) {
        nn->neg = nlk_layer_lookup_load(fp);
+       nn->neg_table_size = nlk_vocab_neg_table_get_size();
        nn->neg_table = nlk_vocab_neg_table_create(&nn->vocab, 
-                                                  NLK_NEG_TABLE_SIZE, 
+                                                  nn->neg_table_size, 
                                                   NLK_NEG_TABLE_POW);
         if(verbose) {
             printf("Loaded NEG Layer\n");
         }
     } else {
-        nn->hs = NULL;
+        nn->neg = NULL;
     }
 
 
@@ -599,6 +623,35 @@ nlk_neuralnet_load(FILE *fp, bool verbose)
     /* set position */
     nn->pos =  nn->n_layers;
 
+    /* read subwords (optional) */
+    ret = fscanf(fp, "%zu %u %u\n", &nn->train_opts.subword_buckets,
+                 &nn->train_opts.subword_min, &nn->train_opts.subword_max);
+    if(ret != 3) {
+        nn->train_opts.subword_buckets = 0;
+        nn->train_opts.subword_min = 0;
+        nn->train_opts.subword_max = 0;
+    }
+    if(nn->train_opts.subword_buckets > 0) {
+        nn->subwords = nlk_subword_load(fp, &nn->vocab, 
+                                        nn->train_opts.subword_min,
+                                        nn->train_opts.subword_max);
+        if(nn->subwords == NULL) {
+            goto nlk_neuralnet_load_err;
+        }
+        if(verbose) {
+            printf("Loaded Subword Table: %zu x %zu\n", 
+                   nn->subwords->ngrams->weights->rows,
+                   nn->subwords->ngrams->weights->cols);
+        }
+    }
+
+    /* read text normalization (optional) */
+    int normalize = NLK_NORMALIZE_NONE;
+    if(fscanf(fp, "%d\n", &normalize) != 1) {
+        normalize = NLK_NORMALIZE_NONE;
+    }
+    nn->train_opts.normalize = (NLK_NORMALIZE) normalize;
+
 
     /* set context options */
     nlk_lm_context_opts(nn->train_opts.model_type, nn->train_opts.window, 
@@ -641,6 +694,8 @@ nlk_lm_model(const char *model_name, const bool concat)
         }
     } else if(strcasecmp(model_name, "pvdbow") == 0) {
         lm_type = NLK_PVDBOW;
+    } else if(strcasecmp(model_name, "pvdbow-pure") == 0) {
+        lm_type = NLK_PVDBOW_PURE;
     } else if(strcasecmp(model_name, "senna") == 0) {
         lm_type = NLK_SENNA;
     } else {
@@ -675,6 +730,8 @@ nlk_lm_learn_rate(NLK_LM lm_type)
             return 0.025;
         case NLK_PVDBOW:
             /* fall through */
+        case NLK_PVDBOW_PURE:
+            /* fall through */
         case NLK_SKIPGRAM:
             return 0.05;
         case NLK_SENNA:
@@ -721,6 +778,7 @@ nlk_lm_context_opts(NLK_LM model, unsigned int window,
             opts->paragraph = true;
             break;
         case NLK_PVDBOW:
+        case NLK_PVDBOW_PURE:
             opts->paragraph = true;
             opts->prepad_paragraph = true;
             break;
@@ -33,6 +33,8 @@
 
 #include "nlk_layer_linear.h"
 #include "nlk_window.h"
+#include "nlk_subword.h"
+#include "nlk_string.h"
 
 
 #undef __BEGIN_DECLS
@@ -60,6 +62,7 @@ enum nlk_lm_t {
     NLK_PVDM_CONCAT = 31,  /**< PVDM concat() instead of avg() */
     NLK_PVDM_SUM    = 32,  /**< PVDM sum() instead of avg() NOT IMPLEMENTED */
     NLK_PVDBOW      = 40,  /**< PVDBOW */
+    NLK_PVDBOW_PURE = 41,  /**< PVDBOW without (interleaved) word training */
     NLK_SENNA       = 500, /**< SENNA */
 };
 typedef enum nlk_lm_t NLK_LM;
@@ -80,6 +83,13 @@ struct nlk_nn_train_t {
     uint64_t         word_count;        /**< total word occurances in corpus */
     uint64_t         paragraph_count;   /**< total paragraphs in corpus */
     bool             line_ids;          /**< file has line (par) ids */
+    size_t           subword_buckets;   /**< char n-gram buckets (0 = off) */
+    unsigned int     subword_min;       /**< min char n-gram size */
+    unsigned int     subword_max;       /**< max char n-gram size */
+    NLK_NORMALIZE    normalize;         /**< text normalization (case) */
+    const char      *paragraph_map;     /**< file backing the PVs (or NULL) */
+    nlk_real         adagrad;           /**< AdaGrad learning rate for the 
+                                             lookup layers (0: SGD) */
 };
 typedef struct nlk_w2v_train_t NLK_W2V_TRAIN;
 
@@ -115,6 +125,8 @@ struct nlk_neuralnet_t {
     struct nlk_layer_lookup_t   *hs;            /**< hierarchical softmax */
     struct nlk_layer_lookup_t   *neg;           /**< negative sampling layer */
     size_t                      *neg_table;     /**< negative sampling table */
+    size_t                       neg_table_size;/**< entries in neg_table */
+    struct nlk_subword_t        *subwords;      /**< char n-gram vectors */
     /**< other layers go here */
     size_t                       n_layers;      /**< total number of layers */
     size_t                       pos;           /**< add positition */
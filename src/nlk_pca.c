@@ -0,0 +1,563 @@
+/******************************************************************************
+ * NLK - Neural Language Kit
+ *
+ * Copyright (c) 2015 Luis Rei <me@luisrei.com> http://luisrei.com @lmrei
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to 
+ * deal in the Software without restriction, including without limitation the 
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or 
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ *****************************************************************************/
+
+
+
+/** @file nlk_pca.c
+ * Dimensionality reduction: PCA (randomized SVD) and random projection
+ */
+
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <errno.h>
+
+#include "nlk.h"
+#include "nlk_err.h"
+#include "nlk_array.h"
+#include "nlk_random.h"
+
+#include "nlk_pca.h"
+
+
+/**
+ * Create an empty projection
+ */
+static struct nlk_pca_t *
+nlk_pca_create(const size_t in, const size_t out)
+{
+    struct nlk_pca_t *pca;
+
+    pca = (struct nlk_pca_t *) malloc(sizeof(struct nlk_pca_t));
+    if(pca == NULL) {
+        NLK_ERROR_NULL("unable to allocate memory for projection", 
+                       NLK_ENOMEM);
+        /* unreachable */
+    }
+    pca->mean = nlk_array_create(1, in);
+    pca->components = nlk_array_create(in, out);
+    pca->variance = nlk_array_create(1, out);
+    nlk_array_zero(pca->mean);
+    nlk_array_zero(pca->variance);
+
+    return pca;
+}
+
+
+/**
+ * Z = Xc' * Xc * Q where Xc is the table minus its mean, streamed over 
+ * blocks of NLK_PCA_BLOCK rows without copying (or centering) the table:
+ *      Xc * Q = X * Q - 1 * (mean * Q)
+ *      Xc' * T = X' * T - mean' * (1' * T)
+ *
+ * @param table the table X [n][d]
+ * @param mean  the mean of the rows of X [d]
+ * @param q     Q [d][l]
+ * @param l     columns of Q
+ * @param t     memory for T = Xc * Q for a block [NLK_PCA_BLOCK][l]
+ * @param z     the result [d][l]
+ */
+static void
+nlk_pca_gram_product(const NLK_ARRAY *table, const nlk_real *mean, 
+                     const nlk_real *q, const size_t l, nlk_real *t, 
+                     nlk_real *z)
+{
+    const size_t n = table->rows;
+    const size_t d = table->cols;
+    nlk_real *mq = (nlk_real *) calloc(l, sizeof(nlk_real));
+    nlk_real *tsum = (nlk_real *) calloc(l, sizeof(nlk_real));
+    const nlk_real *block;
+    size_t rows;
+
+    if(mq == NULL || tsum == NULL) {
+        NLK_ERROR_ABORT("unable to allocate memory", NLK_ENOMEM);
+        /* unreachable */
+    }
+
+    /* standalone GEMMs over the whole table: BLAS gets the thread budget */
+    nlk_blas_parallel();
+
+    /* mean * Q */
+    cblas_sgemv(CblasRowMajor, CblasTrans, d, l, 1, q, l, mean, 1, 0, mq, 1);
+    memset(z, 0, d * l * sizeof(nlk_real));
+
+    for(size_t start = 0; start < n; start += NLK_PCA_BLOCK) {
+        rows = n - start < NLK_PCA_BLOCK ? n - start : NLK_PCA_BLOCK;
+        block = &table->data[start * d];
+
+        /* T = X * Q - 1 * (mean * Q) */
+        cblas_sgemm(CblasRowMajor, CblasNoTrans, CblasNoTrans, rows, l, d, 
+                    1, block, d, q, l, 0, t, l);
+        for(size_t ii = 0; ii < rows; ii++) {
+            for(size_t jj = 0; jj < l; jj++) {
+                t[ii * l + jj] -= mq[jj];
+                tsum[jj] += t[ii * l + jj];
+            }
+        }
+
+        /* Z += X' * T */
+        cblas_sgemm(CblasRowMajor, CblasTrans, CblasNoTrans, d, l, rows, 
+                    1, block, d, t, l, 1, z, l);
+    }
+
+    /* Z -= mean' * (1' * T) */
+    cblas_sger(CblasRowMajor, d, l, -1, mean, 1, tsum, 1, z, l);
+    nlk_blas_single();
+
+    free(mq);
+    free(tsum);
+}
+
+
+/**
+ * Orthonormalize the columns of Q [d][l] (modified Gram-Schmidt, twice)
+ */
+static void
+nlk_pca_orthonormalize(nlk_real *q, const size_t d, const size_t l)
+{
+    double dot;
+
+    for(int pass = 0; pass < 2; pass++) {
+        for(size_t jj = 0; jj < l; jj++) {
+            for(size_t ii = 0; ii < jj; ii++) {
+                dot = 0;
+                for(size_t rr = 0; rr < d; rr++) {
+                    dot += q[rr * l + ii] * q[rr * l + jj];
+                }
+                for(size_t rr = 0; rr < d; rr++) {
+                    q[rr * l + jj] -= dot * q[rr * l + ii];
+                }
+            }
+            dot = 0;
+            for(size_t rr = 0; rr < d; rr++) {
+                dot += q[rr * l + jj] * q[rr * l + jj];
+            }
+            dot = dot > 0 ? 1.0 / sqrt(dot) : 0;
+            for(size_t rr = 0; rr < d; rr++) {
+                q[rr * l + jj] *= dot;
+            }
+        }
+    }
+}
+
+
+/**
+ * Eigen decomposition of a symmetric matrix (cyclic Jacobi)
+ *
+ * @param a     the matrix [n][n], the diagonal becomes the eigenvalues
+ * @param n     the size of the matrix
+ * @param v     the eigenvectors (columns) [n][n]
+ */
+static void
+nlk_pca_eigen(double *a, const size_t n, double *v)
+{
+    double off;
+    double theta;
+    double t;
+    double c;
+    double s;
+    double tmp1;
+    double tmp2;
+
+    for(size_t ii = 0; ii < n * n; ii++) {
+        v[ii] = 0;
+    }
+    for(size_t ii = 0; ii < n; ii++) {
+        v[ii * n + ii] = 1;
+    }
+
+    for(int sweep = 0; sweep < 100; sweep++) {
+        off = 0;
+        for(size_t pp = 0; pp < n; pp++) {
+            for(size_t qq = pp + 1; qq < n; qq++) {
+                off += a[pp * n + qq] * a[pp * n + qq];
+            }
+        }
+        if(off < 1e-22) {
+            break;
+        }
+
+        for(size_t pp = 0; pp < n; pp++) {
+            for(size_t qq = pp + 1; qq < n; qq++) {
+                if(fabs(a[pp * n + qq]) < 1e-300) {
+                    continue;
+                }
+                /* rotation that zeroes a[p][q] */
+                theta = (a[qq * n + qq] - a[pp * n + pp]) / 
+                        (2 * a[pp * n + qq]);
+                t = (theta >= 0 ? 1 : -1) / 
+                    (fabs(theta) + sqrt(theta * theta + 1));
+                c = 1 / sqrt(t * t + 1);
+                s = t * c;
+
+                for(size_t kk = 0; kk < n; kk++) {
+                    tmp1 = a[kk * n + pp];
+                    tmp2 = a[kk * n + qq];
+                    a[kk * n + pp] = c * tmp1 - s * tmp2;
+                    a[kk * n + qq] = s * tmp1 + c * tmp2;
+                }
+                for(size_t kk = 0; kk < n; kk++) {
+                    tmp1 = a[pp * n + kk];
+                    tmp2 = a[qq * n + kk];
+                    a[pp * n + kk] = c * tmp1 - s * tmp2;
+                    a[qq * n + kk] = s * tmp1 + c * tmp2;
+                }
+                for(size_t kk = 0; kk < n; kk++) {
+                    tmp1 = v[kk * n + pp];
+                    tmp2 = v[kk * n + qq];
+                    v[kk * n + pp] = c * tmp1 - s * tmp2;
+                    v[kk * n + qq] = s * tmp1 + c * tmp2;
+                }
+            }
+        }
+    }
+}
+
+
+/**
+ * Principal Component Analysis of the rows of a table (e.g. word or 
+ * paragraph vectors) by randomized SVD: the range of the centered table is 
+ * found with NLK_PCA_POWER_ITER power iterations of a random basis with
+ * dims + NLK_PCA_OVERSAMPLE directions; each iteration is one pass over the
+ * table in blocks (SGEMM) and the table is not copied.
+ *
+ * @param table     the table [n][d]
+ * @param dims      the number of components (<= d)
+ * @param verbose   print the explained variance
+ *
+ * @return the projection onto the principal components
+ */
+struct nlk_pca_t *
+nlk_pca_fit(const NLK_ARRAY *table, const size_t dims, const bool verbose)
+{
+    const size_t n = table->rows;
+    const size_t d = table->cols;
+    const size_t l = dims + NLK_PCA_OVERSAMPLE < d ? 
+                     dims + NLK_PCA_OVERSAMPLE : d;
+    struct nlk_pca_t *pca;
+    struct nlk_rng_t *rng = nlk_rng_thread();
+    double *mean;
+    double *b;
+    double *u;
+    size_t *order;
+    nlk_real *q;
+    nlk_real *z;
+    nlk_real *t;
+    double total = 0;
+    double explained = 0;
+    double sum;
+    size_t tmp;
+
+    if(dims == 0 || dims > d || n < 2) {
+        NLK_ERROR_NULL("invalid number of dimensions for PCA", NLK_EINVAL);
+        /* unreachable */
+    }
+
+    mean = (double *) calloc(d, sizeof(double));
+    b = (double *) malloc(l * l * sizeof(double));
+    u = (double *) malloc(l * l * sizeof(double));
+    order = (size_t *) malloc(l * sizeof(size_t));
+    q = (nlk_real *) malloc(d * l * sizeof(nlk_real));
+    z = (nlk_real *) malloc(d * l * sizeof(nlk_real));
+    t = (nlk_real *) malloc(NLK_PCA_BLOCK * l * sizeof(nlk_real));
+    if(mean == NULL || b == NULL || u == NULL || order == NULL || q == NULL 
+       || z == NULL || t == NULL) {
+        NLK_ERROR_NULL("unable to allocate memory for PCA", NLK_ENOMEM);
+        /* unreachable */
+    }
+    pca = nlk_pca_create(d, dims);
+
+    /** @section Mean and total variance
+     */
+    for(size_t ii = 0; ii < n; ii++) {
+        for(size_t jj = 0; jj < d; jj++) {
+            mean[jj] += table->data[ii * d + jj];
+            total += table->data[ii * d + jj] * table->data[ii * d + jj];
+        }
+    }
+    for(size_t jj = 0; jj < d; jj++) {
+        mean[jj] /= n;
+        total -= n * mean[jj] * mean[jj];
+        pca->mean->data[jj] = mean[jj];
+    }
+    total /= n - 1;
+
+    /** @section Range: random basis and power iterations
+     */
+    for(size_t ii = 0; ii < d * l; ii++) {
+        q[ii] = 2 * nlk_rng_to_float(nlk_rng_next(rng)) - 1;
+    }
+    nlk_pca_orthonormalize(q, d, l);
+
+    for(int it = 0; it < NLK_PCA_POWER_ITER; it++) {
+        nlk_pca_gram_product(table, pca->mean->data, q, l, t, z);
+        memcpy(q, z, d * l * sizeof(nlk_real));
+        nlk_pca_orthonormalize(q, d, l);
+    }
+
+    /** @section Small eigenproblem: B = Q' * Xc' * Xc * Q
+     */
+    nlk_pca_gram_product(table, pca->mean->data, q, l, t, z);
+    for(size_t ii = 0; ii < l; ii++) {
+        for(size_t jj = 0; jj < l; jj++) {
+            sum = 0;
+            for(size_t rr = 0; rr < d; rr++) {
+                sum += (double) q[rr * l + ii] * z[rr * l + jj];
+            }
+            b[ii * l + jj] = sum;
+        }
+    }
+    for(size_t ii = 0; ii < l; ii++) {     /* symmetrize */
+        for(size_t jj = ii + 1; jj < l; jj++) {
+            sum = (b[ii * l + jj] + b[jj * l + ii]) / 2;
+            b[ii * l + jj] = b[jj * l + ii] = sum;
+        }
+    }
+    nlk_pca_eigen(b, l, u);
+
+    /* sort eigenvalues (descending) */
+    for(size_t ii = 0; ii < l; ii++) {
+        order[ii] = ii;
+    }
+    for(size_t ii = 1; ii < l; ii++) {
+        for(size_t jj = ii; jj > 0 && b[order[jj] * l + order[jj]] > 
+                                      b[order[jj - 1] * l + order[jj - 1]]; 
+            jj--) {
+            tmp = order[jj];
+            order[jj] = order[jj - 1];
+            order[jj - 1] = tmp;
+        }
+    }
+
+    /** @section Components = Q * U (top dims) 
+     */
+    for(size_t kk = 0; kk < dims; kk++) {
+        pca->variance->data[kk] = b[order[kk] * l + order[kk]] / (n - 1);
+        explained += pca->variance->data[kk];
+        for(size_t rr = 0; rr < d; rr++) {
+            sum = 0;
+            for(size_t ii = 0; ii < l; ii++) {
+                sum += (double) q[rr * l + ii] * u[ii * l + order[kk]];
+            }
+            pca->components->data[rr * dims + kk] = sum;
+        }
+    }
+
+    if(verbose) {
+        printf("PCA: %zu x %zu -> %zu, explained variance %.2f%%\n", n, d, 
+               dims, total > 0 ? 100 * explained / total : 0);
+    }
+
+    free(mean);
+    free(b);
+    free(u);
+    free(order);
+    free(q);
+    free(z);
+    free(t);
+
+    return pca;
+}
+
+
+/**
+ * Random projection (Achlioptas): components are +-1/sqrt(out)
+ * and the mean is zero. Distances are preserved in expectation.
+ *
+ * @param in    input dimensions
+ * @param out   output dimensions
+ *
+ * @return the projection
+ */
+struct nlk_pca_t *
+nlk_pca_random(const size_t in, const size_t out)
+{
+    struct nlk_pca_t *pca;
+    struct nlk_rng_t *rng = nlk_rng_thread();
+    const nlk_real v = 1.0 / sqrt(out);
+
+    if(out == 0 || in == 0) {
+        NLK_ERROR_NULL("invalid number of dimensions for projection", 
+                       NLK_EINVAL);
+        /* unreachable */
+    }
+
+    pca = nlk_pca_create(in, out);
+    for(size_t ii = 0; ii < pca->components->len; ii++) {
+        pca->components->data[ii] = nlk_rng_next(rng) >> 63 ? v : -v;
+    }
+
+    return pca;
+}
+
+
+/**
+ * Project the rows of a table: (table - mean) * components
+ *
+ * @param pca   the projection
+ * @param table the table [n][in] (e.g. new PVs)
+ *
+ * @return the projected table [n][out]
+ */
+NLK_ARRAY *
+nlk_pca_project(const struct nlk_pca_t *pca, const NLK_ARRAY *table)
+{
+    const size_t in = pca->components->rows;
+    const size_t out = pca->components->cols;
+    NLK_ARRAY *projected;
+    nlk_real *shift;
+
+    if(table->cols != in) {
+        NLK_ERROR_NULL("table and projection dimensions do not match", 
+                       NLK_EBADLEN);
+        /* unreachable */
+    }
+
+    projected = nlk_array_create(table->rows, out);
+    shift = (nlk_real *) malloc(out * sizeof(nlk_real));
+    if(shift == NULL) {
+        NLK_ERROR_NULL("unable to allocate memory", NLK_ENOMEM);
+        /* unreachable */
+    }
+
+    /* standalone GEMM over the whole table: BLAS gets the thread budget */
+    nlk_blas_parallel();
+
+    /* mean * components */
+    cblas_sgemv(CblasRowMajor, CblasTrans, in, out, 1, 
+                pca->components->data, out, pca->mean->data, 1, 0, shift, 1);
+
+    /* table * components - shift */
+    cblas_sgemm(CblasRowMajor, CblasNoTrans, CblasNoTrans, table->rows, out, 
+                in, 1, table->data, in, pca->components->data, out, 0, 
+                projected->data, out);
+    nlk_blas_single();
+    for(size_t ii = 0; ii < table->rows; ii++) {
+        for(size_t jj = 0; jj < out; jj++) {
+            projected->data[ii * out + jj] -= shift[jj];
+        }
+    }
+
+    free(shift);
+    return projected;
+}
+
+
+/**
+ * Save a projection to a file pointer
+ */
+void
+nlk_pca_save(struct nlk_pca_t *pca, FILE *fp)
+{
+    fprintf(fp, "NLKPCA %zu %zu\n", pca->components->rows, 
+            pca->components->cols);
+    nlk_array_save(pca->mean, fp);
+    nlk_array_save(pca->components, fp);
+    nlk_array_save(pca->variance, fp);
+}
+
+
+/**
+ * Save a projection to a file
+ */
+void
+nlk_pca_save_path(struct nlk_pca_t *pca, const char *path)
+{
+    FILE *fp = fopen(path, "wb");
+    if(fp == NULL) {
+        NLK_ERROR_VOID("unable to open file.", NLK_FAILURE);
+        /* unreachable */
+    }
+
+    nlk_pca_save(pca, fp);
+    fclose(fp);
+}
+
+
+/**
+ * Load a projection from a file pointer
+ */
+struct nlk_pca_t *
+nlk_pca_load(FILE *fp)
+{
+    struct nlk_pca_t *pca;
+    size_t in;
+    size_t out;
+
+    if(fscanf(fp, "NLKPCA %zu %zu\n", &in, &out) != 2) {
+        NLK_ERROR_NULL("bad projection header", NLK_EINVAL);
+        /* unreachable */
+    }
+
+    pca = (struct nlk_pca_t *) malloc(sizeof(struct nlk_pca_t));
+    if(pca == NULL) {
+        NLK_ERROR_NULL("unable to allocate memory for projection", 
+                       NLK_ENOMEM);
+        /* unreachable */
+    }
+    pca->mean = nlk_array_load(fp);
+    pca->components = nlk_array_load(fp);
+    pca->variance = nlk_array_load(fp);
+
+    if(pca->mean == NULL || pca->components == NULL || pca->variance == NULL
+       || pca->components->rows != in || pca->components->cols != out) {
+        NLK_ERROR_NULL("bad projection file", NLK_EINVAL);
+        /* unreachable */
+    }
+
+    return pca;
+}
+
+
+/**
+ * Load a projection from a file
+ */
+struct nlk_pca_t *
+nlk_pca_load_path(const char *path)
+{
+    struct nlk_pca_t *pca;
+    FILE *fp = fopen(path, "rb");
+    if(fp == NULL) {
+        NLK_ERROR_NULL("unable to open file.", NLK_FAILURE);
+        /* unreachable */
+    }
+
+    pca = nlk_pca_load(fp);
+    fclose(fp);
+    return pca;
+}
+
+
+/**
+ * Free a projection
+ */
+void
+nlk_pca_free(struct nlk_pca_t *pca)
+{
+    nlk_array_free(pca->mean);
+    nlk_array_free(pca->components);
+    nlk_array_free(pca->variance);
+    free(pca);
+}
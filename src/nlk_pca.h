@@ -0,0 +1,82 @@
+/******************************************************************************
+ * NLK - Neural Language Kit
+ *
+ * Copyright (c) 2015 Luis Rei <me@luisrei.com> http://luisrei.com @lmrei
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to 
+ * deal in the Software without restriction, including without limitation the 
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or 
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ *****************************************************************************/
+
+
+
+/** @file nlk_pca.h
+ * Dimensionality reduction (PCA, random projection) definitions
+ */
+
+
+#ifndef __NLK_PCA_H__
+#define __NLK_PCA_H__
+
+
+#include <stdio.h>
+#include <stdbool.h>
+
+#include "nlk_array.h"
+
+
+#undef __BEGIN_DECLS
+#undef __END_DECLS
+#ifdef __cplusplus
+# define __BEGIN_DECLS extern "C" {
+# define __END_DECLS }
+#else
+# define __BEGIN_DECLS /* empty */
+# define __END_DECLS /* empty */
+#endif
+__BEGIN_DECLS
+
+
+#define NLK_PCA_BLOCK       4096    /**< table rows per SGEMM */
+#define NLK_PCA_OVERSAMPLE  10      /**< extra random directions (range) */
+#define NLK_PCA_POWER_ITER  3       /**< power iterations */
+
+
+/** @struct nlk_pca_t
+ * A linear projection: y = (x - mean) * components
+ */
+struct nlk_pca_t {
+    NLK_ARRAY   *mean;          /**< the input mean [1][in] */
+    NLK_ARRAY   *components;    /**< the projection [in][out] */
+    NLK_ARRAY   *variance;      /**< variance along each component [1][out] */
+};
+typedef struct nlk_pca_t NLK_PCA;
+
+
+struct nlk_pca_t *nlk_pca_fit(const NLK_ARRAY *, const size_t, const bool);
+struct nlk_pca_t *nlk_pca_random(const size_t, const size_t);
+NLK_ARRAY *nlk_pca_project(const struct nlk_pca_t *, const NLK_ARRAY *);
+
+void nlk_pca_save(struct nlk_pca_t *, FILE *);
+void nlk_pca_save_path(struct nlk_pca_t *, const char *);
+struct nlk_pca_t *nlk_pca_load(FILE *);
+struct nlk_pca_t *nlk_pca_load_path(const char *);
+void nlk_pca_free(struct nlk_pca_t *);
+
+
+__END_DECLS
+#endif /* __NLK_PCA_H__ */
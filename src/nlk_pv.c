@@ -31,9 +31,12 @@
 
 #include <errno.h>
 #include <stdio.h>
+#include <string.h>
+#include <strings.h>
 
 #include <omp.h>
 
+#include "nlk.h"
 #include "nlk_err.h"
 #include "nlk_array.h"
 #include "nlk_tic.h"
@@ -84,6 +87,9 @@ nlk_pv_inference_mode(struct nlk_neuralnet_t *nn)
     if(nn->train_opts.negative) {
         nn->neg->update = false;
     }
+    if(nn->subwords != NULL) {
+        nn->subwords->ngrams->update = false;
+    }
 }
 
 
@@ -104,106 +110,510 @@ nlk_pv_learn_mode(struct nlk_neuralnet_t *nn)
     if(nn->train_opts.negative) {
         nn->neg->update = true;
     }
+    if(nn->subwords != NULL) {
+        nn->subwords->ngrams->update = true;
+    }
+}
+
+
+/**
+ * Returns the PV initialization given a name or the default given NULL
+ *
+ * @param name  "random", "words" or "model" (the loaded PV table) or NULL
+ *
+ * @return the initialization type
+ */
+NLK_PV_INIT
+nlk_pv_init_type(const char *name)
+{
+    if(name == NULL || strcasecmp(name, "random") == 0) {
+        return NLK_PV_INIT_RANDOM;
+    } else if(strcasecmp(name, "words") == 0) {
+        return NLK_PV_INIT_WORDS;
+    } else if(strcasecmp(name, "model") == 0) {
+        return NLK_PV_INIT_TABLE;
+    }
+
+    NLK_ERROR_ABORT("Invalid PV initialization.", NLK_EINVAL);
+    /* unreachable */
 }
 
 
 /**
- * Infer Paragraph Vector for a line
- * This is function is the function that does the inference part for 
- * nlk_pv_gen and nlk_pv_gen_string.
+ * Initialize the Paragraph Vector of a line (warm start)
  *
  * @param nn            the neural network structure
- * @param line          the line structure holding the input       
- * @param epochs        the number of epochs or iterations to generate a PV
+ * @param line          the line
+ * @param row           the line's row in the paragraph table
+ * @param opts          the inference options
+ * @param paragraphs    the paragraph table (randomly initialized)
+ */
+static void
+nlk_pv_init_line(struct nlk_neuralnet_t *nn, const struct nlk_line_t *line,
+                 const size_t row, const struct nlk_pv_opts_t *opts, 
+                 struct nlk_layer_lookup_t *paragraphs)
+{
+    const size_t cols = paragraphs->weights->cols;
+    nlk_real *pv = &paragraphs->weights->data[row * cols];
+    const NLK_ARRAY *table = opts->table != NULL ? opts->table->weights : NULL;
+    const NLK_ARRAY *words = nn->words->weights;
+    size_t n = 0;
+
+    switch(opts->init) {
+        case NLK_PV_INIT_TABLE:
+            if(table != NULL && line->line_id < table->rows 
+               && table->cols == cols) {
+                nlk_carray_copy_carray(pv, &table->data[line->line_id * cols],
+                                       cols);
+                break;
+            }
+            /* not in the table: use the word vectors */
+            /* fall through */
+        case NLK_PV_INIT_WORDS:
+            for(size_t ii = 0; ii < line->len; ii++) {
+                if(line->varray[ii]->index >= words->rows) {
+                    continue; /* e.g. out of vocabulary subword */
+                }
+                if(n == 0) {
+                    memset(pv, 0, cols * sizeof(nlk_real));
+                }
+                cblas_saxpy(cols, 1, 
+                            &words->data[line->varray[ii]->index * cols], 1,
+                            pv, 1);
+                n++;
+            }
+            if(n > 0) {
+                cblas_sscal(cols, 1.0 / n, pv, 1);
+            }
+            break;
+        case NLK_PV_INIT_RANDOM:
+        default:
+            break;
+    }
+}
+
+
+/**
+ * Relative squared change of a paragraph vector: |pv - prev|^2 / |prev|^2
+ */
+static nlk_real
+nlk_pv_change(const nlk_real *pv, const nlk_real *prev, const size_t len)
+{
+    nlk_real diff = 0;
+    nlk_real norm = 0;
+
+    for(size_t ii = 0; ii < len; ii++) {
+        diff += (pv[ii] - prev[ii]) * (pv[ii] - prev[ii]);
+        norm += prev[ii] * prev[ii];
+    }
+    if(norm <= 0) {
+        return diff > 0 ? 1 : 0;
+    }
+    return diff / norm;
+}
+
+
+/** @struct nlk_pv_slot_t
+ * A document being inferred by nlk_pv_gen_lines
+ */
+struct nlk_pv_slot_t {
+    struct nlk_line_t  *line;       /**< the document */
+    struct nlk_line_t  *sample;     /**< the subsampled document (epoch) */
+    size_t              row;        /**< the document's paragraph row */
+    struct nlk_rng_t    rng;        /**< the document's random stream */
+    nlk_real           *prev;       /**< the PV before the epoch */
+    nlk_real            learn_rate; /**< the current learning rate */
+    uint64_t            word_count; /**< words seen (for the learning rate) */
+    unsigned int        epochs;     /**< epochs run */
+    bool                active;     /**< still being inferred */
+};
+
+
+/**
+ * Create the per thread memory for PV inference
+ *
+ * @param nn    the neural network
+ * @param batch the number of lines inferred at once (0 = 1)
+ *
+ * @return the inference memory
+ */
+struct nlk_pv_work_t *
+nlk_pv_work_create(const struct nlk_neuralnet_t *nn, const size_t batch)
+{
+    struct nlk_pv_work_t *work;
+    const size_t cols = nn->words->weights->cols;
+    unsigned int layer_size2 = 0;
+
+    if(nn->train_opts.hs) {
+        layer_size2 = nn->hs->weights->cols;
+    } else if(nn->train_opts.negative) {
+        layer_size2 = nn->neg->weights->cols;
+    }
+
+    work = (struct nlk_pv_work_t *) malloc(sizeof(struct nlk_pv_work_t));
+    if(work == NULL) {
+        NLK_ERROR_ABORT("unable to allocate memory for PV inference", 
+                        NLK_ENOMEM);
+        /* unreachable */
+    }
+    work->batch = batch > 0 ? batch : 1;
+
+    /* the lines being inferred together */
+    work->slots = (struct nlk_pv_slot_t *) calloc(work->batch, 
+                                                sizeof(struct nlk_pv_slot_t));
+    if(work->slots == NULL) {
+        NLK_ERROR_ABORT("unable to allocate memory for PV inference", 
+                        NLK_ENOMEM);
+        /* unreachable */
+    }
+    for(size_t ii = 0; ii < work->batch; ii++) {
+        work->slots[ii].sample = nlk_line_create(NLK_MAX_LINE_SIZE);
+        work->slots[ii].prev = (nlk_real *) malloc(cols * sizeof(nlk_real));
+        if(work->slots[ii].prev == NULL) {
+            NLK_ERROR_ABORT("unable to allocate memory for PV inference", 
+                            NLK_ENOMEM);
+            /* unreachable */
+        }
+    }
+
+    /* for converting a sentence to a series of training contexts */
+    work->contexts = nlk_context_create_array(nn->context_opts.max_size);
+
+    /* output of the first layer */
+    work->layer1_out = nlk_array_create(layer_size2, 1);
+
+    /* for storing gradients */
+    work->grad_acc = nlk_array_create(1, layer_size2);
+
+    /* for nlk_pv_work_thread */
+    work->pv_size = cols;
+    work->ctx_size = nn->context_opts.max_size;
+    work->nn = nn;
+
+    /* created by nlk_pv_gen_string when first needed */
+    work->text_line = NULL;
+    work->line = NULL;
+
+    return work;
+}
+
+
+/**
+ * Free the per thread memory for PV inference
+ */
+void
+nlk_pv_work_free(struct nlk_pv_work_t *work)
+{
+    for(size_t ii = 0; ii < work->batch; ii++) {
+        nlk_line_free(work->slots[ii].sample);
+        free(work->slots[ii].prev);
+    }
+    free(work->slots);
+    nlk_context_free_array(work->contexts);
+    nlk_array_free(work->layer1_out);
+    nlk_array_free(work->grad_acc);
+    if(work->text_line != NULL) {
+        nlk_text_line_free(work->text_line);
+    }
+    if(work->line != NULL) {
+        nlk_line_free(work->line);
+    }
+    free(work);
+}
+
+
+/* the inference memory of each thread (nlk_pv_work_thread) */
+static __thread struct nlk_pv_work_t *__pv_work = NULL;
+
+/**
+ * The calling thread's memory for PV inference: kept between calls and only
+ * recreated when the network, its sizes or the batch change, so that repeated 
+ * inference (e.g. nlk_pv_gen_string in a loop) does not allocate it again.
+ *
+ * @param nn    the neural network
+ * @param batch the number of lines inferred at once (0 = 1)
+ *
+ * @return the inference memory (do not free, see nlk_pv_work_thread_free)
+ */
+struct nlk_pv_work_t *
+nlk_pv_work_thread(const struct nlk_neuralnet_t *nn, const size_t batch)
+{
+    size_t layer_size2 = 0;
+
+    if(nn->train_opts.hs) {
+        layer_size2 = nn->hs->weights->cols;
+    } else if(nn->train_opts.negative) {
+        layer_size2 = nn->neg->weights->cols;
+    }
+
+    if(__pv_work != NULL
+       && (__pv_work->nn != nn
+           || __pv_work->batch != (batch > 0 ? batch : 1)
+           || __pv_work->pv_size != nn->words->weights->cols
+           || __pv_work->ctx_size != nn->context_opts.max_size
+           || __pv_work->layer1_out->rows != layer_size2)) {
+        nlk_pv_work_thread_free();
+    }
+    if(__pv_work == NULL) {
+        __pv_work = nlk_pv_work_create(nn, batch);
+    }
+
+    return __pv_work;
+}
+
+/**
+ * Free the calling thread's memory for PV inference
+ */
+void
+nlk_pv_work_thread_free()
+{
+    if(__pv_work != NULL) {
+        nlk_pv_work_free(__pv_work);
+        __pv_work = NULL;
+    }
+}
+
+/**
+ * Free the memory each thread keeps between inference calls: its PV 
+ * inference memory (nlk_pv_work_thread), its workspace (nlk_workspace_thread)
+ * and its HS nodes (nlk_w2v_thread_free). Call once, outside of a parallel 
+ * region, when done.
+ */
+void
+nlk_pv_threads_free()
+{
+    const int num_threads = nlk_get_max_threads();
+
+#pragma omp parallel num_threads(num_threads)
+{
+    nlk_pv_work_thread_free();
+    nlk_workspace_thread_free();
+    nlk_w2v_thread_free();
+} /* end of parallel region */
+}
+
+
+/**
+ * Infer the Paragraph Vectors of n lines, interleaved: every epoch advances 
+ * all lines and for PVDBOW the targets of the lines alternate, so that the 
+ * (independent) row fetches of different documents overlap. 
+ * Each document draws from its own random stream (seeded by its line id) and
+ * only its own PV changes, so the result does not depend on n or order: 
+ * n = 1 is sequential inference.
+ *
+ * @param nn            the neural network structure
+ * @param lines         the lines (documents)
+ * @param n             the number of lines (<= work->batch)
+ * @param base          line_id of paragraph table row 0
+ * @param opts          the inference options (epochs, tolerance, init)
  * @param paragraphs    the paragraph table that will be updated (output)
- * @param line_sample   will hold sampled line for each epoch
- * @param contexts      will hold the contexts generated for each epoch
- * @param grad_acc      for accumulating grandients
- * @param layer1_out    for holding the output of the first layer
+ * @param work          the thread's inference memory
+ *
+ * @return the number of epochs (iterations) run for all lines
  */
-inline static void
-nlk_pv_gen_line(struct nlk_neuralnet_t *nn, 
-                struct nlk_line_t *line,
-                const unsigned int epochs,
-                struct nlk_layer_lookup_t *paragraphs,
-                struct nlk_line_t *line_sample,
-                struct nlk_context_t **contexts, NLK_ARRAY *grad_acc,
-                NLK_ARRAY *layer1_out)
+static uint64_t
+nlk_pv_gen_lines(struct nlk_neuralnet_t *nn, struct nlk_line_t *lines,
+                 const size_t n, const size_t base, 
+                 const struct nlk_pv_opts_t *opts,
+                 struct nlk_layer_lookup_t *paragraphs,
+                 struct nlk_pv_work_t *work)
 {
-    NLK_LM model_type = nn->train_opts.model_type;
-    nlk_real learn_rate = nn->train_opts.learn_rate;
+    const unsigned int epochs = opts->epochs;
+    const nlk_real tol2 = opts->tol * opts->tol;
+    const size_t cols = paragraphs->weights->cols;
+    const NLK_LM model_type = nn->train_opts.model_type;
+    const bool dbow = model_type == NLK_PVDBOW 
+                   || model_type == NLK_PVDBOW_PURE;
     const nlk_real learn_rate_start = nn->train_opts.learn_rate;
-    uint64_t train_words = nn->train_opts.word_count;
+    const uint64_t train_words = nn->train_opts.word_count;
     const float sample_rate = nn->train_opts.sample; 
- 
-
-    /* Generate PV for this line */
+    struct nlk_pv_slot_t *slots = work->slots;
+    struct nlk_context_t **contexts = work->contexts;
+    NLK_ARRAY *grad_acc = work->grad_acc;
+    NLK_ARRAY *layer1_out = work->layer1_out;
+    struct nlk_pv_slot_t *slot;
     unsigned int n_examples;
     unsigned int ex;
-    uint64_t line_words;
-    uint64_t word_count_actual = 0;
+    size_t active = n;
+    size_t max_len;
+    uint64_t iterations = 0;
+    nlk_real *pv;
 
-    
-    line_words = line->len;
+
+    /** @section Start: random streams and warm start
+     */
+    for(size_t ii = 0; ii < n; ii++) {
+        slot = &slots[ii];
+        slot->line = &lines[ii];
+        slot->learn_rate = learn_rate_start;
+        slot->word_count = 0;
+        slot->epochs = 0;
+        slot->active = true;
+        slot->row = slot->line->line_id - base;
+        nlk_rng_init_stream(&slot->rng, slot->line->line_id);
+        nlk_pv_init_line(nn, slot->line, slot->row, opts, paragraphs);
+        if(paragraphs->adagrad != NULL) {
+            paragraphs->adagrad[slot->row] = 0;
+        }
+    }
 
     /** @section Generate Contexts Update Vector Loop
      */
-    unsigned int local_epoch = 0;
-    for(local_epoch = 0; local_epoch < epochs; local_epoch++) {
-        word_count_actual += line_words;
+    for(unsigned int epoch = 0; epoch < epochs && active > 0; epoch++) {
+        /** @subsection Subsample each line
+         */
+        max_len = 0;
+        for(size_t ii = 0; ii < n; ii++) {
+            slot = &slots[ii];
+            if(!slot->active) {
+                continue;
+            }
+            nlk_rng_thread_set(&slot->rng);
+            slot->word_count += slot->line->len;
+            slot->epochs++;
 
-         /* subsample  line */
-        nlk_vocab_line_subsample(line, train_words, sample_rate, 
-                                 line_sample);
+            nlk_vocab_line_subsample(slot->line, train_words, sample_rate, 
+                                     slot->sample);
 
-        /* single word, nothing to do ... */
-        if(line_sample->len < 2) {
-            continue;
+            /* single word, nothing to do ... */
+            if(slot->sample->len < 2) {
+                slot->sample->len = 0;
+            }
+            if(slot->sample->len > max_len) {
+                max_len = slot->sample->len;
+            }
+            if(tol2 > 0) {
+                pv = &paragraphs->weights->data[slot->row * cols];
+                nlk_carray_copy_carray(slot->prev, pv, cols);
+            }
         }
 
-        /* generate contexts  */
-        n_examples = nlk_context_window(line_sample->varray, 
-                                        line_sample->len, 
-                                        line_sample->line_id, 
-                                        &nn->context_opts, 
-                                        contexts);
-
-
-        /** @subsection Update the Paragraph Vector with these contexts
+        /** @subsection Update the Paragraph Vectors
          */
-        switch(model_type) {
-            case NLK_PVDBOW:
-                for(ex = 0; ex < n_examples; ex++) {
-                    nlk_pvdbow(nn, paragraphs, learn_rate, 
-                               contexts[ex], grad_acc, layer1_out);
+        if(dbow) {
+            /* word inputs are frozen: only the PV input does work 
+             * (nlk_pvdbow_target); alternate the lines at each position */
+            for(size_t pos = 0; pos < max_len; pos++) {
+                for(size_t ii = 0; ii < n; ii++) {
+                    slot = &slots[ii];
+                    if(!slot->active || pos >= slot->sample->len) {
+                        continue;
+                    }
+                    nlk_rng_thread_set(&slot->rng);
+                    nlk_layer_lookup_grad_scale(slot->learn_rate);
+                    nlk_pvdbow_target(nn, paragraphs, slot->learn_rate,
+                                      slot->row, slot->sample->varray[pos], 
+                                      grad_acc);
                 }
-                break;
-
-            case NLK_PVDM:
-                for(ex = 0; ex < n_examples; ex++) {
-                    nlk_pvdm(nn, paragraphs, learn_rate, contexts[ex], 
-                             grad_acc, layer1_out);
+            }
+        } else {
+            for(size_t ii = 0; ii < n; ii++) {
+                slot = &slots[ii];
+                if(!slot->active || slot->sample->len == 0) {
+                    continue;
                 }
-                break;
+                nlk_rng_thread_set(&slot->rng);
+                nlk_layer_lookup_grad_scale(slot->learn_rate);
+
+                /* generate contexts  */
+                n_examples = nlk_context_window(slot->sample->varray, 
+                                                slot->sample->len, 
+                                                slot->row, 
+                                                &nn->context_opts, 
+                                                contexts);
+
+                switch(model_type) {
+                    case NLK_PVDM:
+                        for(ex = 0; ex < n_examples; ex++) {
+                            nlk_pvdm(nn, paragraphs, slot->learn_rate, 
+                                     contexts[ex], grad_acc, layer1_out);
+                        }
+                        break;
+                    case NLK_PVDM_CONCAT:
+                        for(ex = 0; ex < n_examples; ex++) {
+                            nlk_pvdm_cc(nn, paragraphs, slot->learn_rate, 
+                                        contexts[ex], grad_acc, layer1_out);
+                        }
+                        break;
+                    case NLK_MODEL_NULL:
+                    case NLK_CBOW:
+                    case NLK_CBOW_SUM:
+                    case NLK_SKIPGRAM:
+                    default:
+                        NLK_ERROR_ABORT("invalid model type", NLK_EINVAL);
+                        /* unreachable */
+                } /* end of model switch */
+            }
+        }
 
-            case NLK_PVDM_CONCAT:
-                for(ex = 0; ex < n_examples; ex++) {
-                    nlk_pvdm_cc(nn, paragraphs, learn_rate, contexts[ex], 
-                                grad_acc, layer1_out);
-                }
-                break;
-            case NLK_MODEL_NULL:
-            case NLK_CBOW:
-            case NLK_CBOW_SUM:
-            case NLK_SKIPGRAM:
-            default:
-                NLK_ERROR_ABORT("invalid model type", NLK_EINVAL);
-                /* unreachable */
-        } /* end of model switch */
-        learn_rate = nlk_learn_rate_w2v(learn_rate, learn_rate_start,
-                                        epochs, word_count_actual, 
-                                        line_words);
-    } /* end of contexts: pv has been generated */ 
+        /** @subsection Learning rates and early stop
+         */
+        for(size_t ii = 0; ii < n; ii++) {
+            slot = &slots[ii];
+            if(!slot->active) {
+                continue;
+            }
+            slot->learn_rate = nlk_learn_rate_w2v(slot->learn_rate, 
+                                                  learn_rate_start, epochs, 
+                                                  slot->word_count, 
+                                                  slot->line->len);
+
+            /* early stop: the PV barely changed in this epoch */
+            pv = &paragraphs->weights->data[slot->row * cols];
+            if(tol2 > 0 && slot->sample->len > 0 
+               && nlk_pv_change(pv, slot->prev, cols) < tol2) {
+                slot->active = false;
+                active--;
+            }
+        }
+    } /* end of epochs: pvs have been generated */ 
+
+    nlk_rng_thread_set(NULL);
+
+    for(size_t ii = 0; ii < n; ii++) {
+        iterations += slots[ii].epochs;
+    }
+    return iterations;
+}
+
+
+/**
+ * Infer the Paragraph Vectors of n lines, work->batch lines at a time.
+ * The PV of a line goes in row line_id - base of the paragraph table. 
+ * This is the function that does the inference part for nlk_pv_gen, 
+ * nlk_pv_gen_string and streaming classification.
+ * Inference mode must be set (nlk_pv_inference_mode).
+ *
+ * @param nn            the neural network structure
+ * @param lines         the lines (documents)
+ * @param n             the number of lines
+ * @param base          line_id of paragraph table row 0
+ * @param opts          the inference options (epochs, tolerance, init)
+ * @param paragraphs    the paragraph table that will be updated (output)
+ * @param work          the thread's inference memory (nlk_pv_work_create)
+ *
+ * @return the number of epochs (iterations) run for all lines
+ */
+uint64_t
+nlk_pv_gen_work(struct nlk_neuralnet_t *nn, struct nlk_line_t *lines,
+                const size_t n, const size_t base, 
+                const struct nlk_pv_opts_t *opts,
+                struct nlk_layer_lookup_t *paragraphs, 
+                struct nlk_pv_work_t *work)
+{
+    uint64_t iterations = 0;
+    size_t len;
+
+    for(size_t ii = 0; ii < n; ii += len) {
+        len = n - ii;
+        if(len > work->batch) {
+            len = work->batch;
+        }
+        iterations += nlk_pv_gen_lines(nn, &lines[ii], len, base, opts, 
+                                       paragraphs, work);
+    }
+
+    return iterations;
 }
 
 
@@ -223,6 +633,35 @@ struct nlk_layer_lookup_t *
 nlk_pv_gen(struct nlk_neuralnet_t *nn, const struct nlk_corpus_t *corpus, 
            const unsigned int epochs, const bool verbose)
 {
+    struct nlk_pv_opts_t opts = { .epochs = epochs, .tol = 0, 
+                                  .init = NLK_PV_INIT_RANDOM, .table = NULL,
+                                  .batch = NLK_PV_BATCH, .adagrad = 0,
+                                  .iterations = 0 };
+
+    return nlk_pv_gen_opts(nn, corpus, &opts, verbose);
+}
+
+
+/**
+ * Paragraph Vector Inference with options: warm start (opts->init), early
+ * stopping (opts->tol) and the number of lines each thread infers at once
+ * (opts->batch, the result is the same). The total number of iterations run
+ * is stored in opts->iterations.
+ *
+ * @param nn            the neural network structure
+ * @param corpus        the input corpus
+ * @param opts          the inference options
+ * @param verbose       siplay progress and print other stuff that is useful
+ *
+ * @return a paragraph table (lookup layer) with the PVs generated
+ */
+struct nlk_layer_lookup_t *
+nlk_pv_gen_opts(struct nlk_neuralnet_t *nn, const struct nlk_corpus_t *corpus, 
+                struct nlk_pv_opts_t *opts, const bool verbose)
+{
+    const unsigned int epochs = opts->epochs;
+    uint64_t iterations = 0;
+
     if(verbose) {
         nlk_tic("Generating paragraph vectors", false);
         printf(" (%u iterations)\n", epochs);
@@ -232,15 +671,8 @@ nlk_pv_gen(struct nlk_neuralnet_t *nn, const struct nlk_corpus_t *corpus,
     struct nlk_layer_lookup_t *paragraphs;
     paragraphs = nlk_layer_lookup_create(corpus->len, nn->words->weights->cols);
     nlk_layer_lookup_init(paragraphs);
-
-    /* unpack options */
-    unsigned int ctx_size = nn->context_opts.max_size;
-    unsigned int layer_size2 = 0;
-
-    if(nn->train_opts.hs) {
-        layer_size2 = nn->hs->weights->cols;
-    } else if(nn->train_opts.negative) {
-        layer_size2 = nn->neg->weights->cols;
+    if(opts->adagrad > 0) {
+        nlk_layer_lookup_adagrad(paragraphs, opts->adagrad);
     }
 
     /* lines shortcut */
@@ -256,22 +688,15 @@ nlk_pv_gen(struct nlk_neuralnet_t *nn, const struct nlk_corpus_t *corpus,
 
     /** @section Parallel Generation of PVs
      */
-#pragma omp parallel shared(generated)
+    /* per example loop: the phase's threads, no BLAS threads */
+    nlk_phase_begin(NLK_PHASE_INFER);
+#pragma omp parallel shared(generated) reduction(+ : iterations)
 {
-    struct nlk_line_t *line = NULL;
-
-    /* for converting a sentence to a series of training contexts */
-    struct nlk_context_t **contexts = NULL;
-    contexts = nlk_context_create_array(ctx_size);
-
-    /* for undersampling words in a line */
-    struct nlk_line_t *line_sample = nlk_line_create(NLK_MAX_LINE_SIZE);
-
-    /* output of the first layer */
-    NLK_ARRAY *layer1_out = nlk_array_create(layer_size2, 1);
+    size_t n;
 
-    /* for storing gradients */
-    NLK_ARRAY *grad_acc = nlk_array_create(1, layer_size2);
+    /* slots, contexts, gradients */
+    struct nlk_pv_work_t *work = nlk_pv_work_thread(nn, opts->batch);
+    const size_t batch = work->batch;
 
     /* variables for handling splitting the corpus among threads */
     int num_threads = omp_get_num_threads();
@@ -288,18 +713,21 @@ nlk_pv_gen(struct nlk_neuralnet_t *nn, const struct nlk_corpus_t *corpus,
         end_line = nlk_text_get_split_end_line(total, num_threads, 
                                                thread_id);
     
-        /* for each line, generate it's PV */
-        while(line_cur < end_line) {
-            /* get the next line */
-            line = &lines[line_cur];
+        /* for each batch of lines, generate their PVs */
+        while(line_cur <= end_line) {
+            /* get the next lines */
+            n = end_line - line_cur + 1;
+            if(n > batch) {
+                n = batch;
+            }
             
-            /* generate the paragraph vector */
-            nlk_pv_gen_line(nn, line, epochs, paragraphs, line_sample,
-                            contexts, grad_acc, layer1_out);
+            /* generate the paragraph vectors */
+            iterations += nlk_pv_gen_lines(nn, &lines[line_cur], n, 0, opts, 
+                                           paragraphs, work);
        
-            /* go to next line */
-            line_cur++;
-            generated++;
+            /* go to next lines */
+            line_cur += n;
+            generated += n;
 
             /* display progress */
             if(verbose) {
@@ -312,14 +740,10 @@ nlk_pv_gen(struct nlk_neuralnet_t *nn, const struct nlk_corpus_t *corpus,
             nlk_pv_display(generated, total);
     }
 
-    /* free thread memory */
-    nlk_context_free_array(contexts);
-    nlk_line_free(line_sample);
-    nlk_array_free(layer1_out);
-    nlk_array_free(grad_acc);
-
 } /* end of parallel section */
 
+    opts->iterations = iterations;
+
     if(verbose) {
         printf("\n");
     }
@@ -339,8 +763,10 @@ nlk_pv_gen(struct nlk_neuralnet_t *nn, const struct nlk_corpus_t *corpus,
  *
  * @return a paragraph table (lookup layer) with the PV generated (id = 0)
  * 
- * @warning terribly inneficient function that allocates and frees all memory
- *          each time it is called.
+ * @note the working memory is the calling thread's (nlk_pv_work_thread), 
+ *       kept between calls as for the other inference paths and freed by 
+ *       nlk_pv_threads_free: only the returned table is allocated by each 
+ *       call.
  */
 struct nlk_layer_lookup_t *
 nlk_pv_gen_string(struct nlk_neuralnet_t *nn, char *str,
@@ -354,35 +780,18 @@ nlk_pv_gen_string(struct nlk_neuralnet_t *nn, char *str,
 
     nlk_layer_lookup_init(paragraphs);
 
-    /* unpack options */
-    unsigned int ctx_size = nn->context_opts.max_size;
-    unsigned int layer_size2 = 0;
-
-    if(nn->train_opts.hs) {
-        layer_size2 = nn->hs->weights->cols;
-    } else if(nn->train_opts.negative) {
-        layer_size2 = nn->neg->weights->cols;
-    }
+    /* slots, contexts, gradients */
+    struct nlk_pv_work_t *work = nlk_pv_work_thread(nn, 1);
 
     /* representation of the line as an array of pointer to strings */
-    char **tline = nlk_text_line_create();
-
-    struct nlk_line_t *line = nlk_line_create(NLK_MAX_LINE_SIZE);
+    if(work->text_line == NULL) {
+        work->text_line = nlk_text_line_create();
+        work->line = nlk_line_create(NLK_MAX_LINE_SIZE);
+    }
+    char **tline = work->text_line;
+    struct nlk_line_t *line = work->line;
     line->line_id = 0;
 
-    /* for converting a sentence to a series of training contexts */
-    struct nlk_context_t **contexts = NULL;
-    contexts = nlk_context_create_array(ctx_size);
-
-    /* for undersampling words in a line */
-    struct nlk_line_t *line_sample = nlk_line_create(NLK_MAX_LINE_SIZE);
-
-    /* output of the first layer */
-    NLK_ARRAY *layer1_out = nlk_array_create(layer_size2, 1);
-
-    /* for storing gradients */
-    NLK_ARRAY *grad_acc = nlk_array_create(1, layer_size2);
-
 
     /** @section Vocabularize & Generate Paragraph Vector
      */
@@ -391,23 +800,27 @@ nlk_pv_gen_string(struct nlk_neuralnet_t *nn, char *str,
     /* 1 - convert to **text_line */
     nlk_text_line_read(str, len, tline);
 
-    /* 2 - vocabularity */
-    line->len = nlk_vocab_vocabularize(&nn->vocab,  tline, NULL, line->varray); 
+    /* 2 - vocabularity: unknown words are dropped unless the model has 
+     * hash buckets to map them to (never to <UNK>) */
+    struct nlk_vocab_t *replacement = nlk_vocab_get_replacement(&nn->vocab);
+    if(replacement != NULL && replacement->type != NLK_VOCAB_BUCKET) {
+        replacement = NULL;
+    }
+    if(nn->subwords != NULL) {
+        line->len = nlk_subword_vocabularize(nn->subwords, &nn->vocab, tline,
+                                             replacement, line->varray);
+    } else {
+        line->len = nlk_vocab_vocabularize(&nn->vocab,  tline, replacement,
+                                           line->varray); 
+    }
  
 
     /* 3 - generate the paragraph vector */
-    nlk_pv_gen_line(nn, line, epochs, paragraphs, line_sample,
-                    contexts, grad_acc, layer1_out);
- 
-
-    /**@section Free memory 
-     */
-    nlk_text_line_free(tline);
-    nlk_line_free(line);
-    nlk_context_free_array(contexts);
-    nlk_line_free(line_sample);
-    nlk_array_free(layer1_out);
-    nlk_array_free(grad_acc);
+    struct nlk_pv_opts_t opts = { .epochs = epochs, .tol = 0, 
+                                  .init = NLK_PV_INIT_RANDOM, .table = NULL,
+                                  .batch = 1, .adagrad = 0, 
+                                  .iterations = 0 };
+    nlk_pv_gen_work(nn, line, 1, 0, &opts, paragraphs, work);
 
     return paragraphs;
 }
@@ -48,12 +48,80 @@
 __BEGIN_DECLS
 
 
+/** default number of lines a thread infers at once (1: one at a time; 
+ * interleaving more has not been measured to be faster) */
+#define NLK_PV_BATCH 1
+
+
+/** @enum NLK_PV_INIT
+ * How an inferred paragraph vector starts
+ */
+enum nlk_pv_init_t {
+    NLK_PV_INIT_RANDOM  = 0,    /**< random (as in training) */
+    NLK_PV_INIT_WORDS   = 1,    /**< average of the line's word vectors */
+    NLK_PV_INIT_TABLE   = 2     /**< row line_id of a previous PV table */
+};
+typedef enum nlk_pv_init_t NLK_PV_INIT;
+
+
+/** @struct nlk_pv_opts_t
+ * Paragraph vector inference options
+ */
+struct nlk_pv_opts_t {
+    unsigned int                     epochs;    /**< maximum iterations */
+    nlk_real                         tol;       /**< stop if relative change 
+                                                     in an iteration < tol */
+    NLK_PV_INIT                      init;      /**< initialization */
+    const struct nlk_layer_lookup_t *table;     /**< for NLK_PV_INIT_TABLE */
+    unsigned int                     batch;     /**< lines inferred at once */
+    nlk_real                         adagrad;   /**< AdaGrad learning rate
+                                                     (0: SGD) */
+    uint64_t                         iterations;/**< (out) iterations run */
+};
+typedef struct nlk_pv_opts_t NLK_PV_OPTS;
+
+
+/** @struct nlk_pv_work_t
+ * Per thread memory for PV inference (see nlk_pv_gen_work)
+ */
+struct nlk_pv_work_t {
+    struct nlk_pv_slot_t    *slots;         /**< lines inferred together */
+    size_t                   batch;         /**< number of slots */
+    struct nlk_context_t   **contexts;      /**< contexts of a line */
+    NLK_ARRAY               *layer1_out;    /**< output of the first layer */
+    NLK_ARRAY               *grad_acc;      /**< for accumulating gradients */
+    size_t                   pv_size;       /**< PV (word vector) size */
+    size_t                   ctx_size;      /**< contexts of a line */
+    const struct nlk_neuralnet_t *nn;       /**< network it was created for */
+    char                   **text_line;     /**< nlk_pv_gen_string input */
+    struct nlk_line_t       *line;          /**< nlk_pv_gen_string line */
+};
+
+
+NLK_PV_INIT nlk_pv_init_type(const char *);
+
 struct nlk_layer_lookup_t *nlk_pv_gen(struct nlk_neuralnet_t *, 
                                       const struct nlk_corpus_t *, 
                                       const unsigned int, const bool);
+struct nlk_layer_lookup_t *nlk_pv_gen_opts(struct nlk_neuralnet_t *, 
+                                           const struct nlk_corpus_t *, 
+                                           struct nlk_pv_opts_t *, 
+                                           const bool);
 struct nlk_layer_lookup_t *nlk_pv_gen_string(struct nlk_neuralnet_t *, char *,
                                              const unsigned int);
 
+struct nlk_pv_work_t *nlk_pv_work_create(const struct nlk_neuralnet_t *, 
+                                         const size_t);
+void nlk_pv_work_free(struct nlk_pv_work_t *);
+struct nlk_pv_work_t *nlk_pv_work_thread(const struct nlk_neuralnet_t *, 
+                                         const size_t);
+void nlk_pv_work_thread_free();
+void nlk_pv_threads_free();
+uint64_t nlk_pv_gen_work(struct nlk_neuralnet_t *, struct nlk_line_t *, 
+                         const size_t, const size_t, 
+                         const struct nlk_pv_opts_t *, 
+                         struct nlk_layer_lookup_t *, struct nlk_pv_work_t *);
+
 void nlk_pv_inference_mode(struct nlk_neuralnet_t *);
 void nlk_pv_learn_mode(struct nlk_neuralnet_t *);
 
@@ -31,31 +31,119 @@
 
 #include <errno.h>
 #include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
 
 #include <omp.h>
 
+#include "nlk.h"
 #include "nlk_tic.h"
 #include "nlk_neuralnet.h"
 #include "nlk_layer_lookup.h"
 #include "nlk_layer_linear.h"
 #include "nlk_transfer.h"
 #include "nlk_criterion.h"
+#include "nlk_exec.h"
 #include "nlk_learn_rate.h"
 #include "nlk_dataset.h"
+#include "nlk_class_score.h"
 #include "nlk_util.h"
 #include "nlk_text.h"
 #include "nlk_vocabulary.h"
 #include "nlk_w2v.h"
 #include "nlk_pv.h"
+#include "nlk_corpus.h"
+#include "nlk_random.h"
 
 
 #include "nlk_pv_class.h"
 
 
+/**
+ * Classify paragraph vectors with the float classifier, NLK_EXEC_BATCH at a
+ * time: each thread runs its own executor over its batches.
+ *
+ * @param nn        the neural network (with the classifier as last layer)
+ * @param par_table the paragraph vectors
+ * @param ids       the ids (rows) of the paragraphs to classify
+ * @param n         the number of ids
+ * @param pred      the predicted classes (result)
+ */
+static void
+nlk_pv_classify_exec(struct nlk_neuralnet_t *nn, 
+                     struct nlk_layer_lookup_t *par_table, const size_t *ids,
+                     const size_t n, unsigned int *pred)
+{
+    const NLK_TRANSFER transfer = NLK_TRANSFER_LOG_SOFTMAX;
+
+#pragma omp parallel
+{
+    struct nlk_exec_t *exec = nlk_exec_create_nn(nn, nn->n_layers - 1, 
+                                                 &transfer, 1, 
+                                                 NLK_EXEC_BATCH);
+    NLK_ARRAY pv;
+    size_t len;
+
+#pragma omp for
+    for(size_t start = 0; start < n; start += NLK_EXEC_BATCH) {
+        len = n - start < NLK_EXEC_BATCH ? n - start : NLK_EXEC_BATCH;
+
+        /* lookup the batch's paragraph vectors */
+        for(size_t ii = 0; ii < len; ii++) {
+            nlk_exec_input(exec, ii, &pv);
+            nlk_layer_lookup_forward_lookup_one(par_table, ids[start + ii], 
+                                                &pv);
+        }
+
+        /* linear layer (GEMM) and log softmax */
+        nlk_exec_forward(exec, len);
+        nlk_exec_predict(exec, len, &pred[start]);
+    }
+
+    nlk_exec_free(exec);
+} /* end of parallel region */
+}
+
+
+/**
+ * Classify paragraph vectors
+ *
+ * @param nn        the neural network (with the classifier as last layer)
+ * @param par_table the paragraph vectors
+ * @param ids       the ids (rows) of the paragraphs to classify
+ * @param n         the number of ids
+ * @param verbose   print progress
+ *
+ * @return the predicted classes
+ */
 unsigned int *
 nlk_pv_classify(struct nlk_neuralnet_t *nn, 
                 struct nlk_layer_lookup_t *par_table, size_t *ids, size_t n,
                 const bool verbose)
+{
+    return nlk_pv_classify_q8(nn, NULL, par_table, ids, n, verbose);
+}
+
+
+/**
+ * Classify paragraph vectors with a quantized classifier (or the float 
+ * classifier in the network if q8 is NULL)
+ *
+ * @param nn        the neural network (with the classifier as last layer)
+ * @param q8        the quantized classifier or NULL
+ * @param par_table the paragraph vectors
+ * @param ids       the ids (rows) of the paragraphs to classify
+ * @param n         the number of ids
+ * @param verbose   print progress
+ *
+ * @return the predicted classes
+ */
+unsigned int *
+nlk_pv_classify_q8(struct nlk_neuralnet_t *nn, 
+                   const struct nlk_layer_linear_q8_t *q8,
+                   struct nlk_layer_lookup_t *par_table, size_t *ids, 
+                   size_t n, const bool verbose)
 {
     /** @section Init
      */
@@ -75,24 +163,35 @@ nlk_pv_classify(struct nlk_neuralnet_t *nn,
     const size_t pv_size = par_table->weights->cols;
 
     /* softmax layer */
-    struct nlk_layer_linear_t *linear = nn->layers[nn->n_layers - 1].ll;
-    unsigned int n_classes = linear->weights->rows;
+    const size_t n_classes = nn->layers[nn->n_layers - 1].ll->weights->rows;
 
 
     /** @section Classify
      */
+    /* per batch loop: the phase's threads, no BLAS threads */
+    nlk_phase_begin(NLK_PHASE_EVAL);
+    if(q8 == NULL) {
+        nlk_pv_classify_exec(nn, par_table, ids, n, pred);
+        return pred;
+    }
+
 #pragma omp parallel
 {
     /** @subsection Parallel Initialization
      */
     /* paragraph id */
     size_t pid = 0;
+    /* scratch memory from the thread's workspace */
+    struct nlk_workspace_t *ws = nlk_workspace_thread();
+    const size_t mark = nlk_workspace_mark(ws);
     /* paragraph vector */
-    NLK_ARRAY *pv = nlk_array_create(pv_size, 1);    
+    NLK_ARRAY *pv = nlk_workspace_array(ws, pv_size, 1);
     /* output of the linear layer */
-    NLK_ARRAY *linear_out = nlk_array_create(n_classes, 1);
+    NLK_ARRAY *linear_out = nlk_workspace_array(ws, n_classes, 1);
     /* output of the softmax transfer (and thus the network) */
-    NLK_ARRAY *out = nlk_array_create(n_classes, 1);
+    NLK_ARRAY *out = nlk_workspace_array(ws, n_classes, 1);
+    /* quantized paragraph vector */
+    int8_t *pv_q8 = (int8_t *) nlk_workspace_alloc(ws, q8->cols_pad);
 
     /** @subsection Parallel Classify
      */
@@ -102,20 +201,420 @@ nlk_pv_classify(struct nlk_neuralnet_t *nn,
             pid = ids[tid];
             /* forward step 1: get paragraph vector (lookup) */
             nlk_layer_lookup_forward_lookup_one(par_table, pid, pv);
-            /* forward step 2: linear layer */
-            nlk_layer_linear_forward(linear, pv, linear_out);
+            /* forward step 2: int8 linear layer */
+            nlk_layer_linear_q8_forward(q8, pv, pv_q8, linear_out);
             /* forward step 3: softmax transfer */
             nlk_log_softmax_forward(linear_out, out);
 
             pred[tid] = nlk_array_max_i(out);
     }
 
+    nlk_workspace_reset(ws, mark);
 } /* end of parallel region */
 
     return pred;
 }
 
 
+/**
+ * Quantize the classifier (last layer of the network) to int8, calibrating
+ * the input scale on the first NLK_Q8_CALIBRATE rows of sample (PVs).
+ * If verbose, reports the agreement of the int8 and float predictions and 
+ * the speedup of the int8 classifier (single thread) on the same rows.
+ *
+ * @param nn        the neural network (with the classifier as last layer)
+ * @param sample    paragraph vectors, one per row
+ * @param verbose   print the report
+ *
+ * @return the quantized classifier
+ */
+struct nlk_layer_linear_q8_t *
+nlk_pv_class_quantize(struct nlk_neuralnet_t *nn, const NLK_ARRAY *sample,
+                      const bool verbose)
+{
+    struct nlk_layer_linear_t *linear = nn->layers[nn->n_layers - 1].ll;
+    const size_t n_classes = linear->weights->rows;
+    struct nlk_layer_linear_q8_t *q8;
+    NLK_ARRAY pv;
+    NLK_ARRAY *out_f = nlk_array_create(n_classes, 1);
+    NLK_ARRAY *out_q = nlk_array_create(n_classes, 1);
+    int8_t *pv_q8;
+    unsigned int *pred;
+    size_t agree = 0;
+    size_t reps;
+    size_t rows;
+    double start;
+    double t_float;
+    double t_q8;
+
+    /** @section Quantize and Calibrate
+     */
+    q8 = nlk_layer_linear_q8_create(linear);
+    nlk_layer_linear_q8_calibrate(q8, sample, NLK_Q8_CALIBRATE);
+    if(!verbose) {
+        nlk_array_free(out_f);
+        nlk_array_free(out_q);
+        return q8;
+    }
+
+    rows = sample->rows < NLK_Q8_CALIBRATE ? sample->rows : NLK_Q8_CALIBRATE;
+    pv_q8 = (int8_t *) malloc(q8->cols_pad * sizeof(int8_t));
+    pred = (unsigned int *) malloc(rows * sizeof(unsigned int));
+    if(pv_q8 == NULL || pred == NULL) {
+        NLK_ERROR_NULL("unable to allocate memory", NLK_ENOMEM);
+        /* unreachable */
+    }
+
+    /** @section Report: agreement and speed
+     * repeat so that at least NLK_Q8_CALIBRATE * 100 PVs are timed
+     */
+    pv.rows = sample->cols;
+    pv.cols = 1;
+    pv.len = sample->cols;
+    pv.mapped = 0;
+    pv.owner = NLK_ARRAY_OWNER_HEAP;
+    reps = 1 + NLK_Q8_CALIBRATE * 100 / (rows + 1);
+
+    start = omp_get_wtime();
+    for(size_t rr = 0; rr < reps; rr++) {
+        for(size_t ii = 0; ii < rows; ii++) {
+            pv.data = &sample->data[ii * sample->cols];
+            nlk_layer_linear_forward(linear, &pv, out_f);
+            pred[ii] = nlk_array_max_i(out_f);
+        }
+    }
+    t_float = omp_get_wtime() - start;
+
+    start = omp_get_wtime();
+    for(size_t rr = 0; rr < reps; rr++) {
+        for(size_t ii = 0; ii < rows; ii++) {
+            pv.data = &sample->data[ii * sample->cols];
+            nlk_layer_linear_q8_forward(q8, &pv, pv_q8, out_q);
+            if(rr == 0 && nlk_array_max_i(out_q) == pred[ii]) {
+                agree++;
+            }
+        }
+    }
+    t_q8 = omp_get_wtime() - start;
+
+    printf("int8 classifier: input scale %g, agreement with float "
+           "%.2f%% (%zu/%zu), speedup %.2fx (%.3fs float, %.3fs int8)\n",
+           q8->in_scale, 100.0 * agree / rows, agree, rows, 
+           t_float / t_q8, t_float, t_q8);
+
+    nlk_array_free(out_f);
+    nlk_array_free(out_q);
+    free(pv_q8);
+    free(pred);
+
+    return q8;
+}
+
+
+/**
+ * Read the next chunk of lines (at most NLK_PV_STREAM_CHUNK) of a stream.
+ * The vocabularized words are copied to a pool that grows as needed and is 
+ * kept between chunks.
+ *
+ * @param nn        the neural network (vocabulary, subwords)
+ * @param fd        the file to read from
+ * @param text_line memory for a line of text
+ * @param buf       memory for reading
+ * @param vline     memory for vocabularizing a line
+ * @param lines     the chunk's lines (output)
+ * @param ids       the chunk's line ids as in the file (output)
+ * @param pool      the pool of words (in/out)
+ * @param pool_size the size of the pool (in/out)
+ * @param eof       set when the end of the file is reached
+ *
+ * @return the number of lines read
+ */
+static size_t
+nlk_pv_stream_read(struct nlk_neuralnet_t *nn, int fd, char **text_line, 
+                   char *buf, struct nlk_line_t *vline, 
+                   struct nlk_line_t *lines, size_t *ids, 
+                   struct nlk_vocab_t ***pool, size_t *pool_size, bool *eof)
+{
+    struct nlk_vocab_t *replacement = nlk_vocab_get_replacement(&nn->vocab);
+    size_t offsets[NLK_PV_STREAM_CHUNK];
+    size_t used = 0;
+    size_t n = 0;
+    int ret;
+
+    while(!*eof && n < NLK_PV_STREAM_CHUNK) {
+        ret = nlk_corpus_read_vocabularize(fd, &nn->vocab, nn->subwords, 
+                                           replacement, text_line, vline, 
+                                           buf);
+        if(ret == EOF) {
+            *eof = true;
+            if(text_line[0][0] == '\0') {
+                break;
+            }
+        }
+
+        /* copy the words to the pool */
+        if(used + vline->len > *pool_size) {
+            *pool_size = 2 * (used + vline->len);
+            *pool = (struct nlk_vocab_t **) 
+                    realloc(*pool, *pool_size * sizeof(struct nlk_vocab_t *));
+            if(*pool == NULL) {
+                NLK_ERROR_ABORT("unable to allocate memory for lines", 
+                                NLK_ENOMEM);
+                /* unreachable */
+            }
+        }
+        memcpy(&(*pool)[used], vline->varray, 
+               vline->len * sizeof(struct nlk_vocab_t *));
+
+        offsets[n] = used;
+        lines[n].len = vline->len;
+        ids[n] = vline->line_id;
+        used += vline->len;
+        n++;
+    }
+
+    /* the pool may have moved */
+    for(size_t ii = 0; ii < n; ii++) {
+        lines[ii].varray = &(*pool)[offsets[ii]];
+    }
+
+    return n;
+}
+
+
+/** @struct nlk_pv_stream_chunk_t
+ * A chunk of lines read from a stream (see nlk_pv_stream_read)
+ */
+struct nlk_pv_stream_chunk_t {
+    struct nlk_line_t    lines[NLK_PV_STREAM_CHUNK];    /**< the lines */
+    size_t               ids[NLK_PV_STREAM_CHUNK];      /**< ids in the file */
+    struct nlk_vocab_t **pool;                          /**< words of lines */
+    size_t               pool_size;                     /**< size of pool */
+    size_t               n;                             /**< lines read */
+    size_t               base;                          /**< first line */
+};
+
+
+/**
+ * Streaming classification: the file is read NLK_PV_STREAM_ROUND chunks
+ * per thread at a time; the threads then infer the PVs of a chunk into 
+ * their own (reused) paragraph table, classify them and write "id class 
+ * score" lines in file order (an ordered loop). 
+ * Memory does not depend on the size of the file.
+ *
+ * Lines are numbered in file order. The number is the PV's random stream 
+ * (see nlk_pv_gen_work) and its row in opts->table (NLK_PV_INIT_TABLE). 
+ * The id written is the line's id in the file or, if it has none, its number.
+ *
+ * @param nn        the neural network (with the classifier as last layer)
+ * @param q8        quantized classifier to use instead or NULL
+ * @param in_path   the file to classify (id-text lines)
+ * @param out_path  the output file (NULL for stdout)
+ * @param opts      the inference options (iterations run is stored here)
+ * @param verbose   display progress
+ *
+ * @return the number of lines classified
+ */
+size_t
+nlk_pv_classify_stream(struct nlk_neuralnet_t *nn, 
+                       const struct nlk_layer_linear_q8_t *q8, 
+                       const char *in_path, const char *out_path, 
+                       struct nlk_pv_opts_t *opts, const bool verbose)
+{
+    FILE *out = stdout;
+    const size_t pv_size = nn->words->weights->cols;
+    const nlk_real low = -0.5 / pv_size;
+    const nlk_real high = 0.5 / pv_size;
+    struct nlk_layer_linear_t *linear = nn->layers[nn->n_layers - 1].ll;
+    const unsigned int n_classes = linear->weights->rows;
+    const double start = omp_get_wtime();
+    double secs;
+    size_t n_chunks = 0;        /* chunks read in this round */
+    size_t total = 0;           /* lines read */
+    bool eof = false;
+    uint64_t iterations = 0;
+
+    int fd = nlk_open(in_path);
+    if(out_path != NULL) {
+        out = fopen(out_path, "w");
+        if(out == NULL) {
+            NLK_ERROR_ABORT(strerror(errno), errno);
+            /* unreachable */
+        }
+    }
+
+    /* prevent weights from changing for words and hs/neg */
+    nlk_pv_inference_mode(nn);
+
+    /* per example loop: the phase's threads, no BLAS threads */
+    const int num_threads = nlk_phase_begin(NLK_PHASE_INFER);
+    const size_t round = NLK_PV_STREAM_ROUND * num_threads;
+
+    /* reading (one thread at a time) */
+    char **text_line = nlk_text_line_create();
+    char *buffer = (char *) malloc(sizeof(char) * NLK_BUFFER_SIZE);
+    struct nlk_line_t *vline = nlk_line_create(NLK_MAX_LINE_SIZE);
+    struct nlk_pv_stream_chunk_t *chunks = (struct nlk_pv_stream_chunk_t *)
+                        calloc(round, sizeof(struct nlk_pv_stream_chunk_t));
+    if(buffer == NULL || chunks == NULL) {
+        NLK_ERROR_ABORT("unable to allocate memory for buffering", NLK_ENOMEM);
+        /* unreachable */
+    }
+
+
+    /** @section Stream
+     */
+#pragma omp parallel reduction(+ : iterations)
+{
+    /** @subsection Thread Memory
+     */
+    struct nlk_rng_t rng;
+
+    /* inference */
+    struct nlk_pv_work_t *work = nlk_pv_work_thread(nn, opts->batch);
+    struct nlk_layer_lookup_t *par_table;
+    par_table = nlk_layer_lookup_create(NLK_PV_STREAM_CHUNK, pv_size);
+    if(opts->adagrad > 0) {
+        nlk_layer_lookup_adagrad(par_table, opts->adagrad);
+    }
+
+    /* classification: float with an executor (a chunk at a time), int8 
+     * with scratch memory from the thread's workspace */
+    const NLK_TRANSFER transfer = NLK_TRANSFER_LOG_SOFTMAX;
+    struct nlk_exec_t *exec = NULL;
+    struct nlk_workspace_t *ws = nlk_workspace_thread();
+    const size_t mark = nlk_workspace_mark(ws);
+    NLK_ARRAY *pv = nlk_workspace_array(ws, pv_size, 1);
+    NLK_ARRAY *linear_out = nlk_workspace_array(ws, n_classes, 1);
+    NLK_ARRAY *class_out = nlk_workspace_array(ws, n_classes, 1);
+    NLK_ARRAY row;
+    int8_t *pv_q8 = NULL;
+    if(q8 != NULL) {
+        pv_q8 = (int8_t *) nlk_workspace_alloc(ws, q8->cols_pad);
+    } else {
+        exec = nlk_exec_create_nn(nn, nn->n_layers - 1, &transfer, 1, 
+                                  NLK_PV_STREAM_CHUNK);
+    }
+    unsigned int pred[NLK_PV_STREAM_CHUNK];
+    nlk_real score[NLK_PV_STREAM_CHUNK];
+
+    while(true) {
+        /** @subsection Read the next chunks
+         */
+#pragma omp single
+{
+        for(n_chunks = 0; n_chunks < round && !eof; n_chunks++) {
+            struct nlk_pv_stream_chunk_t *c = &chunks[n_chunks];
+            c->base = total;
+            c->n = nlk_pv_stream_read(nn, fd, text_line, buffer, vline, 
+                                      c->lines, c->ids, &c->pool, 
+                                      &c->pool_size, &eof);
+            if(c->n == 0) {
+                break;
+            }
+            total += c->n;
+        }
+} /* end of single (barrier) */
+        if(n_chunks == 0) {
+            break;
+        }
+
+#pragma omp for ordered schedule(dynamic, 1)
+        for(size_t cc = 0; cc < n_chunks; cc++) {
+            struct nlk_line_t *lines = chunks[cc].lines;
+            const size_t *ids = chunks[cc].ids;
+            const size_t base = chunks[cc].base;
+            const size_t n = chunks[cc].n;
+
+            /** @subsection Infer
+             * random initialization from a stream that is not a line's
+             */
+            for(size_t ii = 0; ii < n; ii++) {
+                lines[ii].line_id = base + ii;
+            }
+            nlk_rng_init_stream(&rng, ~(uint64_t) base);
+            for(size_t ii = 0; ii < n * pv_size; ii++) {
+                par_table->weights->data[ii] = low + (high - low) * 
+                                        nlk_rng_to_float(nlk_rng_next(&rng));
+            }
+            iterations += nlk_pv_gen_work(nn, lines, n, base, opts, 
+                                          par_table, work);
+
+            /** @subsection Classify
+             */
+            if(exec != NULL) {
+                for(size_t ii = 0; ii < n; ii++) {
+                    nlk_exec_input(exec, ii, &row);
+                    nlk_layer_lookup_forward_lookup_one(par_table, ii, &row);
+                }
+                nlk_exec_forward(exec, n);
+                nlk_exec_predict(exec, n, pred);
+                for(size_t ii = 0; ii < n; ii++) {
+                    nlk_exec_output(exec, ii, &row);
+                    score[ii] = exp(row.data[pred[ii]]);
+                }
+            } else {
+                for(size_t ii = 0; ii < n; ii++) {
+                    nlk_layer_lookup_forward_lookup_one(par_table, ii, pv);
+                    nlk_layer_linear_q8_forward(q8, pv, pv_q8, linear_out);
+                    nlk_log_softmax_forward(linear_out, class_out);
+                    pred[ii] = nlk_array_max_i(class_out);
+                    score[ii] = exp(class_out->data[pred[ii]]);
+                }
+            }
+
+            /** @subsection Write (in order)
+             */
+#pragma omp ordered
+{
+            for(size_t ii = 0; ii < n; ii++) {
+                fprintf(out, "%zu %u %f\n", 
+                        ids[ii] != (size_t) -1 ? ids[ii] : base + ii, 
+                        pred[ii], score[ii]);
+            }
+            if(verbose) {
+                secs = omp_get_wtime() - start;
+                fprintf(stderr, "\rClassified: %zu (%.1f docs/sec)", 
+                        base + n, (base + n) / secs);
+            }
+} /* end of ordered */
+        } /* end of chunks (barrier) */
+    }
+
+    /* free thread memory */
+    nlk_layer_lookup_free(par_table);
+    nlk_exec_free(exec);
+    nlk_workspace_reset(ws, mark);
+} /* end of parallel region */
+
+    /* free reading memory */
+    for(size_t cc = 0; cc < round; cc++) {
+        free(chunks[cc].pool);
+    }
+    free(chunks);
+    nlk_text_line_free(text_line);
+    free(buffer);
+    nlk_line_free(vline);
+
+    nlk_pv_learn_mode(nn);
+    close(fd);
+    if(out != stdout) {
+        fclose(out);
+    }
+    opts->iterations = iterations;
+
+    /* throughput */
+    secs = omp_get_wtime() - start;
+    if(verbose) {
+        fprintf(stderr, "\n");
+    }
+    fprintf(stderr, "Classified %zu documents in %.2f seconds "
+            "(%.1f docs/sec)\n", total, secs, total / secs);
+
+    return total;
+}
+
+
 /**
  * Train a PV vector softmax classifier
  */
@@ -131,34 +630,22 @@ nlk_pv_class_train(struct nlk_neuralnet_t *nn, struct nlk_dataset_t *dset,
     /* paragraph lookup table */
     struct nlk_layer_lookup_t *par_table = nn->paragraphs; 
 
-    /* PV size */
-    const size_t pv_size = par_table->weights->cols;
-
-    /* softmax layer */
-    struct nlk_layer_linear_t *linear = nn->layers[nn->n_layers - 1].ll;
-    const unsigned int n_classes = dset->n_classes;
-    /* n_classes should be equal to linear->weights->rows */
+    /* softmax layer (n_classes should be equal to its output size) */
+    const NLK_TRANSFER transfer = NLK_TRANSFER_LOG_SOFTMAX;
+    struct nlk_exec_t *exec = nlk_exec_create_nn(nn, nn->n_layers - 1, 
+                                                 &transfer, 1, 1);
 
     /* dataset */
     const size_t size = dset->size;
 
 
     /** @section Train Classes
+     * one example at a time (SGD)
      */
     size_t pid; /* the parapraph id */
-    /* paragraph vector */
-    NLK_ARRAY *pv = nlk_array_create(pv_size, 1);    
-    /* output of the linear layer */
-    NLK_ARRAY *linear_out = nlk_array_create(n_classes, 1);
-    /* output of the softmax transfer (and thus the network) */
-    NLK_ARRAY *out = nlk_array_create(n_classes, 1);
-
-    /* gradient at output */
-    NLK_ARRAY *grad_out = nlk_array_create(n_classes, 1);
-    /* gradient at softmax input = gradient at linear output */
-    NLK_ARRAY *grad_sm_in = nlk_array_create(n_classes, 1);
-    /* gradient at linear layer input */
-    NLK_ARRAY *grad_in = nlk_array_create(pv_size, 1);
+    /* paragraph vector: the input */
+    NLK_ARRAY pv;
+    nlk_exec_input(exec, 0, &pv);
 
 
     /** @subsection Train Cycle
@@ -170,6 +657,7 @@ nlk_pv_class_train(struct nlk_neuralnet_t *nn, struct nlk_dataset_t *dset,
 
         /* shuffle the data */
         nlk_dataset_shuffle(dset);
+        nlk_exec_learn_rate(exec, learn_rate, false);
 
         /* for each pv */
         for(size_t tid = 0; tid < size; tid++) {
@@ -179,36 +667,24 @@ nlk_pv_class_train(struct nlk_neuralnet_t *nn, struct nlk_dataset_t *dset,
             pid = dset->ids[tid];
 
             /* forward step 1: get paragraph vector (lookup) */
-            nlk_layer_lookup_forward_lookup_one(par_table, pid, pv);
-
-            /* forward step 2: linear layer */
-            nlk_layer_linear_forward(linear, pv, linear_out);
-
-            /* forward step 3: softmax transfer */
-            nlk_log_softmax_forward(linear_out, out);
+            nlk_layer_lookup_forward_lookup_one(par_table, pid, &pv);
 
+            /* forward step 2: linear layer and log softmax transfer */
+            nlk_exec_forward(exec, 1);
 
             /* check result */
-            pred = nlk_array_max_i(out);
+            nlk_exec_predict(exec, 1, &pred);
             if(pred == dset->classes[tid]) {
                 correct++;
             }
 
 
             /** @subsection Backpropation 
+             * Negative Log Likelihood, softmax transfer and linear layer
+             * no need for the gradient at input, just update parameters
              */
-            /* Backprop step 1: Negative Log Likelihood */
-            nlk_nll_backprop(out, dset->classes[tid], grad_out);
-
-            /* apply learning rate */
-            nlk_array_scale(learn_rate, grad_out);
-
-            /* Backprop step 2: softmax transfer */
-            nlk_log_softmax_backprop(out, grad_out, grad_sm_in); 
-
-            /* Backprop step3: linear layer
-             * no need to update gradient at input, just update parameters: */
-            nlk_layer_linear_update_parameters(linear, pv, grad_sm_in);
+            nlk_exec_nll_backprop(exec, 1, &dset->classes[tid]);
+            nlk_exec_backward(exec, 1, false);
 
         } /* end of paragraphs */
 
@@ -225,12 +701,7 @@ nlk_pv_class_train(struct nlk_neuralnet_t *nn, struct nlk_dataset_t *dset,
 
     /** @subsection Cleanup 
      */
-    nlk_array_free(pv);
-    nlk_array_free(linear_out);
-    nlk_array_free(out);
-    nlk_array_free(grad_out);
-    nlk_array_free(grad_sm_in);
-    nlk_array_free(grad_in);
+    nlk_exec_free(exec);
 
     return accuracy;
 }
@@ -305,6 +776,7 @@ nlk_pv_classify_test(struct nlk_neuralnet_t *nn, const char *test_path,
     float rec = 0;
     unsigned int *pred;
     struct nlk_dataset_t *test_set = NULL;
+    struct nlk_class_score_t *score = NULL;
     test_set = nlk_dataset_load_path(test_path);
     if(test_set == NULL) {
         NLK_ERROR("invalid test set", NLK_FAILURE);
@@ -314,22 +786,23 @@ nlk_pv_classify_test(struct nlk_neuralnet_t *nn, const char *test_path,
     pred = nlk_pv_classify(nn, nn->paragraphs, test_set->ids, test_set->size,
                            verbose);
 
-    ac = nlk_class_score_accuracy(pred, test_set->classes, test_set->size);
-    f1 = nlk_class_score_semeval_senti_f1(pred, test_set->classes, 
-                                          test_set->size, 2, 0);
+    /* count once, derive all scores from the counts */
+    score = nlk_class_score_create(pred, test_set->classes, test_set->size);
+    ac = nlk_class_score_get_accuracy(score);
+    f1 = nlk_class_score_get_semeval(score, 2, 0);
     if(verbose) {
         nlk_dataset_print_class_dist(test_set);
         printf("\nTEST SCORE (ACCURACY) = %f\n", ac);
         printf("TEST SCORE (SEMEVAL F1) = %f\n", f1);
-        f1 = nlk_class_score_f1pr_class(pred, test_set->classes, 
-                                        test_set->size, 2, &prec, &rec);
+        f1 = nlk_class_score_get_f1pr(score, 2, &prec, &rec);
         printf("\tpos: prec = %.3f, rec = %.3f, f1 = %.3f\n", prec, rec, f1);
-        f1 = nlk_class_score_f1pr_class(pred, test_set->classes, 
-                                        test_set->size, 0, &prec, &rec);
+        f1 = nlk_class_score_get_f1pr(score, 0, &prec, &rec);
         printf("\tneg: prec = %.3f, rec = %.3f, f1 = %.3f\n", prec, rec, f1);
 
-        nlk_class_score_cm_print(pred, test_set->classes, test_set->size);
+        nlk_class_score_print(score);
+        nlk_class_score_print_cm(score);
     }
+    nlk_class_score_free(score);
 
     free(pred);
     nlk_dataset_free(test_set);
@@ -44,9 +44,26 @@
 __BEGIN_DECLS
 
 
+/** lines a thread reads, infers and classifies at once (streaming) */
+#define NLK_PV_STREAM_CHUNK 256
+
+/** chunks read per thread before they are classified (streaming) */
+#define NLK_PV_STREAM_ROUND 2
+
+/** PVs used to calibrate the quantized classifier */
+#define NLK_Q8_CALIBRATE 1000
+
+
 unsigned int *nlk_pv_classify(struct nlk_neuralnet_t *, 
                               struct nlk_layer_lookup_t *, size_t *, size_t,
                               const bool);
+unsigned int *nlk_pv_classify_q8(struct nlk_neuralnet_t *, 
+                                 const struct nlk_layer_linear_q8_t *,
+                                 struct nlk_layer_lookup_t *, size_t *, 
+                                 size_t, const bool);
+struct nlk_layer_linear_q8_t *nlk_pv_class_quantize(struct nlk_neuralnet_t *,
+                                                    const NLK_ARRAY *, 
+                                                    const bool);
 
 float nlk_pv_classifier(struct nlk_neuralnet_t *, struct nlk_dataset_t *,
                         const unsigned int, nlk_real, 
@@ -55,6 +72,11 @@ float nlk_pv_classifier(struct nlk_neuralnet_t *, struct nlk_dataset_t *,
 
 float nlk_pv_classify_test(struct nlk_neuralnet_t *, const char *, const bool);
 
+size_t nlk_pv_classify_stream(struct nlk_neuralnet_t *, 
+                              const struct nlk_layer_linear_q8_t *,
+                              const char *, const char *, 
+                              struct nlk_pv_opts_t *, const bool);
+
 
 
 
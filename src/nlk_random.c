@@ -28,7 +28,12 @@
  */
 
 #include <stdint.h>
+#include <stdbool.h>
 #include <time.h>
+#include <omp.h>
+
+#include "nlk_err.h"
+#include "nlk_random.h"
 
 
 /**
@@ -68,6 +73,8 @@ nlk_random_xs64(uint64_t *x) {
 
 static uint64_t __s[16];
 static int __p;
+static uint64_t __seed;             /**< seed for thread batch generators */
+static uint64_t __region = 1;       /**< thread stream base (reseed/region) */
 /**
  * xorshift1024*
  * Written in 2014 by Sebastiano Vigna (vigna@acm.org)
@@ -104,6 +111,8 @@ void
 nlk_random_init_xs1024(uint64_t seed)
 {
     uint64_t init;
+    __seed = seed;
+    __region++;     /* thread generators are reseeded on next use */
     init = nlk_random_fmix(seed);
     for(int ii = 0; ii < 16; ii++) {
         nlk_random_xs64(&init);
@@ -126,3 +135,216 @@ nlk_random_seed()
 
     return seed;
 }
+
+
+/**
+ * Initializes a batch generator: each lane gets its own xoshiro256** state
+ *
+ * @param rng   the generator
+ * @param seed  the seed
+ */
+void
+nlk_rng_init(struct nlk_rng_t *rng, uint64_t seed)
+{
+    uint64_t init = nlk_random_fmix(seed) | 1; /* xorshift64* needs != 0 */
+
+    for(int ii = 0; ii < 4; ii++) {
+        for(int ll = 0; ll < NLK_RNG_LANES; ll++) {
+            nlk_random_xs64(&init);
+            rng->s[ii][ll] = init;
+        }
+    }
+    rng->pos = NLK_RNG_BLOCK; /* empty: first use refills */
+}
+
+/**
+ * Generates n random numbers. Each step advances all lanes at once; the 
+ * lane loops have no dependencies between lanes and are vectorized by the 
+ * compiler (the xoshiro256** multiplications by 5 and 9 are shifts and adds).
+ *
+ * @param rng   the generator
+ * @param out   the random numbers (output)
+ * @param n     how many numbers to generate
+ */
+void
+nlk_rng_fill(struct nlk_rng_t *rng, uint64_t *out, size_t n)
+{
+    uint64_t *s0 = rng->s[0];
+    uint64_t *s1 = rng->s[1];
+    uint64_t *s2 = rng->s[2];
+    uint64_t *s3 = rng->s[3];
+    uint64_t r[NLK_RNG_LANES];
+    uint64_t t;
+    size_t pos = 0;
+
+    while(pos < n) {
+        for(int ll = 0; ll < NLK_RNG_LANES; ll++) {
+            t = s1[ll] * 5;
+            r[ll] = ((t << 7) | (t >> 57)) * 9;
+            t = s1[ll] << 17;
+            s2[ll] ^= s0[ll];
+            s3[ll] ^= s1[ll];
+            s1[ll] ^= s2[ll];
+            s0[ll] ^= s3[ll];
+            s2[ll] ^= t;
+            s3[ll] = (s3[ll] << 45) | (s3[ll] >> 19);
+        }
+        for(int ll = 0; ll < NLK_RNG_LANES && pos < n; ll++, pos++) {
+            out[pos] = r[ll];
+        }
+    }
+}
+
+/**
+ * Initializes a batch generator for a numbered stream (e.g. a document id) 
+ * derived from the seed given to nlk_random_init_xs1024: the same stream
+ * gives the same numbers regardless of thread or order of use.
+ *
+ * @param rng       the generator
+ * @param stream    the stream number
+ */
+void
+nlk_rng_init_stream(struct nlk_rng_t *rng, uint64_t stream)
+{
+    /* distinct from the thread streams */
+    nlk_rng_init(rng, ~__seed ^ nlk_random_fmix(stream + 1));
+}
+
+static __thread struct nlk_rng_t __rng;
+static __thread uint64_t __rng_region = 0;  /**< region of __rng, 0 = none */
+static __thread int __rng_tid = -1;         /**< thread number of __rng */
+static __thread struct nlk_rng_t *__rng_cur = NULL;
+
+/**
+ * Starts a new set of thread streams: the next call to nlk_rng_thread in 
+ * each thread reinitializes its generator. Call before a parallel region 
+ * (see nlk_phase_begin), not inside one.
+ */
+void
+nlk_rng_region()
+{
+    __region++;
+}
+
+/**
+ * The calling thread's batch generator. The stream is derived from the seed
+ * given to nlk_random_init_xs1024, the current region (see nlk_rng_region)
+ * and the OpenMP thread number, so it does not depend on scheduling.
+ * Unless another generator was set with nlk_rng_thread_set.
+ *
+ * @return the generator
+ */
+struct nlk_rng_t *
+nlk_rng_thread()
+{
+    if(__rng_cur != NULL) {
+        return __rng_cur;
+    }
+    const int tid = omp_get_thread_num();
+    if(__rng_region != __region || __rng_tid != tid) {
+        const uint64_t stream = (__region << 32) + (uint64_t) tid;
+        nlk_rng_init(&__rng, __seed ^ nlk_random_fmix(stream + 1));
+        __rng_region = __region;
+        __rng_tid = tid;
+    }
+    return &__rng;
+}
+
+/**
+ * Make rng the generator returned by nlk_rng_thread for the calling thread
+ * (e.g. to give each document its own stream). NULL restores the thread's 
+ * own generator.
+ *
+ * @param rng   the generator or NULL
+ *
+ * @return the previously set generator (or NULL)
+ */
+struct nlk_rng_t *
+nlk_rng_thread_set(struct nlk_rng_t *rng)
+{
+    struct nlk_rng_t *prev = __rng_cur;
+    __rng_cur = rng;
+    return prev;
+}
+
+/**
+ * Returns n contiguous unused numbers from the generator buffer (n <= block)
+ */
+static inline const uint64_t *
+nlk_rng_take(struct nlk_rng_t *rng, const size_t n)
+{
+    const uint64_t *r;
+
+    if(NLK_RNG_BLOCK - rng->pos < n) {
+        nlk_rng_fill(rng, rng->buf, NLK_RNG_BLOCK);
+        rng->pos = 0;
+    }
+    r = &rng->buf[rng->pos];
+    rng->pos += n;
+
+    return r;
+}
+
+/**
+ * Draws a batch of negative examples from the negative sampling table
+ *
+ * @param rng           the generator
+ * @param table         the negative sampling table
+ * @param table_size    the size of the table
+ * @param n             the number of negative examples
+ * @param out           the negative examples (output)
+ */
+void
+nlk_rng_negatives(struct nlk_rng_t *rng, const size_t *table, 
+                  const size_t table_size, const size_t n, size_t *out)
+{
+    for(size_t done = 0; done < n; done += NLK_RNG_BLOCK) {
+        const size_t m = n - done < NLK_RNG_BLOCK ? n - done : NLK_RNG_BLOCK;
+        const uint64_t *r = nlk_rng_take(rng, m);
+        for(size_t ii = 0; ii < m; ii++) {
+            out[done + ii] = table[nlk_rng_to_range(r[ii], table_size)];
+        }
+    }
+}
+
+/**
+ * Draws a batch of random window sizes in [1, max]
+ *
+ * @param rng   the generator
+ * @param max   the maximum window size (> 0)
+ * @param n     the number of windows
+ * @param out   the window sizes (output)
+ */
+void
+nlk_rng_windows(struct nlk_rng_t *rng, const unsigned int max, 
+                const size_t n, unsigned int *out)
+{
+    for(size_t done = 0; done < n; done += NLK_RNG_BLOCK) {
+        const size_t m = n - done < NLK_RNG_BLOCK ? n - done : NLK_RNG_BLOCK;
+        const uint64_t *r = nlk_rng_take(rng, m);
+        for(size_t ii = 0; ii < m; ii++) {
+            out[done + ii] = nlk_rng_to_range(r[ii], max) + 1;
+        }
+    }
+}
+
+/**
+ * Draws a batch of keep/drop decisions: keep[ii] with probability prob[ii]
+ *
+ * @param rng   the generator
+ * @param prob  the keep probabilities
+ * @param n     the number of decisions
+ * @param keep  the decisions (output)
+ */
+void
+nlk_rng_keep(struct nlk_rng_t *rng, const float *prob, const size_t n, 
+             bool *keep)
+{
+    for(size_t done = 0; done < n; done += NLK_RNG_BLOCK) {
+        const size_t m = n - done < NLK_RNG_BLOCK ? n - done : NLK_RNG_BLOCK;
+        const uint64_t *r = nlk_rng_take(rng, m);
+        for(size_t ii = 0; ii < m; ii++) {
+            keep[done + ii] = nlk_rng_to_float(r[ii]) < prob[done + ii];
+        }
+    }
+}
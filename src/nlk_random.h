@@ -32,6 +32,8 @@
 
 
 #include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
 
 
 #undef __BEGIN_DECLS
@@ -46,12 +48,74 @@
 __BEGIN_DECLS
 
 
+#define NLK_RNG_LANES 8     /**< independent xoshiro256** streams (SIMD) */
+#define NLK_RNG_BLOCK 256   /**< numbers generated per refill */
+
+
+/** @struct nlk_rng_t
+ * Per-thread batch generator: NLK_RNG_LANES xoshiro256** generators stored
+ * as a structure of arrays so a refill step is vectorized across lanes.
+ * Numbers are generated NLK_RNG_BLOCK at a time into buf.
+ */
+struct nlk_rng_t {
+    uint64_t    s[4][NLK_RNG_LANES];    /**< lane states */
+    uint64_t    buf[NLK_RNG_BLOCK];     /**< generated numbers */
+    size_t      pos;                    /**< next unused number in buf */
+};
+
+
 uint64_t    nlk_random_fmix(uint64_t);
 uint64_t    nlk_random_xs1024();
 float       nlk_random_xs1024_float();
 void        nlk_random_init_xs1024(uint64_t seed);
 uint64_t    nlk_random_seed();
 
+/* batch generator */
+void                nlk_rng_init(struct nlk_rng_t *, uint64_t);
+void                nlk_rng_fill(struct nlk_rng_t *, uint64_t *, size_t);
+void                nlk_rng_init_stream(struct nlk_rng_t *, uint64_t);
+void                nlk_rng_region();
+struct nlk_rng_t   *nlk_rng_thread();
+struct nlk_rng_t   *nlk_rng_thread_set(struct nlk_rng_t *);
+void                nlk_rng_negatives(struct nlk_rng_t *, const size_t *,
+                                      const size_t, const size_t, size_t *);
+void                nlk_rng_windows(struct nlk_rng_t *, const unsigned int, 
+                                    const size_t, unsigned int *);
+void                nlk_rng_keep(struct nlk_rng_t *, const float *, 
+                                 const size_t, bool *);
+
+
+/**
+ * Next number from a batch generator
+ */
+static inline uint64_t
+nlk_rng_next(struct nlk_rng_t *rng)
+{
+    if(rng->pos == NLK_RNG_BLOCK) {
+        nlk_rng_fill(rng, rng->buf, NLK_RNG_BLOCK);
+        rng->pos = 0;
+    }
+    return rng->buf[rng->pos++];
+}
+
+/**
+ * Uniform float in [0, 1[ from a 64 bit random number (24 bit mantissa)
+ */
+static inline float
+nlk_rng_to_float(const uint64_t r)
+{
+    return (r >> 40) * (1.0f / 16777216.0f);
+}
+
+/**
+ * Maps a 64 bit random number to [0, n[ (multiply-shift, no division)
+ */
+static inline uint64_t
+nlk_rng_to_range(const uint64_t r, const uint64_t n)
+{
+    return (uint64_t) (((unsigned __int128) r * n) >> 64);
+}
+
 
 
 __END_DECLS
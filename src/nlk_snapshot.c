@@ -0,0 +1,377 @@
+/******************************************************************************
+ * NLK - Neural Language Kit
+ *
+ * Copyright (c) 2015 Luis Rei <me@luisrei.com> http://luisrei.com @lmrei
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to 
+ * deal in the Software without restriction, including without limitation the 
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or 
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ *****************************************************************************/
+
+
+/** @file nlk_snapshot.c
+ * Read-only model snapshots published while training
+ *
+ * One writer at a time (the training thread that reaches the publication
+ * interval first, the others skip) copies the tables into a snapshot that no
+ * reader holds and swaps it in as the current one. Readers pin the current 
+ * snapshot: they increment its pin count and check it is still current, 
+ * retrying otherwise. A replaced snapshot is retired until its pin count
+ * drops to zero and is then reused for a later publication. Snapshots are
+ * only freed with the publisher, so a reader that loses the race only ever
+ * touches the pin count of a valid snapshot.
+ */
+
+
+#include <stdlib.h>
+#include <stdbool.h>
+
+#include "nlk_err.h"
+#include "nlk_array.h"
+#include "nlk_layer_lookup.h"
+#include "nlk_neuralnet.h"
+#include "nlk_subword.h"
+
+#include "nlk_snapshot.h"
+
+
+/**
+ * Create a publisher
+ *
+ * @param interval  words trained between publications (0: only explicit
+ *                  calls to nlk_publisher_publish publish)
+ *
+ * @return the publisher (nothing published yet)
+ */
+struct nlk_publisher_t *
+nlk_publisher_create(const size_t interval)
+{
+    struct nlk_publisher_t *pub;
+
+    pub = (struct nlk_publisher_t *) malloc(sizeof(struct nlk_publisher_t));
+    if(pub == NULL) {
+        NLK_ERROR_NULL("unable to allocate memory for publisher", NLK_ENOMEM);
+        /* unreachable */
+    }
+    pub->current = NULL;
+    pub->retired = NULL;
+    pub->spare = NULL;
+    pub->epoch = 0;
+    pub->interval = interval;
+    pub->next = interval > 0 ? interval : (size_t) -1;
+    pub->allocated = 0;
+    pub->busy = false;
+
+    return pub;
+}
+
+/**
+ * A read-only copy of a lookup layer's shape (weights not copied)
+ */
+static struct nlk_layer_lookup_t *
+nlk_snapshot_layer(const struct nlk_layer_lookup_t *layer)
+{
+    struct nlk_layer_lookup_t *copy;
+
+    if(layer == NULL) {
+        return NULL;
+    }
+    copy = nlk_layer_lookup_create(layer->weights->rows, 
+                                   layer->weights->cols);
+    if(copy == NULL) {
+        NLK_ERROR_ABORT("unable to allocate memory for snapshot", NLK_ENOMEM);
+        /* unreachable */
+    }
+    copy->update = false;
+    copy->learn_rate = layer->learn_rate;
+    copy->learn_rate_decay = layer->learn_rate_decay;
+
+    return copy;
+}
+
+/**
+ * Allocate a snapshot for a network (tables not copied)
+ */
+static struct nlk_snapshot_t *
+nlk_snapshot_create(const struct nlk_neuralnet_t *nn)
+{
+    struct nlk_snapshot_t *snap;
+
+    snap = (struct nlk_snapshot_t *) calloc(1, sizeof(struct nlk_snapshot_t));
+    if(snap == NULL) {
+        NLK_ERROR_ABORT("unable to allocate memory for snapshot", NLK_ENOMEM);
+        /* unreachable */
+    }
+    snap->nn.words = nlk_snapshot_layer(nn->words);
+    if(nn->train_opts.hs) {
+        snap->nn.hs = nlk_snapshot_layer(nn->hs);
+    }
+    if(nn->train_opts.negative) {
+        snap->nn.neg = nlk_snapshot_layer(nn->neg);
+    }
+    if(nn->subwords != NULL) {
+        snap->subwords.ngrams = nlk_snapshot_layer(nn->subwords->ngrams);
+    }
+
+    return snap;
+}
+
+/**
+ * Copy a network's tables into a snapshot
+ *
+ * The tables are read while training updates them (Hogwild): a row may mix 
+ * values from before and after a concurrent update, as the training threads
+ * themselves see it.
+ */
+static void
+nlk_snapshot_copy(struct nlk_snapshot_t *snap, 
+                  const struct nlk_neuralnet_t *nn)
+{
+    struct nlk_layer_lookup_t *words = snap->nn.words;
+    struct nlk_layer_lookup_t *hs = snap->nn.hs;
+    struct nlk_layer_lookup_t *neg = snap->nn.neg;
+    struct nlk_layer_lookup_t *ngrams = snap->subwords.ngrams;
+
+    /* options, vocabulary and negative table are shared */
+    snap->nn = *nn;
+    snap->nn.words = words;
+    snap->nn.hs = hs;
+    snap->nn.neg = neg;
+    snap->nn.paragraphs = NULL;
+    snap->nn.n_layers = 0;
+    snap->nn.pos = 0;
+    snap->nn.types = NULL;
+    snap->nn.layers = NULL;
+    snap->nn.subwords = NULL;
+
+    nlk_array_copy(words->weights, nn->words->weights);
+    if(hs != NULL) {
+        nlk_array_copy(hs->weights, nn->hs->weights);
+    }
+    if(neg != NULL) {
+        nlk_array_copy(neg->weights, nn->neg->weights);
+    }
+
+    /* n-grams: own table, shared ids, no OOV cache */
+    if(ngrams != NULL) {
+        snap->subwords = *nn->subwords;
+        snap->subwords.ngrams = ngrams;
+        snap->subwords.cache = NULL;
+        snap->subwords.cache_vectors = NULL;
+        snap->subwords.cache_size = 0;
+        snap->subwords.cache_capacity = 0;
+        nlk_array_copy(ngrams->weights, nn->subwords->ngrams->weights);
+        snap->nn.subwords = &snap->subwords;
+    }
+}
+
+/**
+ * Free a snapshot
+ */
+static void
+nlk_snapshot_free(struct nlk_snapshot_t *snap)
+{
+    nlk_layer_lookup_free(snap->nn.words);
+    if(snap->nn.hs != NULL) {
+        nlk_layer_lookup_free(snap->nn.hs);
+    }
+    if(snap->nn.neg != NULL) {
+        nlk_layer_lookup_free(snap->nn.neg);
+    }
+    if(snap->subwords.ngrams != NULL) {
+        nlk_layer_lookup_free(snap->subwords.ngrams);
+    }
+    free(snap);
+}
+
+/**
+ * Move the retired snapshots no reader holds to the spare list
+ */
+static void
+nlk_publisher_reclaim(struct nlk_publisher_t *pub)
+{
+    struct nlk_snapshot_t **prev = &pub->retired;
+    struct nlk_snapshot_t *snap = pub->retired;
+
+    while(snap != NULL) {
+        struct nlk_snapshot_t *next = snap->next;
+
+        if(__atomic_load_n(&snap->pins, __ATOMIC_SEQ_CST) == 0) {
+            *prev = next;
+            snap->next = pub->spare;
+            pub->spare = snap;
+        } else {
+            prev = &snap->next;
+        }
+        snap = next;
+    }
+}
+
+/**
+ * Publish a snapshot of a network
+ *
+ * @param pub   the publisher
+ * @param nn    the network (being trained)
+ * @param words words trained so far
+ *
+ * @return true if published, false if another thread was publishing
+ *
+ * @note
+ * Never waits: if a publication is already in progress the call returns.
+ * Every network published must have the same table sizes.
+ * @endnote
+ */
+bool
+nlk_publisher_publish(struct nlk_publisher_t *pub, 
+                      const struct nlk_neuralnet_t *nn, const size_t words)
+{
+    struct nlk_snapshot_t *snap;
+    struct nlk_snapshot_t *old;
+
+    if(pub == NULL) {
+        return false;
+    }
+    if(__atomic_exchange_n(&pub->busy, true, __ATOMIC_ACQUIRE)) {
+        return false;
+    }
+    __atomic_store_n(&pub->next, pub->interval > 0 ? words + pub->interval 
+                                                   : (size_t) -1, 
+                     __ATOMIC_RELAXED);
+
+    /* a snapshot no reader holds */
+    nlk_publisher_reclaim(pub);
+    if(pub->spare != NULL) {
+        snap = pub->spare;
+        pub->spare = snap->next;
+    } else {
+        snap = nlk_snapshot_create(nn);
+        pub->allocated++;
+    }
+
+    /* copy and swap */
+    nlk_snapshot_copy(snap, nn);
+    pub->epoch++;
+    snap->epoch = pub->epoch;
+    snap->words = words;
+    snap->next = NULL;
+    old = __atomic_exchange_n(&pub->current, snap, __ATOMIC_SEQ_CST);
+    if(old != NULL) {
+        old->next = pub->retired;
+        pub->retired = old;
+    }
+
+    __atomic_store_n(&pub->busy, false, __ATOMIC_RELEASE);
+    return true;
+}
+
+/**
+ * Publish a snapshot of a network if the publication interval was reached
+ *
+ * @param pub   the publisher (NULL: nothing to do)
+ * @param nn    the network (being trained)
+ * @param words words trained so far
+ *
+ * @return true if published
+ */
+bool
+nlk_publisher_maybe(struct nlk_publisher_t *pub, 
+                    const struct nlk_neuralnet_t *nn, const size_t words)
+{
+    if(pub == NULL || words < __atomic_load_n(&pub->next, __ATOMIC_RELAXED)) {
+        return false;
+    }
+    return nlk_publisher_publish(pub, nn, words);
+}
+
+/**
+ * Pin the current snapshot
+ *
+ * @param pub   the publisher
+ *
+ * @return the current snapshot or NULL if none was published yet
+ *
+ * @note
+ * The snapshot stays valid and unchanged until unpinned. Use the snapshot's
+ * network for inference only (e.g. nlk_pv_gen_string; not nlk_pv_gen_opts,
+ * which restores the learn mode).
+ * @endnote
+ */
+struct nlk_snapshot_t *
+nlk_snapshot_pin(struct nlk_publisher_t *pub)
+{
+    struct nlk_snapshot_t *snap;
+
+    while(true) {
+        snap = __atomic_load_n(&pub->current, __ATOMIC_SEQ_CST);
+        if(snap == NULL) {
+            return NULL;
+        }
+        __atomic_add_fetch(&snap->pins, 1, __ATOMIC_SEQ_CST);
+        if(__atomic_load_n(&pub->current, __ATOMIC_SEQ_CST) == snap) {
+            return snap;
+        }
+        /* replaced before pinned, it may be reused: retry */
+        __atomic_sub_fetch(&snap->pins, 1, __ATOMIC_SEQ_CST);
+    }
+}
+
+/**
+ * Unpin a snapshot
+ *
+ * @param snap  a snapshot returned by nlk_snapshot_pin
+ */
+void
+nlk_snapshot_unpin(struct nlk_snapshot_t *snap)
+{
+    if(snap != NULL) {
+        __atomic_sub_fetch(&snap->pins, 1, __ATOMIC_RELEASE);
+    }
+}
+
+/**
+ * Free a publisher and its snapshots
+ *
+ * @param pub   the publisher
+ *
+ * @note
+ * No snapshot may be pinned.
+ * @endnote
+ */
+void
+nlk_publisher_free(struct nlk_publisher_t *pub)
+{
+    struct nlk_snapshot_t *lists[3];
+    struct nlk_snapshot_t *snap;
+
+    if(pub == NULL) {
+        return;
+    }
+    lists[0] = pub->current;
+    lists[1] = pub->retired;
+    lists[2] = pub->spare;
+    if(lists[0] != NULL) {
+        lists[0]->next = NULL;
+    }
+    for(size_t ii = 0; ii < 3; ii++) {
+        while(lists[ii] != NULL) {
+            snap = lists[ii];
+            lists[ii] = snap->next;
+            nlk_snapshot_free(snap);
+        }
+    }
+    free(pub);
+}
@@ -0,0 +1,107 @@
+/******************************************************************************
+ * NLK - Neural Language Kit
+ *
+ * Copyright (c) 2015 Luis Rei <me@luisrei.com> http://luisrei.com @lmrei
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to 
+ * deal in the Software without restriction, including without limitation the 
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or 
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ *****************************************************************************/
+
+
+/** @file nlk_snapshot.h
+ * Read-only model snapshots published while training
+ */
+
+
+#ifndef __NLK_SNAPSHOT_H__
+#define __NLK_SNAPSHOT_H__
+
+
+#include <stddef.h>
+#include <stdbool.h>
+
+#include "nlk_neuralnet.h"
+#include "nlk_subword.h"
+
+
+#undef __BEGIN_DECLS
+#undef __END_DECLS
+#ifdef __cplusplus
+# define __BEGIN_DECLS extern "C" {
+# define __END_DECLS }
+#else
+# define __BEGIN_DECLS /* empty */
+# define __END_DECLS /* empty */
+#endif
+__BEGIN_DECLS
+
+
+/** @struct nlk_snapshot_t
+ * An immutable copy of the word and output tables of a network being 
+ * trained. The network (nn) shares the vocabulary, the negative sampling
+ * table and the n-gram ids with the training network; its lookup layers are
+ * the snapshot's own and do not update. There are no paragraph vectors.
+ */
+struct nlk_snapshot_t {
+    struct nlk_neuralnet_t   nn;        /**< read-only network */
+    struct nlk_subword_t     subwords;  /**< n-gram view (if nn.subwords) */
+    size_t                   epoch;     /**< publication number (from 1) */
+    size_t                   words;     /**< words trained when published */
+    size_t                   pins;      /**< readers using the snapshot */
+    struct nlk_snapshot_t   *next;      /**< retired/spare list */
+};
+typedef struct nlk_snapshot_t NLK_SNAPSHOT;
+
+/** @struct nlk_publisher_t
+ * Publishes snapshots of a network being trained. The current snapshot is 
+ * swapped atomically: readers pin it and never see a partial copy; the 
+ * training thread that publishes never waits for them - snapshots still 
+ * pinned are retired and their memory reused once unpinned.
+ */
+struct nlk_publisher_t {
+    struct nlk_snapshot_t   *current;   /**< the latest snapshot (or NULL) */
+    struct nlk_snapshot_t   *retired;   /**< replaced, may still be pinned */
+    struct nlk_snapshot_t   *spare;     /**< unpinned, ready for reuse */
+    size_t                   epoch;     /**< snapshots published */
+    size_t                   interval;  /**< words between publications */
+    size_t                   next;      /**< publish when words >= next */
+    size_t                   allocated; /**< snapshots allocated */
+    bool                     busy;      /**< a publication is in progress */
+};
+typedef struct nlk_publisher_t NLK_PUBLISHER;
+
+
+/* create */
+struct nlk_publisher_t *nlk_publisher_create(const size_t);
+
+/* publish (writer) */
+bool nlk_publisher_publish(struct nlk_publisher_t *, 
+                           const struct nlk_neuralnet_t *, const size_t);
+bool nlk_publisher_maybe(struct nlk_publisher_t *, 
+                         const struct nlk_neuralnet_t *, const size_t);
+
+/* pin (readers) */
+struct nlk_snapshot_t *nlk_snapshot_pin(struct nlk_publisher_t *);
+void nlk_snapshot_unpin(struct nlk_snapshot_t *);
+
+/* free */
+void nlk_publisher_free(struct nlk_publisher_t *);
+
+
+__END_DECLS
+#endif /* __NLK_SNAPSHOT_H__ */
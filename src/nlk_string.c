@@ -30,6 +30,9 @@
 #include <string.h>
 #include <locale.h>
 #include <langinfo.h>
+#ifdef __SSE2__
+#include <immintrin.h>
+#endif
 
 #include "nlk_err.h"
 
@@ -370,6 +373,138 @@ error:
 }
 
 
+/**
+ * Lower case a block of ASCII bytes: 32 (AVX2) or 16 (SSE2) at a time.
+ * Stops at the first non-ASCII byte, which passes through unfolded.
+ *
+ * @param str   the string (read from)
+ * @param len   the string length
+ * @param pos   the read position (updated)
+ * @param out   the write position (updated, <= pos)
+ */
+static inline void
+nlk_string_ascii_lower_block(char *str, const size_t len, size_t *pos,
+                             size_t *out)
+{
+    size_t r = *pos;
+    size_t w = *out;
+
+#ifdef __AVX2__
+    const __m256i a32 = _mm256_set1_epi8('A' - 1);
+    const __m256i z32 = _mm256_set1_epi8('Z' + 1);
+    const __m256i d32 = _mm256_set1_epi8(0x20);
+    while(r + 32 <= len) {
+        __m256i c = _mm256_loadu_si256((const __m256i *) &str[r]);
+        if(_mm256_movemask_epi8(c) != 0) {
+            break; /* non-ASCII */
+        }
+        __m256i m = _mm256_and_si256(_mm256_cmpgt_epi8(c, a32),
+                                     _mm256_cmpgt_epi8(z32, c));
+        c = _mm256_add_epi8(c, _mm256_and_si256(m, d32));
+        _mm256_storeu_si256((__m256i *) &str[w], c);
+        r += 32;
+        w += 32;
+    }
+#endif
+#ifdef __SSE2__
+    const __m128i a16 = _mm_set1_epi8('A' - 1);
+    const __m128i z16 = _mm_set1_epi8('Z' + 1);
+    const __m128i d16 = _mm_set1_epi8(0x20);
+    while(r + 16 <= len) {
+        __m128i c = _mm_loadu_si128((const __m128i *) &str[r]);
+        if(_mm_movemask_epi8(c) != 0) {
+            break; /* non-ASCII */
+        }
+        __m128i m = _mm_and_si128(_mm_cmpgt_epi8(c, a16),
+                                  _mm_cmpgt_epi8(z16, c));
+        c = _mm_add_epi8(c, _mm_and_si128(m, d16));
+        _mm_storeu_si128((__m128i *) &str[w], c);
+        r += 16;
+        w += 16;
+    }
+#endif
+    /* remaining ASCII bytes */
+    while(r < len && (unsigned char) str[r] < 0x80) {
+        str[w] = (str[r] >= 'A' && str[r] <= 'Z') ? str[r] + 0x20 : str[r];
+        r++;
+        w++;
+    }
+
+    *pos = r;
+    *out = w;
+}
+
+/**
+ * Lower case or case fold a string in place. Runs of ASCII bytes are
+ * converted with SIMD, only non-ASCII characters go through utf8proc.
+ *
+ * @param str   the string (utf8, need not be NULL terminated; overwritten)
+ * @param len   the string length in bytes
+ * @param mode  the normalization
+ *
+ * @return the length of the normalized string (<= len)
+ *
+ * @note
+ * The rare characters whose lower case takes more bytes than the original
+ * (e.g. U+023A) are left unchanged when there is no room to write them.
+ * Invalid utf8 bytes are copied.
+ * The SIMD case fold only touches ASCII 'A'-'Z': non-ASCII bytes pass
+ * through it unfolded, and the characters they encode are unchanged unless
+ * utf8proc has a lower case (or folded) form for them.
+ * @endnote
+ */
+size_t
+nlk_string_normalize(char *str, const size_t len, const NLK_NORMALIZE mode)
+{
+    size_t pos = 0;             /* read position */
+    size_t out = 0;             /* write position */
+    utf8proc_int32_t ch;
+    utf8proc_ssize_t bytes;
+    utf8proc_ssize_t out_bytes;
+    utf8proc_uint8_t buf[4];
+
+    if(mode == NLK_NORMALIZE_NONE) {
+        return len;
+    }
+
+    while(pos < len) {
+        nlk_string_ascii_lower_block(str, len, &pos, &out);
+        if(pos >= len) {
+            break;
+        }
+
+        /* non-ASCII character */
+        bytes = utf8proc_iterate((utf8proc_uint8_t *) &str[pos], len - pos,
+                                 &ch);
+        if(bytes <= 0) {
+            /* invalid: copy byte */
+            str[out] = str[pos];
+            pos++;
+            out++;
+            continue;
+        }
+
+        ch = utf8proc_tolower(ch);
+        if(mode == NLK_NORMALIZE_CASE_FOLD) {
+            ch = utf8proc_tolower(utf8proc_toupper(ch));
+        }
+        out_bytes = utf8proc_encode_char(ch, buf);
+
+        if(out_bytes > 0 && out + out_bytes <= pos + bytes) {
+            memcpy(&str[out], buf, out_bytes);
+            out += out_bytes;
+        } else {
+            /* no room: keep the original character */
+            memmove(&str[out], &str[pos], bytes);
+            out += bytes;
+        }
+        pos += bytes;
+    }
+
+    return out;
+}
+
+
 /**
  * True if current locale is utf8
  */
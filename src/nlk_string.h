@@ -47,7 +47,19 @@
 __BEGIN_DECLS
 
 
+/** @enum NLK_NORMALIZE
+ * Text normalization applied when reading
+ */
+enum nlk_normalize_t {
+    NLK_NORMALIZE_NONE      = 0,    /**< no normalization */
+    NLK_NORMALIZE_LOWER     = 1,    /**< lower case */
+    NLK_NORMALIZE_CASE_FOLD = 2     /**< case folding */
+};
+typedef enum nlk_normalize_t NLK_NORMALIZE;
+
+
 ssize_t nlk_string_lower(const char *, const ssize_t, char *);
+size_t  nlk_string_normalize(char *, const size_t, const NLK_NORMALIZE);
 ssize_t nlk_string_upper(const char *, const ssize_t, char *);
 ssize_t nlk_string_get_char(const char *, size_t, char *);
 bool    nlk_string_is_locale_utf8();
@@ -0,0 +1,635 @@
+/******************************************************************************
+ * NLK - Neural Language Kit
+ *
+ * Copyright (c) 2015 Luis Rei <me@luisrei.com> http://luisrei.com @lmrei
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to 
+ * deal in the Software without restriction, including without limitation the 
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or 
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ *****************************************************************************/
+
+
+
+/** @file nlk_subword.c
+ * Character n-gram (subword) vectors
+ */
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <omp.h>
+
+#include "uthash.h"
+
+#include "nlk_err.h"
+#include "nlk_text.h"
+#include "nlk_array.h"
+#include "nlk_vocabulary.h"
+#include "nlk_layer_lookup.h"
+
+#include "nlk_subword.h"
+
+
+/**
+ * Generates the hashed character n-grams of a word. The word is wrapped in 
+ * '<' and '>' and n-grams are formed from whole UTF-8 characters.
+ *
+ * @param word      the word
+ * @param min_n     the minimum n-gram size (in characters)
+ * @param max_n     the maximum n-gram size (in characters)
+ * @param buckets   the number of n-gram buckets (rows of the n-gram table)
+ * @param ids       the n-gram rows (at most NLK_SUBWORD_MAX_NGRAMS; output)
+ *
+ * @return the number of n-grams
+ */
+size_t
+nlk_subword_ngrams(const char *word, const unsigned int min_n, 
+                   const unsigned int max_n, const size_t buckets, 
+                   uint32_t *ids)
+{
+    char wrapped[NLK_MAX_WORD_SIZE + 3];
+    size_t starts[NLK_MAX_WORD_SIZE + 3];
+    size_t n_chars = 0;
+    size_t n_ngrams = 0;
+    size_t len;
+    uint64_t h;
+
+    len = snprintf(wrapped, sizeof(wrapped), "<%s>", word);
+    if(len >= sizeof(wrapped)) {
+        len = sizeof(wrapped) - 1;
+    }
+
+    /* character start positions (skip UTF-8 continuation bytes) */
+    for(size_t ii = 0; ii < len; ii++) {
+        if((wrapped[ii] & 0xC0) != 0x80) {
+            starts[n_chars] = ii;
+            n_chars++;
+        }
+    }
+    starts[n_chars] = len;
+
+    for(size_t ii = 0; ii < n_chars; ii++) {
+        for(size_t nn = min_n; nn <= max_n && ii + nn <= n_chars; nn++) {
+            if(n_ngrams >= NLK_SUBWORD_MAX_NGRAMS) {
+                return n_ngrams;
+            }
+            h = nlk_vocab_hash(&wrapped[starts[ii]], 
+                               starts[ii + nn] - starts[ii]);
+            ids[n_ngrams] = h % buckets;
+            n_ngrams++;
+        }
+    }
+
+    return n_ngrams;
+}
+
+/**
+ * Should n-grams be generated for this vocabulary item?
+ */
+static inline bool
+nlk_subword_has_ngrams(const struct nlk_vocab_t *vi)
+{
+    return vi->type == NLK_VOCAB_WORD;
+}
+
+/**
+ * Create a subword structure from an existing n-gram table
+ *
+ * @param vocab             the vocabulary
+ * @param ngrams            the n-gram table (owned by the subword structure)
+ * @param min_n             the minimum n-gram size
+ * @param max_n             the maximum n-gram size
+ * @param cache_capacity    the maximum number of cached OOV words
+ *
+ * @return the subword structure or NULL on error
+ */
+struct nlk_subword_t *
+nlk_subword_create_from_layer(struct nlk_vocab_t **vocab, 
+                              struct nlk_layer_lookup_t *ngrams,
+                              const unsigned int min_n, 
+                              const unsigned int max_n,
+                              const size_t cache_capacity)
+{
+    struct nlk_subword_t *sw;
+    struct nlk_vocab_t *vi;
+    uint32_t ids[NLK_SUBWORD_MAX_NGRAMS];
+    const size_t buckets = ngrams->weights->rows;
+
+    sw = (struct nlk_subword_t *) calloc(1, sizeof(struct nlk_subword_t));
+    if(sw == NULL) {
+        NLK_ERROR_NULL("failed to allocate memory for subword struct", 
+                       NLK_ENOMEM);
+        /* unreachable */
+    }
+    sw->min_n = min_n;
+    sw->max_n = max_n;
+    sw->ngrams = ngrams;
+    sw->vocab_size = 0;
+    for(vi = *vocab; vi != NULL; vi = vi->hh.next) {
+        if(vi->index + 1 > sw->vocab_size) {
+            sw->vocab_size = vi->index + 1;
+        }
+    }
+    sw->cache = NULL;
+    sw->cache_size = 0;
+    sw->cache_capacity = cache_capacity;
+
+    /* word -> n-grams (CSR): count */
+    sw->offsets = (size_t *) calloc(sw->vocab_size + 1, sizeof(size_t));
+    if(sw->offsets == NULL) {
+        NLK_ERROR_NULL("failed to allocate memory for subword offsets", 
+                       NLK_ENOMEM);
+        /* unreachable */
+    }
+    for(vi = *vocab; vi != NULL; vi = vi->hh.next) {
+        if(nlk_subword_has_ngrams(vi)) {
+            sw->offsets[vi->index + 1] = nlk_subword_ngrams(vi->word, min_n, 
+                                                            max_n, buckets, 
+                                                            ids);
+        }
+    }
+    for(size_t ii = 0; ii < sw->vocab_size; ii++) {
+        sw->offsets[ii + 1] += sw->offsets[ii];
+    }
+
+    /* fill */
+    sw->ids = (uint32_t *) malloc((sw->offsets[sw->vocab_size] + 1) * 
+                                  sizeof(uint32_t));
+    if(sw->ids == NULL) {
+        NLK_ERROR_NULL("failed to allocate memory for subword ids", 
+                       NLK_ENOMEM);
+        /* unreachable */
+    }
+    for(vi = *vocab; vi != NULL; vi = vi->hh.next) {
+        if(nlk_subword_has_ngrams(vi)) {
+            nlk_subword_ngrams(vi->word, min_n, max_n, buckets, 
+                               &sw->ids[sw->offsets[vi->index]]);
+        }
+    }
+
+    /* OOV cache */
+    if(cache_capacity > 0) {
+        sw->cache_vectors = nlk_array_create(cache_capacity, 
+                                             ngrams->weights->cols);
+        if(sw->cache_vectors == NULL) {
+            NLK_ERROR_NULL("failed to allocate memory for subword cache", 
+                           NLK_ENOMEM);
+            /* unreachable */
+        }
+    } else {
+        sw->cache_vectors = NULL;
+    }
+
+    return sw;
+}
+
+/**
+ * Create subword vectors for a vocabulary
+ *
+ * @param vocab             the vocabulary
+ * @param buckets           the number of n-gram buckets
+ * @param dim               the vector size (same as the word vectors)
+ * @param min_n             the minimum n-gram size
+ * @param max_n             the maximum n-gram size
+ * @param cache_capacity    the maximum number of cached OOV words
+ *
+ * @return the subword structure or NULL on error
+ */
+struct nlk_subword_t *
+nlk_subword_create(struct nlk_vocab_t **vocab, const size_t buckets,
+                   const size_t dim, const unsigned int min_n, 
+                   const unsigned int max_n, const size_t cache_capacity)
+{
+    struct nlk_layer_lookup_t *ngrams;
+
+    if(buckets == 0 || min_n == 0 || max_n < min_n) {
+        NLK_ERROR_NULL("invalid subword parameters", NLK_EINVAL);
+        /* unreachable */
+    }
+
+    ngrams = nlk_layer_lookup_create(buckets, dim);
+    if(ngrams == NULL) {
+        return NULL;
+    }
+    nlk_layer_lookup_init(ngrams);
+
+    return nlk_subword_create_from_layer(vocab, ngrams, min_n, max_n, 
+                                         cache_capacity);
+}
+
+/**
+ * Adds the scaled (composed) vector of a word to a vector: 
+ * v = v + s * (word + sum(ngrams)) / (1 + n_ngrams)
+ * For cached OOV items the cached vector is used instead.
+ */
+static inline void
+nlk_subword_add_scaled(const struct nlk_subword_t *sw, 
+                       const struct nlk_layer_lookup_t *words,
+                       const size_t index, const nlk_real s, 
+                       const unsigned int dim, NLK_ARRAY *v)
+{
+    if(index >= sw->vocab_size) {
+        nlk_add_scaled_row_vector(s, sw->cache_vectors, 
+                                  index - sw->vocab_size, dim, v);
+        return;
+    }
+
+    const size_t start = sw->offsets[index];
+    const size_t end = sw->offsets[index + 1];
+    const nlk_real t = s / (nlk_real) (1 + end - start);
+
+    nlk_add_scaled_row_vector(t, words->weights, index, dim, v);
+    for(size_t ii = start; ii < end; ii++) {
+        nlk_add_scaled_row_vector(t, sw->ngrams->weights, sw->ids[ii], dim, 
+                                  v);
+    }
+}
+
+/**
+ * Subword forward pass for a single word (output overwritten)
+ *
+ * @param sw        the subword structure
+ * @param words     the word lookup layer
+ * @param index     the word index
+ * @param output    the composed word vector (overwritten)
+ */
+void
+nlk_subword_forward_one(const struct nlk_subword_t *sw, 
+                        const struct nlk_layer_lookup_t *words,
+                        const size_t index, NLK_ARRAY *output)
+{
+    nlk_array_zero(output);
+    nlk_subword_add_scaled(sw, words, index, 1.0, 0, output);
+}
+
+/**
+ * Subword forward pass: average of the composed word vectors
+ *
+ * @param sw        the subword structure
+ * @param words     the word lookup layer
+ * @param indices   the word indices
+ * @param n_indices the number of indices
+ * @param output    the average vector (overwritten)
+ */
+void
+nlk_subword_forward_avg(const struct nlk_subword_t *sw, 
+                        const struct nlk_layer_lookup_t *words,
+                        const size_t *indices, const size_t n_indices, 
+                        NLK_ARRAY *output)
+{
+    nlk_array_zero(output);
+    if(n_indices == 0) {
+        return;
+    }
+
+    const nlk_real s = 1.0 / (nlk_real) n_indices;
+    for(size_t ii = 0; ii < n_indices; ii++) {
+        nlk_subword_add_scaled(sw, words, indices[ii], s, 0, output);
+    }
+}
+
+/**
+ * Subword forward pass with a paragraph vector. The composed word vectors 
+ * are averaged with the paragraph vector already in output. 
+ * Same as nlk_layer_lookup_forward_lookup_avg_p.
+ *
+ * @param sw        the subword structure
+ * @param words     the word lookup layer
+ * @param indices   the word indices
+ * @param n_indices the number of indices
+ * @param output    the paragraph vector (overwritten with the average)
+ */
+void
+nlk_subword_forward_avg_p(const struct nlk_subword_t *sw, 
+                          const struct nlk_layer_lookup_t *words,
+                          const size_t *indices, const size_t n_indices, 
+                          NLK_ARRAY *output)
+{
+    if(n_indices == 0) {
+        return; /* nothing to do */
+    }
+
+    const nlk_real s = 1.0 / (nlk_real) (n_indices + 1);
+    for(size_t ii = 0; ii < n_indices; ii++) {
+        nlk_subword_add_scaled(sw, words, indices[ii], s, 0, output);
+    }
+}
+
+/**
+ * Subword backward pass for a single word. As in fastText, the gradient is 
+ * added to the word vector and to each of its n-gram vectors. 
+ * Cached OOV items are not updated.
+ *
+ * @param sw        the subword structure
+ * @param words     the word lookup layer
+ * @param index     the word index
+ * @param grad_out  the gradient at the output
+ */
+void
+nlk_subword_backprop_one(struct nlk_subword_t *sw, 
+                         struct nlk_layer_lookup_t *words,
+                         const size_t index, const NLK_ARRAY *grad_out)
+{
+    if(index >= sw->vocab_size) {
+        return;
+    }
+
+    nlk_layer_lookup_backprop_lookup_one(words, index, grad_out);
+
+    if(sw->ngrams->update == false) {
+        return;
+    }
+    for(size_t ii = sw->offsets[index]; ii < sw->offsets[index + 1]; ii++) {
+        nlk_layer_lookup_backprop_lookup_one(sw->ngrams, sw->ids[ii], 
+                                             grad_out);
+    }
+}
+
+/**
+ * Subword backward pass for multiple words (see nlk_subword_backprop_one)
+ *
+ * @param sw        the subword structure
+ * @param words     the word lookup layer
+ * @param indices   the word indices
+ * @param n_indices the number of indices
+ * @param grad_out  the gradient at the output
+ */
+void
+nlk_subword_backprop(struct nlk_subword_t *sw, 
+                     struct nlk_layer_lookup_t *words,
+                     const size_t *indices, const size_t n_indices, 
+                     const NLK_ARRAY *grad_out)
+{
+    for(size_t ii = 0; ii < n_indices; ii++) {
+        nlk_subword_backprop_one(sw, words, indices[ii], grad_out);
+    }
+}
+
+/**
+ * Returns the cached item for an out-of-vocabulary word, computing its 
+ * vector (the average of its n-gram vectors) and adding it to the cache if
+ * necessary. 
+ *
+ * @param sw    the subword structure
+ * @param word  the word
+ *
+ * @return the cached item or NULL if the cache is full or the word has no 
+ *         n-grams
+ *
+ * @note
+ * The cached vector is computed when the word is first seen. The cache should
+ * be cleared (nlk_subword_cache_clear) if the n-gram table changes.
+ * @endnote
+ */
+struct nlk_vocab_t *
+nlk_subword_oov(struct nlk_subword_t *sw, const char *word)
+{
+    struct nlk_vocab_t *item = NULL;
+    uint32_t ids[NLK_SUBWORD_MAX_NGRAMS];
+    NLK_ARRAY row;
+    size_t n;
+
+    if(sw->cache_vectors == NULL) {
+        return NULL;
+    }
+
+#pragma omp critical(nlk_subword_cache)
+{
+    HASH_FIND_STR(sw->cache, word, item);
+    if(item == NULL && sw->cache_size < sw->cache_capacity) {
+        n = nlk_subword_ngrams(word, sw->min_n, sw->max_n, 
+                               sw->ngrams->weights->rows, ids);
+        if(n > 0) {
+            /* vector */
+            nlk_array_row_view(sw->cache_vectors, sw->cache_size, &row);
+            nlk_array_zero(&row);
+            for(size_t ii = 0; ii < n; ii++) {
+                nlk_add_scaled_row_vector(1.0 / (nlk_real) n, 
+                                          sw->ngrams->weights, ids[ii], 1, 
+                                          &row);
+            }
+
+            /* item */
+            item = (struct nlk_vocab_t *) calloc(1, 
+                                                 sizeof(struct nlk_vocab_t));
+            if(item != NULL) {
+                item->word = strdup(word);
+                item->type = NLK_VOCAB_CHAR;
+                item->index = sw->vocab_size + sw->cache_size;
+                item->hc = NULL;
+                HASH_ADD_STR(sw->cache, word, item);
+                sw->cache_size++;
+            }
+        }
+    }
+} /* end of critical */
+
+    return item;
+}
+
+/**
+ * Clear the OOV cache. The cached vectors are copies of n-gram averages: 
+ * clear it whenever the n-gram table changes (e.g. after training).
+ *
+ * @param sw    the subword structure
+ */
+void
+nlk_subword_cache_clear(struct nlk_subword_t *sw)
+{
+    if(sw->cache != NULL) {
+        nlk_vocab_free(&sw->cache);
+        sw->cache = NULL;
+    }
+    sw->cache_size = 0;
+}
+
+/**
+ * Vocabularize a paragraph with subword OOV handling: words not in the
+ * vocabulary are represented by their cached n-gram vectors. If that is not
+ * possible the replacement is used (see nlk_vocab_vocabularize).
+ *
+ * @param sw            the subword structure
+ * @param vocab         the vocabulary
+ * @param paragraph     the paragraph (words)
+ * @param replacement   the replacement item or NULL
+ * @param varray        the vocabularized paragraph (output)
+ *
+ * @return the length of varray
+ */
+size_t
+nlk_subword_vocabularize(struct nlk_subword_t *sw, struct nlk_vocab_t **vocab,
+                         char **paragraph, struct nlk_vocab_t *replacement,
+                         struct nlk_vocab_t **varray)
+{
+    struct nlk_vocab_t *vocab_word;
+    size_t vec_idx = 0;
+
+    for(size_t par_idx = 0; paragraph[par_idx][0] != '\0'; par_idx++) {
+        HASH_FIND_STR(*vocab, paragraph[par_idx], vocab_word);
+        if(vocab_word == NULL) {
+            vocab_word = nlk_subword_oov(sw, paragraph[par_idx]);
+        }
+        if(vocab_word == NULL && replacement != NULL) {
+            if(replacement->type == NLK_VOCAB_BUCKET) {
+                vocab_word = nlk_vocab_bucket(vocab, replacement,
+                                              paragraph[par_idx]);
+            } else {
+                vocab_word = replacement;
+            }
+        }
+        if(vocab_word != NULL) {
+            varray[vec_idx] = vocab_word;
+            vec_idx++;
+        }
+    }
+
+    return vec_idx;
+}
+
+/**
+ * The vector of a word that is not in the vocabulary: the average of its 
+ * n-gram vectors. The OOV cache is neither read nor updated.
+ *
+ * @param sw        the subword structure
+ * @param word      the word
+ * @param output    the word vector, size = word vector size (overwritten)
+ *
+ * @return NLK_SUCCESS or NLK_FAILURE if the word has no n-grams
+ */
+int
+nlk_subword_oov_vector(const struct nlk_subword_t *sw, const char *word,
+                       NLK_ARRAY *output)
+{
+    uint32_t ids[NLK_SUBWORD_MAX_NGRAMS];
+    size_t n;
+    NLK_ARRAY out;
+
+    /* view output as a row vector */
+    out.rows = 1;
+    out.cols = out.len = output->len;
+    out.data = output->data;
+    nlk_array_zero(&out);
+
+    n = nlk_subword_ngrams(word, sw->min_n, sw->max_n, 
+                           sw->ngrams->weights->rows, ids);
+    if(n == 0) {
+        return NLK_FAILURE;
+    }
+    for(size_t ii = 0; ii < n; ii++) {
+        nlk_add_scaled_row_vector(1.0 / (nlk_real) n, sw->ngrams->weights, 
+                                  ids[ii], 1, &out);
+    }
+
+    return NLK_SUCCESS;
+}
+
+/**
+ * Get the vector of a word (in or out of the vocabulary).
+ *
+ * @param sw        the subword structure
+ * @param words     the word lookup layer
+ * @param vocab     the vocabulary
+ * @param word      the word
+ * @param output    the word vector, size = word vector size (overwritten)
+ *
+ * @return NLK_SUCCESS or NLK_FAILURE if the word has no vector
+ */
+int
+nlk_subword_word_vector(struct nlk_subword_t *sw, 
+                        const struct nlk_layer_lookup_t *words,
+                        struct nlk_vocab_t **vocab, const char *word,
+                        NLK_ARRAY *output)
+{
+    struct nlk_vocab_t *vi;
+    NLK_ARRAY out;
+
+    HASH_FIND_STR(*vocab, word, vi);
+    if(vi == NULL && sw->cache != NULL) {
+#pragma omp critical(nlk_subword_cache)
+        HASH_FIND_STR(sw->cache, word, vi);
+    }
+    if(vi == NULL) {
+        return nlk_subword_oov_vector(sw, word, output);
+    }
+
+    /* view output as a row vector */
+    out.rows = 1;
+    out.cols = out.len = output->len;
+    out.data = output->data;
+    nlk_array_zero(&out);
+    nlk_subword_add_scaled(sw, words, vi->index, 1.0, 1, &out);
+
+    return NLK_SUCCESS;
+}
+
+/**
+ * Save subword vectors (the n-gram table) to a file
+ *
+ * @param sw    the subword structure
+ * @param fp    the file pointer
+ */
+void
+nlk_subword_save(const struct nlk_subword_t *sw, FILE *fp)
+{
+    nlk_layer_lookup_save(sw->ngrams, fp);
+}
+
+/**
+ * Load subword vectors from a file
+ *
+ * @param fp    the file pointer
+ * @param vocab the vocabulary
+ * @param min_n the minimum n-gram size
+ * @param max_n the maximum n-gram size
+ *
+ * @return the subword structure or NULL on error
+ */
+struct nlk_subword_t *
+nlk_subword_load(FILE *fp, struct nlk_vocab_t **vocab, 
+                 const unsigned int min_n, const unsigned int max_n)
+{
+    struct nlk_layer_lookup_t *ngrams = nlk_layer_lookup_load(fp);
+    if(ngrams == NULL) {
+        return NULL;
+    }
+
+    return nlk_subword_create_from_layer(vocab, ngrams, min_n, max_n, 
+                                         NLK_SUBWORD_CACHE_SIZE);
+}
+
+/**
+ * Free subword vectors
+ *
+ * @param sw    the subword structure
+ */
+void
+nlk_subword_free(struct nlk_subword_t *sw)
+{
+    if(sw == NULL) {
+        return;
+    }
+    nlk_subword_cache_clear(sw);
+    if(sw->cache_vectors != NULL) {
+        nlk_array_free(sw->cache_vectors);
+    }
+    if(sw->ngrams != NULL) {
+        nlk_layer_lookup_free(sw->ngrams);
+    }
+    free(sw->offsets);
+    free(sw->ids);
+    free(sw);
+}
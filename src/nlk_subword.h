@@ -0,0 +1,142 @@
+/******************************************************************************
+ * NLK - Neural Language Kit
+ *
+ * Copyright (c) 2015 Luis Rei <me@luisrei.com> http://luisrei.com @lmrei
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to 
+ * deal in the Software without restriction, including without limitation the 
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or 
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ *****************************************************************************/
+
+
+
+/** @file nlk_subword.h
+ * Character n-gram (subword) vectors
+ */
+
+#ifndef __NLK_SUBWORD_H__
+#define __NLK_SUBWORD_H__
+
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include "nlk_array.h"
+#include "nlk_vocabulary.h"
+#include "nlk_layer_lookup.h"
+
+
+#undef __BEGIN_DECLS
+#undef __END_DECLS
+#ifdef __cplusplus
+# define __BEGIN_DECLS extern "C" {
+# define __END_DECLS }
+#else
+# define __BEGIN_DECLS /* empty */
+# define __END_DECLS /* empty */
+#endif
+__BEGIN_DECLS
+
+
+#define NLK_SUBWORD_MIN_N 3                 /**< default min n-gram size */
+#define NLK_SUBWORD_MAX_N 6                 /**< default max n-gram size */
+#define NLK_SUBWORD_MAX_NGRAMS 256          /**< max n-grams in a word */
+#define NLK_SUBWORD_CACHE_SIZE (size_t)1e5  /**< default OOV cache size */
+
+
+/** @struct nlk_subword_t
+ * Hashed character n-gram vectors. A word's input vector is the average of 
+ * its word vector and the vectors of its n-grams. Words that are not in the
+ * vocabulary are represented by the average of their n-gram vectors only and
+ * are stored in a cache (as NLK_VOCAB_CHAR items) so they can be used as 
+ * inputs in PV inference.
+ *
+ * @note
+ * Cached (OOV) items have indices >= vocab_size: index - vocab_size is the 
+ * row in cache_vectors.
+ * @endnote
+ */
+struct nlk_subword_t {
+    unsigned int               min_n;           /**< min n-gram size */
+    unsigned int               max_n;           /**< max n-gram size */
+    struct nlk_layer_lookup_t *ngrams;          /**< n-gram (bucket) table */
+    size_t                     vocab_size;      /**< max word index + 1 */
+    size_t                    *offsets;         /**< word index -> ids start */
+    uint32_t                  *ids;             /**< n-gram rows of words */
+    struct nlk_vocab_t        *cache;           /**< cached OOV items */
+    NLK_ARRAY                 *cache_vectors;   /**< cached OOV vectors */
+    size_t                     cache_size;      /**< number of cached items */
+    size_t                     cache_capacity;  /**< max cached items */
+};
+
+
+/* create */
+struct nlk_subword_t *nlk_subword_create(struct nlk_vocab_t **, const size_t,
+                                         const size_t, const unsigned int,
+                                         const unsigned int, const size_t);
+struct nlk_subword_t *nlk_subword_create_from_layer(struct nlk_vocab_t **,
+                                                    struct nlk_layer_lookup_t *,
+                                                    const unsigned int,
+                                                    const unsigned int,
+                                                    const size_t);
+/* n-grams */
+size_t nlk_subword_ngrams(const char *, const unsigned int, 
+                          const unsigned int, const size_t, uint32_t *);
+
+/* forward */
+void nlk_subword_forward_one(const struct nlk_subword_t *, 
+                             const struct nlk_layer_lookup_t *, const size_t,
+                             NLK_ARRAY *);
+void nlk_subword_forward_avg(const struct nlk_subword_t *,
+                             const struct nlk_layer_lookup_t *, 
+                             const size_t *, const size_t, NLK_ARRAY *);
+void nlk_subword_forward_avg_p(const struct nlk_subword_t *,
+                               const struct nlk_layer_lookup_t *, 
+                               const size_t *, const size_t, NLK_ARRAY *);
+
+/* backprop */
+void nlk_subword_backprop_one(struct nlk_subword_t *, 
+                              struct nlk_layer_lookup_t *, const size_t,
+                              const NLK_ARRAY *);
+void nlk_subword_backprop(struct nlk_subword_t *, struct nlk_layer_lookup_t *,
+                          const size_t *, const size_t, const NLK_ARRAY *);
+
+/* OOV */
+struct nlk_vocab_t *nlk_subword_oov(struct nlk_subword_t *, const char *);
+void   nlk_subword_cache_clear(struct nlk_subword_t *);
+size_t nlk_subword_vocabularize(struct nlk_subword_t *, struct nlk_vocab_t **,
+                                char **, struct nlk_vocab_t *,
+                                struct nlk_vocab_t **);
+int    nlk_subword_oov_vector(const struct nlk_subword_t *, const char *,
+                              NLK_ARRAY *);
+int    nlk_subword_word_vector(struct nlk_subword_t *, 
+                               const struct nlk_layer_lookup_t *, 
+                               struct nlk_vocab_t **, const char *,
+                               NLK_ARRAY *);
+
+/* save & load */
+void                  nlk_subword_save(const struct nlk_subword_t *, FILE *);
+struct nlk_subword_t *nlk_subword_load(FILE *, struct nlk_vocab_t **,
+                                       const unsigned int, 
+                                       const unsigned int);
+
+/* free */
+void nlk_subword_free(struct nlk_subword_t *);
+
+
+__END_DECLS
+#endif /* __NLK_SUBWORD_H__ */
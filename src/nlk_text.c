@@ -48,18 +48,44 @@
 #include "nlk_text.h"
 
 
+/** normalization applied to all text read (nlk_read_line & co) */
+static NLK_NORMALIZE __normalize = NLK_NORMALIZE_NONE;
+
+
 /**
- * Create a line (allocate memory for a line)
+ * Set the normalization (lower case, case fold) applied to text as it is read
+ * by nlk_read_line and nlk_text_line_read. Set before creating the vocabulary.
  */
-char **
-nlk_text_line_create()
+void
+nlk_text_set_normalize(const NLK_NORMALIZE mode)
+{
+    __normalize = mode;
+}
+
+
+/**
+ * Get the normalization applied to text as it is read
+ */
+NLK_NORMALIZE
+nlk_text_get_normalize()
+{
+    return __normalize;
+}
+
+
+/**
+ * Allocate memory for a text line of up to n words.
+ * The array is NULL terminated so that it can be freed without its size.
+ */
+static char **
+nlk_text_line_create_size(const size_t n)
 {
-    char **text_line = (char **) calloc(NLK_MAX_LINE_SIZE, sizeof(char *));
+    char **text_line = (char **) calloc(n + 1, sizeof(char *));
     if(text_line == NULL) {
         NLK_ERROR_ABORT("unable to allocate memory for text", NLK_ENOMEM);
         /* unreachable */
     }
-    for(size_t zz = 0; zz < NLK_MAX_LINE_SIZE; zz++) {
+    for(size_t zz = 0; zz < n; zz++) {
         text_line[zz] = calloc(NLK_MAX_WORD_SIZE, sizeof(char));
         if(text_line[zz] == NULL) {
             NLK_ERROR_NULL("unable to allocate memory for text", NLK_ENOMEM);
@@ -70,6 +96,27 @@ nlk_text_line_create()
     return text_line;
 }
 
+
+/**
+ * Create a line (allocate memory for a line)
+ */
+char **
+nlk_text_line_create()
+{
+    return nlk_text_line_create_size(NLK_MAX_LINE_SIZE);
+}
+
+
+/**
+ * Create a line for reading chunks of a line (nlk_read_chunk)
+ */
+char **
+nlk_text_chunk_create()
+{
+    /* the line id and the terminator */
+    return nlk_text_line_create_size(NLK_CHUNK_SIZE + 2);
+}
+
 void
 nlk_text_line_free(char **text_line)
 {
@@ -77,7 +124,7 @@ nlk_text_line_free(char **text_line)
         return;
     }
     /* free array elements (words) */
-    for(size_t zz = 0; zz < NLK_MAX_LINE_SIZE; zz++) {
+    for(size_t zz = 0; text_line[zz] != NULL; zz++) {
         free(text_line[zz]);
         text_line[zz] = NULL;
     }
@@ -277,11 +324,13 @@ nlk_fopen(const char *filepath) {
 
 /**
  * Copies a buffer into a char ** with tokenized words
- * Called only from nlk_read_line
- * @param number will store the line number if not NULL
+ * Called only from nlk_read_line and nlk_read_chunk
+ * @param number    will store the line number if not NULL
+ * @param max_words line has room for max_words + 1 (terminator) words
  */
 inline static int
-nlk_text_make_words(char *buf, const ssize_t len, char **line, size_t *number)
+nlk_text_make_words(char *buf, const ssize_t len, char **line, size_t *number,
+                    const int max_words)
 {
     register int idx = 0;
     register int widx = 0;
@@ -305,14 +354,15 @@ nlk_text_make_words(char *buf, const ssize_t len, char **line, size_t *number)
      * dest will point line[idx-1] after the first "word"
      * and thus point to the right array in **line
      */
-    while(p != end && widx < NLK_MAX_LINE_SIZE) {
+    while(p != end && widx < max_words) {
 
         while( ! isspace(*p) && p != end) { 
             p++; 
         } /* p points to the token end, s to the token start */
 
         
-        if(p - s > NLK_MAX_WORD_SIZE) { /* ignore large words */
+        if(p - s >= NLK_MAX_WORD_SIZE) { /* ignore large words */
+            while(p != end && isspace(*p)) { p++; }
             s = p;
             continue;
         }
@@ -370,7 +420,7 @@ nlk_text_make_words(char *buf, const ssize_t len, char **line, size_t *number)
 
     } /* end of buffer */
 
-    if(widx < NLK_MAX_LINE_SIZE - 1) {
+    if(widx < max_words) {
         return 0;
     }
 
@@ -443,7 +493,8 @@ nlk_read_line(int fd, char **line, size_t *number, char *buf)
 
     /* if(len == 1) => empty newline */
     if(len > 1) {
-        nlk_text_make_words(buf, len, line, number);
+        len = nlk_string_normalize(buf, len, __normalize);
+        nlk_text_make_words(buf, len, line, number, NLK_MAX_LINE_SIZE - 1);
     }
 
     if(bytes_read == 0) {
@@ -457,6 +508,88 @@ nlk_read_line(int fd, char **line, size_t *number, char *buf)
 }
 
 
+/**
+ * Reads at most NLK_CHUNK_SIZE words of a line.
+ * A line longer than that is returned as a sequence of chunks: the file is
+ * left at the first word not read so the next call continues the same line.
+ *
+ * @param fd        the file descriptor to read from
+ * @param line      where the words are stored (nlk_text_chunk_create)
+ * @param number    where the line number is stored - only at the start of
+ *                  a line, NULL when reading the rest of a line
+ * @param buf       buffer of NLK_CHUNK_BUFFER_SIZE
+ *
+ * @return '\n' or EOF at the end of the line, NLK_CHUNK if the line continues
+ */
+int
+nlk_read_chunk(int fd, char **line, size_t *number, char *buf)
+{
+    ssize_t  bytes_read = 0;            /**< bytes read by read(2) */
+    ssize_t  len        = 0;            /**< current length of buffer */
+    ssize_t  used       = 0;            /**< bytes of buf in this chunk */
+    ssize_t  word_start = 0;            /**< start of the current word */
+    size_t   words      = 0;            /**< words in the chunk */
+    bool     in_word    = false;
+    int      term       = EOF;
+    const size_t max_words = NLK_CHUNK_SIZE + (number != NULL ? 1 : 0);
+
+    /* inititialize some vars to hadle empty lines */
+    if(number != NULL) {
+        *number = (size_t) -1;
+    }
+    line[0][0] = '\0';
+
+    /* read until the newline, the word limit or the buffer is full */
+    while((bytes_read = read(fd, &buf[len], BUFFER_SIZE)) > 0) {
+        for(used = len; used < len + bytes_read; used++) {
+            if(buf[used] == '\n') {
+                term = '\n';
+                break;
+            } else if(isspace(buf[used])) {
+                in_word = false;
+            } else if(!in_word) {
+                if(words == max_words) {
+                    term = NLK_CHUNK;
+                    break;
+                }
+                in_word = true;
+                word_start = used;
+                words++;
+            }
+        }
+        if(term != EOF) {
+            /* return the bytes after the chunk (and newline) to the file */
+            lseek(fd, used + (term == '\n') - (len + bytes_read), SEEK_CUR);
+            len = used;
+            break;
+        }
+        len += bytes_read;
+
+        /* buffer full: split the line before the current word */
+        if(len + BUFFER_SIZE > NLK_CHUNK_BUFFER_SIZE) {
+            if(in_word && word_start > 0) {
+                lseek(fd, word_start - len, SEEK_CUR);
+                len = word_start;
+            }
+            term = NLK_CHUNK;
+            break;
+        }
+    }
+
+    if(bytes_read < 0) {
+        NLK_ERROR(strerror(errno), NLK_FAILURE);
+        /* unreachable */
+    }
+
+    if(len > 0) {
+        len = nlk_string_normalize(buf, len, __normalize);
+        nlk_text_make_words(buf, len, line, number, NLK_CHUNK_SIZE);
+    }
+
+    return term;
+}
+
+
 /**
  * Create text_line from string
  */
@@ -481,17 +614,21 @@ nlk_text_line_read(char *str, const ssize_t len, char **line)
         } /* p points to the token end, s to the token start */
 
         
-        if(p - s > NLK_MAX_WORD_SIZE) { /* ignore large words */
+        if(p - s >= NLK_MAX_WORD_SIZE) { /* ignore large words */
+            while(p != end && isspace(*p)) { p++; }
             s = p;
             continue;
         }
 
         /* copy without the terminator (whitespace or null) */
+        char *word = dest;
         while(s != p) { 
             *dest = *s;  
             dest++;
             s++;
         }
+        /* normalize the copy (str is left untouched) */
+        dest = word + nlk_string_normalize(word, dest - word, __normalize);
         /* NULL terminate word */
         *dest = '\0'; 
 
@@ -36,6 +36,8 @@
 #include <stdlib.h>
 #include <sys/types.h>
 
+#include "nlk_string.h"
+
 
 #define NLK_MAX_WORD_SIZE    256
 #define NLK_MAX_LINE_SIZE    100000
@@ -44,6 +46,12 @@
 #define BUFFER_SIZE (16 * 1024)
 #define NLK_BUFFER_SIZE (NLK_MAX_CHARS + BUFFER_SIZE)
 
+/* long lines are read as a stream of chunks of at most NLK_CHUNK_SIZE words */
+#define NLK_CHUNK_SIZE  10000
+#define NLK_CHUNK_CHARS (NLK_CHUNK_SIZE * NLK_MAX_WORD_SIZE)
+#define NLK_CHUNK_BUFFER_SIZE (NLK_CHUNK_CHARS + BUFFER_SIZE)
+#define NLK_CHUNK 2     /**< nlk_read_chunk: the line continues */
+
 
 
 #undef __BEGIN_DECLS
@@ -60,6 +68,7 @@ __BEGIN_DECLS
 
 /* create/free/size char **line */
 char    **nlk_text_line_create();
+char    **nlk_text_chunk_create();
 void    nlk_text_line_free(char **);
 size_t  nlk_text_line_size(char **line);
 
@@ -67,9 +76,13 @@ size_t  nlk_text_line_size(char **line);
 void    nlk_text_ascii_lower(char *st);
 
 /* read */
+void            nlk_text_set_normalize(const NLK_NORMALIZE);
+NLK_NORMALIZE   nlk_text_get_normalize();
+
 int      nlk_open(const char *);
 FILE    *nlk_fopen(const char *);
 int      nlk_read_line(int, char **, size_t *, char *);
+int      nlk_read_chunk(int, char **, size_t *, char *);
 void     nlk_text_line_read(char *, const ssize_t, char **);
 int      nlk_read_word(FILE *, char *, const size_t);
 size_t   nlk_read_word_from_string(const char *, const size_t, const size_t, 
@@ -268,3 +268,109 @@ nlk_rectifier_backprop(const NLK_ARRAY *output, const NLK_ARRAY *grad_out,
 
     
 }
+
+
+/**
+ * Row ii of a batch as a vector (view)
+ */
+static inline void
+nlk_transfer_row(const NLK_ARRAY *batch, const size_t ii, NLK_ARRAY *row)
+{
+    row->rows = batch->cols;
+    row->cols = 1;
+    row->len = batch->cols;
+    row->data = &batch->data[ii * batch->cols];
+    row->mapped = 0;
+    row->owner = NLK_ARRAY_OWNER_HEAP;
+}
+
+/**
+ * Transfer forward for a batch: one example per row. Element wise transfers
+ * run over the whole batch at once, softmax row by row.
+ *
+ * @param transfer  the transfer function
+ * @param input     the input [n][size]
+ * @param output    the output [n][size] (result, may be input for NONE)
+ */
+void
+nlk_transfer_forward(const NLK_TRANSFER transfer, const NLK_ARRAY *input, 
+                     NLK_ARRAY *output)
+{
+    NLK_ARRAY in_row;
+    NLK_ARRAY out_row;
+
+    switch(transfer) {
+        case NLK_TRANSFER_NONE:
+            if(output->data != input->data) {
+                nlk_array_copy(output, input);
+            }
+            break;
+        case NLK_TRANSFER_SIGMOID:
+            nlk_sigmoid_forward(input, output);
+            break;
+        case NLK_TRANSFER_HARDTANH:
+            nlk_hardtanh_forward(input, output);
+            break;
+        case NLK_TRANSFER_RECTIFIER:
+            nlk_rectifier_forward(input, output);
+            break;
+        case NLK_TRANSFER_LOG_SOFTMAX:
+            for(size_t ii = 0; ii < input->rows; ii++) {
+                nlk_transfer_row(input, ii, &in_row);
+                nlk_transfer_row(output, ii, &out_row);
+                nlk_log_softmax_forward(&in_row, &out_row);
+            }
+            break;
+        default:
+            NLK_ERROR_VOID("unknown transfer function", NLK_EINVAL);
+            /* unreachable */
+    }
+}
+
+/**
+ * Transfer backprop for a batch: one example per row.
+ *
+ * @param transfer  the transfer function
+ * @param input     the input of the forward step [n][size]
+ * @param output    the output of the forward step [n][size]
+ * @param grad_out  the gradient at the output [n][size]
+ * @param grad_in   the gradient at the input [n][size] (result, may be 
+ *                  grad_out for NONE)
+ */
+void
+nlk_transfer_backprop(const NLK_TRANSFER transfer, const NLK_ARRAY *input,
+                      const NLK_ARRAY *output, const NLK_ARRAY *grad_out,
+                      NLK_ARRAY *grad_in)
+{
+    NLK_ARRAY out_row;
+    NLK_ARRAY go_row;
+    NLK_ARRAY gi_row;
+
+    switch(transfer) {
+        case NLK_TRANSFER_NONE:
+            if(grad_in->data != grad_out->data) {
+                nlk_array_copy(grad_in, grad_out);
+            }
+            break;
+        case NLK_TRANSFER_SIGMOID:
+            nlk_sigmoid_backprop(output, grad_out, grad_in);
+            break;
+        case NLK_TRANSFER_HARDTANH:
+            nlk_hardtanh_backprop(input, grad_out, grad_in);
+            break;
+        case NLK_TRANSFER_RECTIFIER:
+            nlk_rectifier_backprop(output, grad_out, grad_in);
+            break;
+        case NLK_TRANSFER_LOG_SOFTMAX:
+            for(size_t ii = 0; ii < output->rows; ii++) {
+                nlk_transfer_row(output, ii, &out_row);
+                nlk_transfer_row(grad_out, ii, &go_row);
+                nlk_transfer_row(grad_in, ii, &gi_row);
+                nlk_log_softmax_backprop(&out_row, &go_row, &gi_row);
+            }
+            break;
+        default:
+            NLK_ERROR_VOID("unknown transfer function", NLK_EINVAL);
+            /* unreachable */
+    }
+}
@@ -47,6 +47,19 @@
 __BEGIN_DECLS
 
 
+/** @enum NLK_TRANSFER
+ * Transfer function applied after a layer (see nlk_exec_t)
+ */
+enum nlk_transfer_t {
+    NLK_TRANSFER_NONE           = 0,    /**< identity */
+    NLK_TRANSFER_SIGMOID        = 1,    /**< sigmoid */
+    NLK_TRANSFER_HARDTANH       = 2,    /**< hardtanh */
+    NLK_TRANSFER_RECTIFIER      = 3,    /**< rectified linear unit */
+    NLK_TRANSFER_LOG_SOFTMAX    = 4     /**< log softmax */
+};
+typedef enum nlk_transfer_t NLK_TRANSFER;
+
+
 /* sigmoid */
 void    nlk_sigmoid_forward(const NLK_ARRAY *, NLK_ARRAY *);
 void    nlk_sigmoid_backprop(const NLK_ARRAY *, const NLK_ARRAY *, 
@@ -73,6 +86,13 @@ void    nlk_rectifier_forward(const NLK_ARRAY *, NLK_ARRAY *);
 void    nlk_rectifier_backprop(const NLK_ARRAY *, const NLK_ARRAY *, 
                                NLK_ARRAY *);
 
+/* batch: one example per row */
+void    nlk_transfer_forward(const NLK_TRANSFER, const NLK_ARRAY *, 
+                             NLK_ARRAY *);
+void    nlk_transfer_backprop(const NLK_TRANSFER, const NLK_ARRAY *, 
+                              const NLK_ARRAY *, const NLK_ARRAY *, 
+                              NLK_ARRAY *);
+
 
 
 __END_DECLS
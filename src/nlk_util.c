@@ -25,11 +25,12 @@
 
 /** @file nlk_util.c
  * Utility functions
- * @TODO fix all these functions: assume sorted, create NLK_SET
  */
 
 #include <stdbool.h>
 #include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
 
 #include "nlk_err.h"
 #include "nlk_random.h"
@@ -37,8 +38,23 @@
 #include "nlk_util.h"
 
 
+/**
+ * Compare two unsigned ints (qsort)
+ */
+static int
+nlk_cmp_uint(const void *a, const void *b)
+{
+    const unsigned int x = *(const unsigned int *) a;
+    const unsigned int y = *(const unsigned int *) b;
+
+    return (x > y) - (x < y);
+}
+
+
 /**
  * Count unique elements in an array
+ * Values are marked in a bitmap when it is small relative to the array 
+ * (e.g. class labels) otherwise a sorted copy is counted.
  *
  * @param array     the array
  * @param length    the length of the array
@@ -49,34 +65,54 @@ size_t
 nlk_count_unique(const unsigned int *array, const size_t length)
 {
     size_t unique = 0;
-    bool is_unique = false;
-    unsigned int *seen = NULL;
+    unsigned int max = 0;
+    uint64_t *seen = NULL;
+    unsigned int *sorted = NULL;
 
-    seen = (unsigned int *) malloc(sizeof(unsigned int) * length);
-    if(seen == NULL) {
-        NLK_ERROR("unable to allocate memory for count unique", NLK_ENOMEM);
-        /* unreachable */
+    if(length == 0) {
+        return 0;
     }
-
-
-    /* for each element in the array */
     for(size_t ii = 0; ii < length; ii++) {
-        /* assume it's unique unless the value in found in seen */
-        is_unique = true;
-        for(size_t jj = 0; jj < unique; jj++) {
-            if(array[ii] == seen[jj]) {
-                is_unique = false; /* yes we've seen this */
-                break;
+        if(array[ii] > max) {
+            max = array[ii];
+        }
+    }
+
+    /* bitmap: one bit per possible value */
+    if(max / 64 <= length) {
+        seen = (uint64_t *) calloc(max / 64 + 1, sizeof(uint64_t));
+        if(seen == NULL) {
+            NLK_ERROR("unable to allocate memory for count unique", 
+                      NLK_ENOMEM);
+            /* unreachable */
+        }
+        for(size_t ii = 0; ii < length; ii++) {
+            const uint64_t bit = 1ULL << (array[ii] % 64);
+            if(!(seen[array[ii] / 64] & bit)) {
+                seen[array[ii] / 64] |= bit;
+                unique++;
             }
         }
-        /* if it is unique, add it to the seen array */
-        if(is_unique) {
-            seen[unique] = array[ii];
+        free(seen);
+        return unique;
+    }
+
+    /* sparse values: sort a copy */
+    sorted = (unsigned int *) malloc(sizeof(unsigned int) * length);
+    if(sorted == NULL) {
+        NLK_ERROR("unable to allocate memory for count unique", NLK_ENOMEM);
+        /* unreachable */
+    }
+    memcpy(sorted, array, sizeof(unsigned int) * length);
+    qsort(sorted, length, sizeof(unsigned int), nlk_cmp_uint);
+    unique = 1;
+    for(size_t ii = 1; ii < length; ii++) {
+        if(sorted[ii] != sorted[ii - 1]) {
             unique++;
         }
-    }   /* end of array */
+    }
 
-    free(seen);
+    free(sorted);
     return unique;
 }
 
@@ -128,30 +164,174 @@ nlk_in(const size_t value, const size_t *array, const size_t length)
     return false;
 }
 
+
+/** values per bitmap word */
+#define NLK_SET_WORD 64
+
+/** use a bitmap if it takes at most this many times the sorted array */
+#define NLK_SET_DENSITY 8
+
+
+static int
+nlk_set_cmp(const void *a, const void *b)
+{
+    const size_t x = *(const size_t *) a;
+    const size_t y = *(const size_t *) b;
+    return (x > y) - (x < y);
+}
+
+
 /**
- * set difference: elements in a not in b
+ * Create a set for membership tests
+ *
+ * @param values    the values in the set (any order, may repeat)
+ * @param len       the number of values
  *
- * @note
- * terribly inefficient and ugly implementation
- * @endnote
+ * @return the set or NULL on error
+ */
+struct nlk_set_t *
+nlk_set_create(const size_t *values, const size_t len)
+{
+    struct nlk_set_t *set = NULL;
+    size_t max = 0;
+    size_t words;
+
+    set = (struct nlk_set_t *) calloc(1, sizeof(struct nlk_set_t));
+    if(set == NULL) {
+        NLK_ERROR_NULL("unable to allocate memory for set", NLK_ENOMEM);
+        /* unreachable */
+    }
+
+    for(size_t ii = 0; ii < len; ii++) {
+        if(values[ii] >= max) {
+            max = values[ii] + 1;
+        }
+    }
+    set->max = max;
+    words = (max + NLK_SET_WORD - 1) / NLK_SET_WORD;
+
+    /* dense: bitmap */
+    if(words <= NLK_SET_DENSITY * len + NLK_SET_WORD) {
+        set->bits = (uint64_t *) calloc(words + 1, sizeof(uint64_t));
+        if(set->bits == NULL) {
+            free(set);
+            NLK_ERROR_NULL("unable to allocate memory for set", NLK_ENOMEM);
+            /* unreachable */
+        }
+        for(size_t ii = 0; ii < len; ii++) {
+            set->bits[values[ii] / NLK_SET_WORD] |= 
+                (uint64_t) 1 << (values[ii] % NLK_SET_WORD);
+        }
+        return set;
+    }
+
+    /* sparse: sorted unique values */
+    set->sorted = (size_t *) malloc(len * sizeof(size_t));
+    if(set->sorted == NULL) {
+        free(set);
+        NLK_ERROR_NULL("unable to allocate memory for set", NLK_ENOMEM);
+        /* unreachable */
+    }
+    memcpy(set->sorted, values, len * sizeof(size_t));
+    qsort(set->sorted, len, sizeof(size_t), nlk_set_cmp);
+
+    set->len = 0;
+    for(size_t ii = 0; ii < len; ii++) {
+        if(set->len == 0 || set->sorted[set->len - 1] != set->sorted[ii]) {
+            set->sorted[set->len] = set->sorted[ii];
+            set->len++;
+        }
+    }
+
+    return set;
+}
+
+
+/**
+ * Is value in the set? O(1) for a bitmap, O(log n) for a sorted set.
+ */
+bool
+nlk_set_in(const struct nlk_set_t *set, const size_t value)
+{
+    size_t lo = 0;
+    size_t hi = set->len;
+    size_t mid;
+
+    if(value >= set->max) {
+        return false;
+    }
+    if(set->bits != NULL) {
+        return (set->bits[value / NLK_SET_WORD] >> (value % NLK_SET_WORD)) & 1;
+    }
+
+    while(lo < hi) {
+        mid = lo + (hi - lo) / 2;
+        if(set->sorted[mid] < value) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo < set->len && set->sorted[lo] == value;
+}
+
+
+/**
+ * Free a set
  */
 void
+nlk_set_free(struct nlk_set_t *set)
+{
+    if(set == NULL) {
+        return;
+    }
+    free(set->bits);
+    free(set->sorted);
+    free(set);
+}
+
+
+/**
+ * set difference: elements in a not in b (in the order they appear in a)
+ *
+ * @param a     the array
+ * @param len_a the length of a
+ * @param b     the elements to exclude
+ * @param len_b the length of b
+ * @param len_r will hold the length of the result
+ *
+ * @return the elements of a not in b (caller frees) or NULL on error
+ */
+size_t *
 nlk_set_diff(const size_t *a, const size_t len_a, const size_t *b, 
-             const size_t len_b, size_t *r, size_t *len_r)
+             const size_t len_b, size_t *len_r)
 {
     size_t len = 0;
-    size_t ii = 0;
+    size_t *r = NULL;
+    struct nlk_set_t *set = NULL;
+
+    set = nlk_set_create(b, len_b);
+    if(set == NULL) {
+        return NULL;
+    }
+
+    r = (size_t *) malloc((len_a > 0 ? len_a : 1) * sizeof(size_t));
+    if(r == NULL) {
+        nlk_set_free(set);
+        NLK_ERROR_NULL("unable to allocate memory", NLK_ENOMEM);
+        /* unreachable */
+    }
 
-    r = (size_t *) malloc(len_a * sizeof(size_t));
-    for(ii = 0; ii < len_a; ii++) {
-        if(!nlk_in(a[ii], b, len_b)) {
+    for(size_t ii = 0; ii < len_a; ii++) {
+        if(!nlk_set_in(set, a[ii])) {
             r[len] = a[ii];
             len++;
         }
     }
+    nlk_set_free(set);
 
     *len_r = len;
-    r = (size_t *) realloc(r, len * sizeof(size_t));
+    return r;
 }
 
 /**
@@ -206,25 +386,36 @@ nlk_range_not_in(const size_t *a, const size_t len_a, const size_t n,
                  size_t *len_r)
 {
     size_t len = 0;
-    size_t *r = (size_t *) malloc(n * sizeof(size_t));
+    size_t *r = (size_t *) malloc((n > 0 ? n : 1) * sizeof(size_t));
     if(r == NULL) {
         NLK_ERROR_NULL("unable to allocate memory", NLK_ENOMEM);
+        /* unreachable */
+    }
+
+    /* mark a in a bitmap over [0, n[ */
+    uint64_t *bits = (uint64_t *) calloc(n / NLK_SET_WORD + 1, 
+                                         sizeof(uint64_t));
+    if(bits == NULL) {
+        free(r);
+        NLK_ERROR_NULL("unable to allocate memory", NLK_ENOMEM);
+        /* unreachable */
+    }
+    for(size_t ii = 0; ii < len_a; ii++) {
+        if(a[ii] < n) {
+            bits[a[ii] / NLK_SET_WORD] |= 
+                (uint64_t) 1 << (a[ii] % NLK_SET_WORD);
+        }
     }
 
     for(size_t ii = 0; ii < n; ii++) {
-        if(!nlk_in(ii, a, len_a)) {
+        if(!((bits[ii / NLK_SET_WORD] >> (ii % NLK_SET_WORD)) & 1)) {
             r[len] = ii;
             len++;
         }
     }
+    free(bits);
 
-    realloc(r, len * sizeof(size_t));
-    if(r == NULL) {
-        NLK_ERROR_NULL("unable to reallocate memory", NLK_ENOMEM);
-        /* unreachable */
-    }
     *len_r = len;
-
     return r;
 }
 
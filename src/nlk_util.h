@@ -31,6 +31,10 @@
 #ifndef __NLK_UTIL_H__
 #define __NLK_UTIL_H__
 
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
 
 #undef __BEGIN_DECLS
 #undef __END_DECLS
@@ -44,12 +48,32 @@
 __BEGIN_DECLS
 
 
+/** @struct nlk_set_t
+ * A set of indices for membership tests: a bitmap when the values are dense 
+ * enough, a sorted array (binary search) otherwise.
+ */
+struct nlk_set_t {
+    uint64_t    *bits;      /**< bitmap (NULL if sorted) */
+    size_t      *sorted;    /**< sorted unique values (NULL if bitmap) */
+    size_t       len;       /**< number of sorted values */
+    size_t       max;       /**< largest value + 1 */
+};
+typedef struct nlk_set_t NLK_SET;
+
+
 size_t   nlk_count_unique(const unsigned int *, const size_t);
 bool     nlk_in(const size_t, const size_t *, const size_t);
 size_t  *nlk_range(const size_t);
 void     nlk_shuffle_indices(size_t *, const size_t);
 size_t  *nlk_range_not_in(const size_t *, const size_t, const size_t, 
                           size_t *len_r);
+size_t  *nlk_set_diff(const size_t *, const size_t, const size_t *, 
+                      const size_t, size_t *);
+
+/* set */
+struct nlk_set_t   *nlk_set_create(const size_t *, const size_t);
+bool                nlk_set_in(const struct nlk_set_t *, const size_t);
+void                nlk_set_free(struct nlk_set_t *);
 size_t  nlk_unique(const size_t *, const size_t, size_t *);
 void    nlk_flatten(unsigned int **, const size_t, const unsigned int *, 
                     unsigned int *r);
@@ -188,7 +188,7 @@ nlk_vocab_read_add(struct nlk_vocab_t **vocabulary, const char *filepath,
     total_lines = nlk_text_count_lines(filepath);
     
     /* Limit the number of threads */
-    int num_threads = nlk_get_num_threads();
+    int num_threads = nlk_phase_begin(NLK_PHASE_VOCAB);
     if(num_threads > NLK_VOCAB_MAX_THREADS) {
         num_threads = NLK_VOCAB_MAX_THREADS;
     }
@@ -209,7 +209,7 @@ nlk_vocab_read_add(struct nlk_vocab_t **vocabulary, const char *filepath,
 
     /** @section Parallel Allocations and Initializations
      */
-#pragma omp parallel shared(line_counter, updated)
+#pragma omp parallel num_threads(num_threads) shared(line_counter, updated)
 {
     size_t zz;
     size_t cur_line;
@@ -222,6 +222,7 @@ nlk_vocab_read_add(struct nlk_vocab_t **vocabulary, const char *filepath,
     /* word */
     char *word = NULL;
     int ret = 0;
+    bool chunk = false;     /* reading the rest of a line */
 
     /* open file */
     int fd = nlk_open(filepath);
@@ -230,9 +231,9 @@ nlk_vocab_read_add(struct nlk_vocab_t **vocabulary, const char *filepath,
         /* unreachable */
     }
 
-    /* allocate memory for reading from the input file */
-    char **text_line = nlk_text_line_create();
-    char *buffer = (char *) malloc(sizeof(char) * NLK_BUFFER_SIZE);
+    /* allocate memory for reading chunks from the input file */
+    char **text_line = nlk_text_chunk_create();
+    char *buffer = (char *) malloc(sizeof(char) * NLK_CHUNK_BUFFER_SIZE);
     if(buffer == NULL) {
         NLK_ERROR_ABORT("failed to  allocate buffer for reading", NLK_ENOMEM);
         /* unreachable */
@@ -268,19 +269,22 @@ nlk_vocab_read_add(struct nlk_vocab_t **vocabulary, const char *filepath,
                 }
             }
 
-            /* read from file */
-            if(line_has_id) {
-                ret = nlk_read_line(fd, text_line, &par_id, buffer);
+            /* read from file: a long line is read in chunks */
+            chunk = ret == NLK_CHUNK;
+            if(line_has_id && !chunk) {
+                ret = nlk_read_chunk(fd, text_line, &par_id, buffer);
             } else {
-                ret = nlk_read_line(fd, text_line, NULL, buffer);
+                ret = nlk_read_chunk(fd, text_line, NULL, buffer);
                 par_id = cur_line;
             }
            
-            line_counter++;
-            cur_line++;
+            if(ret != NLK_CHUNK) {
+                line_counter++;
+                cur_line++;
+            }
 
             /* all sentences must start with </s> except empty lines */
-            if(text_line[0][0] != '\0') {
+            if(text_line[0][0] != '\0' && !chunk) {
                     start_symbol->count += 1;
             }
 
@@ -509,7 +513,8 @@ nlk_vocab_words_size(struct nlk_vocab_t **vocab)
     HASH_ITER(hh, *vocab, vocab_word, tmp) {
         if(vocab_word->word != NULL) {
             vt = vocab_word->type;
-            if(vt == NLK_VOCAB_WORD || vt == NLK_VOCAB_SPECIAL) {
+            if(vt == NLK_VOCAB_WORD || vt == NLK_VOCAB_SPECIAL || 
+               vt == NLK_VOCAB_BUCKET) {
                 n++;
             }
         }
@@ -714,6 +719,114 @@ void nlk_vocab_sort(struct nlk_vocab_t **vocab)
 }
 
 
+/**
+ * Sets the number of buckets in every bucket item of the vocabulary.
+ * Bucket items are counted, so this should be called after buckets are 
+ * created or loaded.
+ *
+ * @param vocab     the vocabulary structure
+ *
+ * @return the number of buckets in the vocabulary
+ */
+static size_t
+nlk_vocab_buckets_update(struct nlk_vocab_t **vocab)
+{
+    struct nlk_vocab_t *vi;
+    size_t buckets = 0;
+
+    for(vi = *vocab; vi != NULL; vi = vi->hh.next) {
+        if(vi->type == NLK_VOCAB_BUCKET) {
+            buckets++;
+        }
+    }
+    for(vi = *vocab; vi != NULL; vi = vi->hh.next) {
+        if(vi->type == NLK_VOCAB_BUCKET) {
+            vi->buckets = buckets;
+        }
+    }
+
+    return buckets;
+}
+
+/**
+ * Keep the most frequent words and map the rest into a fixed number of hash 
+ * buckets (the "hashing trick"). Each bucket is a vocabulary item that will 
+ * have the sum of the counts of the words hashed to it. Calls sort.
+ *
+ * Words not in the vocabulary are later mapped to the same buckets by 
+ * nlk_vocab_vocabularize, so the size of the vocabulary (and of the tables 
+ * that depend on it) is fixed regardless of the size of the corpus.
+ *
+ * @param vocab     the vocabulary structure
+ * @param min_count words with count < min_count are always hashed
+ * @param max_words maximum number of words to keep (0 = no limit)
+ * @param buckets   the number of hash buckets (> 0)
+ */
+void
+nlk_vocab_reduce_hash(struct nlk_vocab_t **vocab, const uint64_t min_count,
+                      const size_t max_words, const size_t buckets)
+{
+    struct nlk_vocab_t *vi;
+    struct nlk_vocab_t *tmp;
+    struct nlk_vocab_t *bucket;
+    struct nlk_vocab_t *first;
+    char bucket_word[NLK_MAX_WORD_SIZE];
+    size_t kept = 0;
+
+    if(buckets == 0) {
+        NLK_ERROR_VOID("number of buckets must be > 0", NLK_EINVAL);
+        /* unreachable */
+    }
+
+    /* create the buckets unless this is not the first call */
+    for(size_t bb = 0; bb < buckets; bb++) {
+        snprintf(bucket_word, NLK_MAX_WORD_SIZE, NLK_BUCKET_FORMAT, bb);
+        HASH_FIND_STR(*vocab, bucket_word, bucket);
+        if(bucket == NULL) {
+            bucket = nlk_vocab_add_item(vocab, bucket_word, 0, 
+                                        NLK_VOCAB_BUCKET);
+        }
+    }
+    if(nlk_vocab_buckets_update(vocab) != buckets) {
+        NLK_ERROR_VOID("number of buckets does not match existing vocabulary",
+                       NLK_EINVAL);
+        /* unreachable */
+    }
+    snprintf(bucket_word, NLK_MAX_WORD_SIZE, NLK_BUCKET_FORMAT, (size_t) 0);
+    HASH_FIND_STR(*vocab, bucket_word, first);
+
+    /* most frequent first */
+    HASH_SORT(*vocab, nlk_vocab_item_comparator);
+
+    HASH_ITER(hh, *vocab, vi, tmp) {
+        /* ignore special symbols and buckets */
+        if(vi->type != NLK_VOCAB_WORD) {
+            continue;
+        }
+        if(vi->count >= min_count && (max_words == 0 || kept < max_words)) {
+            kept++;
+            continue;
+        }
+
+        /* add the count to its bucket */
+        bucket = nlk_vocab_bucket(vocab, first, vi->word);
+        bucket->count += vi->count;
+
+        /* free structure contents */
+        if(vi->word != NULL) {
+            free(vi->word);
+            vi->word = NULL;
+        }
+        /* delete from hashmap and free structure **/
+        HASH_DEL(*vocab, vi);
+        free(vi);
+    }
+
+    /* call sort to update the index */
+    nlk_vocab_sort(vocab);
+}
+
+
 /**
  * Creates (alloc) a code structure for holding huffman coding data
  */
@@ -1005,6 +1118,7 @@ nlk_vocab_import(const char *filepath, const size_t max_word_size,
     struct nlk_vocab_t *vocab = nlk_vocab_init();
     struct nlk_vocab_t *vocab_item = NULL;
     struct nlk_vocab_t *start;
+    NLK_VOCAB_TYPE type;
     size_t index = 0;
 
     uint64_t count = 0;
@@ -1040,10 +1154,17 @@ nlk_vocab_import(const char *filepath, const size_t max_word_size,
             start->index = index;
         }
 
-        vocab_item = nlk_vocab_add_item(&vocab, word, count, NLK_VOCAB_WORD);
+        if(strncmp(word, NLK_BUCKET_PREFIX, strlen(NLK_BUCKET_PREFIX)) == 0) {
+            type = NLK_VOCAB_BUCKET;
+        } else {
+            type = NLK_VOCAB_WORD;
+        }
+
+        vocab_item = nlk_vocab_add_item(&vocab, word, count, type);
         vocab_item->index = index;
         index++;
     }
+    nlk_vocab_buckets_update(&vocab);
 
     /* free/close */
     free(word);
@@ -1193,6 +1314,7 @@ nlk_vocab_load(FILE *file)
     }
 
     nlk_vocab_sort(&vocab);
+    nlk_vocab_buckets_update(&vocab);
     return vocab;
 
 
@@ -1220,6 +1342,80 @@ nlk_vocab_find(struct nlk_vocab_t **vocab, char *word)
     return vocab_word;
 }
 
+/**
+ * Hash a string (FNV-1a followed by a 64bit finalizer)
+ *
+ * @param str       the string
+ * @param len       the length of the string
+ *
+ * @return the hash value
+ */
+uint64_t
+nlk_vocab_hash(const char *str, const size_t len)
+{
+    uint64_t h = 14695981039346656037ULL;
+
+    for(size_t ii = 0; ii < len; ii++) {
+        h ^= (unsigned char) str[ii];
+        h *= 1099511628211ULL;
+    }
+
+    return nlk_random_fmix(h);
+}
+
+/**
+ * Find the hash bucket for a word (string)
+ *
+ * @param vocab     the vocabulary
+ * @param first     the first bucket (bucket 0)
+ * @param word      the word
+ *
+ * @return the bucket vocabulary item the word hashes to
+ */
+struct nlk_vocab_t *
+nlk_vocab_bucket(struct nlk_vocab_t **vocab, struct nlk_vocab_t *first,
+                 const char *word)
+{
+    struct nlk_vocab_t *bucket;
+    char bucket_word[NLK_MAX_WORD_SIZE];
+    size_t bb = nlk_vocab_hash(word, strlen(word)) % first->buckets;
+
+    if(bb == 0) {
+        return first;
+    }
+
+    snprintf(bucket_word, NLK_MAX_WORD_SIZE, NLK_BUCKET_FORMAT, bb);
+    HASH_FIND_STR(*vocab, bucket_word, bucket);
+
+    return bucket;
+}
+
+/**
+ * Returns the item used to replace words not in the vocabulary: the first 
+ * hash bucket if the vocabulary has buckets, the unknown symbol if it was
+ * reduced with replacement.
+ *
+ * @param vocab     the vocabulary
+ *
+ * @return the replacement vocabulary item or NULL if there is none
+ */
+struct nlk_vocab_t *
+nlk_vocab_get_replacement(struct nlk_vocab_t **vocab)
+{
+    struct nlk_vocab_t *vi;
+    char bucket_word[NLK_MAX_WORD_SIZE];
+
+    snprintf(bucket_word, NLK_MAX_WORD_SIZE, NLK_BUCKET_FORMAT, (size_t) 0);
+    HASH_FIND_STR(*vocab, bucket_word, vi);
+    if(vi != NULL) {
+        return vi;
+    }
+
+    HASH_FIND_STR(*vocab, NLK_UNK_SYMBOL, vi);
+
+    return vi;
+}
+
 /**
  * Find a word (string) in the vocabulary
  *
@@ -1301,6 +1497,30 @@ nlk_vocab_neg_table_save(struct nlk_vocab_t **vocab, size_t *neg_table, size_t s
     fp = NULL;
 }
 
+/* entries in NEG tables created by the neural networks */
+static size_t __neg_table_size = NLK_NEG_TABLE_SIZE;
+
+/**
+ * Set the size of the NEG tables created for training and inference
+ * (smaller tables use less memory, the distribution is coarser)
+ */
+void
+nlk_vocab_neg_table_set_size(const size_t size)
+{
+    __neg_table_size = size > 0 ? size : NLK_NEG_TABLE_SIZE;
+}
+
+
+/**
+ * Get the size of the NEG tables created for training and inference
+ */
+size_t
+nlk_vocab_neg_table_get_size()
+{
+    return __neg_table_size;
+}
+
+
 /**
  * Create NEG table
  *
@@ -1385,35 +1605,42 @@ nlk_vocab_line_subsample(const struct nlk_line_t *in,
                          const float sample, struct nlk_line_t *out)
 {
     struct nlk_vocab_t *vocab_word;
-    float prob;                     /* probability of being sampled */
-    float r;                        /* random number */
+    float prob[NLK_RNG_BLOCK];      /* probability of being sampled */
+    bool keep[NLK_RNG_BLOCK];       /* sampled? */
+    struct nlk_rng_t *rng = nlk_rng_thread();
+    const float threshold = sample * total_words;
     size_t out_idx = 0;
+    size_t n;
 
     out->line_id = in->line_id;
 
-    for(size_t ii = 0; ii < in->len; ii++) {
-        vocab_word = in->varray[ii];
-        if(sample <= 0) {
-            /* simply copy */
-            out->varray[out_idx] = vocab_word;
-            out_idx++;
-            continue;
+    if(sample <= 0) {
+        /* simply copy */
+        for(size_t ii = 0; ii < in->len; ii++) {
+            out->varray[ii] = in->varray[ii];
         }
-        /* calculate sampling probability */
-        prob = sqrt((float)vocab_word->count / (sample * total_words)) + 1;
-        prob *= (sample * total_words) / (float) vocab_word->count;
+        out->len = in->len;
+        return;
+    }
 
-        /* "flip coin " */
-        r = nlk_random_xs1024_float();
-        if(prob < r) {
-            continue;
-            /* 
-             * word was not sampled 
-             * unreachable
-             */
-        } else {
-            out->varray[out_idx] = vocab_word;
-            out_idx++;
+    /* "flip coins" a block of words at a time */
+    for(size_t start = 0; start < in->len; start += NLK_RNG_BLOCK) {
+        n = in->len - start < NLK_RNG_BLOCK ? in->len - start : NLK_RNG_BLOCK;
+
+        /* calculate sampling probabilities */
+        for(size_t ii = 0; ii < n; ii++) {
+            vocab_word = in->varray[start + ii];
+            prob[ii] = sqrt((float)vocab_word->count / threshold) + 1;
+            prob[ii] *= threshold / (float) vocab_word->count;
+        }
+
+        nlk_rng_keep(rng, prob, n, keep);
+
+        for(size_t ii = 0; ii < n; ii++) {
+            if(keep[ii]) {
+                out->varray[out_idx] = in->varray[start + ii];
+                out_idx++;
+            }
         }
     } /* end of input array */
 
@@ -1442,6 +1669,9 @@ nlk_vocab_line_subsample(const struct nlk_line_t *in,
  * as if it was not there and the returned size will be small than the size of 
  * the paragraph.
  *
+ * If replacement is a hash bucket (see nlk_vocab_reduce_hash), the word will 
+ * be replaced by the bucket it hashes to.
+ *
  * @endnote
  */
 size_t
@@ -1462,7 +1692,12 @@ nlk_vocab_vocabularize(struct nlk_vocab_t **vocab,  char **paragraph,
             vec_idx++;
         } else if(vocab_word == NULL && replacement != NULL) { 
             /* word NOT in vocabulary but will be replaced */ 
-            varray[vec_idx] = replacement;
+            if(replacement->type == NLK_VOCAB_BUCKET) {
+                varray[vec_idx] = nlk_vocab_bucket(vocab, replacement,
+                                                   paragraph[par_idx]);
+            } else {
+                varray[vec_idx] = replacement;
+            }
             vec_idx++;
         }
         /* word not in vocabulary, not replacing, do nothing */
@@ -1494,12 +1729,13 @@ nlk_vocab_count_words_worker(struct nlk_vocab_t **vocab, const char *file_path,
         par_id_ptr = NULL;
 
     }
-    /* allocate memory for reading from the input file */
-    char **text_line = nlk_text_line_create();
-    char *buffer = malloc(sizeof(char) * NLK_BUFFER_SIZE);
+    /* allocate memory for reading chunks from the input file */
+    char **text_line = nlk_text_chunk_create();
+    char *buffer = malloc(sizeof(char) * NLK_CHUNK_BUFFER_SIZE);
 
     /* for converting to a vocabularized representation of text */
-    struct nlk_vocab_t *vectorized[NLK_MAX_LINE_SIZE];
+    struct nlk_vocab_t *vectorized[NLK_CHUNK_SIZE];
+    struct nlk_vocab_t *replacement = nlk_vocab_get_replacement(vocab);
 
     /* open file */
     errno = 0;
@@ -1518,17 +1754,20 @@ nlk_vocab_count_words_worker(struct nlk_vocab_t **vocab, const char *file_path,
 
     /**@section Count
      */
-    while(ret != EOF && cur_line < end_line) {
-        /* read line */
-        ret = nlk_read_line(fd, text_line, par_id_ptr, buffer);
+    while(ret != EOF && cur_line <= end_line) {
+        /* read line (chunk), the id is only at the start of the line */
+        ret = nlk_read_chunk(fd, text_line, 
+                             ret == NLK_CHUNK ? NULL : par_id_ptr, buffer);
         
         /* vocabularize */
-        line_len = nlk_vocab_vocabularize(vocab, text_line, NULL, 
+        line_len = nlk_vocab_vocabularize(vocab, text_line, replacement, 
                                           vectorized); 
 
         /* increment word and line counts */
         total_words += line_len;
-        cur_line++;
+        if(ret != NLK_CHUNK) {
+            cur_line++;
+        }
     }
 
     /* end of file */
@@ -1549,13 +1788,13 @@ nlk_vocab_count_words(struct nlk_vocab_t **vocab, const char *file_path,
                       const bool line_ids, const size_t total_lines)
 {
     size_t total_words = 0;
-    int num_threads = omp_get_num_threads();
+    int num_threads = nlk_phase_begin(NLK_PHASE_COUNT);
 
     /** @section Parallel Count (Map)
      */
 #pragma omp parallel for reduction(+ : total_words)
     for(int thread_id = 0; thread_id < num_threads; thread_id++) {
-        total_words = nlk_vocab_count_words_worker(vocab, file_path,
+        total_words += nlk_vocab_count_words_worker(vocab, file_path,
                                                    line_ids, total_lines, 
                                                    thread_id, num_threads);
     }
@@ -1602,6 +1841,36 @@ nlk_vocab_read_vocabularize(int fd, const bool line_ids,
 #endif
 }
 
+/**
+ * Read a chunk of a line from file and vocabularize it.
+ *
+ * @param fd        the file descriptor to read from
+ * @param line_id   read the line id (only at the start of a line)
+ * @param vocab     the vocabulary
+ * @param text_line temporary memory for text read (nlk_text_chunk_create)
+ * @param v         vocalularized chunk (NLK_CHUNK_SIZE)
+ * @param buf       buffer of NLK_CHUNK_BUFFER_SIZE
+ *
+ * @return '\n' or EOF at the end of the line, NLK_CHUNK if the line continues
+ */
+int
+nlk_vocab_read_vocabularize_chunk(int fd, const bool line_id,
+                                  struct nlk_vocab_t **vocab, 
+                                  struct nlk_vocab_t *replacement,
+                                  char **text_line, struct nlk_line_t *v, 
+                                  char *buf)
+{
+    int ret;
+
+    /* read text */
+    ret = nlk_read_chunk(fd, text_line, line_id ? &v->line_id : NULL, buf);
+
+    /* vocabularize */
+    v->len = nlk_vocab_vocabularize(vocab, text_line, replacement, v->varray); 
+
+    return ret;
+}
+
 /**
  * Create a line 
  *
@@ -1630,6 +1899,8 @@ nlk_line_create(const size_t size) {
         NLK_ERROR_NULL("insufficient memory for line", NLK_ENOMEM);
         /* unreachable */
     }
+    line->len = 0;
+    line->line_id = 0;
 
     return line;
 }
@@ -52,6 +52,8 @@ __BEGIN_DECLS
 
 #define NLK_START_SYMBOL "</s>"               /**< PADDING symbol */
 #define NLK_UNK_SYMBOL "<UNK>"
+#define NLK_BUCKET_PREFIX "<BUCKET_"          /**< hash bucket item prefix */
+#define NLK_BUCKET_FORMAT NLK_BUCKET_PREFIX "%zu>"
 #define NLK_MAX_CODE 40
 #define NLK_VOCAB_MAX_THREADS 512             /**< maximum number of threads */
 #define NLK_VOCAB_MIN_SIZE_THREADED (long)1e4 /**< min lines to use threads */
@@ -66,7 +68,8 @@ enum nlk_vocab_type_t {
     NLK_VOCAB_WORD      = 0, 
     NLK_VOCAB_SPECIAL   = 1,
     NLK_VOCAB_CHAR      = 2,
-    NLK_VOCAB_LABEL     = 3
+    NLK_VOCAB_LABEL     = 3,
+    NLK_VOCAB_BUCKET    = 4
 };
 typedef enum nlk_vocab_type_t NLK_VOCAB_TYPE;
 
@@ -98,6 +101,7 @@ struct nlk_vocab_t {
     size_t                   index;     /**< sorted index position */
     uint64_t                 count;     /**< word count */
     struct nlk_vocab_code_t *hc;        /**< huffman code */
+    size_t                   buckets;   /**< hash buckets (bucket items) */
     UT_hash_handle           hh;        /**< handle for hash table */
 };
 typedef struct nlk_vocab_t NLK_VOCAB;
@@ -137,6 +141,9 @@ void                  nlk_vocab_free(struct nlk_vocab_t **);
 void                  nlk_vocab_reduce(struct nlk_vocab_t **, const uint64_t);
 void                  nlk_vocab_reduce_replace(struct nlk_vocab_t **, 
                                                const size_t);
+void                  nlk_vocab_reduce_hash(struct nlk_vocab_t **, 
+                                            const uint64_t, const size_t,
+                                            const size_t);
 /* stats */
 size_t       nlk_vocab_size(struct nlk_vocab_t **);
 size_t       nlk_vocab_words_size(struct nlk_vocab_t **);
@@ -163,15 +170,25 @@ size_t  nlk_vocab_vocabularize(struct nlk_vocab_t **, char **,
 void    nlk_vocab_read_vocabularize(int, const bool, struct nlk_vocab_t **, 
                                     struct nlk_vocab_t *, char **, 
                                     struct nlk_line_t *, char *);
+int     nlk_vocab_read_vocabularize_chunk(int, const bool, 
+                                          struct nlk_vocab_t **, 
+                                          struct nlk_vocab_t *, char **, 
+                                          struct nlk_line_t *, char *);
 
 void         nlk_vocab_print_line(struct nlk_vocab_t **, size_t, bool);
 
 /* NEG table */
 size_t      *nlk_vocab_neg_table_create(struct nlk_vocab_t **, const size_t, 
                                         double);
+void         nlk_vocab_neg_table_set_size(const size_t);
+size_t       nlk_vocab_neg_table_get_size();
 
 /* find */
 struct nlk_vocab_t   *nlk_vocab_find(struct nlk_vocab_t **, char *);
+struct nlk_vocab_t   *nlk_vocab_bucket(struct nlk_vocab_t **, 
+                                       struct nlk_vocab_t *, const char *);
+struct nlk_vocab_t   *nlk_vocab_get_replacement(struct nlk_vocab_t **);
+uint64_t              nlk_vocab_hash(const char *, const size_t);
 struct nlk_vocab_t   *nlk_vocab_at_index(struct nlk_vocab_t **, size_t);
 /*size_t       nlk_vocab_last_id(struct nlk_vocab_t **); */
 size_t                nlk_vocab_last_index(struct nlk_vocab_t **);
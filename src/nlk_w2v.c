@@ -29,8 +29,10 @@
 
 #include <time.h>
 #include <errno.h>
+#include <string.h>
 #include <math.h>
 #include <float.h>
+#include <sys/mman.h>
 
 #include <omp.h>
 
@@ -42,17 +44,34 @@
 #include "nlk_window.h"
 #include "nlk_neuralnet.h"
 #include "nlk_layer_lookup.h"
+#include "nlk_subword.h"
 #include "nlk_tic.h"
 #include "nlk_text.h"
 #include "nlk_transfer.h"
 #include "nlk_criterion.h"
 #include "nlk_learn_rate.h"
 #include "nlk_util.h"
+#include "nlk_snapshot.h"
 #include "nlk.h"
 
 #include "nlk_w2v.h"
 
 
+/** snapshots of the network published while training (NULL: none) */
+static struct nlk_publisher_t *__publisher = NULL;
+
+
+/**
+ * Set the publisher of the snapshots taken while training (NULL: none).
+ * Readers pin the snapshots concurrently with nlk_w2v; the last one is 
+ * published when training returns.
+ */
+void
+nlk_w2v_set_publisher(struct nlk_publisher_t *pub)
+{
+    __publisher = pub;
+}
+
 
 /**
  * Word2Vec style progress display.
@@ -135,8 +154,11 @@ nlk_w2v_create(struct nlk_nn_train_t train_opts, const bool concat,
 
 
 
-    /* Word Table */
-    nn->words = nlk_layer_lookup_create(vocab_size, vector_size);
+    /* Word Table: pure PV-DBOW trains no word vectors, a single row keeps 
+     * the vector size for the code that reads it from the table */
+    const size_t word_rows = train_opts.model_type == NLK_PVDBOW_PURE ? 1 : 
+                             vocab_size;
+    nn->words = nlk_layer_lookup_create(word_rows, vector_size);
     if(verbose) {
         printf("Layer 1 (word lookup): %zu x %zu\n",
                 nn->words->weights->rows, nn->words->weights->cols);
@@ -146,8 +168,19 @@ nlk_w2v_create(struct nlk_nn_train_t train_opts, const bool concat,
 
 
     /* Paragraph Table */
-    if(nn->train_opts.paragraph) {
+    if(nn->train_opts.paragraph && train_opts.paragraph_map != NULL) {
+        /* backed by a file: can exceed memory, persisted while training */
+        NLK_ARRAY *pvs = nlk_array_create_map(train_opts.paragraph_map, 
+                                              paragraph_size, vector_size);
+        nn->paragraphs = nlk_layer_lookup_create_from_array(pvs);
+        if(nn->paragraphs == NULL) {
+            nlk_neuralnet_free(nn);
+            return NULL;
+        }
+    } else if(nn->train_opts.paragraph) {
         nn->paragraphs = nlk_layer_lookup_create(paragraph_size, vector_size);
+    }
+    if(nn->train_opts.paragraph) {
         if(verbose) {
             printf("Layer 1 (paragraph lookup): %zu x %zu\n",
                    nn->paragraphs->weights->rows,
@@ -182,73 +215,284 @@ nlk_w2v_create(struct nlk_nn_train_t train_opts, const bool concat,
 
     nn->neg_table = NULL;
 
+    /* Subword (char n-gram) Table */
+    if(nn->train_opts.subword_buckets > 0) {
+        if(concat) {
+            nlk_neuralnet_free(nn);
+            NLK_ERROR_NULL("subwords are not supported by concat models", 
+                           NLK_EINVAL);
+            /* unreachable */
+        }
+        nn->subwords = nlk_subword_create(&nn->vocab, 
+                                          nn->train_opts.subword_buckets,
+                                          vector_size,
+                                          nn->train_opts.subword_min,
+                                          nn->train_opts.subword_max,
+                                          NLK_SUBWORD_CACHE_SIZE);
+        if(nn->subwords == NULL) {
+            nlk_neuralnet_free(nn);
+            return NULL;
+        }
+        if(verbose) {
+            printf("Layer 1 (subword lookup): %zu x %zu\n",
+                   nn->subwords->ngrams->weights->rows,
+                   nn->subwords->ngrams->weights->cols);
+        }
+    }
+
     return nn;
 }
 
 
+/* per thread buffer for the gathered HS node rows of a target (and a copy
+ * of them as gathered, for writing back only the changes) */
+static __thread nlk_real *__hs_nodes = NULL;
+static __thread size_t __hs_nodes_len = 0;
+
+/**
+ * Frees the calling thread's HS node buffer (end of a parallel region)
+ */
+void
+nlk_w2v_thread_free()
+{
+    free(__hs_nodes);
+    __hs_nodes = NULL;
+    __hs_nodes_len = 0;
+}
+
+/**
+ * Gathers the HS node (point) rows of a target word into a contiguous 
+ * [length][layer2 size] per thread buffer. If the layer is updated, a copy
+ * of the rows follows the gathered rows (see nlk_w2v_hs_scatter).
+ *
+ * @param nn            the neural network structure
+ * @param center_word   the center/target word
+ *
+ * @return the gathered rows
+ */
+static nlk_real *
+nlk_w2v_hs_gather(struct nlk_neuralnet_t *nn, 
+                  const struct nlk_vocab_t *center_word)
+{
+    const size_t cols = nn->hs->weights->cols;
+    const size_t nodes_len = (size_t) center_word->hc->length * cols;
+    const size_t len = nn->hs->update ? 2 * nodes_len : nodes_len;
+
+    if(len > __hs_nodes_len) {
+        nlk_real *nodes = realloc(__hs_nodes, len * sizeof(nlk_real));
+        if(nodes == NULL) {
+            NLK_ERROR_ABORT("unable to allocate memory for HS nodes", 
+                            NLK_ENOMEM);
+            /* unreachable */
+        }
+        __hs_nodes = nodes;
+        __hs_nodes_len = len;
+    }
+
+    for(size_t pp = 0; pp < center_word->hc->length; pp++) {
+        nlk_carray_copy_carray(&__hs_nodes[pp * cols], 
+                &nn->hs->weights->data[center_word->hc->point[pp] * cols],
+                cols);
+    }
+    if(nn->hs->update) {
+        nlk_carray_copy_carray(&__hs_nodes[nodes_len], __hs_nodes, nodes_len);
+    }
+
+    return __hs_nodes;
+}
+
+/**
+ * Adds the changes made to the gathered HS node rows to the HS layer: 
+ * row += gathered - original. Only the change is written so concurrent 
+ * (Hogwild) updates made by other threads to the same rows are kept.
+ *
+ * @param nn            the neural network structure
+ * @param center_word   the center/target word
+ * @param nodes         the gathered rows (see nlk_w2v_hs_gather)
+ */
+static void
+nlk_w2v_hs_scatter(struct nlk_neuralnet_t *nn, 
+                   const struct nlk_vocab_t *center_word, 
+                   const nlk_real *nodes)
+{
+    const size_t cols = nn->hs->weights->cols;
+    const nlk_real *orig = &nodes[(size_t) center_word->hc->length * cols];
+
+    if(!nn->hs->update) {
+        return;
+    }
+
+    for(size_t pp = 0; pp < center_word->hc->length; pp++) {
+        nlk_real *row = 
+            &nn->hs->weights->data[center_word->hc->point[pp] * cols];
+        const nlk_real *node = &nodes[pp * cols];
+        const nlk_real *node_orig = &orig[pp * cols];
+        for(size_t cc = 0; cc < cols; cc++) {
+            row[cc] += node[cc] - node_orig[cc];
+        }
+    }
+}
+
+/**
+ * Hierarchical Softmax gradient at the output for all nodes of a target
+ *
+ * @param center_word   the center/target word
+ * @param lk2_out       the node scores
+ * @param learn_rate    the learning rate
+ * @param grad_out      the gradient for each node (output)
+ */
+static inline void
+nlk_w2v_hs_grad(const struct nlk_vocab_t *center_word, 
+                const nlk_real *lk2_out, const nlk_real learn_rate,
+                nlk_real *grad_out)
+{
+    const size_t length = center_word->hc->length;
+    nlk_real out[NLK_MAX_CODE];
+
+    nlk_sigmoid_vector(lk2_out, length, out);
+
+    /** Backprop
+     * Using the negative log likelihood,
+     *
+     * log(sigma(z=v'n(w,j))'vwi) =
+     * = (1 - code) * z - log(1 + e^z)
+     * d/dx = 1 - code  - sigmoid(z)
+     *
+     * points with outputs outside of sigm bounds are ignored
+     */
+    for(size_t pp = 0; pp < length; pp++) {
+        grad_out[pp] = (1.0 - center_word->hc->code[pp] - out[pp]) * 
+                       learn_rate;
+        grad_out[pp] = (lk2_out[pp] >= NLK_MAX_EXP || 
+                        lk2_out[pp] <= -NLK_MAX_EXP) ? 0 : grad_out[pp];
+    }
+}
+
 /**
- * Hierarchical Softmax
+ * Hierarchical Softmax on gathered node rows: all scores in one GEMV, the
+ * gradient at the input in one transposed GEMV and the node updates in one
+ * rank-1 update (of the gathered rows).
+ *
  * @param nn            the neural network structure
  * @param lk1_out       the output of the previous layer, input to this one
  * @param learn_rate    the learning rate
  * @param center_word   the center/target word
+ * @param nodes         the gathered node rows (updated)
  * @param grad_acc      the accumulated gradient (updated)
  */
 static void
-nlk_w2v_hs(struct nlk_neuralnet_t *nn, const NLK_ARRAY *lk1_out,
-           const nlk_real learn_rate, const struct nlk_vocab_t *center_word,
-           NLK_ARRAY *grad_acc)
+nlk_w2v_hs_nodes(struct nlk_neuralnet_t *nn, const NLK_ARRAY *lk1_out,
+                 const nlk_real learn_rate, 
+                 const struct nlk_vocab_t *center_word, nlk_real *nodes,
+                 NLK_ARRAY *grad_acc)
 {
-    nlk_real out;
-    nlk_real lk2_out;
-    nlk_real grad_out;
-    uint32_t point;
-    uint8_t code;
+    nlk_real lk2_out[NLK_MAX_CODE];
+    nlk_real grad_out[NLK_MAX_CODE];
+    const size_t length = center_word->hc->length;
+    const size_t cols = nn->hs->weights->cols;
 
     /** @section Hierarchical Softmax Forward
      * the center word (target) gets forwarded through the second lookup
      * layer. The second lookup layer "maps" points to codes
-     * (through the output softmax)
+     * (through the output softmax): lk2_out = nodes * lk1_out
      */
+    cblas_sgemv(CblasRowMajor, CblasNoTrans, length, cols, 1.0, nodes, cols,
+                lk1_out->data, 1, 0.0, lk2_out, 1);
+    nlk_w2v_hs_grad(center_word, lk2_out, learn_rate, grad_out);
+
+    /* accumulate gradient for all points: grad_acc += nodes' * grad_out */
+    cblas_sgemv(CblasRowMajor, CblasTrans, length, cols, 1.0, nodes, cols,
+                grad_out, 1, 1.0, grad_acc->data, 1);
+
+    /* learn node weights: nodes += grad_out * lk1_out' */
+    if(nn->hs->update) {
+        cblas_sger(CblasRowMajor, length, cols, 1.0, grad_out, 1, 
+                   lk1_out->data, 1, nodes, cols);
+    }
+}
 
-    /* for each point of center word */
-    for(size_t pp = 0; pp < center_word->hc->length; pp++) {
-        point = center_word->hc->point[pp];
-        code = center_word->hc->code[pp];
-
-        /* forward with lookup for point pp */
-        nlk_layer_lookup_forward(nn->hs, lk1_out, point, &lk2_out);
+/**
+ * Hierarchical Softmax for a single example, on the node rows in place 
+ * (nothing to amortize a gather over): the scores are computed first so 
+ * the sigmoid is vectorized across nodes.
+ *
+ * @param nn            the neural network structure
+ * @param lk1_out       the output of the previous layer, input to this one
+ * @param learn_rate    the learning rate
+ * @param center_word   the center/target word
+ * @param grad_acc      the accumulated gradient (updated)
+ */
+static void
+nlk_w2v_hs(struct nlk_neuralnet_t *nn, const NLK_ARRAY *lk1_out,
+           const nlk_real learn_rate, const struct nlk_vocab_t *center_word,
+           NLK_ARRAY *grad_acc)
+{
+    /* zeroed: the compiler cannot see the lookups write the first length */
+    nlk_real lk2_out[NLK_MAX_CODE] = {0};
+    nlk_real grad_out[NLK_MAX_CODE];
+    const size_t length = center_word->hc->length;
+
+    /* forward with lookup for each point */
+    for(size_t pp = 0; pp < length; pp++) {
+        nlk_layer_lookup_forward(nn->hs, lk1_out, center_word->hc->point[pp],
+                                 &lk2_out[pp]);
+    }
+    nlk_w2v_hs_grad(center_word, lk2_out, learn_rate, grad_out);
 
-        /* ignore points with outputs outside of sigm bounds */
-        if(lk2_out >= NLK_MAX_EXP) {
-            continue;
-        } else if(lk2_out <= -NLK_MAX_EXP) {
+    /* accumulate gradient for all points and learn the node weights */
+    for(size_t pp = 0; pp < length; pp++) {
+        if(grad_out[pp] == 0) {
             continue;
         }
-        out = nlk_sigmoid(lk2_out);
-
+        nlk_layer_lookup_backprop_acc(nn->hs, lk1_out, 
+                                      center_word->hc->point[pp], grad_out[pp],
+                                      grad_acc);
+    }
+}
 
-        /** Backprop
-         * Using the negative log likelihood,
-         *
-         * log(sigma(z=v'n(w,j))'vwi) =
-         * = (1 - code) * z - log(1 + e^z)
-         * d/dx = 1 - code  - sigmoid(z)
-         */
-        /* error */
-        grad_out = code - out;
 
-        /* gradient */
-        grad_out = 1.0 - grad_out;
+/**
+ * Negative Sampling for a batch of examples
+ *
+ * @param nn            the neural network structure
+ * @param learn_rate    the learning rate
+ * @param targets       the examples
+ * @param n             the number of examples
+ * @param positive      the first example is the positive example
+ * @param lk1_out       the output of the previous layer, input to this one
+ * @param grad_acc      the accumulated gradient (output)
+ */
+static void
+nlk_w2v_neg_batch(struct nlk_neuralnet_t *nn, const nlk_real learn_rate,
+                  const size_t *targets, const size_t n, const bool positive,
+                  const NLK_ARRAY *lk1_out, NLK_ARRAY *grad_acc)
+{
+    nlk_real lk2_out[NLK_RNG_BLOCK];
+    nlk_real out[NLK_RNG_BLOCK];
+    nlk_real grad_out;
 
-        /* multiply by learning rate */
-        grad_out *= learn_rate;
+    /* forward with lookup for all examples */
+    for(size_t ii = 0; ii < n; ii++) {
+        nlk_layer_lookup_forward(nn->neg, lk1_out, targets[ii], &lk2_out[ii]);
+    }
+    nlk_sigmoid_vector(lk2_out, n, out);
 
-        /* layer2hs backprop, accumulate gradient for all points */
-        nlk_layer_lookup_backprop_acc(nn->hs, lk1_out, point, grad_out,
-                                      grad_acc);
+    /** NEG Sampling Backprop
+     * Same gradient formula as in HS: label is 1 for the positive example
+     * and 0 for the negative examples. Outside of the sigmoid bounds the
+     * output is 0 or 1: either no error or the full learning rate.
+     */
+    for(size_t ii = 0; ii < n; ii++) {
+        const nlk_real label = (ii == 0 && positive) ? 1.0 : 0.0;
+        grad_out = (label - out[ii]) * learn_rate;
+        if(grad_out == 0) {
+            continue;
+        }
 
-    } /* end of points/codes */
+       /* Backprop and accumulate gradient for all examples */
+        nlk_layer_lookup_backprop_acc(nn->neg, lk1_out, targets[ii],
+                                      grad_out, grad_acc);
+    }
 }
 
 
@@ -267,80 +511,48 @@ nlk_w2v_neg(struct nlk_neuralnet_t *nn, const nlk_real learn_rate,
             const size_t center_word, const NLK_ARRAY *lk1_out,
             NLK_ARRAY *grad_acc)
 {
-    nlk_real out;
     size_t target;
-    uint64_t random;
-    nlk_real grad_out;
-    nlk_real lk2_out;
+    size_t targets[NLK_RNG_BLOCK];
+    size_t batch[NLK_RNG_BLOCK];
+    size_t n = 0;
+    bool positive = true;
+    struct nlk_rng_t *rng = nlk_rng_thread();
+    const size_t negative = nn->train_opts.negative;
 
     /** @section Positive Example
      */
-    /* forward with lookup for target word */
-    nlk_layer_lookup_forward(nn->neg, lk1_out, center_word, &lk2_out);
-
-    /* shortcuts when outside of sigm bounds */
-    if(lk2_out >= NLK_MAX_EXP) {
-        /* do nothing, no error */
-    } else if(lk2_out <= -NLK_MAX_EXP) {
-        grad_out = learn_rate;
-
-       /* layer2neg backprop, accumulate gradient for all examples */
-        nlk_layer_lookup_backprop_acc(nn->neg, lk1_out, center_word, grad_out,
-                                      grad_acc);
-    } else {
-        /* inside sigmoid bounds */
-        out = nlk_sigmoid(lk2_out);
-
-        /** NEG Sampling Backprop
-         * Same gradient formula as in HS but here label (truth) is 1
-         */
-        grad_out = -out * learn_rate;
-
-       /* Backprop and accumulate gradient for pos example */
-        nlk_layer_lookup_backprop_acc(nn->neg, lk1_out, center_word,
-                                      grad_out, grad_acc);
-    }
-
+    batch[n] = center_word;
+    n++;
 
     /** @section Negative Examples
      */
-    for(size_t ex = 0; ex < nn->train_opts.negative; ex++) {
-        random = nlk_random_xs1024();
-        if(random != 0) {
-            target = nn->neg_table[random % NLK_NEG_TABLE_SIZE];
-        } else {
-            target = nlk_random_xs1024() % (nn->words->weights->rows - 1) + 1;
+    for(size_t ex = 0; ex < negative; ex++) {
+        /* draw negatives in batches */
+        if(ex % NLK_RNG_BLOCK == 0) {
+            nlk_rng_negatives(rng, nn->neg_table, nn->neg_table_size, 
+                              negative - ex < NLK_RNG_BLOCK ? 
+                              negative - ex : NLK_RNG_BLOCK, targets);
         }
+        target = targets[ex % NLK_RNG_BLOCK];
         if(target == center_word) {
             /* ignore if this is the actual word */
             continue;
         }
-
-        /* forward with lookup for target word */
-        nlk_layer_lookup_forward(nn->neg, lk1_out, target, &lk2_out);
-
-        /* shortcuts when outside of sigm bounds */
-        if(lk2_out >= NLK_MAX_EXP) {
-            grad_out = -learn_rate;
-        } else if(lk2_out <= -NLK_MAX_EXP) {
-            /* no error, do nothing */
-            continue;
-        } else {
-            /* inside sigmoid bounds */
-            out = nlk_sigmoid(lk2_out);
-
-            /** @section Skipgram NEG Sampling Backprop
-             * Same gradient formula but this time label is 0
-             * multiply by learning rate
-             */
-            grad_out = (1.0 - out) * learn_rate;
+        batch[n] = target;
+        n++;
+
+        if(n == NLK_RNG_BLOCK) {
+            nlk_w2v_neg_batch(nn, learn_rate, batch, n, positive, lk1_out, 
+                              grad_acc);
+            positive = false;
+            n = 0;
         }
-
-
-        /* Backprop using accumulate gradient for all examples */
-        nlk_layer_lookup_backprop_acc(nn->neg, lk1_out, target, grad_out,
-                                      grad_acc);
     } /* end of negative examples */
+
+    if(n > 0) {
+        nlk_w2v_neg_batch(nn, learn_rate, batch, n, positive, lk1_out, 
+                          grad_acc);
+    }
 }
 
 
@@ -365,8 +577,13 @@ nlk_cbow(struct nlk_neuralnet_t *nn, const nlk_real learn_rate,
      * The context words get forwarded through the first lookup layer
      * and their vectors are averaged.
      */
-    nlk_layer_lookup_forward_lookup_avg(nn->words, context->window,
-                                        context->size, lk1_out);
+    if(nn->subwords != NULL) {
+        nlk_subword_forward_avg(nn->subwords, nn->words, context->window,
+                                context->size, lk1_out);
+    } else {
+        nlk_layer_lookup_forward_lookup_avg(nn->words, context->window,
+                                            context->size, lk1_out);
+    }
 
     /* Hierarchical Softmax */
     if(nn->train_opts.hs) {
@@ -381,8 +598,13 @@ nlk_cbow(struct nlk_neuralnet_t *nn, const nlk_real learn_rate,
 
     /** Backprop into the words using the accumulated gradient
      */
-    nlk_layer_lookup_backprop_lookup(nn->words, context->window,
-                                     context->size, grad_acc);
+    if(nn->subwords != NULL) {
+        nlk_subword_backprop(nn->subwords, nn->words, context->window,
+                             context->size, grad_acc);
+    } else {
+        nlk_layer_lookup_backprop_lookup(nn->words, context->window,
+                                         context->size, grad_acc);
+    }
 }
 
 
@@ -394,6 +616,14 @@ nlk_skipgram(struct nlk_neuralnet_t *nn, const nlk_real learn_rate,
              const struct nlk_context_t *context,
              NLK_ARRAY *grad_acc, NLK_ARRAY *lk1_out)
 {
+    nlk_real *nodes = NULL;
+
+    /* the target is the same for all context words: gather its HS nodes
+     * once and write their changes back after the window */
+    if(nn->train_opts.hs) {
+        nodes = nlk_w2v_hs_gather(nn, context->target);
+    }
+
     /* for each context word jj */
     for(size_t jj = 0; jj < context->size; jj++) {
         nlk_array_zero(grad_acc);
@@ -402,8 +632,13 @@ nlk_skipgram(struct nlk_neuralnet_t *nn, const nlk_real learn_rate,
         /** Word Lookup
          * Each context word gets forwarded through the first lookup layer
          */
-        nlk_layer_lookup_forward_lookup_one(nn->words, context->window[jj],
-                                            lk1_out);
+        if(nn->subwords != NULL) {
+            nlk_subword_forward_one(nn->subwords, nn->words,
+                                    context->window[jj], lk1_out);
+        } else {
+            nlk_layer_lookup_forward_lookup_one(nn->words, 
+                                                context->window[jj], lk1_out);
+        }
         /* @TODO or equivalently w/o a copy:
          * (but w2v_train needs to save lk1->data pointer)
          * lk1_out->data = &lk1->weights->data[context->window[jj]
@@ -412,8 +647,8 @@ nlk_skipgram(struct nlk_neuralnet_t *nn, const nlk_real learn_rate,
 
         /* Hierarchical Softmax */
         if(nn->train_opts.hs) {
-            nlk_w2v_hs(nn, lk1_out, learn_rate, context->target,
-                       grad_acc);
+            nlk_w2v_hs_nodes(nn, lk1_out, learn_rate, context->target, nodes,
+                             grad_acc);
         }
 
         /* NEG Sampling */
@@ -424,10 +659,20 @@ nlk_skipgram(struct nlk_neuralnet_t *nn, const nlk_real learn_rate,
 
         /** Backprop into the words using the accumulated gradient
          */
-        nlk_layer_lookup_backprop_lookup_one(nn->words, context->window[jj],
-                                             grad_acc);
+        if(nn->subwords != NULL) {
+            nlk_subword_backprop_one(nn->subwords, nn->words,
+                                     context->window[jj], grad_acc);
+        } else {
+            nlk_layer_lookup_backprop_lookup_one(nn->words, 
+                                                 context->window[jj],
+                                                 grad_acc);
+        }
 
     } /* end of context words */
+
+    if(nodes != NULL) {
+        nlk_w2v_hs_scatter(nn, context->target, nodes);
+    }
 }
 
 
@@ -453,6 +698,10 @@ nlk_pvdm(struct nlk_neuralnet_t *nn, struct nlk_layer_lookup_t *par_table,
     }
 #endif
 
+    /* OOV (subword) targets have no output weights */
+    if(context->target->type == NLK_VOCAB_CHAR) {
+        return;
+    }
 
     nlk_array_zero(grad_acc);
 
@@ -467,8 +716,13 @@ nlk_pvdm(struct nlk_neuralnet_t *nn, struct nlk_layer_lookup_t *par_table,
     /* The context words get forwarded through the first lookup layer
      * and their vectors are averaged together with the PV.
      */
-    nlk_layer_lookup_forward_lookup_avg_p(nn->words, context->window,
-                                          ppos, lk1_out);
+    if(nn->subwords != NULL) {
+        nlk_subword_forward_avg_p(nn->subwords, nn->words, context->window,
+                                  ppos, lk1_out);
+    } else {
+        nlk_layer_lookup_forward_lookup_avg_p(nn->words, context->window,
+                                              ppos, lk1_out);
+    }
 
     /* Hierarchical Softmax */
     if(nn->train_opts.hs) {
@@ -481,8 +735,13 @@ nlk_pvdm(struct nlk_neuralnet_t *nn, struct nlk_layer_lookup_t *par_table,
     }
 
     /* Backprop into the word vectors: Learn using the accumulated gradient */
-    nlk_layer_lookup_backprop_lookup(nn->words, context->window,
-                                     ppos, grad_acc);
+    if(nn->subwords != NULL) {
+        nlk_subword_backprop(nn->subwords, nn->words, context->window, ppos, 
+                             grad_acc);
+    } else {
+        nlk_layer_lookup_backprop_lookup(nn->words, context->window,
+                                         ppos, grad_acc);
+    }
 
     /* Backprop into the PV: Learn PV weights using the accumulated gradient */
     nlk_layer_lookup_backprop_lookup_one(par_table,
@@ -491,10 +750,182 @@ nlk_pvdm(struct nlk_neuralnet_t *nn, struct nlk_layer_lookup_t *par_table,
 }
 
 
+/**
+ * The source row of a slot of the PVDM concat input: the PV is slot 0, the
+ * context words follow it.
+ */
+static inline nlk_real *
+nlk_pvdm_cc_row(struct nlk_neuralnet_t *nn, 
+                struct nlk_layer_lookup_t *par_table,
+                const struct nlk_context_t *context, const size_t slot)
+{
+    const size_t ppos = context->size - 1;
+    const size_t dim = par_table->weights->cols;
+
+    if(slot == 0) {
+        return &par_table->weights->data[context->window[ppos] * dim];
+    }
+    return &nn->words->weights->data[context->window[slot - 1] * dim];
+}
+
+/**
+ * Fused Negative Sampling for a batch of examples of a PVDM concat context.
+ * The concatenated input is never materialized:
+ *
+ * Forward: each score is the sum of the per slot partial dots of the NEG row
+ * with the slot's source (PV or word) row.
+ *
+ * Backward: one slot at a time, the slot's gradient is accumulated in the
+ * slot's position of grad_acc and the NEG rows learn from the (not yet 
+ * updated) source row in one pass over the slot's columns. The source rows
+ * are only updated by the caller, after all the batches.
+ *
+ * @param nn            the neural network structure
+ * @param par_table     the paragraph vectors
+ * @param learn_rate    the learning rate
+ * @param context       the context (words + paragraph id)
+ * @param targets       the examples
+ * @param n             the number of examples
+ * @param positive      the first example is the positive example
+ * @param grad_acc      the accumulated gradient (output)
+ */
+static void
+nlk_pvdm_cc_neg_batch(struct nlk_neuralnet_t *nn, 
+                      struct nlk_layer_lookup_t *par_table,
+                      const nlk_real learn_rate, 
+                      const struct nlk_context_t *context,
+                      const size_t *targets, const size_t n, 
+                      const bool positive, NLK_ARRAY *grad_acc)
+{
+    nlk_real lk2_out[NLK_RNG_BLOCK];
+    nlk_real out[NLK_RNG_BLOCK];
+    nlk_real grad_out[NLK_RNG_BLOCK];
+    const size_t ppos = context->size - 1;
+    const size_t dim = par_table->weights->cols;
+    const size_t cols = nn->neg->weights->cols;
+    const nlk_real *row;
+    nlk_real *grad;
+    size_t ii;
+
+    /* forward: sum of the per slot partial dots */
+    memset(lk2_out, 0, n * sizeof(nlk_real));
+    for(size_t ss = 0; ss <= ppos; ss++) {
+        row = nlk_pvdm_cc_row(nn, par_table, context, ss);
+        for(ii = 0; ii < n; ii++) {
+            const nlk_real *block = 
+                &nn->neg->weights->data[targets[ii] * cols + ss * dim];
+            nlk_real dot = 0;
+            for(size_t jj = 0; jj < dim; jj++) {
+                dot += block[jj] * row[jj];
+            }
+            lk2_out[ii] += dot;
+        }
+    }
+    nlk_sigmoid_vector(lk2_out, n, out);
+
+    /* gradient at the output: same as in nlk_w2v_neg_batch */
+    for(ii = 0; ii < n; ii++) {
+        const nlk_real label = (ii == 0 && positive) ? 1.0 : 0.0;
+        grad_out[ii] = (label - out[ii]) * learn_rate;
+    }
+
+    /* backward: one slot at a time */
+    for(size_t ss = 0; ss <= ppos; ss++) {
+        row = nlk_pvdm_cc_row(nn, par_table, context, ss);
+        grad = &grad_acc->data[ss * dim];
+
+        for(ii = 0; ii < n; ii++) {
+            nlk_real *block = 
+                &nn->neg->weights->data[targets[ii] * cols + ss * dim];
+            const nlk_real g = grad_out[ii];
+            if(g == 0) {
+                continue;
+            }
+            if(nn->neg->update) {
+                for(size_t jj = 0; jj < dim; jj++) {
+                    grad[jj] += g * block[jj];
+                    block[jj] += g * row[jj];
+                }
+            } else {
+                for(size_t jj = 0; jj < dim; jj++) {
+                    grad[jj] += g * block[jj];
+                }
+            }
+        }
+    }
+}
+
+/**
+ * Fused Negative Sampling for a PVDM concat context 
+ * (see nlk_pvdm_cc_neg_batch)
+ *
+ * @param nn            the neural network structure
+ * @param par_table     the paragraph vectors
+ * @param learn_rate    the learning rate
+ * @param context       the context (words + paragraph id)
+ * @param grad_acc      the accumulated gradient (output)
+ */
+static void
+nlk_pvdm_cc_neg(struct nlk_neuralnet_t *nn, 
+                struct nlk_layer_lookup_t *par_table,
+                const nlk_real learn_rate, 
+                const struct nlk_context_t *context, NLK_ARRAY *grad_acc)
+{
+    size_t target;
+    size_t targets[NLK_RNG_BLOCK];
+    size_t batch[NLK_RNG_BLOCK];
+    size_t n = 0;
+    bool positive = true;
+    struct nlk_rng_t *rng = nlk_rng_thread();
+    const size_t negative = nn->train_opts.negative;
+    const size_t center_word = context->target->index;
+
+    /** @section Positive Example
+     */
+    batch[n] = center_word;
+    n++;
+
+    /** @section Negative Examples
+     */
+    for(size_t ex = 0; ex < negative; ex++) {
+        /* draw negatives in batches */
+        if(ex % NLK_RNG_BLOCK == 0) {
+            nlk_rng_negatives(rng, nn->neg_table, nn->neg_table_size, 
+                              negative - ex < NLK_RNG_BLOCK ? 
+                              negative - ex : NLK_RNG_BLOCK, targets);
+        }
+        target = targets[ex % NLK_RNG_BLOCK];
+        if(target == center_word) {
+            /* ignore if this is the actual word */
+            continue;
+        }
+        batch[n] = target;
+        n++;
+
+        if(n == NLK_RNG_BLOCK) {
+            nlk_pvdm_cc_neg_batch(nn, par_table, learn_rate, context, batch, 
+                                  n, positive, grad_acc);
+            positive = false;
+            n = 0;
+        }
+    } /* end of negative examples */
+
+    if(n > 0) {
+        nlk_pvdm_cc_neg_batch(nn, par_table, learn_rate, context, batch, n, 
+                              positive, grad_acc);
+    }
+}
+
 /**
  * PVDM Concat (CBOW for PVs concatenating words+pvs instead of averaging)
- * The only thing different from the PVDM function is the use of
- * nlk_layer_lookup_forward_lookup_concat_p instead of avg_p
+ * The same model as PVDM with the concatenation of the PV and the context
+ * word vectors as input instead of their average.
+ *
+ * Negative sampling never materializes the concatenation: scores and 
+ * gradients are computed per slot straight from the PV and word rows
+ * (see nlk_pvdm_cc_neg_batch). HS works on the gathered node rows of the
+ * target with a few BLAS calls over the whole concatenated input which is 
+ * faster than splitting them per slot so it still uses lk1_out.
  */
 void
 nlk_pvdm_cc(struct nlk_neuralnet_t *nn, struct nlk_layer_lookup_t *par_table,
@@ -514,29 +945,29 @@ nlk_pvdm_cc(struct nlk_neuralnet_t *nn, struct nlk_layer_lookup_t *par_table,
     }
 #endif
 
-    /* PVDM Forward through the first layer
-     * the first element of lk1_out (position 0) is the PV
-     */
-    nlk_layer_lookup_forward_lookup_one(par_table, context->window[ppos],
-                                        lk1_out);
-
-    /* The context words get forwarded through the first lookup layer
-     * and their vectors are concatenate together with the PV.
-     * concat_p starts concatenation into lk1_out at posion 1 (after the PV)
-     */
-    nlk_layer_lookup_forward_lookup_concat_p(nn->words, context->window,
-                                             ppos, lk1_out);
-
     nlk_array_zero(grad_acc);
 
     /* Hierarchical Softmax */
     if(nn->train_opts.hs) {
+        /* PVDM Forward through the first layer
+         * the first element of lk1_out (position 0) is the PV
+         */
+        nlk_layer_lookup_forward_lookup_one(par_table, context->window[ppos],
+                                            lk1_out);
+
+        /* The context words get forwarded through the first lookup layer
+         * and their vectors are concatenate together with the PV.
+         * concat_p starts concatenation into lk1_out at posion 1 (after PV)
+         */
+        nlk_layer_lookup_forward_lookup_concat_p(nn->words, context->window,
+                                                 ppos, lk1_out);
+
         nlk_w2v_hs(nn, lk1_out, learn_rate, context->target, grad_acc);
     }
 
-    /* NEG Sampling */
+    /* NEG Sampling: accumulate the gradient (with the HS one) */
     if(nn->train_opts.negative) {
-        nlk_w2v_neg(nn, learn_rate, context->target->index, lk1_out, grad_acc);
+        nlk_pvdm_cc_neg(nn, par_table, learn_rate, context, grad_acc);
     }
 
     /* Backprop into the PV: Learn PV weights using the accumulated gradient.
@@ -564,6 +995,18 @@ nlk_pvdbow(struct nlk_neuralnet_t *nn, struct nlk_layer_lookup_t *par_table,
            const nlk_real learn_rate, const struct nlk_context_t *context,
            NLK_ARRAY *grad_acc, NLK_ARRAY *lk1_out)
 {
+    nlk_real *nodes = NULL;
+
+    /* OOV (subword) targets have no output weights */
+    if(context->target->type == NLK_VOCAB_CHAR) {
+        return;
+    }
+
+    /* same target for all context words (see nlk_skipgram) */
+    if(nn->train_opts.hs) {
+        nodes = nlk_w2v_hs_gather(nn, context->target);
+    }
+
     /* for each context word jj */
     for(size_t jj = 0; jj < context->size; jj++) {
         nlk_array_zero(grad_acc);
@@ -574,6 +1017,9 @@ nlk_pvdbow(struct nlk_neuralnet_t *nn, struct nlk_layer_lookup_t *par_table,
         if(context->is_paragraph[jj]) {
             nlk_layer_lookup_forward_lookup_one(par_table,
                                                 context->window[jj], lk1_out);
+        } else if(nn->subwords != NULL) {
+            nlk_subword_forward_one(nn->subwords, nn->words, 
+                                    context->window[jj], lk1_out);
         } else {
             nlk_layer_lookup_forward_lookup_one(nn->words,
                                                 context->window[jj], lk1_out);
@@ -581,7 +1027,8 @@ nlk_pvdbow(struct nlk_neuralnet_t *nn, struct nlk_layer_lookup_t *par_table,
 
         /* Hierarchical Softmax */
         if(nn->train_opts.hs) {
-            nlk_w2v_hs(nn, lk1_out, learn_rate, context->target, grad_acc);
+            nlk_w2v_hs_nodes(nn, lk1_out, learn_rate, context->target, nodes,
+                             grad_acc);
         }
 
         /* NEG Sampling */
@@ -596,12 +1043,92 @@ nlk_pvdbow(struct nlk_neuralnet_t *nn, struct nlk_layer_lookup_t *par_table,
            nlk_layer_lookup_backprop_lookup_one(par_table,
                                                 context->window[jj],
                                                 grad_acc);
+        } else if(nn->subwords != NULL) {
+            nlk_subword_backprop_one(nn->subwords, nn->words, 
+                                     context->window[jj], grad_acc);
         } else if(context->is_paragraph[jj] == false) {
             nlk_layer_lookup_backprop_lookup_one(nn->words,
                                                  context->window[jj],
                                                  grad_acc);
         }
     } /* end of context words */
+
+    if(nodes != NULL) {
+        nlk_w2v_hs_scatter(nn, context->target, nodes);
+    }
+}
+
+
+/**
+ * Train pure PVDBOW for a single target: the paragraph vector is the only 
+ * input. The PV row is read in place (no copy) and the words table is 
+ * neither read nor updated.
+ *
+ * @param nn            the neural network structure
+ * @param par_table     the paragraph table
+ * @param learn_rate    the learning rate
+ * @param par_id        the paragraph (PV row)
+ * @param target        the target word
+ * @param grad_acc      for accumulating gradients
+ */
+void
+nlk_pvdbow_target(struct nlk_neuralnet_t *nn, 
+                  struct nlk_layer_lookup_t *par_table,
+                  const nlk_real learn_rate, const size_t par_id,
+                  const struct nlk_vocab_t *target, NLK_ARRAY *grad_acc)
+{
+    const size_t cols = par_table->weights->cols;
+    NLK_ARRAY pv;   /* the paragraph row as a column vector (no copy) */
+
+    /* OOV (subword) targets have no output weights */
+    if(target->type == NLK_VOCAB_CHAR) {
+        return;
+    }
+
+    pv.rows = pv.len = cols;
+    pv.cols = 1;
+    pv.data = &par_table->weights->data[par_id * cols];
+    pv.mapped = 0;
+    pv.owner = NLK_ARRAY_OWNER_HEAP;
+
+    nlk_array_zero(grad_acc);
+
+    /* Hierarchical Softmax */
+    if(nn->train_opts.hs) {
+        nlk_w2v_hs(nn, &pv, learn_rate, target, grad_acc);
+    }
+
+    /* NEG Sampling */
+    if(nn->train_opts.negative) {
+        nlk_w2v_neg(nn, learn_rate, target->index, &pv, grad_acc);
+    }
+
+    /* Backprop into the paragraph (in place) */
+    nlk_layer_lookup_backprop_lookup_one(par_table, par_id, grad_acc);
+}
+
+
+/**
+ * Train pure PVDBOW for a line: every word in the line is a target of the
+ * line's paragraph vector (see nlk_pvdbow_target). Used for training 
+ * NLK_PVDBOW_PURE and for PVDBOW inference (where words are frozen anyway).
+ *
+ * @param nn            the neural network structure
+ * @param par_table     the paragraph table
+ * @param learn_rate    the learning rate
+ * @param line          the (subsampled) line, line_id is the PV row
+ * @param grad_acc      for accumulating gradients
+ */
+void
+nlk_pvdbow_line(struct nlk_neuralnet_t *nn, 
+                struct nlk_layer_lookup_t *par_table,
+                const nlk_real learn_rate, const struct nlk_line_t *line,
+                NLK_ARRAY *grad_acc)
+{
+    for(size_t ii = 0; ii < line->len; ii++) {
+        nlk_pvdbow_target(nn, par_table, learn_rate, line->line_id, 
+                          line->varray[ii], grad_acc);
+    }
 }
 
 
@@ -615,8 +1142,6 @@ nlk_pvdbow(struct nlk_neuralnet_t *nn, struct nlk_layer_lookup_t *par_table,
 void
 nlk_w2v(struct nlk_neuralnet_t *nn, const char *train_file, const bool verbose)
 {
-    /*goto_set_num_threads(1);*/
-
     /* unpack training options */
     NLK_LM model_type = nn->train_opts.model_type;
     nlk_real learn_rate = nn->train_opts.learn_rate;
@@ -630,7 +1155,7 @@ nlk_w2v(struct nlk_neuralnet_t *nn, const char *train_file, const bool verbose)
 
     /* shortcuts */
     struct nlk_vocab_t **vocab = &nn->vocab;
-    struct nlk_vocab_t *replacement = nlk_vocab_find(vocab, NLK_UNK_SYMBOL);
+    struct nlk_vocab_t *replacement = nlk_vocab_get_replacement(vocab);
 
     size_t layer_size2 = 0;
 
@@ -668,17 +1193,30 @@ nlk_w2v(struct nlk_neuralnet_t *nn, const char *train_file, const bool verbose)
 
     /* neg table for negative sampling */
     if(nn->train_opts.negative && nn->neg_table == NULL) {
-        nn->neg_table = nlk_vocab_neg_table_create(vocab, NLK_NEG_TABLE_SIZE,
+        nn->neg_table_size = nlk_vocab_neg_table_get_size();
+        nn->neg_table = nlk_vocab_neg_table_create(vocab, nn->neg_table_size,
                                                    NLK_NEG_TABLE_POW);
     }
 
+    /* AdaGrad for the lookup layers (the output layers stay SGD) */
+    if(nn->train_opts.adagrad > 0) {
+        nlk_layer_lookup_adagrad(nn->words, nn->train_opts.adagrad);
+        if(par_table != NULL) {
+            nlk_layer_lookup_adagrad(par_table, nn->train_opts.adagrad);
+        }
+        if(nn->subwords != NULL) {
+            nlk_layer_lookup_adagrad(nn->subwords->ngrams, 
+                                     nn->train_opts.adagrad);
+        }
+    }
+
     /* time keeping */
     clock_t start = clock();
     nlk_tic_reset();
     nlk_tic(NULL, false);
 
-    /* threads */
-    int num_threads = nlk_get_num_threads();
+    /* threads: per example loop, no BLAS threads */
+    int num_threads = nlk_phase_begin(NLK_PHASE_TRAIN);
 
 
     /** @section Thread Private initializations
@@ -696,9 +1234,9 @@ nlk_w2v(struct nlk_neuralnet_t *nn, const char *train_file, const bool verbose)
     size_t line_end = 0;        /**< last line for thread */
     size_t line_cur = 0;        /**< line being read/processed by thread */
     off_t train_file_start = 0; /**< thread specific start */
-    char **text_line = nlk_text_line_create();
+    char **text_line = nlk_text_chunk_create();
 
-    char *buffer = malloc(sizeof(char) * NLK_BUFFER_SIZE);
+    char *buffer = malloc(sizeof(char) * NLK_CHUNK_BUFFER_SIZE);
     if(buffer == NULL) {
         NLK_ERROR_ABORT("not enough memory", NLK_ENOMEM);
         /* UNREACHABLE */
@@ -709,6 +1247,7 @@ nlk_w2v(struct nlk_neuralnet_t *nn, const char *train_file, const bool verbose)
     size_t word_count = 0;
     size_t last_word_count = 0;
     unsigned int local_epoch = 0;   /* current epoch (thread local) */
+    nlk_layer_lookup_grad_scale(learn_rate);
 
     /** @subsection Neural Network Forward/Backward
      */
@@ -720,19 +1259,32 @@ nlk_w2v(struct nlk_neuralnet_t *nn, const char *train_file, const bool verbose)
 
 
     /** @subsection Context
+     * A long line is read as a stream of chunks. The undersampled line keeps
+     * the last words of the previous chunk: the words that still need a 
+     * context and the window before them.
      */
     unsigned int n_examples;
     unsigned int ex;
+    int ret = EOF;
+    bool chunked = false;       /* reading the rest of a line */
+    const size_t overlap = context_opts.before > context_opts.after ?
+                           context_opts.before : context_opts.after;
+    size_t first = 0;           /* first word without a context */
+    size_t last = 0;            /* end of the words with a full window */
 
-    /* vocabularized line */
-    struct nlk_line_t *line = nlk_line_create(NLK_MAX_LINE_SIZE);
+    /* vocabularized line (chunk) */
+    struct nlk_line_t *line = nlk_line_create(NLK_CHUNK_SIZE);
 
     /* for undersampling words in a line */
-    struct nlk_line_t *line_sample = nlk_line_create(NLK_MAX_LINE_SIZE);
+    struct nlk_line_t *line_sample = nlk_line_create(NLK_CHUNK_SIZE + 
+                                                     2 * overlap);
+    struct nlk_line_t tail;     /* the end of line_sample */
+    struct nlk_line_t range;    /* the words in [first, last) */
 
 
-    /* for converting a sentence to a series of training contexts */
-    struct nlk_context_t **contexts = nlk_context_create_array(ctx_size);
+    /* for converting a chunk to a series of training contexts */
+    struct nlk_context_t **contexts = 
+        nlk_context_create_array_size(ctx_size, NLK_CHUNK_SIZE + overlap);
 
 
 #pragma omp for
@@ -745,6 +1297,12 @@ nlk_w2v(struct nlk_neuralnet_t *nn, const char *train_file, const bool verbose)
                                                   thread_id);
         train_file_start = nlk_text_goto_line(train_fd, line_cur);
 
+        /* a file backed PV table is read in order: one shard per thread */
+        if(par_table != NULL) {
+            nlk_array_map_advise(par_table->weights, line_start, line_end + 1,
+                                 MADV_SEQUENTIAL);
+        }
+
         /** @section Start of Training Loop (Epoch Loop)
          */
         while(local_epoch < epochs) {
@@ -757,10 +1315,19 @@ nlk_w2v(struct nlk_neuralnet_t *nn, const char *train_file, const bool verbose)
                 word_count_actual += word_count - last_word_count;
                 local_epoch++;
 
+                /* start writing back this shard of the PV table */
+                if(par_table != NULL) {
+                    nlk_array_map_sync(par_table->weights, line_start, 
+                                       line_end + 1, true);
+                }
+
                 /* rewind */
                 word_count = 0;
                 last_word_count = 0;
                 line_cur = line_start;
+                line_sample->len = 0;
+                first = 0;
+                ret = EOF;
                 nlk_text_goto_location(train_fd, train_file_start);
                 continue;
             }
@@ -782,40 +1349,54 @@ nlk_w2v(struct nlk_neuralnet_t *nn, const char *train_file, const bool verbose)
                 learn_rate = nlk_learn_rate_w2v(learn_rate, learn_rate_start,
                                                 epochs, word_count_actual,
                                                 train_words);
+                nlk_layer_lookup_grad_scale(learn_rate);
+                /* snapshot for the readers (skipped if one is underway) */
+                nlk_publisher_maybe(__publisher, nn, word_count_actual);
             }
 
             /** @subsection Read from File and Create Context Windows
              * The actual difference between the word models and the paragraph
              * models is in the context that gets generated here.
+             * The line id is only read at the start of a line.
              */
-            nlk_vocab_read_vocabularize(train_fd, line_ids, vocab, replacement,
-                                        text_line, line, buffer);
+            chunked = ret == NLK_CHUNK;
+            ret = nlk_vocab_read_vocabularize_chunk(train_fd, 
+                                                    line_ids && !chunked,
+                                                    vocab, replacement,
+                                                    text_line, line, buffer);
             if(!line_ids) {
                 line->line_id = line_cur;
             }
+            word_count += line->len;
 
-            /* check for errors, empty lines, etc */
-            if(line->len == 0) {
-                line_cur++;
-                continue;
-            }
+            /* subsample: append to the words kept from the previous chunk */
+            tail.varray = &line_sample->varray[line_sample->len];
+            nlk_vocab_line_subsample(line, train_words, sample_rate, &tail);
+            line_sample->len += tail.len;
+            line_sample->line_id = line->line_id;
 
-            /* subsample  */
-            nlk_vocab_line_subsample(line, train_words, sample_rate,
-                                     line_sample);
+            /* the last words of a chunk wait for the window after them */
+            last = line_sample->len;
+            if(ret == NLK_CHUNK) {
+                last = last > first + overlap ? last - overlap : first;
+            }
 
             /* single word, nothing to do ... */
-            if(line_sample->len < 2) {
-                line_cur++;
-                continue;
+            if(line_sample->len < 2 || last == first) {
+                goto nlk_w2v_next_chunk;
             }
 
-            /* Context Window
+            /* Context Window (none for pure PVDBOW)
              */
-            n_examples = nlk_context_window(line_sample->varray,
-                                            line_sample->len,
-                                            line_sample->line_id,
-                                            &context_opts, contexts);
+            n_examples = 0;
+            if(model_type != NLK_PVDBOW_PURE) {
+                n_examples = nlk_context_window_range(line_sample->varray,
+                                                      line_sample->len,
+                                                      first, last,
+                                                      line_sample->line_id,
+                                                      &context_opts, 
+                                                      contexts);
+            }
 
             /** @subsection Algorithm Parallel Loop Over Contexts
              */
@@ -838,6 +1419,13 @@ nlk_w2v(struct nlk_neuralnet_t *nn, const char *train_file, const bool verbose)
                                    contexts[ex], grad_acc, layer1_out);
                     }
                     break;
+                case NLK_PVDBOW_PURE:
+                    range.line_id = line_sample->line_id;
+                    range.varray = &line_sample->varray[first];
+                    range.len = last - first;
+                    nlk_pvdbow_line(nn, par_table, learn_rate, &range,
+                                    grad_acc);
+                    break;
                 case NLK_PVDM:
                     for(ex = 0; ex < n_examples; ex++) {
                         nlk_pvdm(nn, par_table, learn_rate, contexts[ex],
@@ -856,8 +1444,20 @@ nlk_w2v(struct nlk_neuralnet_t *nn, const char *train_file, const bool verbose)
             }
 
 
-            /* update count/location */
-            word_count += line->len;
+nlk_w2v_next_chunk:
+            /* keep the words without a context and the window before them */
+            if(ret == NLK_CHUNK) {
+                first = last > overlap ? last - overlap : 0;
+                line_sample->len -= first;
+                memmove(line_sample->varray, &line_sample->varray[first],
+                        line_sample->len * sizeof(struct nlk_vocab_t *));
+                first = last - first;
+                continue;
+            }
+
+            /* update location */
+            line_sample->len = 0;
+            first = 0;
             line_cur++;
 
         } /* end of epoch cycle */
@@ -868,16 +1468,34 @@ nlk_w2v(struct nlk_neuralnet_t *nn, const char *train_file, const bool verbose)
     free(buffer);
     nlk_text_line_free(text_line);
     nlk_context_free_array(contexts);
+    nlk_line_free(line);
     nlk_line_free(line_sample);
     nlk_array_free(layer1_out);
     nlk_array_free(grad_acc);
+    nlk_w2v_thread_free();
 
 
     } /* *** End of Paralell Region *** */
     /** @section End
      */
-    free(nn->neg_table);
-    nn->neg_table = NULL;
+    /* cached OOV vectors were averaged from the n-grams before training */
+    if(nn->subwords != NULL) {
+        nlk_subword_cache_clear(nn->subwords);
+    }
+
+    /* the PV table file is complete when training returns */
+    if(par_table != NULL) {
+        nlk_array_map_sync(par_table->weights, 0, par_table->weights->rows,
+                           false);
+    }
+
+    /* the final snapshot, its readers share the negative table */
+    if(__publisher != NULL) {
+        nlk_publisher_publish(__publisher, nn, word_count_actual);
+    } else {
+        free(nn->neg_table);
+        nn->neg_table = NULL;
+    }
     nlk_tic_reset();
 }
 
@@ -35,6 +35,7 @@
 #include "nlk_layer_lookup.h"
 #include "nlk_window.h"
 #include "nlk_neuralnet.h"
+#include "nlk_snapshot.h"
 
 
 #undef __BEGIN_DECLS
@@ -55,8 +56,10 @@ struct nlk_neuralnet_t *nlk_w2v_create(struct nlk_nn_train_t,
                                        const bool);
 
 /* train */
+void nlk_w2v_set_publisher(struct nlk_publisher_t *);
 
 void nlk_w2v(struct nlk_neuralnet_t *, const char *, const bool);
+void nlk_w2v_thread_free();
 
 void    nlk_pvdm(struct nlk_neuralnet_t *, struct nlk_layer_lookup_t *,
                  const nlk_real, const struct nlk_context_t *, NLK_ARRAY *, 
@@ -66,6 +69,14 @@ void    nlk_pvdbow(struct nlk_neuralnet_t *, struct nlk_layer_lookup_t *,
                    const nlk_real, const struct nlk_context_t *, NLK_ARRAY *, 
                    NLK_ARRAY *);
 
+void    nlk_pvdbow_target(struct nlk_neuralnet_t *, 
+                          struct nlk_layer_lookup_t *, const nlk_real, 
+                          const size_t, const struct nlk_vocab_t *, 
+                          NLK_ARRAY *);
+void    nlk_pvdbow_line(struct nlk_neuralnet_t *, struct nlk_layer_lookup_t *,
+                        const nlk_real, const struct nlk_line_t *, 
+                        NLK_ARRAY *);
+
 void    nlk_pvdm_cc(struct nlk_neuralnet_t *, struct nlk_layer_lookup_t *, 
                     const nlk_real, const struct nlk_context_t *, 
                     NLK_ARRAY *, NLK_ARRAY *);
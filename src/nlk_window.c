@@ -41,31 +41,35 @@
 
 
 /**
- * Random Windows
+ * Random Windows for the next n positions
  */
 static void
-nlk_window_random(const unsigned int _before, const unsigned int _after, 
-                  const bool equal, unsigned int *before, unsigned int *after)
+nlk_window_random(struct nlk_rng_t *rng, const unsigned int _before, 
+                  const unsigned int _after, const bool equal, const size_t n,
+                  unsigned int *before, unsigned int *after)
 {
-    unsigned int random_window;
     if(equal) {/* if after == before, keep it that way (word2vec style) */
-        random_window = (nlk_random_xs1024() % (uint64_t) _before) + 1;
-        *before = random_window;
-        *after = random_window;
+        nlk_rng_windows(rng, _before, n, before);
+        for(size_t ii = 0; ii < n; ii++) {
+            after[ii] = before[ii];
+        }
+        return;
+    } 
+
+    if(_before > 0) {
+        nlk_rng_windows(rng, _before, n, before);
     } else {
-        if(_before > 0) {
-            random_window = (nlk_random_xs1024()  % (uint64_t) _before) + 1;
-            *before = random_window;
-        } else {
-            *before = 0;
+        for(size_t ii = 0; ii < n; ii++) {
+            before[ii] = 0;
         }
-        if(_after > 0) {
-            random_window = (nlk_random_xs1024()  % (uint64_t) _after) + 1;
-            *after = random_window;
-        } else {
-            *after = 0;
+    }
+    if(_after > 0) {
+        nlk_rng_windows(rng, _after, n, after);
+    } else {
+        for(size_t ii = 0; ii < n; ii++) {
+            after[ii] = 0;
         }
-    } 
+    }
 }
 
 
@@ -146,27 +150,34 @@ nlk_context_for_pos(struct nlk_vocab_t **varray, const size_t paragraph_id,
 
 
 /** 
- * Creates a context window from a vocabularized line/sentence/pararaph
+ * Creates the context windows for the words in [first, last) of a 
+ * vocabularized line/sentence/paragraph
+ *
+ * The words outside the range are only used as context: this is how a long
+ * line read in chunks keeps its windows across chunk boundaries.
  *
  *  @param varray           vocab items for the line/paragraph/document
  *  @param line_length      lengh of the line array
+ *  @param first            first word to create a context for
+ *  @param last             end of the words to create contexts for
  *  @param paragraph_id     the paragraph id/index
  *  @param opts             context generaton options
- *  @param context          the context for each word in the line_array
+ *  @param context          the context for each word in the range
  *
- *  @return number of elements in the *contexts* array (== line_length).
+ *  @return number of elements in the *contexts* array (== last - first).
  *
  *  @note
- *  Memory for contexts and it's words array should be pre-allocated. 
- *  If _before == _after and random_windows is true, the random window sizes
- *  will continue to be equal.
+ *  The start of varray is the start of the line (padding) and its end is the
+ *  end of the line: last should be line_length or leave at least a full 
+ *  window after it.
  *  @endnote
  */
 size_t
-nlk_context_window(struct nlk_vocab_t **varray, const size_t line_length,
-                   const size_t paragraph_id,
-                   struct nlk_context_opts_t *opts,
-                   struct nlk_context_t **contexts)
+nlk_context_window_range(struct nlk_vocab_t **varray, const size_t line_length,
+                         const size_t first, const size_t last,
+                         const size_t paragraph_id,
+                         struct nlk_context_opts_t *opts,
+                         struct nlk_context_t **contexts)
 {
     size_t center_pos       = 0;        /* position in line/par (input) */
     int window_pos          = 0;        /* position in window for line/par */
@@ -177,14 +188,26 @@ nlk_context_window(struct nlk_vocab_t **varray, const size_t line_length,
     bool prepad_paragraph   = false;    /* prepad context with par id */
     unsigned int prepad     = 0;
     unsigned int postpad    = 0;
+    struct nlk_rng_t *rng   = nlk_rng_thread();
+    unsigned int random_before[NLK_RNG_BLOCK];  /* batch of random windows */
+    unsigned int random_after[NLK_RNG_BLOCK];
+    size_t rr;
 
 
     /* go through the paragraph changing the center word */
-    for(center_pos = 0; center_pos < line_length; center_pos++) {
-        /* random window */
+    for(center_pos = first; center_pos < last; center_pos++) {
+        /* random window: drawn in batches */
         if(opts->random_windows) {
-            nlk_window_random(opts->before, opts->after, opts->b_equals_a, 
-                              &before, &after);
+            rr = (center_pos - first) % NLK_RNG_BLOCK;
+            if(rr == 0) {
+                nlk_window_random(rng, opts->before, opts->after, 
+                                  opts->b_equals_a, 
+                                  last - center_pos < NLK_RNG_BLOCK ?
+                                  last - center_pos : NLK_RNG_BLOCK,
+                                  random_before, random_after);
+            }
+            before = random_before[rr];
+            after = random_after[rr];
         } else {
             before = opts->before;
             after = opts->after;
@@ -237,6 +260,33 @@ nlk_context_window(struct nlk_vocab_t **varray, const size_t line_length,
     return ctx_idx;
 }
 
+/** 
+ * Creates a context window from a vocabularized line/sentence/pararaph
+ *
+ *  @param varray           vocab items for the line/paragraph/document
+ *  @param line_length      lengh of the line array
+ *  @param paragraph_id     the paragraph id/index
+ *  @param opts             context generaton options
+ *  @param context          the context for each word in the line_array
+ *
+ *  @return number of elements in the *contexts* array (== line_length).
+ *
+ *  @note
+ *  Memory for contexts and it's words array should be pre-allocated. 
+ *  If _before == _after and random_windows is true, the random window sizes
+ *  will continue to be equal.
+ *  @endnote
+ */
+size_t
+nlk_context_window(struct nlk_vocab_t **varray, const size_t line_length,
+                   const size_t paragraph_id,
+                   struct nlk_context_opts_t *opts,
+                   struct nlk_context_t **contexts)
+{
+    return nlk_context_window_range(varray, line_length, 0, line_length,
+                                    paragraph_id, opts, contexts);
+}
+
 /**
  * Creates a context window of size max_context_size
  *
@@ -293,15 +343,14 @@ nlk_context_free(struct nlk_context_t *context)
 }
 
 /**
- * Create a continuous array of contexts for n lines
+ * Create an array of n contexts
+ * The array is NULL terminated so that it can be freed without its size.
  */
 struct nlk_context_t **
-nlk_context_create_array_lines(const size_t max_context_size, 
-                               const size_t n_lines)
+nlk_context_create_array_size(const size_t max_context_size, const size_t n)
 {
-    const size_t n = NLK_MAX_LINE_SIZE * n_lines;
     struct nlk_context_t **contexts = (struct nlk_context_t **) 
-        malloc(n * sizeof(struct nlk_context_t *));
+        calloc(n + 1, sizeof(struct nlk_context_t *));
     if(contexts == NULL) {
         NLK_ERROR_NULL("unable to allocate memory for contexts", NLK_ENOMEM);
         /* unreachable */
@@ -318,6 +367,17 @@ nlk_context_create_array_lines(const size_t max_context_size,
     return contexts;
 }
 
+/**
+ * Create a continuous array of contexts for n lines
+ */
+struct nlk_context_t **
+nlk_context_create_array_lines(const size_t max_context_size, 
+                               const size_t n_lines)
+{
+    return nlk_context_create_array_size(max_context_size, 
+                                         NLK_MAX_LINE_SIZE * n_lines);
+}
+
 /**
  * Create an array of contexts for a single line
  */
@@ -337,11 +397,9 @@ nlk_context_free_array(struct nlk_context_t **contexts)
         return;
     }
 
-    for(size_t zz = 0; zz < NLK_MAX_LINE_SIZE; zz++) {
-        if(contexts[zz] != NULL) {
-            nlk_context_free(contexts[zz]);
-            contexts[zz] = NULL;
-        }
+    for(size_t zz = 0; contexts[zz] != NULL; zz++) {
+        nlk_context_free(contexts[zz]);
+        contexts[zz] = NULL;
     }
 
     free(contexts);
@@ -82,12 +82,18 @@ typedef struct nlk_context_opts_t NLK_CONTEXT_OPTS;
 size_t  nlk_context_window(struct nlk_vocab_t **, const size_t, const size_t,
                            struct nlk_context_opts_t *,
                            struct nlk_context_t **);
+size_t  nlk_context_window_range(struct nlk_vocab_t **, const size_t, 
+                                 const size_t, const size_t, const size_t,
+                                 struct nlk_context_opts_t *,
+                                 struct nlk_context_t **);
 
 
 struct nlk_context_t  *nlk_context_create(const size_t); 
 struct nlk_context_t **nlk_context_create_array_lines(const size_t, 
                                                       const size_t);
 struct nlk_context_t **nlk_context_create_array(const size_t);
+struct nlk_context_t **nlk_context_create_array_size(const size_t, 
+                                                     const size_t);
 
 void nlk_context_free(struct nlk_context_t *);
 void nlk_context_free_array(struct nlk_context_t **);
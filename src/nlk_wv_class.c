@@ -33,12 +33,14 @@
 
 #include <omp.h>
 
+#include "nlk.h"
 #include "nlk_tic.h"
 #include "nlk_neuralnet.h"
 #include "nlk_layer_lookup.h"
 #include "nlk_layer_linear.h"
 #include "nlk_transfer.h"
 #include "nlk_criterion.h"
+#include "nlk_exec.h"
 #include "nlk_learn_rate.h"
 #include "nlk_dataset.h"
 #include "nlk_util.h"
@@ -118,33 +120,39 @@ nlk_wv_class_create_senna(struct nlk_nn_train_t train_opts,
 
 
 /**
- * Forward propagation for the SENNA imlementation
+ * Executor for the SENNA layers: hardtanh linear layer, softmax linear layer
  */
-inline static void
-nlk_wv_class_senna_forward(struct nlk_neuralnet_t *nn,
-                           struct nlk_context_t *context,
-                           NLK_ARRAY *lk1_out, NLK_ARRAY *ll1_out,
-                           NLK_ARRAY *hth_out, NLK_ARRAY *ll2_out,
-                           NLK_ARRAY *out)
+static struct nlk_exec_t *
+nlk_wv_class_senna_exec(struct nlk_neuralnet_t *nn, const size_t batch)
 {
-    /* shortcuts */
-    struct nlk_layer_linear_t *ll1 = nn->layers[0].ll;
-    struct nlk_layer_linear_t *ll2 = nn->layers[1].ll;
- 
-    /* lookup words */
-    nlk_layer_lookup_forward_lookup_concat(nn->words, 
-                                           context->window,
-                                           context->size,
-                                           lk1_out);
-    /* hardtanh */
-    nlk_layer_linear_forward(ll1, lk1_out, ll1_out);
-    nlk_hardtanh_forward(ll1_out, hth_out);
+    const NLK_TRANSFER transfers[2] = { NLK_TRANSFER_HARDTANH, 
+                                        NLK_TRANSFER_LOG_SOFTMAX };
+
+    return nlk_exec_create_nn(nn, 0, transfers, 2, batch);
+}
 
-    /* softmax */
-    nlk_layer_linear_forward(ll2, hth_out, ll2_out);
-    nlk_log_softmax_forward(ll2_out, out);
+/**
+ * Forward propagation for the SENNA imlementation: the first n contexts, 
+ * one per example of the batch
+ */
+inline static void
+nlk_wv_class_senna_forward(struct nlk_neuralnet_t *nn, 
+                           struct nlk_exec_t *exec,
+                           struct nlk_context_t **contexts, const size_t n)
+{
+    NLK_ARRAY lk1_out;
 
+    /* lookup words */
+    for(size_t ii = 0; ii < n; ii++) {
+        nlk_exec_input(exec, ii, &lk1_out);
+        nlk_layer_lookup_forward_lookup_concat(nn->words, 
+                                               contexts[ii]->window,
+                                               contexts[ii]->size,
+                                               &lk1_out);
+    }
 
+    /* hardtanh, softmax */
+    nlk_exec_forward(exec, n);
 }
 
 
@@ -166,7 +174,7 @@ nlk_wv_class_senna_train(struct nlk_neuralnet_t *nn,
     struct nlk_vocab_t **vocab = &nn->vocab;
     struct nlk_context_opts_t context_opts = nn->context_opts;
 
-    struct nlk_vocab_t *replacement = nlk_vocab_find(vocab, NLK_UNK_SYMBOL);
+    struct nlk_vocab_t *replacement = nlk_vocab_get_replacement(vocab);
     struct nlk_vocab_t **varray;
     unsigned int max_sentence_size = 0;
     unsigned int len = 0;
@@ -180,44 +188,14 @@ nlk_wv_class_senna_train(struct nlk_neuralnet_t *nn,
     
     unsigned int ctx_size = context_opts.max_size;
     struct nlk_context_t **contexts = nlk_context_create_array(ctx_size);
-    struct nlk_context_t *context;
 
-    /** neural network 
+    /** neural network: one example at a time (SGD), the learn rate of each
+     * layer divided by its input size
      */
     const nlk_real learn_rate = nn->train_opts.learn_rate;
     unsigned int epochs = nn->train_opts.iter;
-    struct nlk_layer_linear_t *ll1 = nn->layers[0].ll;
-    struct nlk_layer_linear_t *ll2 = nn->layers[1].ll;
-    const size_t concat_size = ll1->weights->cols;
-    const size_t hidden_size = ll1->weights->rows;
-    const size_t n_classes = ll2->weights->rows;
-
-    /* output of the first layer (lookup layer) */
-    NLK_ARRAY *lk1_out = nlk_array_create(concat_size, 1);
-    /* output of the second layer (hardtanh linear layer - hidden) - ll1 */
-    NLK_ARRAY *ll1_out = nlk_array_create(hidden_size, 1);
-    /* output of the hardtanh transfer */
-    NLK_ARRAY *hth_out = nlk_array_create(hidden_size, 1);
-    /* output of the 3rd layer (softmax linear layer) - ll2 */
-    NLK_ARRAY *ll2_out = nlk_array_create(n_classes, 1);
-    /* output of the softmax transfer function */
-    NLK_ARRAY *out = nlk_array_create(n_classes, 1);
-
-    /* gradient at output */
-    NLK_ARRAY *grad_out = nlk_array_create(n_classes, 1);
-    /* gradient at softmax transfer input */
-    NLK_ARRAY *grad_sm = nlk_array_create(n_classes, 1);
-    /* gradient at the softmax linear layer input */
-    NLK_ARRAY *grad_ll2 = nlk_array_create(hidden_size, 1);
-    /* gradient at hardtanh input */
-    NLK_ARRAY *grad_hth = nlk_array_create(hidden_size, 1);
-    /* gradient at the hardtanh linear layer input */
-    NLK_ARRAY *grad_ll1 = nlk_array_create(concat_size, 1);
-
-    /* learn rate for ll2 */
-    const nlk_real learn_rate_ll2 = learn_rate / hidden_size;
-    const nlk_real learn_rate_ll1 = learn_rate / concat_size;
-
+    struct nlk_exec_t *exec = nlk_wv_class_senna_exec(nn, 1);
+    nlk_exec_learn_rate(exec, learn_rate, true);
 
     /** cycle variables 
      */
@@ -225,7 +203,7 @@ nlk_wv_class_senna_train(struct nlk_neuralnet_t *nn,
     unsigned int epoch = 0;
     unsigned int si = 0;
     unsigned int ci = 0;
-    size_t pred = 0;
+    unsigned int pred = 0;
     size_t correct = 0;
 
     /**@TODO generate contexts only once */
@@ -253,51 +231,23 @@ nlk_wv_class_senna_train(struct nlk_neuralnet_t *nn,
                              "wrong number of examples generated");
 
             for(ci = 0; ci < n_examples; ci++) {
-                context = contexts[ci];
                 /** @section Forward propagation
                  */
-                nlk_wv_class_senna_forward(nn, context, lk1_out, ll1_out,
-                                           hth_out, ll2_out, out);
+                nlk_wv_class_senna_forward(nn, exec, &contexts[ci], 1);
                 /* check result */
-                pred = nlk_array_max_i(out);
+                nlk_exec_predict(exec, 1, &pred);
                 if(pred == train->classes[si][ci]) {
                     correct++;
                 }
 
                 /** @section Backpropagation
+                 * Negative Log Likelihood, softmax and hardtanh layers; 
+                 * the gradient at the input of the hardtanh layer is 
+                 * unnecessary because we are not propagating back into the
+                 * lookup layer
                  */
-                /* Negative Log Likelihood */
-                nlk_nll_backprop(out, train->classes[si][ci], grad_out);
-
-                /** Sofmax layer backprop
-                 */
-                /* Softmax Transfer */
-                nlk_log_softmax_backprop(out, grad_out, grad_sm); 
-
-                /* update gradient at input of the softmax linear layer */
-                nlk_layer_linear_update_gradient(ll2, grad_sm, grad_ll2);
-
-                /* apply learning rate */
-                nlk_array_scale(learn_rate_ll2, grad_sm);
-
-                /* update parameters of the softmax linear layer */
-                nlk_layer_linear_update_parameters(ll2, hth_out, grad_sm);
-
-                /** Hardtanh Layer backprop
-                 */
-                /* hardtanh transfer */
-                nlk_hardtanh_backprop(hth_out, grad_ll2, grad_hth);
-
-                /* to update the gradient at input of this layer is unnecessary
-                 * because we are not propagating back into the lookup layer
-                nlk_layer_linear_update_gradient(ll1, grad_sm, grad_ll1);
-                */
-
-                /* apply learning rate */
-                nlk_array_scale(learn_rate_ll1, grad_hth);
-
-                /* update parameters of the softmax linear layer */
-                nlk_layer_linear_update_parameters(ll1, lk1_out, grad_hth);
+                nlk_exec_nll_backprop(exec, 1, &train->classes[si][ci]);
+                nlk_exec_backward(exec, 1, false);
 
             }
         }
@@ -315,16 +265,7 @@ nlk_wv_class_senna_train(struct nlk_neuralnet_t *nn,
     free(varray);
     free(sentence_indices);
     nlk_context_free_array(contexts);
-    nlk_array_free(lk1_out);
-    nlk_array_free(ll1_out);
-    nlk_array_free(hth_out);
-    nlk_array_free(ll2_out);
-    nlk_array_free(out);
-    nlk_array_free(grad_out);
-    nlk_array_free(grad_sm);
-    nlk_array_free(grad_ll2);
-    nlk_array_free(grad_hth);
-    nlk_array_free(grad_ll1);
+    nlk_exec_free(exec);
 
     return;
 
@@ -361,48 +302,38 @@ nlk_wv_class_senna_classify(struct nlk_neuralnet_t *nn,
     struct nlk_vocab_t **vocab = &nn->vocab;
     struct nlk_context_opts_t context_opts = nn->context_opts;
 
-    struct nlk_vocab_t *replacement = nlk_vocab_find(vocab, NLK_UNK_SYMBOL);
+    struct nlk_vocab_t *replacement = nlk_vocab_get_replacement(vocab);
     unsigned int max_sentence_size = 0;
-    unsigned int len = 0;
-    unsigned int n_examples = 0;
     
     max_sentence_size = nlk_supervised_corpus_max_sentence_size(test);
 
-    /* neural network */
-    struct nlk_layer_linear_t *ll1 = nn->layers[0].ll;
-    struct nlk_layer_linear_t *ll2 = nn->layers[1].ll;
-    const size_t concat_size = ll1->weights->cols;
-    const size_t hidden_size = ll1->weights->rows;
-    const size_t n_classes = ll2->weights->rows;
 
-
-//#pragma omp parallel
+    /* per sentence loop: the phase's threads, no BLAS threads */
+    nlk_phase_begin(NLK_PHASE_EVAL);
+#pragma omp parallel
 {
+    unsigned int len = 0;
+    unsigned int n_examples = 0;
+    size_t batch;
     struct nlk_vocab_t **varray;
     varray = (struct nlk_vocab_t **) malloc(sizeof(struct nlk_vocab_t *) 
                                             * max_sentence_size);
-    /* @TODO check memory */
+    if(varray == NULL) {
+        NLK_ERROR_ABORT("unable to allocate memory", NLK_ENOMEM);
+        /* unreachable */
+    }
     
     unsigned int ctx_size = context_opts.max_size;
     struct nlk_context_t **contexts = nlk_context_create_array(ctx_size);
-    struct nlk_context_t *context;
 
-    /* output of the first layer (lookup layer) */
-    NLK_ARRAY *lk1_out = nlk_array_create(concat_size, 1);
-    /* output of the second layer (hardtanh linear layer - hidden) - ll1 */
-    NLK_ARRAY *ll1_out = nlk_array_create(hidden_size, 1);
-    /* output of the hardtanh transfer */
-    NLK_ARRAY *hth_out = nlk_array_create(hidden_size, 1);
-    /* output of the 3rd layer (softmax linear layer) - ll2 */
-    NLK_ARRAY *ll2_out = nlk_array_create(n_classes, 1);
-    /* output of the softmax transfer function */
-    NLK_ARRAY *out = nlk_array_create(n_classes, 1);
+    /* neural network: the contexts of a sentence, NLK_EXEC_BATCH at a time */
+    struct nlk_exec_t *exec = nlk_wv_class_senna_exec(nn, NLK_EXEC_BATCH);
 
 
     /** @section Parallel Classify
      */
     /* for each sentence */
-//#pragma omp for
+#pragma omp for schedule(dynamic)
     for(size_t si = 0; si < n_sentences; si++) {
         /* Vocabularize */
         len = nlk_vocab_vocabularize(vocab,  test->words[si], 
@@ -411,14 +342,14 @@ nlk_wv_class_senna_classify(struct nlk_neuralnet_t *nn,
         n_examples = nlk_context_window(varray, len, 0, &context_opts, 
                                         contexts);
 
-        for(unsigned int ci = 0; ci < n_examples; ci++) {
-            context = contexts[ci];
+        for(unsigned int ci = 0; ci < n_examples; ci += batch) {
+            batch = n_examples - ci < NLK_EXEC_BATCH ? n_examples - ci 
+                                                     : NLK_EXEC_BATCH;
             /** @section Forward propagation
              */
-            nlk_wv_class_senna_forward(nn, context, lk1_out, ll1_out,
-                                       hth_out, ll2_out, out);
+            nlk_wv_class_senna_forward(nn, exec, &contexts[ci], batch);
             /* for each word */
-            pred[si][ci] = nlk_array_max_i(out);
+            nlk_exec_predict(exec, batch, &pred[si][ci]);
         }
     }
 
@@ -426,11 +357,7 @@ nlk_wv_class_senna_classify(struct nlk_neuralnet_t *nn,
      */
     free(varray);
     nlk_context_free_array(contexts);
-    nlk_array_free(lk1_out);
-    nlk_array_free(ll1_out);
-    nlk_array_free(hth_out);
-    nlk_array_free(ll2_out);
-    nlk_array_free(out);
+    nlk_exec_free(exec);
 
 } /* end of parallel region */
 
@@ -1,6 +1,16 @@
 #include <stdio.h>
+#include <string.h>
+#include <math.h>
 #include "minunit.h"
+#include "../src/nlk.h"
+#include "../src/nlk_random.h"
 #include "../src/nlk_dataset.h"
+#include "../src/nlk_layer_linear.h"
+#include "../src/nlk_class_score.h"
+#include "../src/nlk_vocabulary.h"
+#include "../src/nlk_w2v.h"
+#include "../src/nlk_pv.h"
+#include "../src/nlk_pv_class.h"
  
 int tests_run = 0;
 int tests_passed = 0;
@@ -202,11 +212,279 @@ test_conll_load()
     return 0;
 }
 
+/**
+ * Test the quantized (int8) linear layer against the float layer
+ */
+static char *
+test_linear_q8()
+{
+    const size_t n_out = 7;     /* not a multiple of 4 rows */
+    const size_t n_in = 45;     /* not a multiple of NLK_Q8_PAD */
+    struct nlk_layer_linear_t *layer;
+    struct nlk_layer_linear_q8_t *q8;
+    NLK_ARRAY *x = nlk_array_create(n_in, 1);
+    NLK_ARRAY *out = nlk_array_create(n_out, 1);
+    NLK_ARRAY *out_q8 = nlk_array_create(n_out, 1);
+    int8_t work[64];
+    nlk_real wmax = 0;
+
+    printf("Testing int8 linear layer\n");
+    layer = nlk_layer_linear_create(n_out, n_in, true);
+    for(size_t ii = 0; ii < layer->weights->len; ii++) {
+        layer->weights->data[ii] = sin(ii * 0.37) * 0.5;
+        if(fabs(layer->weights->data[ii]) > wmax) {
+            wmax = fabs(layer->weights->data[ii]);
+        }
+    }
+    for(size_t ii = 0; ii < n_out; ii++) {
+        layer->bias->data[ii] = 0.1 * ii;
+    }
+    for(size_t ii = 0; ii < n_in; ii++) {
+        x->data[ii] = cos(ii * 0.91) * 0.02;
+    }
+
+    /* calibrate on x (one row) */
+    NLK_ARRAY sample = { .rows = 1, .cols = n_in, .len = n_in, 
+                         .data = x->data, .mapped = 0,
+                         .owner = NLK_ARRAY_OWNER_HEAP };
+    q8 = nlk_layer_linear_q8_create(layer);
+    nlk_layer_linear_q8_calibrate(q8, &sample, 1);
+    mu_assert("q8: bad padding", q8->cols_pad % NLK_Q8_PAD == 0);
+    mu_assert("q8: bad input scale", fabs(q8->in_scale * NLK_Q8_MAX - 0.02) 
+                                     < 1e-3);
+
+    nlk_layer_linear_forward(layer, x, out);
+    nlk_layer_linear_q8_forward(q8, x, work, out_q8);
+
+    /* error bound: half a step in the weights and in the inputs */
+    for(size_t ii = 0; ii < n_out; ii++) {
+        mu_assert("q8: output too far from float", 
+                  fabs(out->data[ii] - out_q8->data[ii]) < 
+                  n_in * 0.02 * wmax / NLK_Q8_MAX);
+    }
+
+    nlk_layer_linear_q8_free(q8);
+    nlk_layer_linear_free(layer);
+    nlk_array_free(x);
+    nlk_array_free(out);
+    nlk_array_free(out_q8);
+    return 0;
+}
+
+/**
+ * Test streaming classification: the output is in file order and does not
+ * depend on the number of threads; repeated calls reuse the thread memory
+ */
+static char *
+test_classify_stream()
+{
+    const char *path = "tmp/stream.txt";
+    const char *out_paths[2] = {"tmp/stream1.out", "tmp/stream3.out"};
+    const int threads[2] = {1, 3};
+    const size_t n_lines = 600;
+    const char *topics[3][4] = {{"red", "green", "blue", "color"},
+                                {"cat", "dog", "bird", "animal"},
+                                {"one", "two", "three", "number"}};
+    char line[2][64];
+    size_t id;
+    unsigned int class;
+    float score;
+
+    printf("Testing streaming classification\n");
+    nlk_init();
+    nlk_random_init_xs1024(1);
+
+    /* corpus: ids (rows of the training PVs) are not the line numbers */
+    FILE *fp = fopen(path, "w");
+    mu_assert("stream: unable to write corpus", fp != NULL);
+    for(size_t ii = 0; ii < n_lines; ii++) {
+        const size_t tt = ii % 3;
+        fprintf(fp, "%zu %s %s %s %s\n", n_lines - 1 - ii, topics[tt][ii % 4], 
+                topics[tt][(ii + 1) % 4], topics[tt][(ii + 2) % 4], 
+                topics[(tt + 1) % 3][ii % 4]);
+    }
+    fclose(fp);
+
+    /* network: a small PV-DBOW and a linear classifier */
+    struct nlk_vocab_t *vocab = nlk_vocab_create(path, true, 1, false, false);
+    nlk_vocab_encode_huffman(&vocab);
+    struct nlk_nn_train_t train_opts;
+    memset(&train_opts, 0, sizeof(train_opts));
+    train_opts.model_type = NLK_PVDBOW;
+    train_opts.paragraph = true;
+    train_opts.window = 4;
+    train_opts.learn_rate = 0.05;
+    train_opts.hs = true;
+    train_opts.iter = 2;
+    train_opts.vector_size = 16;
+    train_opts.word_count = nlk_vocab_count_words(&vocab, path, true, 
+                                                  n_lines);
+    train_opts.paragraph_count = n_lines;
+    train_opts.line_ids = true;
+    struct nlk_neuralnet_t *nn = nlk_w2v_create(train_opts, false, vocab, 
+                                                false);
+    mu_assert("stream: network creation failed", nn != NULL);
+    nlk_w2v(nn, path, false);
+
+    struct nlk_layer_linear_t *linear = nlk_layer_linear_create(3, 16, true);
+    nlk_layer_linear_init_sigmoid(linear);
+    nlk_neuralnet_expand(nn, 1);
+    nlk_neuralnet_add_layer_linear(nn, linear);
+
+    /* classify with 1 and 3 threads */
+    struct nlk_workspace_t *ws = NULL;
+    struct nlk_pv_work_t *work = NULL;
+    size_t ws_size = 0;
+    for(size_t tt = 0; tt < 2; tt++) {
+        NLK_PV_OPTS opts = { .epochs = 5, .tol = 0, 
+                             .init = NLK_PV_INIT_RANDOM, .table = NULL,
+                             .batch = NLK_PV_BATCH, .adagrad = 0, 
+                             .iterations = 0 };
+        nlk_set_phase_threads(NLK_PHASE_INFER, threads[tt]);
+        size_t n = nlk_pv_classify_stream(nn, NULL, path, out_paths[tt], 
+                                          &opts, false);
+        mu_assert("stream: wrong number of lines classified", n == n_lines);
+
+        /* the second call reuses the thread memory of the first */
+        if(tt == 0) {
+            ws = nlk_workspace_thread();
+            ws_size = nlk_workspace_size(ws);
+            work = nlk_pv_work_thread(nn, NLK_PV_BATCH);
+        } else {
+            mu_assert("stream: new workspace", nlk_workspace_thread() == ws);
+            mu_assert("stream: workspace grew", 
+                      nlk_workspace_size(ws) == ws_size);
+            mu_assert("stream: workspace not reset", 
+                      nlk_workspace_mark(ws) == 0);
+            mu_assert("stream: new inference memory", 
+                      nlk_pv_work_thread(nn, NLK_PV_BATCH) == work);
+        }
+    }
+
+    /* and so do repeated single inferences */
+    nlk_pv_inference_mode(nn);
+    for(size_t ii = 0; ii < 2; ii++) {
+        struct nlk_layer_lookup_t *pv = nlk_pv_gen_string(nn, 
+                                                "red green cat one", 5);
+        mu_assert("stream: string inference failed", pv != NULL);
+        mu_assert("stream: new string inference memory", 
+                  nlk_pv_work_thread(nn, 1) == work);
+        nlk_layer_lookup_free(pv);
+    }
+    nlk_pv_learn_mode(nn);
+    mu_assert("stream: workspace grew", nlk_workspace_size(ws) == ws_size);
+
+    /* same output, in file order */
+    FILE *f1 = fopen(out_paths[0], "r");
+    FILE *f3 = fopen(out_paths[1], "r");
+    mu_assert("stream: unable to read output", f1 != NULL && f3 != NULL);
+    for(size_t ii = 0; ii < n_lines; ii++) {
+        mu_assert("stream: output too short (1 thread)",
+                  fgets(line[0], sizeof(line[0]), f1) != NULL);
+        mu_assert("stream: output too short (3 threads)",
+                  fgets(line[1], sizeof(line[1]), f3) != NULL);
+        mu_assert("stream: output depends on the number of threads", 
+                  strcmp(line[0], line[1]) == 0);
+        mu_assert("stream: bad output line", 
+                  sscanf(line[0], "%zu %u %f", &id, &class, &score) == 3);
+        mu_assert("stream: output not in file order", id == n_lines - 1 - ii);
+        mu_assert("stream: bad class", class < 3);
+        mu_assert("stream: bad score", score > 0 && score <= 1);
+    }
+    mu_assert("stream: output too long", fgets(line[0], 64, f1) == NULL);
+    fclose(f1);
+    fclose(f3);
+
+    nlk_pv_threads_free();
+    nlk_neuralnet_free(nn);
+    nlk_vocab_free(&vocab);
+    return 0;
+}
+
+/**
+ * Test the confusion counts and F1 scores of known predictions, with dense
+ * and sparse (large class values) counts
+ */
+static char *
+test_class_score()
+{
+    /* 
+     * T\P  0  1  2
+     * 0    3  1  0
+     * 1    1  2  1
+     * 2    0  0  2
+     */
+    const unsigned int truth[10] = {0, 0, 0, 0, 1, 1, 1, 1, 2, 2};
+    const unsigned int pred[10] =  {0, 0, 0, 1, 0, 1, 1, 2, 2, 2};
+    const unsigned int small[3] = {0, 1, 2};
+    const unsigned int big[3] = {7, 1000000, 4000000000u};
+    unsigned int truth_sparse[10];
+    unsigned int pred_sparse[10];
+    struct nlk_class_score_t *score;
+    float p;
+    float r;
+    float f1;
+
+    printf("Testing classification scores\n");
+
+    for(int sparse = 0; sparse < 2; sparse++) {
+        const unsigned int *c = sparse ? big : small;
+        for(size_t ii = 0; ii < 10; ii++) {
+            truth_sparse[ii] = c[truth[ii]];
+            pred_sparse[ii] = c[pred[ii]];
+        }
+        score = nlk_class_score_create(pred_sparse, truth_sparse, 10);
+        mu_assert("score: create failed", score != NULL);
+        mu_assert("score: sparse counts", (score->classes != NULL) == sparse);
+        mu_assert("score: number of counts", score->len == 3);
+        mu_assert("score: correct", score->correct == 7);
+        mu_assert("score: error cells", score->n_errors == 3);
+        mu_assert("score: error cell (0, 1)", 
+                  score->errors[0].truth == c[0] && 
+                  score->errors[0].pred == c[1] && 
+                  score->errors[0].count == 1);
+
+        mu_assert("score: accuracy", 
+                  fabs(nlk_class_score_get_accuracy(score) - 0.7) < 1e-6);
+
+        /* class 0: p = 3/4, r = 3/4; 1: p = 2/3, r = 2/4; 2: p = 2/3, r = 1 */
+        f1 = nlk_class_score_get_f1pr(score, c[0], &p, &r);
+        mu_assert("score: class 0", fabs(p - 0.75) < 1e-6 && 
+                                    fabs(r - 0.75) < 1e-6 &&
+                                    fabs(f1 - 0.75) < 1e-6);
+        f1 = nlk_class_score_get_f1pr(score, c[1], &p, &r);
+        mu_assert("score: class 1", fabs(p - 2 / 3.0) < 1e-6 && 
+                                    fabs(r - 0.5) < 1e-6 &&
+                                    fabs(f1 - 4 / 7.0) < 1e-6);
+        f1 = nlk_class_score_get_f1pr(score, c[2], &p, &r);
+        mu_assert("score: class 2", fabs(p - 2 / 3.0) < 1e-6 && 
+                                    fabs(r - 1) < 1e-6 &&
+                                    fabs(f1 - 0.8) < 1e-6);
+        f1 = nlk_class_score_get_f1pr(score, 5, &p, &r);
+        mu_assert("score: absent class", f1 == 0 && p == 0 && r == 0);
+
+        f1 = nlk_class_score_get_micro(score, &p, &r);
+        mu_assert("score: micro", fabs(f1 - 0.7) < 1e-6);
+        f1 = nlk_class_score_get_macro(score, &p, &r);
+        mu_assert("score: macro f1", 
+                  fabs(f1 - (0.75 + 4 / 7.0 + 0.8) / 3) < 1e-6);
+        mu_assert("score: macro precision", 
+                  fabs(p - (0.75 + 4 / 3.0) / 3) < 1e-6);
+
+        nlk_class_score_free(score);
+    }
+
+    return 0;
+}
+
 /**
 * Function that runs all tests
 */
 static char *
 all_tests() {
+    mu_run_test(test_linear_q8);
+    mu_run_test(test_class_score);
+    mu_run_test(test_classify_stream);
     mu_run_test(test_conll_count);
     mu_run_test(test_conll_load);
     mu_run_test(test_read_classes);
@@ -0,0 +1,214 @@
+#include <stdio.h>
+#include <math.h>
+#include "minunit.h"
+#include "../src/nlk.h"
+#include "../src/nlk_array.h"
+#include "../src/nlk_transfer.h"
+#include "../src/nlk_layer_linear.h"
+#include "../src/nlk_exec.h"
+
+int tests_run = 0;
+int tests_passed = 0;
+
+#define N_EXAMPLES  5
+#define N_IN        7
+#define N_HIDDEN    6
+#define N_CLASSES   4
+
+
+/**
+ * Two linear layers (sigmoid, log softmax) with fixed parameters
+ */
+static void
+exec_test_layers(struct nlk_layer_linear_t **layers)
+{
+    layers[0] = nlk_layer_linear_create(N_HIDDEN, N_IN, true);
+    layers[1] = nlk_layer_linear_create(N_CLASSES, N_HIDDEN, true);
+
+    for(size_t ll = 0; ll < 2; ll++) {
+        for(size_t ii = 0; ii < layers[ll]->weights->len; ii++) {
+            layers[ll]->weights->data[ii] = 0.5 * sin(ii * 0.37 + ll);
+        }
+        for(size_t ii = 0; ii < layers[ll]->bias->len; ii++) {
+            layers[ll]->bias->data[ii] = 0.1 * cos(ii * 1.3 + ll);
+        }
+    }
+}
+
+/**
+ * Largest absolute difference between the parameters of two stacks
+ */
+static nlk_real
+exec_test_diff(struct nlk_layer_linear_t **a, struct nlk_layer_linear_t **b)
+{
+    nlk_real diff = 0;
+
+    for(size_t ll = 0; ll < 2; ll++) {
+        for(size_t ii = 0; ii < a[ll]->weights->len; ii++) {
+            diff = fmax(diff, fabs(a[ll]->weights->data[ii] -
+                                   b[ll]->weights->data[ii]));
+        }
+        for(size_t ii = 0; ii < a[ll]->bias->len; ii++) {
+            diff = fmax(diff, fabs(a[ll]->bias->data[ii] -
+                                   b[ll]->bias->data[ii]));
+        }
+    }
+    return diff;
+}
+
+/**
+ * Fill the input of example ii of an executor's batch (row jj of inputs)
+ */
+static void
+exec_test_input(struct nlk_exec_t *exec, const size_t ii, const size_t jj)
+{
+    NLK_ARRAY in;
+
+    nlk_exec_input(exec, ii, &in);
+    for(size_t kk = 0; kk < N_IN; kk++) {
+        in.data[kk] = cos((jj + 1) * (kk + 2) * 0.71);
+    }
+}
+
+/**
+ * Forward and backward of a stack of layers: a batch of n examples (GEMM)
+ * gives the outputs, input gradients and parameter updates of n batch-1
+ * runs (GEMV, GER), the update being the sum of the examples' updates.
+ */
+static char *
+test_exec_batch()
+{
+    const NLK_TRANSFER transfers[2] = {NLK_TRANSFER_SIGMOID,
+                                       NLK_TRANSFER_LOG_SOFTMAX};
+    const nlk_real learn_rate = 0.05;
+    const unsigned int targets[N_EXAMPLES] = {0, 3, 1, 2, 3};
+    struct nlk_layer_linear_t *batched[2];
+    struct nlk_layer_linear_t *single[2];
+    struct nlk_layer_linear_t *initial[2];
+    struct nlk_exec_t *exec_n;
+    struct nlk_exec_t *exec_1;
+    NLK_ARRAY out_n;
+    NLK_ARRAY out_1;
+    nlk_real grad_in[N_EXAMPLES][N_IN];
+    nlk_real delta;
+
+    printf("Testing batched forward and backward\n");
+
+    exec_test_layers(batched);
+    exec_test_layers(single);
+    exec_test_layers(initial);
+    exec_n = nlk_exec_create(batched, transfers, 2, N_EXAMPLES);
+    exec_1 = nlk_exec_create(single, transfers, 2, 1);
+    mu_assert("exec: create failed", exec_n != NULL && exec_1 != NULL);
+
+    /* batch of n: zero learn rate (the default) */
+    for(size_t ii = 0; ii < N_EXAMPLES; ii++) {
+        exec_test_input(exec_n, ii, ii);
+    }
+    nlk_exec_forward(exec_n, N_EXAMPLES);
+    nlk_exec_nll_backprop(exec_n, N_EXAMPLES, targets);
+    nlk_exec_backward(exec_n, N_EXAMPLES, true);
+    for(size_t ii = 0; ii < N_EXAMPLES; ii++) {
+        for(size_t kk = 0; kk < N_IN; kk++) {
+            grad_in[ii][kk] = exec_n->grad[0]->data[ii * N_IN + kk];
+        }
+    }
+
+    /* n batches of 1: same outputs and gradients at the input */
+    for(size_t ii = 0; ii < N_EXAMPLES; ii++) {
+        exec_test_input(exec_1, 0, ii);
+        nlk_exec_forward(exec_1, 1);
+        nlk_exec_nll_backprop(exec_1, 1, &targets[ii]);
+        nlk_exec_backward(exec_1, 1, true);
+
+        nlk_exec_output(exec_n, ii, &out_n);
+        nlk_exec_output(exec_1, 0, &out_1);
+        for(size_t kk = 0; kk < N_CLASSES; kk++) {
+            mu_assert("exec: batch output differs",
+                      fabs(out_n.data[kk] - out_1.data[kk]) < 1e-5);
+        }
+        for(size_t kk = 0; kk < N_IN; kk++) {
+            mu_assert("exec: batch input gradient differs",
+                      fabs(grad_in[ii][kk] - exec_1->grad[0]->data[kk])
+                      < 1e-5);
+        }
+    }
+
+    /* zero learn rate: no update */
+    mu_assert("exec: batch updated with zero learn rate",
+              exec_test_diff(batched, initial) == 0);
+    mu_assert("exec: single updated with zero learn rate",
+              exec_test_diff(single, initial) == 0);
+
+    /* one update of the batch */
+    nlk_exec_learn_rate(exec_n, learn_rate, false);
+    nlk_exec_forward(exec_n, N_EXAMPLES);
+    nlk_exec_nll_backprop(exec_n, N_EXAMPLES, targets);
+    nlk_exec_backward(exec_n, N_EXAMPLES, false);
+    delta = exec_test_diff(batched, initial);
+    mu_assert("exec: batch did not update", delta > 1e-4);
+
+    /* the update of each batch of 1 from the same parameters, summed */
+    nlk_exec_learn_rate(exec_1, learn_rate, false);
+    for(size_t ii = 0; ii < N_EXAMPLES; ii++) {
+        for(size_t ll = 0; ll < 2; ll++) {
+            nlk_array_copy(single[ll]->weights, initial[ll]->weights);
+            nlk_array_copy(single[ll]->bias, initial[ll]->bias);
+        }
+        exec_test_input(exec_1, 0, ii);
+        nlk_exec_forward(exec_1, 1);
+        nlk_exec_nll_backprop(exec_1, 1, &targets[ii]);
+        nlk_exec_backward(exec_1, 1, false);
+
+        /* batched -= single - initial */
+        for(size_t ll = 0; ll < 2; ll++) {
+            nlk_array_add(initial[ll]->weights, batched[ll]->weights);
+            nlk_array_scale(-1, single[ll]->weights);
+            nlk_array_add(single[ll]->weights, batched[ll]->weights);
+            nlk_array_add(initial[ll]->bias, batched[ll]->bias);
+            nlk_array_scale(-1, single[ll]->bias);
+            nlk_array_add(single[ll]->bias, batched[ll]->bias);
+        }
+    }
+    mu_assert("exec: batch update is not the sum of the updates",
+              exec_test_diff(batched, initial) < 1e-5);
+
+    nlk_exec_free(exec_n);
+    nlk_exec_free(exec_1);
+    for(size_t ll = 0; ll < 2; ll++) {
+        nlk_layer_linear_free(batched[ll]);
+        nlk_layer_linear_free(single[ll]);
+        nlk_layer_linear_free(initial[ll]);
+    }
+    return 0;
+}
+
+
+/**
+ * Function that runs all tests
+ */
+static char *
+all_tests() {
+    mu_run_test(test_exec_batch);
+    return 0;
+}
+
+int
+main() {
+    printf("\n-------------------------------------------------------\n");
+    printf("Exec Tests\n");
+    printf("---------------------------------------------------------\n");
+
+    nlk_init();
+
+    char *result = all_tests();
+    if(result != 0) {
+        printf("FAIL: %s\n", result);
+    }
+    else {
+        printf("ALL TESTS PASSED\n");
+    }
+    printf("Tests Passed: %d/%d\n", tests_passed, tests_run);
+
+    return result != 0;
+}
@@ -0,0 +1,129 @@
+#include <stdio.h>
+#include <math.h>
+#include "minunit.h"
+#include "../src/nlk_array.h"
+#include "../src/nlk_layer_lookup.h"
+
+int tests_run = 0;
+int tests_passed = 0;
+
+
+/**
+ * Test the SGD update of a lookup layer: the gradient is added to the row
+ */
+static char *
+test_lookup_sgd()
+{
+    struct nlk_layer_lookup_t *layer = nlk_layer_lookup_create(3, 4);
+    NLK_ARRAY *grad = nlk_array_create(4, 1);
+
+    printf("Testing lookup SGD update\n");
+    for(size_t ii = 0; ii < 4; ii++) {
+        grad->data[ii] = 0.1 * (ii + 1);
+    }
+    nlk_layer_lookup_backprop_lookup_one(layer, 1, grad);
+    nlk_layer_lookup_backprop_lookup_one(layer, 1, grad);
+
+    for(size_t ii = 0; ii < 4; ii++) {
+        mu_assert("sgd: row 0 changed", layer->weights->data[ii] == 0);
+        mu_assert("sgd: row 1 is not the sum of the gradients",
+                  fabs(layer->weights->data[4 + ii] - 0.2 * (ii + 1)) < 1e-6);
+        mu_assert("sgd: row 2 changed", layer->weights->data[8 + ii] == 0);
+    }
+
+    nlk_array_free(grad);
+    nlk_layer_lookup_free(layer);
+    return 0;
+}
+
+/**
+ * Test the AdaGrad update of a lookup layer: the accumulator is the sum of
+ * the mean squared raw gradients and the step does not depend on the
+ * learning rate the gradients were scaled by
+ */
+static char *
+test_lookup_adagrad()
+{
+    const nlk_real rate = 0.1;
+    const nlk_real scales[2] = {1, 0.01};
+    const nlk_real raw[4] = {0.5, -1, 1.5, 2};
+    struct nlk_layer_lookup_t *layers[2];
+    NLK_ARRAY *grad = nlk_array_create(4, 1);
+    nlk_real acc = 0;
+    nlk_real expected[4] = {0, 0, 0, 0};
+
+    printf("Testing lookup AdaGrad update\n");
+
+    /* two updates of the same raw gradient scaled by different rates */
+    for(size_t ll = 0; ll < 2; ll++) {
+        layers[ll] = nlk_layer_lookup_create(3, 4);
+        mu_assert("adagrad: allocation failed",
+                  nlk_layer_lookup_adagrad(layers[ll], rate) == NLK_SUCCESS);
+        mu_assert("adagrad: base rate", layers[ll]->adagrad_rate == rate);
+        mu_assert("adagrad: layer rate changed",
+                  layers[ll]->learn_rate == 0);
+
+        nlk_layer_lookup_grad_scale(scales[ll]);
+        for(size_t ii = 0; ii < 4; ii++) {
+            grad->data[ii] = raw[ii] * scales[ll];
+        }
+        nlk_layer_lookup_backprop_lookup_one(layers[ll], 2, grad);
+        nlk_layer_lookup_backprop_lookup_one(layers[ll], 2, grad);
+    }
+    nlk_layer_lookup_grad_scale(1);
+
+    /* expected: acc_t = acc_t-1 + mean(raw^2), w += rate raw / sqrt(acc_t) */
+    for(size_t tt = 0; tt < 2; tt++) {
+        acc += (0.25 + 1 + 2.25 + 4) / 4;
+        for(size_t ii = 0; ii < 4; ii++) {
+            expected[ii] += rate * raw[ii] / (sqrt(acc) + NLK_ADAGRAD_EPS);
+        }
+    }
+    for(size_t ll = 0; ll < 2; ll++) {
+        mu_assert("adagrad: bad accumulator",
+                  fabs(layers[ll]->adagrad[2] - acc) < 1e-4);
+        mu_assert("adagrad: untouched rows accumulated",
+                  layers[ll]->adagrad[0] == 0 && layers[ll]->adagrad[1] == 0);
+        for(size_t ii = 0; ii < 4; ii++) {
+            mu_assert("adagrad: bad step",
+                      fabs(layers[ll]->weights->data[8 + ii] - expected[ii])
+                      < 1e-5);
+            mu_assert("adagrad: untouched row changed",
+                      layers[ll]->weights->data[ii] == 0);
+        }
+    }
+
+    nlk_array_free(grad);
+    nlk_layer_lookup_free(layers[0]);
+    nlk_layer_lookup_free(layers[1]);
+    return 0;
+}
+
+
+/**
+ * Function that runs all tests
+ */
+static char *
+all_tests() {
+    mu_run_test(test_lookup_sgd);
+    mu_run_test(test_lookup_adagrad);
+    return 0;
+}
+
+int
+main() {
+    printf("\n-------------------------------------------------------\n");
+    printf("Layer Tests\n");
+    printf("---------------------------------------------------------\n");
+
+    char *result = all_tests();
+    if(result != 0) {
+        printf("FAIL: %s\n", result);
+    }
+    else {
+        printf("ALL TESTS PASSED\n");
+    }
+    printf("Tests Passed: %d/%d\n", tests_passed, tests_run);
+
+    return result != 0;
+}
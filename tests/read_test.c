@@ -1,6 +1,7 @@
 #include <stdio.h>
 #include <stdint.h>
 #include <unistd.h>
+#include <stdlib.h>
 #include <string.h>
 #include "minunit.h"
 #include "../src/nlk_text.h"
@@ -173,11 +174,100 @@ test_count_empty_lines()
 }
 
 
+/**
+ * Test reading long lines in chunks: a line longer than NLK_CHUNK_SIZE 
+ * words continues in the next call and no word is lost or split
+ */
+static char *
+test_read_chunks()
+{
+    const size_t long_words = 2 * NLK_CHUNK_SIZE + NLK_CHUNK_SIZE / 2;
+    char **text_line = nlk_text_chunk_create();
+    char *buffer = (char *) malloc(NLK_CHUNK_BUFFER_SIZE);
+    char word[32];
+    size_t par_id = 0;
+    size_t next = 0;
+    size_t ww;
+    int ret;
+
+    printf("Testing chunked reading\n");
+
+    /* a long line, a short one, one of exactly NLK_CHUNK_SIZE words and a 
+     * last one without a newline */
+    FILE *fp = fopen("tmp/chunks.txt", "w");
+    mu_assert("chunks: unable to write file", fp != NULL);
+    fprintf(fp, "7");
+    for(size_t ii = 0; ii < long_words; ii++) {
+        fprintf(fp, " w%zu", ii);
+    }
+    fprintf(fp, "\n8 a b c\n9");
+    for(size_t ii = 0; ii < NLK_CHUNK_SIZE; ii++) {
+        fprintf(fp, "  x%zu", ii);
+    }
+    fprintf(fp, "\n10 last");
+    fclose(fp);
+
+    int fd = nlk_open("tmp/chunks.txt");
+
+    /* long line: two full chunks then the rest */
+    ret = nlk_read_chunk(fd, text_line, &par_id, buffer);
+    mu_assert("chunks: long line id", par_id == 7);
+    while(true) {
+        for(ww = 0; text_line[ww][0] != '\0'; ww++, next++) {
+            snprintf(word, sizeof(word), "w%zu", next);
+            mu_assert("chunks: word lost or split", 
+                      strcmp(word, text_line[ww]) == 0);
+        }
+        if(ret != NLK_CHUNK) {
+            break;
+        }
+        mu_assert("chunks: full chunk", ww == NLK_CHUNK_SIZE);
+        ret = nlk_read_chunk(fd, text_line, NULL, buffer);
+    }
+    mu_assert("chunks: long line terminator", ret == '\n');
+    mu_assert("chunks: long line words", next == long_words);
+
+    /* short line */
+    ret = nlk_read_chunk(fd, text_line, &par_id, buffer);
+    mu_assert("chunks: short line terminator", ret == '\n');
+    mu_assert("chunks: short line id", par_id == 8);
+    mu_assert("chunks: short line words", strcmp("a", text_line[0]) == 0 &&
+                                          strcmp("c", text_line[2]) == 0 &&
+                                          text_line[3][0] == '\0');
+
+    /* exactly NLK_CHUNK_SIZE words: one chunk ending the line */
+    ret = nlk_read_chunk(fd, text_line, &par_id, buffer);
+    mu_assert("chunks: full line terminator", ret == '\n');
+    mu_assert("chunks: full line id", par_id == 9);
+    snprintf(word, sizeof(word), "x%d", NLK_CHUNK_SIZE - 1);
+    mu_assert("chunks: full line last word", 
+              strcmp(word, text_line[NLK_CHUNK_SIZE - 1]) == 0);
+    mu_assert("chunks: full line words", 
+              text_line[NLK_CHUNK_SIZE][0] == '\0');
+
+    /* last line, no newline */
+    ret = nlk_read_chunk(fd, text_line, &par_id, buffer);
+    mu_assert("chunks: last line terminator", ret == EOF);
+    mu_assert("chunks: last line id", par_id == 10);
+    mu_assert("chunks: last line word", strcmp("last", text_line[0]) == 0 &&
+                                        text_line[1][0] == '\0');
+
+    ret = nlk_read_chunk(fd, text_line, &par_id, buffer);
+    mu_assert("chunks: end of file", ret == EOF && text_line[0][0] == '\0');
+
+    close(fd);
+    free(buffer);
+    nlk_text_line_free(text_line);
+    return 0;
+}
+
+
 /**
  * Function that runs all tests
  */
 static char *
 all_tests() {
+    mu_run_test(test_read_chunks);
     mu_run_test(test_read_lines);
     mu_run_test(test_goto_lines);
     mu_run_test(test_count_empty_lines);
@@ -1,5 +1,6 @@
 #include <stdio.h>
 #include "minunit.h"
+#include "../src/nlk_err.h"
 #include "../src/nlk_array.h"
  
 int tests_run = 0;
@@ -104,12 +105,61 @@ test_array_load_text()
     return 0;
 }
 
+/**
+ * Test reopening a file backed array (nlk_array_create_map/open_map)
+ */
+static char *
+test_array_map()
+{
+    size_t rows = 37;
+    size_t cols = 13;
+
+    /* create, fill, persist */
+    NLK_ARRAY *origin = nlk_array_create_map("tmp/array.map", rows, cols);
+    mu_assert("Array-Map: unable to create tmp/array.map", origin != NULL);
+    for(size_t ii = 0; ii < origin->len; ii++) {
+        origin->data[ii] = ii * 0.5 - 7;
+    }
+    nlk_array_free(origin);
+
+    /* reopen (read only) */
+    NLK_ARRAY *loaded = nlk_array_open_map("tmp/array.map", true);
+    mu_assert("Array-Map: unable to open tmp/array.map", loaded != NULL);
+    mu_assert("Array-Map: arrays rows do not match", loaded->rows == rows);
+    mu_assert("Array-Map: arrays columns do not match", loaded->cols == cols);
+    for(size_t ii = 0; ii < loaded->len; ii++) {
+        mu_assert("Array-Map: error in data", 
+                  loaded->data[ii] == (nlk_real) (ii * 0.5 - 7));
+    }
+
+    /* read only: changes stay in memory */
+    loaded->data[0] = 1000;
+    nlk_array_free(loaded);
+    loaded = nlk_array_open_map("tmp/array.map", false);
+    mu_assert("Array-Map: read only open changed the file",
+              loaded->data[0] == -7);
+    nlk_array_free(loaded);
+
+    /* not a mapped array */
+    FILE *fp = fopen("tmp/array.bad", "wb");
+    mu_assert("unable to open file for writting: array.bad", fp != NULL);
+    fprintf(fp, "%d %d\n", 1, 2);
+    fclose(fp);
+    nlk_set_error_handler_off();
+    loaded = nlk_array_open_map("tmp/array.bad", true);
+    nlk_set_error_handler(NULL);
+    mu_assert("Array-Map: opened a file without a header", loaded == NULL);
+
+    return 0;
+}
+
 /**
  * Function that runs all tests
  */
 static char *
 all_tests() {
     mu_run_test(test_array_text);
+    mu_run_test(test_array_map);
     mu_run_test(test_array_load_text);
     return 0;
 }
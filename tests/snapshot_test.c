@@ -0,0 +1,285 @@
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "minunit.h"
+#include "../src/nlk.h"
+#include "../src/nlk_array.h"
+#include "../src/nlk_random.h"
+#include "../src/nlk_layer_lookup.h"
+#include "../src/nlk_neuralnet.h"
+#include "../src/nlk_vocabulary.h"
+#include "../src/nlk_w2v.h"
+#include "../src/nlk_eval.h"
+#include "../src/nlk_snapshot.h"
+
+int tests_run = 0;
+int tests_passed = 0;
+
+
+/**
+ * Publish the network with all of its word weights set to value
+ */
+static bool
+snapshot_test_publish(struct nlk_publisher_t *pub,
+                      struct nlk_neuralnet_t *nn, const nlk_real value)
+{
+    for(size_t ii = 0; ii < nn->words->weights->len; ii++) {
+        nn->words->weights->data[ii] = value;
+    }
+    return nlk_publisher_publish(pub, nn, (size_t) value);
+}
+
+/**
+ * True if all the word weights of a snapshot are value
+ */
+static bool
+snapshot_test_is(const struct nlk_snapshot_t *snap, const nlk_real value)
+{
+    const NLK_ARRAY *weights = snap->nn.words->weights;
+
+    for(size_t ii = 0; ii < weights->len; ii++) {
+        if(weights->data[ii] != value) {
+            return false;
+        }
+    }
+    return snap->words == (size_t) value;
+}
+
+/**
+ * Test pin, publish, retire and reuse: a pinned snapshot keeps its copy
+ * and is never reused, unpinned snapshots are reused instead of allocating
+ */
+static char *
+test_snapshot_reuse()
+{
+    struct nlk_neuralnet_t nn;
+    struct nlk_publisher_t *pub;
+    struct nlk_snapshot_t *pinned;
+    struct nlk_snapshot_t *snap;
+
+    printf("Testing snapshot reuse\n");
+
+    memset(&nn, 0, sizeof(nn));
+    nn.words = nlk_layer_lookup_create(5, 3);
+    pub = nlk_publisher_create(0);
+    mu_assert("snapshot: publisher creation failed", pub != NULL);
+    mu_assert("snapshot: pinned before a publication",
+              nlk_snapshot_pin(pub) == NULL);
+
+    /* pin the first snapshot */
+    mu_assert("snapshot: publish 1", snapshot_test_publish(pub, &nn, 1));
+    pinned = nlk_snapshot_pin(pub);
+    mu_assert("snapshot: pin failed", pinned != NULL && pinned->epoch == 1);
+    mu_assert("snapshot: bad copy", snapshot_test_is(pinned, 1));
+
+    /* it is retired but, pinned, neither reused nor changed */
+    for(nlk_real value = 2; value <= 5; value++) {
+        mu_assert("snapshot: publish", snapshot_test_publish(pub, &nn, value));
+        mu_assert("snapshot: not the latest",
+                  pub->current != pinned &&
+                  snapshot_test_is(pub->current, value));
+        mu_assert("snapshot: pinned snapshot changed",
+                  pinned->epoch == 1 && snapshot_test_is(pinned, 1));
+    }
+    /* the pinned one, the current one, and one retired before reuse */
+    mu_assert("snapshot: unpinned snapshots not reused", pub->allocated == 3);
+
+    /* once unpinned it is reused */
+    nlk_snapshot_unpin(pinned);
+    mu_assert("snapshot: publish 6", snapshot_test_publish(pub, &nn, 6));
+    mu_assert("snapshot: publish 7", snapshot_test_publish(pub, &nn, 7));
+    mu_assert("snapshot: allocated after unpin", pub->allocated == 3);
+    snap = nlk_snapshot_pin(pub);
+    mu_assert("snapshot: bad latest",
+              snap->epoch == 7 && snapshot_test_is(snap, 7));
+    nlk_snapshot_unpin(snap);
+    mu_assert("snapshot: unpinned snapshot never reused",
+              pinned->epoch > 1 && snapshot_test_is(pinned, pinned->epoch));
+
+    nlk_publisher_free(pub);
+    nlk_layer_lookup_free(nn.words);
+    return 0;
+}
+
+/** @struct snapshot_test_monitor_t
+ * Evaluates the snapshots published while training
+ */
+struct snapshot_test_monitor_t {
+    struct nlk_publisher_t  *pub;       /**< the training's publisher */
+    struct nlk_vocab_t     **vocab;     /**< the vocabulary */
+    const char              *questions; /**< word-analogy questions */
+    bool                     done;      /**< training finished */
+    size_t                   evaluated; /**< snapshots evaluated */
+    size_t                   failed;    /**< failed or bad evaluations */
+};
+
+/**
+ * Monitor thread: evaluate each new snapshot, as nlktool --publish does
+ */
+static void *
+snapshot_test_monitor(void *arg)
+{
+    struct snapshot_test_monitor_t *mon = 
+        (struct snapshot_test_monitor_t *) arg;
+    struct nlk_snapshot_t *snap;
+    size_t last = 0;
+    bool done = false;
+    nlk_real accuracy;
+
+    while(!done) {
+        done = __atomic_load_n(&mon->done, __ATOMIC_ACQUIRE);
+        snap = nlk_snapshot_pin(mon->pub);
+        if(snap != NULL && snap->epoch != last) {
+            last = snap->epoch;
+            if(nlk_eval_on_questions_threads(mon->questions, mon->vocab,
+                                             snap->nn.words->weights, 
+                                             snap->nn.subwords, 0, false, 1,
+                                             &accuracy) 
+               != NLK_SUCCESS || accuracy < 0 || accuracy > 1) {
+                mon->failed++;
+            }
+            mon->evaluated++;
+        }
+        nlk_snapshot_unpin(snap);
+        if(!done) {
+            usleep(1000);
+        }
+    }
+    nlk_workspace_thread_free();
+
+    return NULL;
+}
+
+/**
+ * Test evaluating snapshots while training: the evaluation does not touch
+ * the training's thread setup or RNG streams
+ */
+static char *
+test_snapshot_eval_training()
+{
+    const char *path = "tmp/snapshot_corpus.txt";
+    const char *questions = "tmp/snapshot_questions.txt";
+    const char *topics[3][4] = {{"red", "green", "blue", "color"},
+                                {"cat", "dog", "bird", "animal"},
+                                {"one", "two", "three", "number"}};
+    const size_t n_lines = 3000;
+    struct snapshot_test_monitor_t mon;
+    struct nlk_publisher_t *pub;
+    struct nlk_rng_t *rng;
+    struct nlk_rng_t saved;
+    pthread_t monitor_thread;
+    nlk_real accuracy;
+
+    printf("Testing snapshot evaluation while training\n");
+    nlk_random_init_xs1024(1);
+
+    /* corpus and questions */
+    FILE *fp = fopen(path, "w");
+    mu_assert("snapshot: unable to write corpus", fp != NULL);
+    for(size_t ii = 0; ii < n_lines; ii++) {
+        const size_t tt = ii % 3;
+        fprintf(fp, "%s %s %s %s\n", topics[tt][ii % 4], 
+                topics[tt][(ii + 1) % 4], topics[tt][(ii + 2) % 4], 
+                topics[tt][(ii + 3) % 4]);
+    }
+    fclose(fp);
+    fp = fopen(questions, "w");
+    mu_assert("snapshot: unable to write questions", fp != NULL);
+    fprintf(fp, ": topics\nred color cat animal\ncat animal one number\n"
+                "one number red color\n");
+    fclose(fp);
+
+    /* network */
+    struct nlk_vocab_t *vocab = nlk_vocab_create(path, false, 1, false, 
+                                                 false);
+    nlk_vocab_encode_huffman(&vocab);
+    struct nlk_nn_train_t train_opts;
+    memset(&train_opts, 0, sizeof(train_opts));
+    train_opts.model_type = NLK_CBOW;
+    train_opts.window = 3;
+    train_opts.learn_rate = 0.05;
+    train_opts.hs = true;
+    train_opts.iter = 5;
+    train_opts.vector_size = 16;
+    train_opts.word_count = nlk_vocab_count_words(&vocab, path, false, 
+                                                  n_lines);
+    train_opts.paragraph_count = n_lines;
+    struct nlk_neuralnet_t *nn = nlk_w2v_create(train_opts, false, vocab, 
+                                                false);
+    mu_assert("snapshot: network creation failed", nn != NULL);
+    pub = nlk_publisher_create(train_opts.word_count / 4);
+    mu_assert("snapshot: publisher creation failed", pub != NULL);
+
+    /* evaluating a snapshot leaves the thread's RNG stream alone */
+    rng = nlk_rng_thread();
+    nlk_rng_next(rng);
+    memcpy(&saved, rng, sizeof(saved));
+    mu_assert("snapshot: publish", nlk_publisher_publish(pub, nn, 0));
+    struct nlk_snapshot_t *snap = nlk_snapshot_pin(pub);
+    mu_assert("snapshot: evaluation failed", 
+              nlk_eval_on_questions_threads(questions, &vocab, 
+                                            snap->nn.words->weights, NULL, 0,
+                                            false, 2, &accuracy) 
+              == NLK_SUCCESS);
+    nlk_snapshot_unpin(snap);
+    mu_assert("snapshot: evaluation reseeded the RNG streams",
+              nlk_rng_thread() == rng && 
+              memcmp(rng, &saved, sizeof(saved)) == 0);
+
+    /* evaluate the snapshots while training with two threads */
+    memset(&mon, 0, sizeof(mon));
+    mon.pub = pub;
+    mon.vocab = &vocab;
+    mon.questions = questions;
+    nlk_set_phase_threads(NLK_PHASE_TRAIN, 2);
+    nlk_w2v_set_publisher(pub);
+    mu_assert("snapshot: unable to start the monitor",
+              pthread_create(&monitor_thread, NULL, snapshot_test_monitor, 
+                             &mon) == 0);
+    nlk_w2v(nn, path, false);
+    __atomic_store_n(&mon.done, true, __ATOMIC_RELEASE);
+    pthread_join(monitor_thread, NULL);
+    nlk_w2v_set_publisher(NULL);
+
+    mu_assert("snapshot: no snapshot evaluated", mon.evaluated > 1);
+    mu_assert("snapshot: snapshot evaluation failed", mon.failed == 0);
+    mu_assert("snapshot: final snapshot not published", 
+              pub->epoch > 1 && pub->current->words > 0);
+
+    nlk_publisher_free(pub);
+    nlk_neuralnet_free(nn);
+    nlk_vocab_free(&vocab);
+    return 0;
+}
+
+
+/**
+ * Function that runs all tests
+ */
+static char *
+all_tests() {
+    mu_run_test(test_snapshot_reuse);
+    mu_run_test(test_snapshot_eval_training);
+    return 0;
+}
+
+int
+main() {
+    printf("\n-------------------------------------------------------\n");
+    printf("Snapshot Tests\n");
+    printf("---------------------------------------------------------\n");
+
+    nlk_init();
+
+    char *result = all_tests();
+    if(result != 0) {
+        printf("FAIL: %s\n", result);
+    }
+    else {
+        printf("ALL TESTS PASSED\n");
+    }
+    printf("Tests Passed: %d/%d\n", tests_passed, tests_run);
+
+    return result != 0;
+}
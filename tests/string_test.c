@@ -151,12 +151,95 @@ test_case_folding()
 }
 
 
+/**
+ * Test in-place normalization (SIMD ASCII runs + utf8proc)
+ */
+static char *
+test_normalize()
+{
+    /* long enough for the vector paths, with a non-ASCII char in between */
+    char str[] = "THE QUICK Brown FOX JUMPS OVER THE LAZY DOG \xc3\x89" "COLE "
+                 "AND THE \xce\xa3\xce\xa3 DOGS";
+    const char *lower = "the quick brown fox jumps over the lazy dog "
+                        "\xc3\xa9" "cole and the \xcf\x83\xcf\x83 dogs";
+    size_t len = strlen(str);
+
+    len = nlk_string_normalize(str, len, NLK_NORMALIZE_NONE);
+    mu_assert("normalize none changed the length", len == strlen(str));
+
+    len = nlk_string_normalize(str, len, NLK_NORMALIZE_LOWER);
+    str[len] = '\0';
+    mu_assert("normalize lower failure", strcmp(str, lower) == 0);
+
+    len = nlk_string_normalize(str, len, NLK_NORMALIZE_CASE_FOLD);
+    str[len] = '\0';
+    mu_assert("normalize case fold failure", strcmp(str, lower) == 0);
+
+    return 0;
+}
+
+
+/**
+ * Test normalization of mixed ASCII and caseless utf8: the ASCII is folded
+ * and the utf8 bytes are identical, at every offset of the vector blocks
+ */
+static char *
+test_normalize_mixed_utf8()
+{
+    /* caseless or already lower case: CJK, e acute, emoji, arrow */
+    const char *utf8[] = {"\xe6\x97\xa5\xe6\x9c\xac", "\xc3\xa9",
+                          "\xf0\x9f\x98\x80", "\xe2\x86\x92"};
+    const char *ascii = "ABCDEFGHIJKLMNOPQRSTUVWXYZ@[`{";
+    const char *folded = "abcdefghijklmnopqrstuvwxyz@[`{";
+    char str[256];
+    char expected[256];
+    size_t len;
+
+    for(size_t uu = 0; uu < sizeof(utf8) / sizeof(utf8[0]); uu++) {
+        for(size_t off = 0; off <= 40; off++) {
+            /* off ASCII bytes, the utf8 character, ASCII again */
+            len = 0;
+            for(size_t ii = 0; ii < off; ii++) {
+                str[len] = ascii[ii % 30];
+                expected[len] = folded[ii % 30];
+                len++;
+            }
+            memcpy(&str[len], utf8[uu], strlen(utf8[uu]));
+            memcpy(&expected[len], utf8[uu], strlen(utf8[uu]));
+            len += strlen(utf8[uu]);
+            for(size_t ii = 0; ii < 40; ii++) {
+                str[len] = ascii[ii % 30];
+                expected[len] = folded[ii % 30];
+                len++;
+            }
+
+            for(NLK_NORMALIZE mode = NLK_NORMALIZE_LOWER; 
+                mode <= NLK_NORMALIZE_CASE_FOLD; mode++) {
+                char work[256];
+                memcpy(work, str, len);
+                mu_assert("normalize mixed: length changed",
+                          nlk_string_normalize(work, len, mode) == len);
+                mu_assert("normalize mixed: utf8 bytes changed",
+                          memcmp(&work[off], utf8[uu], strlen(utf8[uu])) 
+                          == 0);
+                mu_assert("normalize mixed: ASCII not folded",
+                          memcmp(work, expected, len) == 0);
+            }
+        }
+    }
+
+    return 0;
+}
+
+
 /**
  * Function that runs all tests
  */
 static char *
 all_tests() {
     mu_run_test(test_case_folding);
+    mu_run_test(test_normalize);
+    mu_run_test(test_normalize_mixed_utf8);
     return 0;
 }
  
@@ -0,0 +1,199 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include "minunit.h"
+#include "../src/nlk.h"
+#include "../src/nlk_util.h"
+#include "../src/nlk_corpus.h"
+
+int tests_run = 0;
+int tests_passed = 0;
+
+
+/**
+ * Test membership in a dense (bitmap) set
+ */
+static char *
+test_set_bitmap()
+{
+    size_t values[] = {5, 0, 64, 63, 5, 130};
+    const size_t len = sizeof(values) / sizeof(values[0]);
+
+    struct nlk_set_t *set = nlk_set_create(values, len);
+    mu_assert("set creation failed", set != NULL);
+    mu_assert("dense set should be a bitmap", set->bits != NULL);
+
+    for(size_t ii = 0; ii < 200; ii++) {
+        const bool in = ii == 0 || ii == 5 || ii == 63 || ii == 64 ||
+                        ii == 130;
+        mu_assert("bitmap set membership", nlk_set_in(set, ii) == in);
+    }
+    mu_assert("bitmap set beyond max", !nlk_set_in(set, 1000000));
+
+    nlk_set_free(set);
+    return 0;
+}
+
+/**
+ * Test membership in a sparse (sorted) set
+ */
+static char *
+test_set_sorted()
+{
+    size_t values[] = {1000000, 3, 7000000, 3, 42, 1000000};
+    const size_t len = sizeof(values) / sizeof(values[0]);
+
+    struct nlk_set_t *set = nlk_set_create(values, len);
+    mu_assert("set creation failed", set != NULL);
+    mu_assert("sparse set should be sorted", set->sorted != NULL);
+    mu_assert("sorted set keeps unique values", set->len == 4);
+
+    for(size_t ii = 1; ii < set->len; ii++) {
+        mu_assert("sorted set order", set->sorted[ii - 1] < set->sorted[ii]);
+    }
+    mu_assert("sorted set has 3", nlk_set_in(set, 3));
+    mu_assert("sorted set has 42", nlk_set_in(set, 42));
+    mu_assert("sorted set has 1000000", nlk_set_in(set, 1000000));
+    mu_assert("sorted set has 7000000", nlk_set_in(set, 7000000));
+    mu_assert("sorted set lacks 0", !nlk_set_in(set, 0));
+    mu_assert("sorted set lacks 43", !nlk_set_in(set, 43));
+    mu_assert("sorted set lacks 6999999", !nlk_set_in(set, 6999999));
+    mu_assert("sorted set beyond max", !nlk_set_in(set, 7000001));
+
+    nlk_set_free(set);
+    return 0;
+}
+
+/**
+ * Test set difference and range exclusion
+ */
+static char *
+test_set_diff()
+{
+    size_t a[] = {9, 2, 4, 7, 2, 0};
+    size_t b[] = {2, 7, 100};
+    size_t expected[] = {9, 4, 0};
+    size_t len = 0;
+
+    size_t *r = nlk_set_diff(a, 6, b, 3, &len);
+    mu_assert("set diff failed", r != NULL);
+    mu_assert("set diff length", len == 3);
+    for(size_t ii = 0; ii < len; ii++) {
+        mu_assert("set diff keeps the order of a", r[ii] == expected[ii]);
+    }
+    free(r);
+
+    /* nothing to exclude */
+    r = nlk_set_diff(a, 6, NULL, 0, &len);
+    mu_assert("set diff with empty b", r != NULL && len == 6);
+    free(r);
+
+    /* [0, 10[ not in a (ids >= n are ignored) */
+    size_t excl[] = {0, 3, 9, 3, 50};
+    size_t range[] = {1, 2, 4, 5, 6, 7, 8};
+    r = nlk_range_not_in(excl, 5, 10, &len);
+    mu_assert("range not in failed", r != NULL);
+    mu_assert("range not in length", len == 7);
+    for(size_t ii = 0; ii < len; ii++) {
+        mu_assert("range not in values", r[ii] == range[ii]);
+    }
+    free(r);
+
+    return 0;
+}
+
+/**
+ * Test counting the words of a corpus subset
+ */
+static char *
+test_corpus_subset_count()
+{
+    struct nlk_line_t lines[5];
+    struct nlk_corpus_t corpus;
+    size_t ids[] = {40, 10, 10, 1000};
+
+    for(size_t ii = 0; ii < 5; ii++) {
+        lines[ii].line_id = (ii + 1) * 10;  /* 10, 20, ..., 50 */
+        lines[ii].len = ii + 1;
+        lines[ii].varray = NULL;
+    }
+    corpus.lines = lines;
+    corpus.len = 5;
+    corpus.count = 15;
+
+    mu_assert("subset count", nlk_corpus_subset_count(&corpus, ids, 4) == 5);
+    mu_assert("empty subset count",
+              nlk_corpus_subset_count(&corpus, ids, 0) == 0);
+
+    return 0;
+}
+
+/**
+ * Test per phase thread specs: valid specs set the phases they name, invalid
+ * ones (unknown phase, count <= 0, trailing garbage) set nothing
+ */
+static char *
+test_phase_threads_spec()
+{
+    const char *invalid[] = {"bogus=2", "train=0", "train=-4", "train=4x",
+                             "train=4 x", "train=", "=4", "infer=2,train=abc",
+                             "infer=2;eval=3"};
+
+    nlk_set_num_threads(3);
+    mu_assert("spec: valid spec rejected", 
+              nlk_set_phase_threads_spec("vocab=8, train=cores,eval = 32")
+              == NLK_SUCCESS);
+    mu_assert("spec: vocab", nlk_get_phase_threads(NLK_PHASE_VOCAB) == 8);
+    mu_assert("spec: cores", 
+              nlk_get_phase_threads(NLK_PHASE_TRAIN) == nlk_get_num_cores());
+    mu_assert("spec: eval", nlk_get_phase_threads(NLK_PHASE_EVAL) == 32);
+    mu_assert("spec: unnamed phase changed", 
+              nlk_get_phase_threads(NLK_PHASE_INFER) == 3);
+
+    for(size_t ii = 0; ii < sizeof(invalid) / sizeof(invalid[0]); ii++) {
+        mu_assert("spec: invalid spec accepted", 
+                  nlk_set_phase_threads_spec(invalid[ii]) == NLK_EINVAL);
+        mu_assert("spec: invalid spec applied", 
+                  nlk_get_phase_threads(NLK_PHASE_INFER) == 3 &&
+                  nlk_get_phase_threads(NLK_PHASE_TRAIN) == 
+                  nlk_get_num_cores() &&
+                  nlk_get_phase_threads(NLK_PHASE_EVAL) == 32);
+    }
+
+    for(int pp = 0; pp < NLK_PHASE_MAX; pp++) {
+        nlk_set_phase_threads(pp, 0);
+    }
+    return 0;
+}
+
+
+/**
+ * Function that runs all tests
+ */
+static char *
+all_tests() {
+    mu_run_test(test_set_bitmap);
+    mu_run_test(test_set_sorted);
+    mu_run_test(test_set_diff);
+    mu_run_test(test_corpus_subset_count);
+    mu_run_test(test_phase_threads_spec);
+    return 0;
+}
+
+int
+main() {
+    printf("\n-------------------------------------------------------\n");
+    printf("Util Tests\n");
+    printf("---------------------------------------------------------\n");
+
+    char *result = all_tests();
+    if(result != 0) {
+        printf("FAIL: %s\n", result);
+    }
+    else {
+        printf("ALL TESTS PASSED\n");
+    }
+    printf("Tests Passed: %d/%d\n", tests_passed, tests_run);
+
+    return result != 0;
+}
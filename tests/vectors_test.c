@@ -0,0 +1,257 @@
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include "minunit.h"
+#include "../src/nlk.h"
+#include "../src/nlk_random.h"
+#include "../src/nlk_array.h"
+#include "../src/nlk_pca.h"
+#include "../src/nlk_kmeans.h"
+#include "../src/nlk_vocabulary.h"
+
+int tests_run = 0;
+int tests_passed = 0;
+
+
+/**
+ * Test PCA on a rank 3 table: the components are orthonormal, they recover
+ * the variance of the table and the projected columns have that variance
+ */
+static char *
+test_pca_rank()
+{
+    const size_t n = 2000;
+    const size_t d = 20;
+    const size_t k = 3;
+    const double scale[3] = {3.0, 2.0, 1.0};
+    NLK_ARRAY *table = nlk_array_create(n, d);
+    NLK_ARRAY *proj;
+    struct nlk_pca_t *pca;
+    struct nlk_rng_t *rng = nlk_rng_thread();
+    double dir[3][20];
+    double mean[20];
+    double total = 0;
+    double explained = 0;
+    double sum;
+    double sum2;
+
+    printf("Testing PCA\n");
+
+    /* orthonormal directions: disjoint supports, unit norm */
+    for(size_t kk = 0; kk < k; kk++) {
+        sum = 0;
+        for(size_t jj = 0; jj < d; jj++) {
+            dir[kk][jj] = jj % k == kk ? 1 : 0;
+            sum += dir[kk][jj];
+        }
+        for(size_t jj = 0; jj < d; jj++) {
+            dir[kk][jj] /= sqrt(sum);
+        }
+    }
+
+    /* rows: an offset plus a combination of the directions */
+    for(size_t ii = 0; ii < n; ii++) {
+        for(size_t jj = 0; jj < d; jj++) {
+            table->data[ii * d + jj] = 0.5 + 0.1 * jj;
+        }
+        for(size_t kk = 0; kk < k; kk++) {
+            double a = scale[kk] *
+                       (2 * nlk_rng_to_float(nlk_rng_next(rng)) - 1);
+            for(size_t jj = 0; jj < d; jj++) {
+                table->data[ii * d + jj] += a * dir[kk][jj];
+            }
+        }
+    }
+
+    /* total variance of the table */
+    for(size_t jj = 0; jj < d; jj++) {
+        mean[jj] = 0;
+        for(size_t ii = 0; ii < n; ii++) {
+            mean[jj] += table->data[ii * d + jj];
+        }
+        mean[jj] /= n;
+        for(size_t ii = 0; ii < n; ii++) {
+            sum = table->data[ii * d + jj] - mean[jj];
+            total += sum * sum / (n - 1);
+        }
+    }
+
+    pca = nlk_pca_fit(table, k, false);
+    mu_assert("pca: fit failed", pca != NULL);
+
+    /* components are orthonormal */
+    for(size_t aa = 0; aa < k; aa++) {
+        for(size_t bb = 0; bb < k; bb++) {
+            sum = 0;
+            for(size_t jj = 0; jj < d; jj++) {
+                sum += pca->components->data[jj * k + aa] *
+                       pca->components->data[jj * k + bb];
+            }
+            mu_assert("pca: components are not orthonormal",
+                      fabs(sum - (aa == bb)) < 1e-4);
+        }
+    }
+
+    /* variance is recovered, largest first, along the directions */
+    for(size_t kk = 0; kk < k; kk++) {
+        explained += pca->variance->data[kk];
+        if(kk > 0) {
+            mu_assert("pca: variance not in descending order",
+                      pca->variance->data[kk] <
+                      pca->variance->data[kk - 1]);
+        }
+        sum = 0;
+        for(size_t jj = 0; jj < d; jj++) {
+            sum += pca->components->data[jj * k + kk] * dir[kk][jj];
+        }
+        mu_assert("pca: component is not the direction",
+                  fabs(fabs(sum) - 1) < 1e-3);
+    }
+    mu_assert("pca: variance not recovered",
+              fabs(explained - total) < 1e-3 * total);
+
+    /* projected columns: zero mean, the component's variance */
+    proj = nlk_pca_project(pca, table);
+    mu_assert("pca: bad projection size", proj->rows == n && proj->cols == k);
+    for(size_t kk = 0; kk < k; kk++) {
+        sum = 0;
+        sum2 = 0;
+        for(size_t ii = 0; ii < n; ii++) {
+            sum += proj->data[ii * k + kk];
+            sum2 += proj->data[ii * k + kk] * proj->data[ii * k + kk];
+        }
+        mu_assert("pca: projection is not centered", fabs(sum / n) < 1e-3);
+        mu_assert("pca: projected variance",
+                  fabs(sum2 / (n - 1) - pca->variance->data[kk]) <
+                  1e-3 * pca->variance->data[kk]);
+    }
+
+    nlk_array_free(proj);
+    nlk_pca_free(pca);
+    nlk_array_free(table);
+    return 0;
+}
+
+
+/**
+ * Test k-means (full and mini-batch) on well separated blobs and writing
+ * the clusters of word vectors
+ */
+static char *
+test_kmeans_blobs()
+{
+    const size_t n = 300;
+    const size_t d = 4;
+    const size_t k = 3;
+    const nlk_real centers[3][4] = {{5, 0, 0, 0}, {0, 5, 0, 0}, 
+                                    {0, 0, -5, 5}};
+    NLK_ARRAY *table = nlk_array_create(n, d);
+    struct nlk_rng_t *rng = nlk_rng_thread();
+    struct nlk_kmeans_t *km;
+    struct nlk_vocab_t *vocab = NULL;
+    struct nlk_vocab_t *vi;
+    unsigned int assign[300];
+    unsigned int blob[3];
+    char word[32];
+    unsigned int cluster;
+    double inertia;
+    double dist;
+
+    printf("Testing k-means\n");
+
+    /* row ii is in blob ii % 3 */
+    for(size_t ii = 0; ii < n; ii++) {
+        for(size_t jj = 0; jj < d; jj++) {
+            table->data[ii * d + jj] = centers[ii % k][jj] + 0.2 * 
+                        (2 * nlk_rng_to_float(nlk_rng_next(rng)) - 1);
+        }
+    }
+
+    for(size_t batch = 0; batch <= 32; batch += 32) {
+        km = nlk_kmeans_fit(table, k, batch > 0 ? 200 : 0, batch, false);
+        mu_assert("kmeans: fit failed", km != NULL);
+        mu_assert("kmeans: bad centroids size", km->centroids->rows == k &&
+                                               km->centroids->cols == d);
+        inertia = nlk_kmeans_assign(km, table, assign);
+        mu_assert("kmeans: inertia too large", inertia < n * d * 0.04);
+
+        /* one cluster per blob, the blob's center */
+        for(size_t bb = 0; bb < k; bb++) {
+            blob[bb] = assign[bb];
+            for(size_t cc = 0; cc < bb; cc++) {
+                mu_assert("kmeans: blobs share a cluster", blob[bb] != blob[cc]);
+            }
+            dist = 0;
+            for(size_t jj = 0; jj < d; jj++) {
+                nlk_real diff = km->centroids->data[blob[bb] * d + jj] - 
+                                centers[bb][jj];
+                dist += diff * diff;
+            }
+            mu_assert("kmeans: centroid is not the blob's center", 
+                      dist < 0.05);
+        }
+        for(size_t ii = 0; ii < n; ii++) {
+            mu_assert("kmeans: blob split", assign[ii] == blob[ii % k]);
+        }
+        nlk_kmeans_free(km);
+    }
+
+    /* word vectors: the id written is the word */
+    for(size_t ii = 0; ii < n; ii++) {
+        snprintf(word, sizeof(word), "w%zu", ii);
+        vi = nlk_vocab_add(&vocab, word, NLK_VOCAB_WORD);
+        vi->index = ii;
+    }
+    nlk_kmeans_cluster_path(table, &vocab, k, 0, 0, "tmp/kmeans.txt", false);
+    FILE *fp = fopen("tmp/kmeans.txt", "r");
+    mu_assert("kmeans: unable to read clusters", fp != NULL);
+    for(size_t ii = 0; ii < n; ii++) {
+        char expected[32];
+        mu_assert("kmeans: bad clusters line", 
+                  fscanf(fp, "%31s %u", word, &cluster) == 2);
+        snprintf(expected, sizeof(expected), "w%zu", ii);
+        mu_assert("kmeans: the id is not the word", 
+                  strcmp(word, expected) == 0);
+        assign[ii] = cluster;
+    }
+    for(size_t ii = k; ii < n; ii++) {
+        mu_assert("kmeans: written blob split", assign[ii] == assign[ii % k]);
+    }
+    fclose(fp);
+
+    nlk_vocab_free(&vocab);
+    nlk_array_free(table);
+    return 0;
+}
+
+
+/**
+ * Function that runs all tests
+ */
+static char *
+all_tests() {
+    mu_run_test(test_pca_rank);
+    mu_run_test(test_kmeans_blobs);
+    return 0;
+}
+
+int
+main() {
+    printf("\n-------------------------------------------------------\n");
+    printf("Vectors Tests\n");
+    printf("---------------------------------------------------------\n");
+
+    nlk_init();
+    nlk_random_init_xs1024(1);
+
+    char *result = all_tests();
+    if(result != 0) {
+        printf("FAIL: %s\n", result);
+    }
+    else {
+        printf("ALL TESTS PASSED\n");
+    }
+    printf("Tests Passed: %d/%d\n", tests_passed, tests_run);
+
+    return result != 0;
+}
@@ -3,6 +3,9 @@
 #include "minunit.h"
 #include "../src/nlk_vocabulary.h"
 #include "../src/nlk_text.h"
+#include "../src/nlk_subword.h"
+#include "../src/nlk_neuralnet.h"
+#include "../src/nlk_eval.h"
  
 int tests_run = 0;
 int tests_passed = 0;
@@ -159,11 +162,163 @@ test_vocab_create_large()
     return 0;
 }
 
+/**
+ * Test hashing words beyond the most frequent into buckets
+ */
+static char *
+test_vocab_reduce_hash()
+{
+    struct nlk_vocab_t *vocab = NULL;
+    struct nlk_vocab_t *replacement;
+    struct nlk_vocab_t *varray[4];
+    char *words[] = { "a", "a", "a", "b", "b", "c", "d", "e", "" };
+    char *unseen[] = { "zzz", "zzz", "" };
+    size_t len;
+
+    nlk_vocab_add(&vocab, NLK_START_SYMBOL, NLK_VOCAB_SPECIAL);
+    for(size_t ii = 0; words[ii][0] != '\0'; ii++) {
+        nlk_vocab_add(&vocab, words[ii], NLK_VOCAB_WORD);
+    }
+
+    /* keep "a" and "b", hash "c", "d", "e" */
+    nlk_vocab_reduce_hash(&vocab, 0, 2, 4);
+    mu_assert("Hash: wrong vocabulary size", nlk_vocab_size(&vocab) == 7);
+    mu_assert("Hash: frequent word removed", 
+              nlk_vocab_find(&vocab, "b") != NULL);
+    mu_assert("Hash: infrequent word kept", 
+              nlk_vocab_find(&vocab, "c") == NULL);
+    mu_assert("Hash: total count changed", nlk_vocab_total(&vocab) == 9);
+
+    /* unseen words map to the same bucket */
+    replacement = nlk_vocab_get_replacement(&vocab);
+    mu_assert("Hash: no replacement", replacement != NULL);
+    len = nlk_vocab_vocabularize(&vocab, unseen, replacement, varray);
+    mu_assert("Hash: word dropped", len == 2);
+    mu_assert("Hash: not a bucket", varray[0]->type == NLK_VOCAB_BUCKET);
+    mu_assert("Hash: not deterministic", varray[0] == varray[1]);
+
+    nlk_vocab_free(&vocab);
+    return 0;
+}
+
+static char *
+test_subword_oov()
+{
+    struct nlk_vocab_t *vocab = NULL;
+    struct nlk_vocab_t *oov;
+    struct nlk_subword_t *sw;
+    struct nlk_layer_lookup_t *words;
+    uint32_t ids[NLK_SUBWORD_MAX_NGRAMS];
+    NLK_ARRAY *vec;
+
+    nlk_vocab_add(&vocab, NLK_START_SYMBOL, NLK_VOCAB_SPECIAL);
+    nlk_vocab_add(&vocab, "walking", NLK_VOCAB_WORD);
+    nlk_vocab_add(&vocab, "talking", NLK_VOCAB_WORD);
+
+    /* "<ab>": "<ab", "ab>" */
+    mu_assert("Subword: wrong number of n-grams", 
+              nlk_subword_ngrams("ab", 3, 3, 100, ids) == 2);
+
+    sw = nlk_subword_create(&vocab, 1000, 10, 3, 6, 4);
+    words = nlk_layer_lookup_create(3, 10);
+    oov = nlk_vocab_find(&vocab, "walking");
+    mu_assert("Subword: no n-grams for word", 
+              sw->offsets[oov->index + 1] > sw->offsets[oov->index]);
+
+    /* OOV words are cached once */
+    oov = nlk_subword_oov(sw, "walked");
+    mu_assert("Subword: OOV not cached", oov != NULL);
+    mu_assert("Subword: bad OOV index", oov->index >= sw->vocab_size);
+    mu_assert("Subword: OOV cached twice", 
+              nlk_subword_oov(sw, "walked") == oov && sw->cache_size == 1);
+
+    /* query matches the cached vector */
+    vec = nlk_array_create(10, 1);
+    mu_assert("Subword: no vector", 
+              nlk_subword_word_vector(sw, words, &vocab, "walked", vec)
+              == NLK_SUCCESS);
+    mu_assert("Subword: vector differs from cache", 
+              nlk_array_compare_carray(vec, sw->cache_vectors->data, 1e-6));
+
+    nlk_array_free(vec);
+    nlk_layer_lookup_free(words);
+    nlk_subword_free(sw);
+    nlk_vocab_free(&vocab);
+    return 0;
+}
+
+/**
+ * Test OOV question words in the word-analogy evaluation: skipped without 
+ * subwords, represented by their n-gram vectors with them
+ */
+static char *
+test_subword_eval_oov()
+{
+    const char *path = "tmp/subword_questions.txt";
+    char *names[6] = {NLK_START_SYMBOL, "man", "woman", "queen", 
+                      "king", "apple"};
+    const nlk_real rows[6][4] = {{0, 0, 0, -1}, {0, 1, 0, 0}, {0, 0, 1, 0},
+                                 {1, -1, 1, 0}, {0, 0, 1, 1}, {0, 0, 0, 1}};
+    struct nlk_vocab_t *vocab = NULL;
+    struct nlk_subword_t *sw;
+    NLK_ARRAY *weights;
+    nlk_real accuracy;
+
+    printf("Testing OOV words in the word-analogy evaluation\n");
+
+    nlk_vocab_add(&vocab, names[0], NLK_VOCAB_SPECIAL);
+    for(size_t ii = 1; ii < 6; ii++) {
+        nlk_vocab_add(&vocab, names[ii], NLK_VOCAB_WORD);
+    }
+    /* indices start at 1: row 0 is unused */
+    weights = nlk_array_create(7, 4);
+    nlk_array_zero(weights);
+    for(size_t ii = 0; ii < 6; ii++) {
+        const size_t index = nlk_vocab_find(&vocab, names[ii])->index;
+        for(size_t jj = 0; jj < 4; jj++) {
+            weights->data[index * 4 + jj] = rows[ii][jj];
+        }
+    }
+
+    /* all n-grams point the same way: an OOV word is (1, 0, 0, 0) */
+    sw = nlk_subword_create(&vocab, 100, 4, 3, 6, 4);
+    nlk_array_zero(sw->ngrams->weights);
+    for(size_t ii = 0; ii < sw->ngrams->weights->rows; ii++) {
+        sw->ngrams->weights->data[ii * 4] = 1;
+    }
+
+    /* kingly - man + woman = queen (OOV); king - man + woman != apple */
+    FILE *fp = fopen(path, "w");
+    mu_assert("Subword: unable to write questions", fp != NULL);
+    fprintf(fp, ": test\nman kingly woman queen\nman king woman apple\n");
+    fclose(fp);
+
+    mu_assert("Subword: evaluation failed",
+              nlk_eval_on_questions_threads(path, &vocab, weights, NULL, 0,
+                                            false, 1, &accuracy) 
+              == NLK_SUCCESS);
+    mu_assert("Subword: OOV question not skipped", accuracy == 0);
+    mu_assert("Subword: evaluation failed",
+              nlk_eval_on_questions_threads(path, &vocab, weights, sw, 0,
+                                            false, 1, &accuracy) 
+              == NLK_SUCCESS);
+    mu_assert("Subword: wrong OOV answer", accuracy == 0.5);
+    mu_assert("Subword: evaluation used the OOV cache", sw->cache_size == 0);
+
+    nlk_array_free(weights);
+    nlk_subword_free(sw);
+    nlk_vocab_free(&vocab);
+    return 0;
+}
+
 /**
  * Function that runs all tests
  */
 static char *
 all_tests() {
+    mu_run_test(test_vocab_reduce_hash);
+    mu_run_test(test_subword_oov);
+    mu_run_test(test_subword_eval_oov);
     mu_run_test(test_vocab_create_large);
     mu_run_test(test_vocab_create_large_id);
     return 0;
@@ -0,0 +1,269 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "minunit.h"
+#include "../src/nlk.h"
+#include "../src/nlk_array.h"
+#include "../src/nlk_math.h"
+#include "../src/nlk_random.h"
+#include "../src/nlk_layer_lookup.h"
+#include "../src/nlk_neuralnet.h"
+#include "../src/nlk_vocabulary.h"
+#include "../src/nlk_window.h"
+#include "../src/nlk_w2v.h"
+
+int tests_run = 0;
+int tests_passed = 0;
+
+#define N_WORDS     64
+#define WINDOW      4
+#define VECTOR_SIZE 8
+
+
+/**
+ * Largest absolute difference between two arrays
+ */
+static nlk_real
+w2v_test_diff(const NLK_ARRAY *a, const NLK_ARRAY *b)
+{
+    nlk_real diff = 0;
+
+    for(size_t ii = 0; ii < a->len; ii++) {
+        diff = fmax(diff, fabs(a->data[ii] - b->data[ii]));
+    }
+    return diff;
+}
+
+/**
+ * Unfused negative sampling for a batch of examples (as nlk_w2v_neg_batch):
+ * forward all the examples, then backprop them one at a time
+ */
+static void
+w2v_test_neg_batch(struct nlk_neuralnet_t *nn, const nlk_real learn_rate,
+                   const size_t *batch, const size_t n, const bool positive,
+                   const NLK_ARRAY *lk1_out, NLK_ARRAY *grad_acc)
+{
+    nlk_real scores[NLK_RNG_BLOCK];
+    nlk_real out[NLK_RNG_BLOCK];
+
+    for(size_t ii = 0; ii < n; ii++) {
+        nlk_layer_lookup_forward(nn->neg, lk1_out, batch[ii], &scores[ii]);
+    }
+    nlk_sigmoid_vector(scores, n, out);
+    for(size_t ii = 0; ii < n; ii++) {
+        const nlk_real label = (ii == 0 && positive) ? 1.0 : 0.0;
+        nlk_layer_lookup_backprop_acc(nn->neg, lk1_out, batch[ii],
+                                      (label - out[ii]) * learn_rate,
+                                      grad_acc);
+    }
+}
+
+/**
+ * Unfused PVDM concat negative sampling: materialize the concatenated input,
+ * accumulate the gradient over all the batches, then learn the PV and word
+ * vectors once.
+ */
+static void
+w2v_test_pvdm_cc_neg(struct nlk_neuralnet_t *nn,
+                     struct nlk_layer_lookup_t *par_table,
+                     const nlk_real learn_rate,
+                     const struct nlk_context_t *context,
+                     NLK_ARRAY *grad_acc, NLK_ARRAY *lk1_out)
+{
+    const size_t ppos = context->size - 1;
+    const size_t negative = nn->train_opts.negative;
+    const size_t center_word = context->target->index;
+    struct nlk_rng_t *rng = nlk_rng_thread();
+    size_t targets[NLK_RNG_BLOCK];
+    size_t batch[NLK_RNG_BLOCK];
+    size_t n = 0;
+    bool positive = true;
+
+    nlk_layer_lookup_forward_lookup_one(par_table, context->window[ppos],
+                                        lk1_out);
+    nlk_layer_lookup_forward_lookup_concat_p(nn->words, context->window,
+                                             ppos, lk1_out);
+    nlk_array_zero(grad_acc);
+
+    /* the positive example, then the negatives drawn as nlk_pvdm_cc does */
+    batch[n] = center_word;
+    n++;
+    for(size_t ex = 0; ex < negative; ex++) {
+        if(ex % NLK_RNG_BLOCK == 0) {
+            nlk_rng_negatives(rng, nn->neg_table, nn->neg_table_size,
+                              negative - ex < NLK_RNG_BLOCK ?
+                              negative - ex : NLK_RNG_BLOCK, targets);
+        }
+        if(targets[ex % NLK_RNG_BLOCK] == center_word) {
+            continue;
+        }
+        batch[n] = targets[ex % NLK_RNG_BLOCK];
+        n++;
+        if(n == NLK_RNG_BLOCK) {
+            w2v_test_neg_batch(nn, learn_rate, batch, n, positive, lk1_out,
+                               grad_acc);
+            positive = false;
+            n = 0;
+        }
+    }
+    if(n > 0) {
+        w2v_test_neg_batch(nn, learn_rate, batch, n, positive, lk1_out,
+                           grad_acc);
+    }
+
+    nlk_layer_lookup_backprop_lookup_concat_one(par_table,
+                                                context->window[ppos],
+                                                0, grad_acc);
+    nlk_layer_lookup_backprop_lookup_concat(nn->words, context->window,
+                                            ppos, 1, grad_acc);
+}
+
+/**
+ * Fused and unfused PVDM concat negative sampling give the same gradient
+ * and weights for the same negatives: more negatives than a batch, with a
+ * repeated context word and random NEG weights so that an early update of
+ * the source rows would change the later batches.
+ */
+static char *
+test_pvdm_cc_neg_fused()
+{
+    const char *path = "tmp/w2v_corpus.txt";
+    const nlk_real learn_rate = 0.05;
+    const char *window_words[WINDOW] = {"w3", "w17", "w3", "w40"};
+    struct nlk_vocab_t *vocab;
+    struct nlk_neuralnet_t *nn;
+    struct nlk_context_t *context;
+    struct nlk_rng_t *rng;
+    struct nlk_rng_t saved;
+    NLK_ARRAY *words;
+    NLK_ARRAY *pvs;
+    NLK_ARRAY *neg;
+    NLK_ARRAY *grad_fused;
+    NLK_ARRAY *grad_acc;
+    NLK_ARRAY *lk1_out;
+    char word[16];
+
+    printf("Testing fused PVDM concat negative sampling\n");
+    nlk_random_init_xs1024(1);
+
+    /* vocabulary: word ii appears ii + 1 times */
+    FILE *fp = fopen(path, "w");
+    mu_assert("w2v: unable to write corpus", fp != NULL);
+    for(size_t ii = 0; ii < N_WORDS; ii++) {
+        for(size_t jj = 0; jj <= ii; jj++) {
+            fprintf(fp, "w%zu ", ii);
+        }
+        fprintf(fp, "\n");
+    }
+    fclose(fp);
+    vocab = nlk_vocab_create(path, false, 1, false, false);
+
+    /* network */
+    struct nlk_nn_train_t train_opts;
+    memset(&train_opts, 0, sizeof(train_opts));
+    train_opts.model_type = NLK_PVDM_CONCAT;
+    train_opts.window = WINDOW;
+    train_opts.learn_rate = learn_rate;
+    train_opts.negative = NLK_RNG_BLOCK + 44;
+    train_opts.vector_size = VECTOR_SIZE;
+    train_opts.paragraph = true;
+    train_opts.paragraph_count = 4;
+    nn = nlk_w2v_create(train_opts, true, vocab, false);
+    mu_assert("w2v: network creation failed", nn != NULL);
+    nn->neg_table_size = nlk_vocab_neg_table_get_size();
+    nn->neg_table = nlk_vocab_neg_table_create(&nn->vocab, nn->neg_table_size,
+                                               NLK_NEG_TABLE_POW);
+    for(size_t ii = 0; ii < nn->neg->weights->len; ii++) {
+        nn->neg->weights->data[ii] = 0.5 * sin(ii * 0.37);
+    }
+
+    /* context: the window words and paragraph 2 */
+    context = nlk_context_create(WINDOW + 1);
+    for(size_t ii = 0; ii < WINDOW; ii++) {
+        strcpy(word, window_words[ii]);
+        context->window[ii] = nlk_vocab_find(&vocab, word)->index;
+        context->is_paragraph[ii] = false;
+    }
+    context->window[WINDOW] = 2;
+    context->is_paragraph[WINDOW] = true;
+    context->size = WINDOW + 1;
+    strcpy(word, "w21");
+    context->target = nlk_vocab_find(&vocab, word);
+
+    /* initial weights and RNG stream */
+    words = nlk_array_create_copy(nn->words->weights);
+    pvs = nlk_array_create_copy(nn->paragraphs->weights);
+    neg = nlk_array_create_copy(nn->neg->weights);
+    grad_acc = nlk_array_create(1, nn->neg->weights->cols);
+    lk1_out = nlk_array_create(nn->neg->weights->cols, 1);
+    rng = nlk_rng_thread();
+    memcpy(&saved, rng, sizeof(saved));
+
+    /* fused */
+    nlk_pvdm_cc(nn, nn->paragraphs, learn_rate, context, grad_acc, lk1_out);
+    grad_fused = nlk_array_create_copy(grad_acc);
+    mu_assert("w2v: fused did not learn",
+              w2v_test_diff(nn->paragraphs->weights, pvs) > 1e-4 &&
+              w2v_test_diff(nn->words->weights, words) > 1e-4);
+
+    /* swap the learned weights with the initial ones, run unfused */
+    NLK_ARRAY *tmp;
+    tmp = nn->words->weights; nn->words->weights = words; words = tmp;
+    tmp = nn->paragraphs->weights; nn->paragraphs->weights = pvs; pvs = tmp;
+    tmp = nn->neg->weights; nn->neg->weights = neg; neg = tmp;
+    memcpy(rng, &saved, sizeof(saved));
+    w2v_test_pvdm_cc_neg(nn, nn->paragraphs, learn_rate, context, grad_acc,
+                         lk1_out);
+
+    mu_assert("w2v: fused gradient differs",
+              w2v_test_diff(grad_acc, grad_fused) < 1e-5);
+    mu_assert("w2v: fused PVs differ",
+              w2v_test_diff(nn->paragraphs->weights, pvs) < 1e-5);
+    mu_assert("w2v: fused word vectors differ",
+              w2v_test_diff(nn->words->weights, words) < 1e-5);
+    mu_assert("w2v: fused NEG weights differ",
+              w2v_test_diff(nn->neg->weights, neg) < 1e-5);
+
+    nlk_array_free(words);
+    nlk_array_free(pvs);
+    nlk_array_free(neg);
+    nlk_array_free(grad_fused);
+    nlk_array_free(grad_acc);
+    nlk_array_free(lk1_out);
+    nlk_context_free(context);
+    free(nn->neg_table);
+    nlk_neuralnet_free(nn);
+    nlk_vocab_free(&vocab);
+    return 0;
+}
+
+
+/**
+ * Function that runs all tests
+ */
+static char *
+all_tests() {
+    mu_run_test(test_pvdm_cc_neg_fused);
+    return 0;
+}
+
+int
+main() {
+    printf("\n-------------------------------------------------------\n");
+    printf("W2V Tests\n");
+    printf("---------------------------------------------------------\n");
+
+    nlk_init();
+
+    char *result = all_tests();
+    if(result != 0) {
+        printf("FAIL: %s\n", result);
+    }
+    else {
+        printf("ALL TESTS PASSED\n");
+    }
+    printf("Tests Passed: %d/%d\n", tests_passed, tests_run);
+
+    return result != 0;
+}